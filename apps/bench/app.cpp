@@ -0,0 +1,85 @@
+#include "gft/args.hpp"
+#include "gft/bench.hpp"
+#include "gft/json.hpp"
+#include "gft/log.hpp"
+#include "gft/util.hpp"
+
+using namespace liong;
+
+struct AppConfig {
+  std::string filter = "*";
+  std::string out_path = "";
+  std::string baseline_path = "";
+  uint32_t nsample = 30;
+  uint32_t min_sample_time_us = 5000;
+  uint32_t warmup_time_us = 100000;
+} CFG;
+
+void initialize(int argc, const char** argv) {
+  args::init_arg_parse("Bench", "GraphiT micro-benchmarks.");
+  args::reg_arg<args::StringParser>(
+    "-f", "--filter", CFG.filter,
+    "Only run benchmarks whose names match this wildcard pattern."
+  );
+  args::reg_arg<args::StringParser>(
+    "-o", "--out", CFG.out_path, "Save the results to this JSON file."
+  );
+  args::reg_arg<args::StringParser>(
+    "-b", "--baseline", CFG.baseline_path,
+    "Compare the results against a JSON file saved by a previous run."
+  );
+  args::reg_arg<args::UintParser>(
+    "-n", "--nsample", CFG.nsample, "Number of samples per benchmark."
+  );
+  args::reg_arg<args::UintParser>(
+    "-t", "--min-sample-time", CFG.min_sample_time_us,
+    "Minimal duration of each sample in microseconds."
+  );
+  args::reg_arg<args::UintParser>(
+    "-w", "--warmup-time", CFG.warmup_time_us,
+    "Warm-up duration of each benchmark in microseconds."
+  );
+  args::parse_args(argc, argv);
+}
+
+int main(int argc, const char** argv) {
+  int ret = 0;
+  try {
+    initialize(argc, argv);
+
+    bench::BenchConfig bench_cfg {};
+    bench_cfg.filter = CFG.filter;
+    bench_cfg.nsample = CFG.nsample;
+    bench_cfg.min_sample_time_us = CFG.min_sample_time_us;
+    bench_cfg.warmup_time_us = CFG.warmup_time_us;
+    std::vector<bench::BenchResult> results =
+      bench::BenchRegistry::run_all(bench_cfg);
+
+    if (!CFG.out_path.empty()) {
+      util::save_text(
+        CFG.out_path.c_str(), json::print(bench::results2json(results))
+      );
+      L_INFO("saved results to '", CFG.out_path, "'");
+    }
+    if (!CFG.baseline_path.empty()) {
+      std::vector<bench::BenchResult> baseline = bench::json2results(
+        json::parse(util::load_text(CFG.baseline_path.c_str()))
+      );
+      uint32_t nregression = bench::compare_results(baseline, results);
+      if (nregression > 0) {
+        L_WARN(nregression, " benchmarks regressed");
+        ret = 1;
+      }
+    }
+  } catch (const std::exception& e) {
+    L_ERROR("application threw an exception");
+    L_ERROR(e.what());
+    L_ERROR("application cannot continue");
+    return -1;
+  } catch (...) {
+    L_ERROR("application threw an illiterate exception");
+    return -1;
+  }
+
+  return ret;
+}
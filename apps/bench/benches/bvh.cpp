@@ -0,0 +1,197 @@
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "gft/bench.hpp"
+#include "gft/bvh.hpp"
+#include "gft/log.hpp"
+#include "gft/mesh.hpp"
+#include "gft/rand.hpp"
+
+using namespace liong;
+
+namespace {
+
+// Triangles of the OBJ model at `GFT_BENCH_OBJ` if set, or a bumpy UV sphere
+// of about half a million triangles otherwise.
+const std::vector<geom::Triangle>& get_bench_model() {
+  static std::vector<geom::Triangle> tris = []() {
+    const char* path = std::getenv("GFT_BENCH_OBJ");
+    if (path != nullptr) {
+      L_INFO("loading benchmark model from '", path, "'");
+      return mesh::load_obj(path).to_tris();
+    }
+
+    const float PI = 3.14159265358979f;
+    const uint32_t NLAT = 384;
+    const uint32_t NLON = 768;
+    auto vert = [&](uint32_t ilat, uint32_t ilon) {
+      float theta = PI * ilat / NLAT;
+      float phi = 2.0f * PI * ilon / NLON;
+      float r = 1.0f + 0.05f * std::sin(theta * 37.0f) * std::cos(phi * 23.0f);
+      return r * glm::vec3(
+        std::sin(theta) * std::cos(phi),
+        std::cos(theta),
+        std::sin(theta) * std::sin(phi)
+      );
+    };
+    std::vector<geom::Triangle> out;
+    out.reserve(NLAT * NLON * 2);
+    for (uint32_t ilat = 0; ilat < NLAT; ++ilat) {
+      for (uint32_t ilon = 0; ilon < NLON; ++ilon) {
+        glm::vec3 a = vert(ilat, ilon);
+        glm::vec3 b = vert(ilat + 1, ilon);
+        glm::vec3 c = vert(ilat + 1, ilon + 1);
+        glm::vec3 d = vert(ilat, ilon + 1);
+        out.emplace_back(geom::Triangle { a, b, c });
+        out.emplace_back(geom::Triangle { a, c, d });
+      }
+    }
+    return out;
+  }();
+  return tris;
+}
+const geom::TriangleBvh& get_bench_bvh() {
+  static geom::TriangleBvh bvh =
+    geom::TriangleBvh::build(std::vector<geom::Triangle>(get_bench_model()));
+  return bvh;
+}
+
+// Rays from a sphere around the model towards random points inside its
+// bounds.
+std::vector<geom::Ray> make_bench_rays(const geom::Aabb& aabb, size_t nray) {
+  std::vector<geom::Ray> out;
+  out.reserve(nray);
+  rand::Lcg rng;
+  glm::vec3 center = aabb.center();
+  float radius = glm::length(aabb.size());
+  for (size_t i = 0; i < nray; ++i) {
+    glm::vec3 dir =
+      glm::vec3(rng.unorm(), rng.unorm(), rng.unorm()) - 0.5f + 1e-3f;
+    glm::vec3 p = center + glm::normalize(dir) * radius;
+    glm::vec3 target = aabb.min +
+      aabb.size() * glm::vec3(rng.unorm(), rng.unorm(), rng.unorm());
+    out.emplace_back(geom::Ray { p, target - p });
+  }
+  return out;
+}
+
+} // namespace
+
+L_BENCH(BvhBuild) {
+  const std::vector<geom::Triangle>& tris = get_bench_model();
+  std::vector<geom::Aabb> aabbs;
+  for (const auto& tri : tris) {
+    aabbs.emplace_back(geom::Aabb::from_points(&tri.a, 3));
+  }
+  for (auto _ : state) {
+    bench::do_not_optimize(geom::Bvh::build(aabbs));
+  }
+}
+
+L_BENCH(BvhCollapseWide) {
+  const geom::TriangleBvh& bvh = get_bench_bvh();
+  for (auto _ : state) {
+    bench::do_not_optimize(geom::WideBvh<4>::from_bvh(bvh.bvh));
+  }
+}
+
+L_BENCH(BvhRefit) {
+  geom::TriangleBvh bvh =
+    geom::TriangleBvh::build(std::vector<geom::Triangle>(get_bench_model()));
+  // Two poses of a wave running across the model, like a skinned mesh
+  // animated between frames.
+  std::vector<geom::Triangle> poses[2];
+  for (uint32_t i = 0; i < 2; ++i) {
+    float phase = i * 0.5f;
+    auto wave = [&](glm::vec3 p) {
+      return p + glm::vec3(0.0f, 0.1f * std::sin(p.x * 4.0f + phase), 0.0f);
+    };
+    for (const auto& tri : bvh.tris) {
+      poses[i].emplace_back(
+        geom::Triangle { wave(tri.a), wave(tri.b), wave(tri.c) });
+    }
+  }
+  uint32_t ipose = 0;
+  for (auto _ : state) {
+    bench::do_not_optimize(bvh.refit(poses[ipose]));
+    ipose ^= 1;
+  }
+}
+
+L_BENCH(BvhRaycast) {
+  const geom::TriangleBvh& bvh = get_bench_bvh();
+  std::vector<geom::Ray> rays = make_bench_rays(bvh.bvh.aabb(), 1024);
+  for (auto _ : state) {
+    uint32_t nhit = 0;
+    geom::BvhRayHit hit;
+    for (const auto& ray : rays) {
+      nhit += bvh.raycast(ray, hit) ? 1 : 0;
+    }
+    bench::do_not_optimize(nhit);
+  }
+}
+
+L_BENCH(BvhRaycastBinary) {
+  const geom::TriangleBvh& bvh = get_bench_bvh();
+  std::vector<geom::Ray> rays = make_bench_rays(bvh.bvh.aabb(), 1024);
+  for (auto _ : state) {
+    uint32_t nhit = 0;
+    for (const auto& ray : rays) {
+      bool is_hit = false;
+      float t_max = std::numeric_limits<float>::infinity();
+      bvh.bvh.traverse_ray(ray, t_max, [&](uint32_t itri, float& t_far) {
+        float t;
+        glm::vec2 bary;
+        if (geom::raycast_tri(ray, bvh.tris[itri], t, bary) && t <= t_far) {
+          t_far = t;
+          is_hit = true;
+        }
+        return false;
+      });
+      nhit += is_hit ? 1 : 0;
+    }
+    bench::do_not_optimize(nhit);
+  }
+}
+
+L_BENCH(BvhRaycastAny) {
+  const geom::TriangleBvh& bvh = get_bench_bvh();
+  std::vector<geom::Ray> rays = make_bench_rays(bvh.bvh.aabb(), 1024);
+  for (auto _ : state) {
+    uint32_t nhit = 0;
+    for (const auto& ray : rays) {
+      nhit += bvh.raycast_any(ray) ? 1 : 0;
+    }
+    bench::do_not_optimize(nhit);
+  }
+}
+
+L_BENCH(BvhNearestPoint) {
+  const geom::TriangleBvh& bvh = get_bench_bvh();
+  std::vector<geom::Ray> rays = make_bench_rays(bvh.bvh.aabb(), 1024);
+  for (auto _ : state) {
+    float sum = 0.0f;
+    geom::BvhPointHit hit;
+    for (const auto& ray : rays) {
+      // Ray targets are scattered in the model bounds.
+      if (bvh.nearest_point(ray.p + ray.v, hit)) {
+        sum += hit.dist;
+      }
+    }
+    bench::do_not_optimize(sum);
+  }
+}
+
+L_BENCH(BvhQueryAabb) {
+  const geom::TriangleBvh& bvh = get_bench_bvh();
+  std::vector<geom::Ray> rays = make_bench_rays(bvh.bvh.aabb(), 1024);
+  glm::vec3 size = bvh.bvh.aabb().size() * 0.02f;
+  std::vector<uint32_t> itris;
+  for (auto _ : state) {
+    for (const auto& ray : rays) {
+      itris.clear();
+      bvh.query_aabb(geom::Aabb::from_center_size(ray.p + ray.v, size), itris);
+    }
+    bench::do_not_optimize(itris);
+  }
+}
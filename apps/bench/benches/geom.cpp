@@ -0,0 +1,298 @@
+#include <bitset>
+#include <vector>
+#include "gft/bench.hpp"
+#include "gft/geom.hpp"
+#include "gft/geom-soa.hpp"
+#include "gft/parallel.hpp"
+#include "gft/rand.hpp"
+
+using namespace liong;
+
+namespace {
+
+// Deterministic points scattered in `[-1, 1]^3`.
+std::vector<glm::vec3> make_bench_points(size_t npoint) {
+  std::vector<glm::vec3> out;
+  out.reserve(npoint);
+  rand::Lcg rng;
+  for (size_t i = 0; i < npoint; ++i) {
+    out.emplace_back(rng.vec3());
+  }
+  return out;
+}
+
+} // namespace
+
+L_BENCH(ContainsPointTetra) {
+  geom::Tetrahedron tet {
+    { -1.0f, -1.0f, -1.0f },
+    { 1.0f, -1.0f, -1.0f },
+    { -1.0f, 1.0f, -1.0f },
+    { -1.0f, -1.0f, 1.0f },
+  };
+  std::vector<glm::vec3> points = make_bench_points(1024);
+  for (auto _ : state) {
+    uint32_t ncontained = 0;
+    glm::vec4 bary;
+    for (const auto& point : points) {
+      ncontained += geom::contains_point_tetra(tet, point, bary) ? 1 : 0;
+    }
+    bench::do_not_optimize(ncontained);
+  }
+}
+
+L_BENCH(ContainsPointTetraSoa) {
+  geom::Tetrahedron tet {
+    { -1.0f, -1.0f, -1.0f },
+    { 1.0f, -1.0f, -1.0f },
+    { -1.0f, 1.0f, -1.0f },
+    { -1.0f, -1.0f, 1.0f },
+  };
+  geom::PointSoa points = geom::PointSoa::from_points(make_bench_points(1024));
+  std::vector<uint32_t> masks;
+  for (auto _ : state) {
+    geom::contains_point_tetra(tet, points, masks);
+    bench::do_not_optimize(masks);
+  }
+}
+
+L_BENCH(IntersectAabb) {
+  std::vector<glm::vec3> points = make_bench_points(1024);
+  std::vector<geom::Aabb> aabbs;
+  for (const auto& point : points) {
+    aabbs.emplace_back(geom::Aabb::from_center_size(point, glm::vec3(0.1f)));
+  }
+  for (auto _ : state) {
+    uint32_t nintersected = 0;
+    for (size_t i = 1; i < aabbs.size(); ++i) {
+      nintersected += geom::intersect_aabb(aabbs[i - 1], aabbs[i]) ? 1 : 0;
+    }
+    bench::do_not_optimize(nintersected);
+  }
+}
+
+L_BENCH(SplitAabb2Tetras) {
+  geom::Aabb aabb = geom::Aabb::from_min_max(glm::vec3(-1.0f), glm::vec3(1.0f));
+  std::vector<geom::Tetrahedron> tets;
+  for (auto _ : state) {
+    tets.clear();
+    geom::split_aabb2tetras(aabb, tets);
+    bench::do_not_optimize(tets);
+  }
+}
+
+L_BENCH(SubdivideAabb) {
+  geom::Aabb aabb = geom::Aabb::from_min_max(glm::vec3(-1.0f), glm::vec3(1.0f));
+  std::vector<geom::Aabb> out;
+  for (auto _ : state) {
+    out.clear();
+    geom::subdivide_aabb(aabb, glm::uvec3(64), out);
+    bench::do_not_optimize(out);
+  }
+}
+
+L_BENCH(AabbGridIndex) {
+  geom::AabbGrid grid {
+    geom::Aabb::from_min_max(glm::vec3(-1.0f), glm::vec3(1.0f)),
+    glm::uvec3(64),
+  };
+  for (auto _ : state) {
+    float volume = 0.0f;
+    for (size_t i = 0; i < grid.size(); ++i) {
+      glm::vec3 size = grid[i].size();
+      volume += size.x * size.y * size.z;
+    }
+    bench::do_not_optimize(volume);
+  }
+}
+
+L_BENCH(AabbGridForEach) {
+  geom::AabbGrid grid {
+    geom::Aabb::from_min_max(glm::vec3(-1.0f), glm::vec3(1.0f)),
+    glm::uvec3(64),
+  };
+  for (auto _ : state) {
+    float volume = 0.0f;
+    grid.for_each([&](size_t, const geom::Aabb& sub_aabb) {
+      glm::vec3 size = sub_aabb.size();
+      volume += size.x * size.y * size.z;
+    });
+    bench::do_not_optimize(volume);
+  }
+}
+
+L_BENCH(AabbGridParallelForEach) {
+  geom::AabbGrid grid {
+    geom::Aabb::from_min_max(glm::vec3(-1.0f), glm::vec3(1.0f)),
+    glm::uvec3(128),
+  };
+  std::vector<glm::vec3> points = make_bench_points(16);
+  std::vector<uint8_t> occupied(grid.size());
+  for (auto _ : state) {
+    parallel::parallel_for_range(0, grid.size(), [&](size_t beg, size_t end) {
+      grid.for_each(beg, end, [&](size_t i, const geom::Aabb& sub_aabb) {
+        uint8_t x = 0;
+        for (const auto& point : points) {
+          x |= geom::contains_point_aabb(sub_aabb, point) ? 1 : 0;
+        }
+        occupied[i] = x;
+      });
+    });
+    bench::do_not_optimize(occupied);
+  }
+}
+
+L_BENCH(AabbFromPoints) {
+  std::vector<glm::vec3> points = make_bench_points(4096);
+  state.set_nbyte_per_iter(points.size() * sizeof(glm::vec3));
+  for (auto _ : state) {
+    bench::do_not_optimize(geom::Aabb::from_points(points));
+  }
+}
+
+L_BENCH(GetPointsAabb) {
+  std::vector<glm::vec3> points = make_bench_points(4096);
+  state.set_nbyte_per_iter(points.size() * sizeof(glm::vec3));
+  for (auto _ : state) {
+    bench::do_not_optimize(
+      geom::get_points_aabb(points.data(), points.size()));
+  }
+}
+
+L_BENCH(PointSoaAabb) {
+  geom::PointSoa points = geom::PointSoa::from_points(make_bench_points(4096));
+  state.set_nbyte_per_iter(points.size() * sizeof(glm::vec3));
+  for (auto _ : state) {
+    bench::do_not_optimize(points.aabb());
+  }
+}
+
+L_BENCH(PointSoaApplyTrans) {
+  geom::PointSoa points = geom::PointSoa::from_points(make_bench_points(4096));
+  glm::mat4 trans(1.0f);
+  trans[3] = glm::vec4(1e-3f, 0.0f, 0.0f, 1.0f);
+  state.set_nbyte_per_iter(points.size() * sizeof(glm::vec3));
+  for (auto _ : state) {
+    points.apply_trans(trans);
+    bench::do_not_optimize(points);
+  }
+}
+
+L_BENCH(RaycastTri) {
+  std::vector<glm::vec3> points = make_bench_points(3 * 1024);
+  std::vector<geom::Triangle> tris;
+  for (size_t i = 0; i < points.size(); i += 3) {
+    geom::Triangle tri { points[i], points[i + 1], points[i + 2] };
+    tris.emplace_back(tri);
+  }
+  geom::Ray ray { glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+  for (auto _ : state) {
+    uint32_t nhit = 0;
+    float t;
+    glm::vec2 bary;
+    for (const auto& tri : tris) {
+      nhit += geom::raycast_tri(ray, tri, t, bary) ? 1 : 0;
+    }
+    bench::do_not_optimize(nhit);
+  }
+}
+
+L_BENCH(RaycastTriPacket8) {
+  std::vector<glm::vec3> points = make_bench_points(3 * 1024);
+  std::vector<geom::TrianglePacket<8>> tri_pkts(points.size() / 3 / 8);
+  for (size_t i = 0; i < points.size() / 3; ++i) {
+    geom::Triangle tri { points[i * 3], points[i * 3 + 1], points[i * 3 + 2] };
+    tri_pkts[i / 8].set(i % 8, tri);
+  }
+  geom::Ray ray { glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+  for (auto _ : state) {
+    uint32_t nhit = 0;
+    geom::RayHitPacket<8> hits;
+    for (const auto& tri_pkt : tri_pkts) {
+      nhit += std::bitset<8>(geom::raycast_tri(ray, tri_pkt, hits)).count();
+    }
+    bench::do_not_optimize(nhit);
+  }
+}
+
+L_BENCH(RaycastAabbPacket8) {
+  std::vector<glm::vec3> points = make_bench_points(1024);
+  std::vector<geom::AabbPacket<8>> aabb_pkts(points.size() / 8);
+  for (size_t i = 0; i < points.size(); ++i) {
+    geom::Aabb aabb = geom::Aabb::from_center_size(points[i], glm::vec3(0.1f));
+    aabb_pkts[i / 8].set(i % 8, aabb);
+  }
+  geom::Ray ray { glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.1f, 0.2f, -1.0f) };
+  for (auto _ : state) {
+    uint32_t nhit = 0;
+    geom::RayHitPacket<8> hits;
+    for (const auto& aabb_pkt : aabb_pkts) {
+      nhit += std::bitset<8>(geom::raycast_aabb(ray, aabb_pkt, hits)).count();
+    }
+    bench::do_not_optimize(nhit);
+  }
+}
+
+L_BENCH(IntersectAabbTri) {
+  std::vector<glm::vec3> points = make_bench_points(3 * 1024);
+  geom::Aabb aabb = geom::Aabb::from_center_size(glm::vec3(0.0f),
+    glm::vec3(0.5f));
+  for (auto _ : state) {
+    uint32_t nintersected = 0;
+    for (size_t i = 0; i < points.size(); i += 3) {
+      geom::Triangle tri { points[i], points[i + 1], points[i + 2] };
+      nintersected += geom::intersect_aabb_tri(tri, aabb) ? 1 : 0;
+    }
+    bench::do_not_optimize(nintersected);
+  }
+}
+
+L_BENCH(IntersectAabbTriPacket8) {
+  std::vector<glm::vec3> points = make_bench_points(3 * 1024);
+  std::vector<geom::TrianglePacket<8>> tri_pkts(points.size() / 3 / 8);
+  for (size_t i = 0; i < points.size() / 3; ++i) {
+    geom::Triangle tri { points[i * 3], points[i * 3 + 1], points[i * 3 + 2] };
+    tri_pkts[i / 8].set(i % 8, tri);
+  }
+  geom::Aabb aabb = geom::Aabb::from_center_size(glm::vec3(0.0f),
+    glm::vec3(0.5f));
+  for (auto _ : state) {
+    uint32_t nintersected = 0;
+    for (const auto& tri_pkt : tri_pkts) {
+      nintersected +=
+        std::bitset<8>(geom::intersect_aabb_tri(tri_pkt, aabb)).count();
+    }
+    bench::do_not_optimize(nintersected);
+  }
+}
+
+L_BENCH(IntersectTri) {
+  std::vector<glm::vec3> points = make_bench_points(3 * 1024);
+  geom::Triangle tri0 { points[0], points[1], points[2] };
+  for (auto _ : state) {
+    uint32_t nintersected = 0;
+    for (size_t i = 3; i < points.size(); i += 3) {
+      geom::Triangle tri { points[i], points[i + 1], points[i + 2] };
+      nintersected += geom::intersect_tri(tri0, tri) ? 1 : 0;
+    }
+    bench::do_not_optimize(nintersected);
+  }
+}
+
+L_BENCH(IntersectTriPacket8) {
+  std::vector<glm::vec3> points = make_bench_points(3 * 1024);
+  std::vector<geom::TrianglePacket<8>> tri_pkts(points.size() / 3 / 8);
+  for (size_t i = 0; i < points.size() / 3; ++i) {
+    geom::Triangle tri { points[i * 3], points[i * 3 + 1], points[i * 3 + 2] };
+    tri_pkts[i / 8].set(i % 8, tri);
+  }
+  geom::Triangle tri0 { points[0], points[1], points[2] };
+  for (auto _ : state) {
+    uint32_t nintersected = 0;
+    for (const auto& tri_pkt : tri_pkts) {
+      nintersected +=
+        std::bitset<8>(geom::intersect_tri(tri0, tri_pkt)).count();
+    }
+    bench::do_not_optimize(nintersected);
+  }
+}
@@ -0,0 +1,41 @@
+#include <string>
+#include "gft/bench.hpp"
+#include "gft/json.hpp"
+
+using namespace liong;
+
+namespace {
+
+json::JsonValue make_bench_json() {
+  json::JsonArray arr {};
+  for (int i = 0; i < 256; ++i) {
+    json::JsonObject obj {};
+    obj["name"] = "item_" + std::to_string(i);
+    obj["idx"] = i;
+    obj["weight"] = i * 0.25;
+    obj["enabled"] = i % 2 == 0;
+    arr.inner.emplace_back(std::move(obj));
+  }
+  json::JsonObject out {};
+  out["items"] = std::move(arr);
+  return out;
+}
+
+} // namespace
+
+L_BENCH(JsonParse) {
+  std::string json_lit = json::print(make_bench_json());
+  state.set_nbyte_per_iter(json_lit.size());
+  for (auto _ : state) {
+    json::JsonValue json = json::parse(json_lit);
+    bench::do_not_optimize(json);
+  }
+}
+
+L_BENCH(JsonPrint) {
+  json::JsonValue json = make_bench_json();
+  for (auto _ : state) {
+    std::string json_lit = json::print(json);
+    bench::do_not_optimize(json_lit);
+  }
+}
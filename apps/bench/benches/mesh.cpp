@@ -0,0 +1,63 @@
+#include <cmath>
+#include <vector>
+#include "gft/bench.hpp"
+#include "gft/mesh.hpp"
+
+using namespace liong;
+
+namespace {
+
+// A UV sphere of `nlat * nlon * 2` triangles.
+mesh::Mesh make_bench_sphere(uint32_t nlat, uint32_t nlon) {
+  const float PI = 3.14159265358979f;
+  auto vert = [&](uint32_t ilat, uint32_t ilon) {
+    float theta = PI * ilat / nlat;
+    float phi = 2.0f * PI * ilon / nlon;
+    return glm::vec3(
+      std::sin(theta) * std::cos(phi),
+      std::cos(theta),
+      std::sin(theta) * std::sin(phi)
+    );
+  };
+
+  std::vector<geom::Triangle> tris;
+  tris.reserve(nlat * nlon * 2);
+  for (uint32_t ilat = 0; ilat < nlat; ++ilat) {
+    for (uint32_t ilon = 0; ilon < nlon; ++ilon) {
+      glm::vec3 a = vert(ilat, ilon);
+      glm::vec3 b = vert(ilat + 1, ilon);
+      glm::vec3 c = vert(ilat + 1, ilon + 1);
+      glm::vec3 d = vert(ilat, ilon + 1);
+      tris.emplace_back(geom::Triangle { a, b, c });
+      tris.emplace_back(geom::Triangle { a, c, d });
+    }
+  }
+  return mesh::Mesh::from_tris(tris);
+}
+
+} // namespace
+
+L_BENCH(MeshAabb) {
+  mesh::Mesh mesh = make_bench_sphere(64, 128);
+  state.set_nbyte_per_iter(mesh.poses.size() * sizeof(glm::vec3));
+  for (auto _ : state) {
+    bench::do_not_optimize(mesh.aabb());
+  }
+}
+
+L_BENCH(BinMesh) {
+  mesh::Mesh mesh = make_bench_sphere(16, 32);
+  for (auto _ : state) {
+    mesh::BinGrid grid = mesh::bin_mesh(glm::vec3(0.15f), mesh);
+    bench::do_not_optimize(grid);
+  }
+}
+
+L_BENCH(BinIdxMesh) {
+  mesh::IndexedMesh idxmesh =
+    mesh::IndexedMesh::from_mesh(make_bench_sphere(16, 32));
+  for (auto _ : state) {
+    mesh::BinGrid grid = mesh::bin_idxmesh(glm::vec3(0.15f), idxmesh);
+    bench::do_not_optimize(grid);
+  }
+}
@@ -0,0 +1,82 @@
+#include <vector>
+#include "gft/bench.hpp"
+#include "gft/stream.hpp"
+
+using namespace liong;
+
+namespace {
+
+const size_t NVALUE = 1 << 16;
+
+int64_t get_bench_int(size_t i) {
+  return (int64_t)(i * 2654435761u) >> (i % 40);
+}
+std::vector<uint8_t> make_bench_varints() {
+  stream::WriteStream ws;
+  for (size_t i = 0; i < NVALUE; ++i) {
+    ws.append_zigzag(get_bench_int(i));
+  }
+  return ws.take();
+}
+std::vector<uint8_t> make_bench_bits() {
+  stream::WriteStream ws;
+  stream::BitWriter<stream::WriteStream> bw(ws);
+  for (size_t i = 0; i < NVALUE; ++i) {
+    bw.write(i, 1 + i % 24);
+  }
+  bw.flush();
+  return ws.take();
+}
+
+} // namespace
+
+L_BENCH(VarintEncode) {
+  state.set_nbyte_per_iter(make_bench_varints().size());
+  for (auto _ : state) {
+    stream::WriteStream ws;
+    for (size_t i = 0; i < NVALUE; ++i) {
+      ws.append_zigzag(get_bench_int(i));
+    }
+    bench::do_not_optimize(ws);
+  }
+}
+
+L_BENCH(VarintDecode) {
+  std::vector<uint8_t> data = make_bench_varints();
+  state.set_nbyte_per_iter(data.size());
+  for (auto _ : state) {
+    stream::ReadStream rs(data.data(), data.size());
+    int64_t sum = 0;
+    for (size_t i = 0; i < NVALUE; ++i) {
+      sum += rs.extract_zigzag();
+    }
+    bench::do_not_optimize(sum);
+  }
+}
+
+L_BENCH(BitPackEncode) {
+  state.set_nbyte_per_iter(make_bench_bits().size());
+  for (auto _ : state) {
+    stream::WriteStream ws;
+    stream::BitWriter<stream::WriteStream> bw(ws);
+    for (size_t i = 0; i < NVALUE; ++i) {
+      bw.write(i, 1 + i % 24);
+    }
+    bw.flush();
+    bench::do_not_optimize(ws);
+  }
+}
+
+L_BENCH(BitPackDecode) {
+  std::vector<uint8_t> data = make_bench_bits();
+  state.set_nbyte_per_iter(data.size());
+  for (auto _ : state) {
+    stream::ReadStream rs(data.data(), data.size());
+    stream::BitReader br(rs);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < NVALUE; ++i) {
+      sum += br.read(1 + i % 24);
+    }
+    bench::do_not_optimize(sum);
+  }
+}
@@ -0,0 +1,25 @@
+#include <vector>
+#include "gft/bench.hpp"
+#include "gft/util.hpp"
+
+using namespace liong;
+
+L_BENCH(Crc32) {
+  std::vector<uint8_t> data(64 * 1024);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = (uint8_t)(i * 31 + 7);
+  }
+  state.set_nbyte_per_iter(data.size());
+  for (auto _ : state) {
+    bench::do_not_optimize(util::crc32(data.data(), data.size()));
+  }
+}
+
+L_BENCH(Format) {
+  std::string out;
+  for (auto _ : state) {
+    out.clear();
+    util::format_to(out, "frame ", 1234, " took ", 16.7f, "ms");
+    bench::do_not_optimize(out);
+  }
+}
@@ -0,0 +1,44 @@
+#include <string>
+#include <vector>
+#include "gft/bench.hpp"
+#include "gft/zip.hpp"
+
+using namespace liong;
+
+namespace {
+
+std::vector<uint8_t> make_bench_zip() {
+  static std::vector<uint8_t> data(4096, 0x5A);
+  zip::ZipArchive ar {};
+  for (int i = 0; i < 64; ++i) {
+    std::string file_name = "dir_" + std::to_string(i % 8) + "/file_" +
+      std::to_string(i) + ".bin";
+    ar.add_file(file_name, data.data(), data.size());
+  }
+  std::vector<uint8_t> out;
+  ar.to_bytes(out);
+  return out;
+}
+
+} // namespace
+
+L_BENCH(ZipFromBytes) {
+  std::vector<uint8_t> bytes = make_bench_zip();
+  state.set_nbyte_per_iter(bytes.size());
+  for (auto _ : state) {
+    zip::ZipArchive ar = zip::ZipArchive::from_bytes(bytes);
+    bench::do_not_optimize(ar);
+  }
+}
+
+L_BENCH(ZipToBytes) {
+  std::vector<uint8_t> bytes = make_bench_zip();
+  zip::ZipArchive ar = zip::ZipArchive::from_bytes(bytes);
+  state.set_nbyte_per_iter(bytes.size());
+  std::vector<uint8_t> out;
+  for (auto _ : state) {
+    out.clear();
+    ar.to_bytes(out);
+    bench::do_not_optimize(out);
+  }
+}
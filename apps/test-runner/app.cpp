@@ -1,11 +1,63 @@
+#include <fstream>
+#include "gft/args.hpp"
+#include "gft/json.hpp"
 #include "gft/log.hpp"
 #include "gft/test.hpp"
+#include "gft/util.hpp"
 
 using namespace liong;
 
-int main(int argc, char** argv) {
+struct AppConfig {
+  std::string filter = "*";
+  uint32_t nthread = 0;
+  std::string report_path = "";
+} CFG;
+
+void initialize(int argc, const char** argv) {
+  args::init_arg_parse("TestRunner", "GraphiT unit tests.");
+  args::reg_arg<args::StringParser>(
+    "-f", "--filter", CFG.filter,
+    "Only run tests whose names match this wildcard pattern."
+  );
+  args::reg_arg<args::UintParser>(
+    "-j", "--nthread", CFG.nthread,
+    "Number of tests to run concurrently; 0 for one per hardware thread."
+  );
+  args::reg_arg<args::StringParser>(
+    "-r", "--report", CFG.report_path,
+    "Save a JSON report to this path. Test durations in an existing report "
+    "are used to start the slowest tests first."
+  );
+  args::parse_args(argc, argv);
+}
+
+int main(int argc, const char** argv) {
   try {
-    test::TestRegistry::run_all();
+    initialize(argc, argv);
+
+    test::TestConfig test_cfg {};
+    test_cfg.filter = CFG.filter;
+    test_cfg.nthread = CFG.nthread;
+    if (!CFG.report_path.empty() && std::ifstream(CFG.report_path).good()) {
+      std::string prev_report_lit = util::load_text(CFG.report_path.c_str());
+      json::JsonValue prev_report;
+      if (json::try_parse(prev_report_lit, prev_report)) {
+        test_cfg.name2duration_ns = test::json2durations(prev_report);
+      } else {
+        L_WARN("ignored unparsable test report '", CFG.report_path, "'");
+      }
+    }
+
+    test::TestReport report = test::TestRegistry::run_all(test_cfg);
+
+    if (!CFG.report_path.empty()) {
+      util::save_text(
+        CFG.report_path.c_str(), json::print(test::report2json(report))
+      );
+    }
+    if (report.nfail > 0) {
+      return 1;
+    }
   } catch (const std::exception& e) {
     L_ERROR("application threw an exception");
     L_ERROR(e.what());
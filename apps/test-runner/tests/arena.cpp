@@ -0,0 +1,105 @@
+#include <cstdint>
+#include <vector>
+#include "gft/arena.hpp"
+
+#include "gft/assert.hpp"
+#include "gft/test.hpp"
+
+using namespace liong;
+
+L_TEST(ArenaReusesBlocks) {
+  arena::Arena arena(256);
+  uint8_t* a = (uint8_t*)arena.alloc(1, 1);
+  uint32_t* b = arena.alloc_array<uint32_t>(4);
+  L_ASSERT(((uintptr_t)b & (alignof(uint32_t) - 1)) == 0);
+  L_ASSERT((uint8_t*)b > a);
+  // Larger than a block.
+  double* c = arena.alloc_array<double>(100);
+  L_ASSERT(((uintptr_t)c & (alignof(double) - 1)) == 0);
+  size_t nbyte_reserved = arena.nbyte_reserved();
+  L_ASSERT(nbyte_reserved >= 256 + 800);
+
+  arena.reset();
+  L_ASSERT(arena.nbyte_used() == 0);
+  // The same sequence lands on the same memory without growing.
+  L_ASSERT(arena.alloc(1, 1) == a);
+  L_ASSERT(arena.alloc_array<uint32_t>(4) == b);
+  L_ASSERT(arena.alloc_array<double>(100) == c);
+  L_ASSERT(arena.nbyte_reserved() == nbyte_reserved);
+  L_ASSERT(arena.nbyte_peak() >= 800);
+}
+
+L_TEST(ArenaScopeAndAllocator) {
+  arena::Arena arena(1024);
+  void* before = nullptr;
+  {
+    arena::ArenaScope scope(arena);
+    before = arena.alloc(16);
+    arena::Vector<int> xs(arena);
+    for (int i = 0; i < 1000; ++i) {
+      xs.emplace_back(i);
+    }
+    int sum = 0;
+    for (int x : xs) {
+      sum += x;
+    }
+    L_ASSERT(sum == 999 * 1000 / 2);
+  }
+  L_ASSERT(arena.nbyte_used() == 0);
+  L_ASSERT(arena.alloc(16) == before);
+
+  arena.reset();
+  {
+    arena::ArenaScope outer(arena);
+    arena.alloc(16);
+    void* inner_alloc = nullptr;
+    {
+      arena::ArenaScope inner(arena);
+      L_ASSERT(inner.depth == outer.depth + 1);
+      inner_alloc = arena.alloc(16);
+    }
+    // Only the inner allocation is given back.
+    L_ASSERT(arena.alloc(16) == inner_alloc);
+  }
+  L_ASSERT(arena.nbyte_used() == 0);
+}
+
+L_TEST(FrameArenasCycleSlots) {
+  const uint32_t NFRAME = 3;
+  arena::FrameArenas frames(NFRAME, 1024);
+  L_ASSERT(frames.nframe() == NFRAME);
+
+  std::vector<arena::Arena*> slots;
+  std::vector<void*> allocs;
+  for (uint32_t i = 0; i < NFRAME; ++i) {
+    arena::Arena& frame = frames.begin_frame();
+    L_ASSERT(&frames.get() == &frame);
+    L_ASSERT(frame.nbyte_used() == 0);
+    allocs.emplace_back(frame.alloc(64));
+    slots.emplace_back(&frame);
+  }
+  // Every slot is a distinct arena and keeps its data while the other frames
+  // are in flight.
+  for (uint32_t i = 0; i < NFRAME; ++i) {
+    for (uint32_t j = i + 1; j < NFRAME; ++j) {
+      L_ASSERT(slots.at(i) != slots.at(j));
+    }
+    L_ASSERT(slots.at(i)->nbyte_used() != 0);
+  }
+
+  // Going around the ring resets each slot as it's reused, and the memory of
+  // the previous round is handed out again.
+  for (uint32_t round = 0; round < 2; ++round) {
+    for (uint32_t i = 0; i < NFRAME; ++i) {
+      arena::Arena& frame = frames.begin_frame();
+      L_ASSERT(&frame == slots.at(i));
+      L_ASSERT(frame.nbyte_used() == 0);
+      L_ASSERT(frame.alloc(64) == allocs.at(i));
+      // The slots not yet reused in this round are untouched.
+      for (uint32_t j = i + 1; j < NFRAME; ++j) {
+        L_ASSERT(slots.at(j)->nbyte_used() != 0);
+      }
+    }
+  }
+  L_ASSERT(frames.iframe() == 3 * NFRAME);
+}
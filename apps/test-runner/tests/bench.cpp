@@ -0,0 +1,68 @@
+#include "gft/assert.hpp"
+#include "gft/bench.hpp"
+#include "gft/json.hpp"
+#include "gft/test.hpp"
+#include "gft/util.hpp"
+
+using namespace liong;
+
+L_TEST(BenchWildcardFilter) {
+  L_ASSERT(util::match_wildcard("*", ""));
+  L_ASSERT(util::match_wildcard("*", "Crc32"));
+  L_ASSERT(util::match_wildcard("Json*", "JsonParse"));
+  L_ASSERT(util::match_wildcard("*Mesh", "BinIdxMesh"));
+  L_ASSERT(util::match_wildcard("Bin?dx*", "BinIdxMesh"));
+  L_ASSERT(!util::match_wildcard("Json*", "ZipToBytes"));
+  L_ASSERT(!util::match_wildcard("?", ""));
+  L_ASSERT(!util::match_wildcard("*Mesh", "BinMeshes"));
+}
+
+L_TEST(BenchResultsRoundTrip) {
+  bench::BenchResult result {};
+  result.name = "Crc32";
+  result.niter = 1000;
+  result.nsample = 30;
+  result.min_ns = 10.0;
+  result.median_ns = 12.0;
+  result.p99_ns = 20.0;
+  result.mean_ns = 12.5;
+  result.ci95_ns = 0.5;
+  result.nbyte_per_sec = 5.0e9;
+
+  std::vector<bench::BenchResult> baseline { result };
+  std::string json_lit = json::print(bench::results2json(baseline));
+  std::vector<bench::BenchResult> results =
+    bench::json2results(json::parse(json_lit));
+  L_ASSERT(results.size() == 1);
+  L_ASSERT(results[0].name == "Crc32");
+  L_ASSERT(results[0].niter == 1000);
+  L_ASSERT(results[0].median_ns == 12.0);
+  L_ASSERT(results[0].nbyte_per_sec == 5.0e9);
+  L_ASSERT(bench::compare_results(baseline, results) == 0);
+
+  // Well beyond the tolerance and the confidence intervals.
+  results[0].median_ns = 24.0;
+  results[0].mean_ns = 24.5;
+  L_ASSERT(bench::compare_results(baseline, results) == 1);
+  // Slower, but within the noise.
+  results[0].median_ns = 13.0;
+  results[0].mean_ns = 13.0;
+  results[0].ci95_ns = 2.0;
+  L_ASSERT(bench::compare_results(baseline, results) == 0);
+}
+
+L_TEST(BenchNeverIteratedFails) {
+  uint32_t ncall = 0;
+  bench::BenchRegistry::get_inst().reg(
+    "TestBenchNeverIterated",
+    [&](bench::BenchState&) { ++ncall; }
+  );
+  bench::BenchConfig cfg {};
+  cfg.filter = "TestBenchNeverIterated";
+  // The benchmark is reported as failed rather than calibrated forever.
+  std::vector<bench::BenchResult> results =
+    bench::BenchRegistry::run_all(cfg);
+  L_ASSERT(results.empty());
+  L_ASSERT(ncall == 1);
+  bench::BenchRegistry::get_inst().benches.erase("TestBenchNeverIterated");
+}
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "gft/bvh.hpp"
+#include "gft/rand.hpp"
+
+#include "gft/assert.hpp"
+#include "gft/test.hpp"
+
+using namespace liong;
+
+namespace {
+
+// Small triangles scattered in `[-1, 1]^3`.
+std::vector<geom::Triangle> make_test_tris(uint32_t ntri) {
+  rand::Lcg rng(0x87654321);
+  std::vector<geom::Triangle> out;
+  for (uint32_t i = 0; i < ntri; ++i) {
+    glm::vec3 p = rng.vec3();
+    glm::vec3 a = p + rng.vec3() * 0.1f;
+    glm::vec3 b = p + rng.vec3() * 0.1f;
+    glm::vec3 c = p + rng.vec3() * 0.1f;
+    out.emplace_back(geom::Triangle { a, b, c });
+  }
+  return out;
+}
+
+bool contains_aabb(const geom::Aabb& outer, const geom::Aabb& inner) {
+  return geom::contains_point_aabb(outer, inner.min) &&
+    geom::contains_point_aabb(outer, inner.max);
+}
+
+// Check that the bounds are conservative and that every triangle is in
+// exactly one leaf.
+void check_bvh_structure(
+  const geom::TriangleBvh& bvh,
+  const geom::BvhConfig& cfg
+) {
+  const auto& nodes = bvh.bvh.nodes;
+  std::vector<uint32_t> nref(bvh.tris.size());
+  for (uint32_t i = 0; i < nodes.size(); ++i) {
+    const geom::BvhNode& node = nodes[i];
+    if (node.is_leaf()) {
+      L_ASSERT(node.nprim <= cfg.max_leaf_nprim);
+      for (uint32_t j = 0; j < node.nprim; ++j) {
+        uint32_t itri = bvh.bvh.iprims.at(node.offset + j);
+        geom::Aabb tri_aabb = geom::Aabb::from_points(&bvh.tris.at(itri).a, 3);
+        L_ASSERT(contains_aabb(node.aabb, tri_aabb));
+        nref[itri] += 1;
+      }
+    } else {
+      L_ASSERT(node.offset > i + 1 && node.offset < nodes.size());
+      L_ASSERT(contains_aabb(node.aabb, nodes[i + 1].aabb));
+      L_ASSERT(contains_aabb(node.aabb, nodes[node.offset].aabb));
+    }
+  }
+  for (uint32_t n : nref) {
+    L_ASSERT(n == 1);
+  }
+}
+
+// Check closest hits against a linear scan over the triangles.
+void check_bvh_raycast(const geom::TriangleBvh& bvh, uint32_t nray) {
+  rand::Lcg rng(0x87654321);
+  for (uint32_t i = 0; i < nray; ++i) {
+    geom::Ray ray { rng.vec3() * 2.0f, rng.vec3() };
+    bool expected = false;
+    float t_min = std::numeric_limits<float>::infinity();
+    for (const auto& tri : bvh.tris) {
+      float t;
+      glm::vec2 bary;
+      if (geom::raycast_tri(ray, tri, t, bary) && t < t_min) {
+        t_min = t;
+        expected = true;
+      }
+    }
+    geom::BvhRayHit hit;
+    L_ASSERT(bvh.raycast(ray, hit) == expected);
+    L_ASSERT(!expected || hit.t == t_min);
+  }
+}
+
+} // namespace
+
+L_TEST(BvhStructure) {
+  geom::BvhConfig cfg {};
+  // Exercise subtrees built in parallel.
+  cfg.min_parallel_nprim = 64;
+  geom::TriangleBvh bvh = geom::TriangleBvh::build(make_test_tris(3000), cfg);
+  check_bvh_structure(bvh, cfg);
+}
+
+L_TEST(BvhQueriesMatchLinearScan) {
+  geom::BvhConfig cfg {};
+  cfg.min_parallel_nprim = 64;
+  std::vector<geom::Triangle> tris = make_test_tris(2000);
+  geom::TriangleBvh bvh = geom::TriangleBvh::build(
+    std::vector<geom::Triangle>(tris),
+    cfg
+  );
+
+  rand::Lcg rng(0x87654321);
+  for (uint32_t i = 0; i < 200; ++i) {
+    geom::Ray ray { rng.vec3() * 2.0f, rng.vec3() };
+
+    bool expected = false;
+    float t_min = std::numeric_limits<float>::infinity();
+    uint32_t itri_min = 0;
+    for (uint32_t itri = 0; itri < tris.size(); ++itri) {
+      float t;
+      glm::vec2 bary;
+      if (geom::raycast_tri(ray, tris[itri], t, bary) && t < t_min) {
+        t_min = t;
+        itri_min = itri;
+        expected = true;
+      }
+    }
+    geom::BvhRayHit hit;
+    L_ASSERT(bvh.raycast(ray, hit) == expected);
+    L_ASSERT(bvh.raycast_any(ray) == expected);
+    L_ASSERT(!expected || (hit.iprim == itri_min && hit.t == t_min));
+    // The same with the binary tree.
+    uint32_t itri_binary = UINT32_MAX;
+    bvh.bvh.traverse_ray(ray, t_min, [&](uint32_t itri, float& t_far) {
+      float t;
+      glm::vec2 bary;
+      if (geom::raycast_tri(ray, tris[itri], t, bary) && t <= t_far) {
+        t_far = t;
+        itri_binary = itri;
+      }
+      return false;
+    });
+    L_ASSERT(itri_binary == (expected ? itri_min : UINT32_MAX));
+
+    glm::vec3 point = rng.vec3() * 1.5f;
+    float dist_min = std::numeric_limits<float>::infinity();
+    for (const auto& tri : tris) {
+      glm::vec3 d = geom::nearest_point_tri(tri, point) - point;
+      dist_min = std::min(dist_min, std::sqrt(glm::dot(d, d)));
+    }
+    geom::BvhPointHit point_hit;
+    L_ASSERT(bvh.nearest_point(point, point_hit));
+    L_ASSERT(std::abs(point_hit.dist - dist_min) < 1e-5f);
+    L_ASSERT(!bvh.nearest_point(point, point_hit, dist_min * 0.99f));
+
+    geom::Aabb aabb = geom::Aabb::from_center_size(point, glm::vec3(0.2f));
+    std::vector<uint32_t> itris;
+    bvh.query_aabb(aabb, itris);
+    uint32_t noverlap = 0;
+    for (const auto& tri : tris) {
+      noverlap += geom::intersect_aabb_tri(tri, aabb) ? 1 : 0;
+    }
+    L_ASSERT(itris.size() == noverlap);
+  }
+
+  geom::Ray ray { glm::vec3(0.0f, 0.0f, -2.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+  geom::TriangleBvh empty = geom::TriangleBvh::build({});
+  geom::BvhRayHit hit;
+  L_ASSERT(!empty.raycast(ray, hit) && !empty.raycast_any(ray));
+}
+
+L_TEST(BvhRefit) {
+  geom::BvhConfig cfg {};
+  cfg.min_parallel_nprim = 64;
+  // Large enough to refit subtrees in parallel.
+  std::vector<geom::Triangle> tris = make_test_tris(12000);
+  geom::TriangleBvh bvh = geom::TriangleBvh::build(
+    std::vector<geom::Triangle>(tris),
+    cfg
+  );
+  L_ASSERT(!bvh.treelets.empty());
+
+  // Twisting and stretching keeps neighbours together.
+  auto twist = [](glm::vec3 p) {
+    float angle = p.y * 0.5f;
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+    return glm::vec3(c * p.x - s * p.z, p.y * 1.5f, s * p.x + c * p.z);
+  };
+  std::vector<geom::Triangle> twisted = tris;
+  for (auto& tri : twisted) {
+    tri = geom::Triangle { twist(tri.a), twist(tri.b), twist(tri.c) };
+  }
+  L_ASSERT(bvh.refit(twisted) == geom::L_BVH_UPDATE_REFIT);
+  check_bvh_structure(bvh, cfg);
+  check_bvh_raycast(bvh, 100);
+
+  // Shuffling the triangles in a corner degrades only the subtrees there.
+  std::vector<geom::Triangle> shuffled = tris;
+  std::vector<uint32_t> icorner;
+  for (uint32_t i = 0; i < tris.size(); ++i) {
+    if (tris[i].a.x > 0.6f && tris[i].a.y > 0.6f) {
+      icorner.emplace_back(i);
+    }
+  }
+  for (uint32_t i = 0; i < icorner.size(); ++i) {
+    uint32_t j = icorner[(i * 7919) % icorner.size()];
+    glm::vec3 d = tris[j].a - tris[icorner[i]].a;
+    shuffled[icorner[i]].a += d;
+    shuffled[icorner[i]].b += d;
+    shuffled[icorner[i]].c += d;
+  }
+  L_ASSERT(bvh.refit(shuffled) == geom::L_BVH_UPDATE_PARTIAL_REBUILD);
+  check_bvh_structure(bvh, cfg);
+  check_bvh_raycast(bvh, 100);
+  float cost = bvh.bvh.get_sah_cost(cfg.node_cost);
+  L_ASSERT(cost <= bvh.build_cost * cfg.max_refit_cost_ratio);
+
+  // Shuffling everything degrades the whole tree.
+  for (uint32_t i = 0; i < tris.size(); ++i) {
+    uint32_t j = (i * 7919) % tris.size();
+    glm::vec3 d = tris[j].a - tris[i].a;
+    shuffled[i] =
+      geom::Triangle { tris[i].a + d, tris[i].b + d, tris[i].c + d };
+  }
+  L_ASSERT(bvh.refit(shuffled) == geom::L_BVH_UPDATE_FULL_REBUILD);
+  check_bvh_structure(bvh, cfg);
+  check_bvh_raycast(bvh, 100);
+}
+
+L_TEST(BvhRefitCollapsesSmallTreelet) {
+  geom::BvhConfig cfg {};
+  // Few enough triangles for some treelets to fit in a leaf.
+  std::vector<geom::Triangle> tris = make_test_tris(400);
+  geom::TriangleBvh bvh = geom::TriangleBvh::build(
+    std::vector<geom::Triangle>(tris),
+    cfg
+  );
+  const auto& nodes = bvh.bvh.nodes;
+  uint32_t inode = 0;
+  uint32_t nprim = 0;
+  for (const geom::BvhTreelet& treelet : bvh.treelets) {
+    nprim = 0;
+    uint32_t end = bvh.bvh.get_subtree_end(treelet.inode);
+    for (uint32_t i = treelet.inode; i < end; ++i) {
+      nprim += nodes[i].is_leaf() ? nodes[i].nprim : 0;
+    }
+    if (nprim <= cfg.max_leaf_nprim) {
+      inode = treelet.inode;
+      break;
+    }
+  }
+  L_ASSERT(nprim <= cfg.max_leaf_nprim && inode != 0);
+
+  // Moving all its triangles onto one makes a single leaf the best subtree.
+  uint32_t end = bvh.bvh.get_subtree_end(inode);
+  uint32_t iprim_beg = ~0u;
+  for (uint32_t i = inode; i < end; ++i) {
+    if (nodes[i].is_leaf()) {
+      iprim_beg = std::min(iprim_beg, nodes[i].offset);
+    }
+  }
+  std::vector<geom::Triangle> collapsed = tris;
+  const geom::Triangle& tri = tris[bvh.bvh.iprims[iprim_beg]];
+  for (uint32_t i = 0; i < nprim; ++i) {
+    collapsed[bvh.bvh.iprims[iprim_beg + i]] = tri;
+  }
+  size_t ntreelet = bvh.treelets.size();
+  L_ASSERT(bvh.refit(collapsed) == geom::L_BVH_UPDATE_PARTIAL_REBUILD);
+  L_ASSERT(bvh.bvh.nodes[inode].is_leaf());
+  L_ASSERT(bvh.treelets.size() == ntreelet - 1);
+  for (const geom::BvhTreelet& treelet : bvh.treelets) {
+    L_ASSERT(!bvh.bvh.nodes[treelet.inode].is_leaf());
+  }
+  check_bvh_structure(bvh, cfg);
+  check_bvh_raycast(bvh, 100);
+}
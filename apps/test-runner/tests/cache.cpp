@@ -0,0 +1,88 @@
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gft/cache.hpp"
+
+#include "gft/assert.hpp"
+#include "gft/test.hpp"
+
+using namespace liong;
+
+L_TEST(LruCacheEvictsLeastRecentlyUsed) {
+  cache::LruCache<int, std::string>::Config cfg {};
+  cfg.nshard = 1;
+  cfg.nbyte_budget = 7;
+  cfg.get_nbyte = [](const int&, const std::string& value) {
+    return value.size();
+  };
+  cache::LruCache<int, std::string> cache(cfg);
+
+  cache.put(1, "abc");
+  cache.put(2, "def");
+  L_ASSERT(*cache.get(1) == "abc");
+  // 2 is the least recently used now.
+  cache.put(3, "gh");
+  L_ASSERT(cache.get(2) == nullptr);
+  L_ASSERT(*cache.get(1) == "abc" && *cache.get(3) == "gh");
+  // Too large to ever fit.
+  auto big = cache.put(4, "0123456789");
+  L_ASSERT(*big == "0123456789" && cache.get(4) == nullptr);
+
+  auto counters = cache.counters();
+  L_ASSERT(counters.nhit == 3 && counters.nmiss == 2);
+  L_ASSERT(counters.nevicted == 1);
+  L_ASSERT(counters.nentry == 2 && counters.nbyte == 5);
+
+  cache.clear();
+  L_ASSERT(cache.get(1) == nullptr);
+  L_ASSERT(cache.counters().nentry == 0 && cache.counters().nbyte == 0);
+}
+
+L_TEST(LruCacheSingleFlight) {
+  const uint32_t NTHREAD = 4;
+  cache::LruCache<std::string, int> cache;
+  std::atomic<uint32_t> ncompute { 0 };
+  std::atomic<uint32_t> nstarted { 0 };
+
+  std::vector<std::thread> threads;
+  std::vector<int> results(NTHREAD);
+  for (uint32_t i = 0; i < NTHREAD; ++i) {
+    threads.emplace_back([&, i]() {
+      nstarted.fetch_add(1);
+      results[i] = *cache.get_or_compute("x", [&]() {
+        ncompute.fetch_add(1);
+        // Give the other threads a chance to miss as well.
+        while (nstarted.load() != NTHREAD) {
+          std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return 42;
+      });
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  L_ASSERT(ncompute.load() == 1);
+  for (int result : results) {
+    L_ASSERT(result == 42);
+  }
+  auto counters = cache.counters();
+  L_ASSERT(counters.nhit + counters.nmiss == NTHREAD);
+  L_ASSERT(counters.nmiss == counters.nshared + 1);
+
+  // Failures are reported to the caller and not cached.
+  bool has_thrown = false;
+  try {
+    cache.get_or_compute("y", []() -> int {
+      throw std::runtime_error("failed");
+    });
+  } catch (const std::runtime_error& e) {
+    has_thrown = true;
+  }
+  L_ASSERT(has_thrown);
+  L_ASSERT(*cache.get_or_compute("y", []() { return 1; }) == 1);
+}
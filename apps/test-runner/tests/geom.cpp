@@ -0,0 +1,523 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+#include "gft/geom.hpp"
+#include "gft/geom-soa.hpp"
+#include "gft/parallel.hpp"
+#include "gft/rand.hpp"
+
+#include "gft/assert.hpp"
+#include "gft/test.hpp"
+
+using namespace liong;
+
+L_TEST(GeomRaycastScalar) {
+  float t;
+  glm::vec2 bary;
+
+  geom::Triangle tri {
+    { 0.0f, 0.0f, 0.0f },
+    { 1.0f, 0.0f, 0.0f },
+    { 0.0f, 1.0f, 0.0f },
+  };
+  geom::Ray ray { { 0.25f, 0.5f, 2.0f }, { 0.0f, 0.0f, -2.0f } };
+  L_ASSERT(geom::raycast_tri(ray, tri, t, bary));
+  L_ASSERT(t == 1.0f && bary.x == 0.25f && bary.y == 0.5f);
+  // Double-sided, but nothing behind the origin.
+  L_ASSERT(geom::raycast_tri({ { 0.25f, 0.5f, -2.0f }, { 0, 0, 1 } }, tri, t,
+    bary));
+  L_ASSERT(!geom::raycast_tri({ { 0.25f, 0.5f, 2.0f }, { 0, 0, 1 } }, tri, t,
+    bary));
+  L_ASSERT(!geom::raycast_tri({ { 0.75f, 0.5f, 2.0f }, { 0, 0, -1 } }, tri, t,
+    bary));
+
+  geom::Aabb aabb = geom::Aabb::from_min_max(glm::vec3(-1.0f), glm::vec3(1.0f));
+  L_ASSERT(geom::raycast_aabb({ { -3.0f, 0.0f, 0.0f }, { 1, 0, 0 } }, aabb, t));
+  L_ASSERT(t == 2.0f);
+  L_ASSERT(geom::raycast_aabb({ { 0.0f, 0.0f, 0.0f }, { 1, 0, 0 } }, aabb, t));
+  L_ASSERT(t == 0.0f);
+  L_ASSERT(!geom::raycast_aabb({ { -3.0f, 2.0f, 0.0f }, { 1, 0, 0 } }, aabb,
+    t));
+  L_ASSERT(!geom::raycast_aabb({ { 3.0f, 0.0f, 0.0f }, { 1, 0, 0 } }, aabb,
+    t));
+
+  geom::Sphere sphere { { 0.0f, 0.0f, 0.0f }, 1.0f };
+  L_ASSERT(geom::raycast_sphere({ { 0.0f, 0.0f, 3.0f }, { 0, 0, -1 } },
+    sphere, t));
+  L_ASSERT(t == 2.0f);
+  L_ASSERT(geom::raycast_sphere({ { 0.0f, 0.5f, 0.0f }, { 0, 0, -1 } },
+    sphere, t));
+  L_ASSERT(t == 0.0f);
+  L_ASSERT(!geom::raycast_sphere({ { 0.0f, 0.0f, 3.0f }, { 0, 0, 1 } },
+    sphere, t));
+
+  geom::Tetrahedron tet {
+    { 0.0f, 0.0f, 0.0f },
+    { 1.0f, 0.0f, 0.0f },
+    { 0.0f, 1.0f, 0.0f },
+    { 0.0f, 0.0f, 1.0f },
+  };
+  L_ASSERT(geom::raycast_tet({ { 0.2f, 0.2f, 3.0f }, { 0, 0, -1 } }, tet, t));
+  L_ASSERT(std::abs(t - 2.4f) < 1e-5f);
+  L_ASSERT(geom::raycast_tet({ { 0.1f, 0.1f, 0.1f }, { 1, 0, 0 } }, tet, t));
+  L_ASSERT(t == 0.0f);
+  L_ASSERT(!geom::raycast_tet({ { 0.8f, 0.8f, 3.0f }, { 0, 0, -1 } }, tet,
+    t));
+}
+
+namespace {
+
+template<int N>
+void test_raycast_packets() {
+  rand::Lcg rng;
+  for (uint32_t iround = 0; iround < 64; ++iround) {
+    geom::Ray rays[N];
+    geom::Triangle tris[N];
+    geom::Aabb aabbs[N];
+    geom::RayPacket<N> ray_pkt;
+    geom::TrianglePacket<N> tri_pkt;
+    geom::AabbPacket<N> aabb_pkt;
+    for (int i = 0; i < N; ++i) {
+      rays[i] = geom::Ray { rng.vec3() * 3.0f, rng.vec3() };
+      tris[i] = geom::Triangle { rng.vec3(), rng.vec3(), rng.vec3() };
+      glm::vec3 p = rng.vec3();
+      aabbs[i] = geom::Aabb::from_center_size(p, glm::abs(rng.vec3()));
+      ray_pkt.set(i, rays[i]);
+      tri_pkt.set(i, tris[i]);
+      aabb_pkt.set(i, aabbs[i]);
+    }
+    // The last lane is unused.
+    ray_pkt.clear(N - 1);
+    tri_pkt.clear(N - 1);
+    aabb_pkt.clear(N - 1);
+
+    geom::RayHitPacket<N> hits;
+    float t;
+    glm::vec2 bary;
+    uint32_t mask = geom::raycast_tri(ray_pkt, tris[0], hits);
+    for (int i = 0; i < N; ++i) {
+      bool expected = i != N - 1 && geom::raycast_tri(rays[i], tris[0], t,
+        bary);
+      L_ASSERT(((mask >> i) & 1) == (expected ? 1 : 0));
+      L_ASSERT(!expected || std::abs(hits.t[i] - t) < 1e-4f);
+    }
+    mask = geom::raycast_tri(rays[0], tri_pkt, hits);
+    for (int i = 0; i < N; ++i) {
+      bool expected = i != N - 1 && geom::raycast_tri(rays[0], tris[i], t,
+        bary);
+      L_ASSERT(((mask >> i) & 1) == (expected ? 1 : 0));
+      L_ASSERT(!expected || std::abs(hits.u[i] - bary.x) < 1e-4f);
+    }
+    mask = geom::raycast_aabb(ray_pkt, aabbs[0], hits);
+    for (int i = 0; i < N; ++i) {
+      bool expected = i != N - 1 && geom::raycast_aabb(rays[i], aabbs[0], t);
+      L_ASSERT(((mask >> i) & 1) == (expected ? 1 : 0));
+      L_ASSERT(!expected || std::abs(hits.t[i] - t) < 1e-4f);
+    }
+    mask = geom::raycast_aabb(rays[0], aabb_pkt, hits);
+    for (int i = 0; i < N; ++i) {
+      bool expected = i != N - 1 && geom::raycast_aabb(rays[0], aabbs[i], t);
+      L_ASSERT(((mask >> i) & 1) == (expected ? 1 : 0));
+      L_ASSERT(!expected || std::abs(hits.t[i] - t) < 1e-4f);
+    }
+  }
+}
+
+} // namespace
+
+L_TEST(GeomRaycastPacketsMatchScalar) {
+  test_raycast_packets<4>();
+  test_raycast_packets<8>();
+
+  // Rays along the boundary of a slab.
+  geom::Aabb aabb = geom::Aabb::from_min_max(glm::vec3(0.0f), glm::vec3(1.0f));
+  geom::RayPacket<4> rays;
+  rays.set(0, { { 0.0f, 0.5f, -1.0f }, { 0, 0, 1 } });
+  rays.set(1, { { 1.0f, 1.0f, -1.0f }, { 0, 0, 1 } });
+  rays.set(2, { { 1.5f, 0.5f, -1.0f }, { 0, 0, 1 } });
+  rays.set(3, { { 0.5f, 0.5f, 0.5f }, { 0, 0, 0 } });
+  geom::RayHitPacket<4> hits;
+  L_ASSERT(geom::raycast_aabb(rays, aabb, hits) == 0b1011);
+  L_ASSERT(hits.t[0] == 1.0f && hits.t[1] == 1.0f && hits.t[3] == 0.0f);
+  // Only the ray starting inside hits before `t_max`.
+  L_ASSERT(geom::raycast_aabb(rays, aabb, hits, 0.5f) == 0b1000);
+
+  geom::Triangle tri {
+    { -1.0f, -1.0f, 0.0f },
+    { 3.0f, -1.0f, 0.0f },
+    { -1.0f, 3.0f, 0.0f },
+  };
+  L_ASSERT(geom::raycast_tri(rays, tri, hits) == 0b0111);
+  L_ASSERT(geom::raycast_tri(rays, tri, hits, 0.5f) == 0);
+}
+
+namespace {
+
+// References built from ray casts: in general position, a triangle meets a
+// box iff a vertex is inside or an edge of either crosses the other, and two
+// triangles intersect iff an edge of either crosses the other.
+bool cast_segment_tri(glm::vec3 p, glm::vec3 q, const geom::Triangle& tri) {
+  float t;
+  glm::vec2 bary;
+  return geom::raycast_tri({ p, q - p }, tri, t, bary) && t <= 1.0f;
+}
+bool cast_segment_aabb(glm::vec3 p, glm::vec3 q, const geom::Aabb& aabb) {
+  float t;
+  return geom::raycast_aabb({ p, q - p }, aabb, t) && t <= 1.0f;
+}
+bool intersect_aabb_tri_ref(const geom::Triangle& tri, const geom::Aabb& aabb) {
+  const glm::vec3 verts[3] { tri.a, tri.b, tri.c };
+  for (int i = 0; i < 3; ++i) {
+    if (cast_segment_aabb(verts[i], verts[(i + 1) % 3], aabb)) {
+      return true;
+    }
+  }
+  for (int i = 0; i < 12; ++i) {
+    // Box edges as pairs of corners differing in one axis.
+    int axis = i / 4;
+    glm::vec3 p = aabb.min;
+    glm::vec3 q = aabb.min;
+    for (int j = 0; j < 2; ++j) {
+      int other = (axis + 1 + j) % 3;
+      if ((i >> j) & 1) {
+        p[other] = q[other] = aabb.max[other];
+      }
+    }
+    q[axis] = aabb.max[axis];
+    if (cast_segment_tri(p, q, tri)) {
+      return true;
+    }
+  }
+  return false;
+}
+bool intersect_tri_ref(const geom::Triangle& tri1, const geom::Triangle& tri2) {
+  const glm::vec3 verts1[3] { tri1.a, tri1.b, tri1.c };
+  const glm::vec3 verts2[3] { tri2.a, tri2.b, tri2.c };
+  for (int i = 0; i < 3; ++i) {
+    if (cast_segment_tri(verts1[i], verts1[(i + 1) % 3], tri2) ||
+      cast_segment_tri(verts2[i], verts2[(i + 1) % 3], tri1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template<int N>
+void test_intersect_packets() {
+  rand::Lcg rng;
+  for (uint32_t iround = 0; iround < 256; ++iround) {
+    geom::Triangle tris[N];
+    geom::Aabb aabbs[N];
+    geom::TrianglePacket<N> tri_pkt;
+    geom::AabbPacket<N> aabb_pkt;
+    for (int i = 0; i < N; ++i) {
+      glm::vec3 p = rng.vec3();
+      tris[i] = geom::Triangle { p, p + rng.vec3(), p + rng.vec3() };
+      aabbs[i] = geom::Aabb::from_center_size(rng.vec3(),
+        glm::abs(rng.vec3()));
+      tri_pkt.set(i, tris[i]);
+      aabb_pkt.set(i, aabbs[i]);
+    }
+    tri_pkt.clear(N - 1);
+    aabb_pkt.clear(N - 1);
+
+    uint32_t mask = geom::intersect_aabb_tri(tri_pkt, aabbs[0]);
+    for (int i = 0; i < N; ++i) {
+      bool expected = i != N - 1 && geom::intersect_aabb_tri(tris[i],
+        aabbs[0]);
+      L_ASSERT(((mask >> i) & 1) == (expected ? 1 : 0));
+    }
+    mask = geom::intersect_aabb_tri(tris[0], aabb_pkt);
+    for (int i = 0; i < N; ++i) {
+      bool expected = i != N - 1 && geom::intersect_aabb_tri(tris[0],
+        aabbs[i]);
+      L_ASSERT(((mask >> i) & 1) == (expected ? 1 : 0));
+    }
+    mask = geom::intersect_tri(tris[0], tri_pkt);
+    for (int i = 0; i < N; ++i) {
+      bool expected = i != N - 1 && geom::intersect_tri(tris[0], tris[i]);
+      L_ASSERT(((mask >> i) & 1) == (expected ? 1 : 0));
+    }
+  }
+}
+
+} // namespace
+
+L_TEST(GeomIntersectTri) {
+  geom::Triangle tri {
+    { 0.0f, 0.0f, 0.0f },
+    { 1.0f, 0.0f, 0.0f },
+    { 0.0f, 1.0f, 0.0f },
+  };
+  // Boxes overlapping the bounds of the triangle but not the triangle.
+  L_ASSERT(!geom::intersect_aabb_tri(tri,
+    geom::Aabb::from_min_max({ 0.6f, 0.6f, -1.0f }, { 1.0f, 1.0f, 1.0f })));
+  L_ASSERT(!geom::intersect_aabb_tri(tri,
+    geom::Aabb::from_min_max({ 0.1f, 0.1f, 0.1f }, { 1.0f, 1.0f, 1.0f })));
+  L_ASSERT(geom::intersect_aabb_tri(tri,
+    geom::Aabb::from_min_max({ 0.4f, 0.4f, -1.0f }, { 1.0f, 1.0f, 1.0f })));
+  // Touching.
+  L_ASSERT(geom::intersect_aabb_tri(tri,
+    geom::Aabb::from_min_max({ 0.5f, 0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f })));
+  // Inside a large triangle.
+  L_ASSERT(geom::intersect_aabb_tri(
+    geom::Triangle { { -9, -9, 0 }, { 9, -9, 0 }, { 0, 9, 0 } },
+    geom::Aabb::from_center_size(glm::vec3(0.0f), glm::vec3(0.1f))));
+
+  // Piercing, parallel, touching at a vertex, and coplanar.
+  L_ASSERT(geom::intersect_tri(tri, geom::Triangle {
+    { 0.2f, 0.2f, -1.0f }, { 0.2f, 0.2f, 1.0f }, { 5.0f, 5.0f, 0.0f } }));
+  L_ASSERT(!geom::intersect_tri(tri, geom::Triangle {
+    { 0.2f, 0.2f, 1.0f }, { 1.2f, 0.2f, 1.0f }, { 0.2f, 1.2f, 1.0f } }));
+  L_ASSERT(geom::intersect_tri(tri, geom::Triangle {
+    { 1.0f, 0.0f, 0.0f }, { 2.0f, 0.0f, 1.0f }, { 2.0f, 1.0f, 1.0f } }));
+  L_ASSERT(geom::intersect_tri(tri, geom::Triangle {
+    { 0.4f, 0.4f, 0.0f }, { 2.0f, 0.4f, 0.0f }, { 0.4f, 2.0f, 0.0f } }));
+  L_ASSERT(!geom::intersect_tri(tri, geom::Triangle {
+    { 0.6f, 0.6f, 0.0f }, { 2.0f, 0.6f, 0.0f }, { 0.6f, 2.0f, 0.0f } }));
+  // Degenerate.
+  L_ASSERT(!geom::intersect_tri(tri, geom::Triangle {
+    { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 0.0f }, { 2.0f, 2.0f, 0.0f } }));
+
+  rand::Lcg rng;
+  for (uint32_t i = 0; i < 2000; ++i) {
+    glm::vec3 p = rng.vec3();
+    geom::Triangle tri1 { p, p + rng.vec3(), p + rng.vec3() };
+    p = rng.vec3();
+    geom::Triangle tri2 { p, p + rng.vec3(), p + rng.vec3() };
+    geom::Aabb aabb =
+      geom::Aabb::from_center_size(rng.vec3(), glm::abs(rng.vec3()));
+    L_ASSERT(geom::intersect_aabb_tri(tri1, aabb) ==
+      intersect_aabb_tri_ref(tri1, aabb));
+    L_ASSERT(geom::intersect_tri(tri1, tri2) == intersect_tri_ref(tri1, tri2));
+    L_ASSERT(geom::intersect_tri(tri1, tri2) ==
+      geom::intersect_tri(tri2, tri1));
+  }
+
+  test_intersect_packets<4>();
+  test_intersect_packets<8>();
+}
+
+L_TEST(GeomSoaKernelsMatchScalar) {
+  rand::Lcg rng;
+  // Not a multiple of the SIMD width, to exercise the tails.
+  std::vector<glm::vec3> points;
+  for (uint32_t i = 0; i < 1003; ++i) {
+    points.emplace_back(rng.vec3() * 2.0f);
+  }
+  geom::PointSoa soa = geom::PointSoa::from_points(points);
+  geom::Aabb bounds = geom::Aabb::from_points(points);
+  for (uint32_t npoint : { 0u, 3u, 1003u }) {
+    geom::Aabb aabb = geom::get_points_aabb(points.data(), npoint);
+    geom::Aabb expected = geom::Aabb::from_points(points.data(), npoint);
+    L_ASSERT(aabb.min == expected.min && aabb.max == expected.max);
+  }
+  L_ASSERT(soa.aabb().min == bounds.min && soa.aabb().max == bounds.max);
+
+  std::vector<uint32_t> masks;
+  geom::Aabb box = geom::Aabb::from_center_size(glm::vec3(0.5f),
+    glm::vec3(2.0f));
+  geom::contains_point_aabb(box, soa, masks);
+  L_ASSERT(masks.size() == (points.size() + 31) / 32);
+  for (uint32_t i = 0; i < points.size(); ++i) {
+    bool expected = geom::contains_point_aabb(box, points[i]);
+    L_ASSERT(((masks[i / 32] >> (i % 32)) & 1) == (expected ? 1 : 0));
+  }
+
+  geom::Tetrahedron tet {
+    { -1.0f, -1.0f, -1.0f },
+    { 2.0f, -1.0f, -0.5f },
+    { -1.0f, 2.0f, -1.0f },
+    { -0.5f, -1.0f, 2.0f },
+  };
+  geom::contains_point_tetra(tet, soa, masks);
+  std::vector<geom::Tetrahedron> tets;
+  for (uint32_t i = 0; i < points.size(); ++i) {
+    glm::vec4 bary;
+    bool expected = geom::contains_point_tetra(tet, points[i], bary);
+    L_ASSERT(((masks[i / 32] >> (i % 32)) & 1) == (expected ? 1 : 0));
+    tets.emplace_back(geom::Tetrahedron {
+      tet.a + points[i],
+      tet.b + points[i],
+      tet.c + points[i],
+      tet.d + points[i],
+    });
+  }
+  // Point location among many tetrahedra, including a degenerate one.
+  tets[5] = geom::Tetrahedron { tet.a, tet.a, tet.c, tet.d };
+  geom::TetrahedronSoa tet_soa = geom::TetrahedronSoa::from_tetras(tets);
+  glm::vec3 point(0.25f, 0.0f, -0.25f);
+  geom::contains_point_tetra(tet_soa, point, masks);
+  for (uint32_t i = 0; i < tets.size(); ++i) {
+    glm::vec4 bary;
+    bool expected = i != 5 && geom::contains_point_tetra(tets[i], point, bary);
+    L_ASSERT(((masks[i / 32] >> (i % 32)) & 1) == (expected ? 1 : 0));
+    if (expected) {
+      glm::vec4 bary2 = tet_soa.get_bary(i, point);
+      for (glm::length_t j = 0; j < 4; ++j) {
+        L_ASSERT(std::abs(bary[j] - bary2[j]) < 1e-4f);
+      }
+    }
+  }
+
+  auto is_near = [](const glm::vec3& a, const glm::vec3& b) {
+    glm::vec3 d = glm::abs(a - b);
+    return std::max(std::max(d.x, d.y), d.z) < 1e-5f;
+  };
+  glm::mat4 trans(1.0f);
+  trans[0] = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+  trans[1] = glm::vec4(-2.0f, 0.0f, 0.0f, 0.0f);
+  trans[3] = glm::vec4(1.0f, 2.0f, 3.0f, 1.0f);
+  soa.apply_trans(trans);
+  for (uint32_t i = 0; i < points.size(); ++i) {
+    glm::vec3 expected = glm::vec3(trans * glm::vec4(points[i], 1.0f));
+    L_ASSERT(is_near(soa.get(i), expected));
+  }
+  std::vector<geom::Aabb> aabbs;
+  for (uint32_t i = 0; i + 1 < points.size(); i += 2) {
+    aabbs.emplace_back(geom::Aabb::from_points(&points[i], 2));
+  }
+  geom::AabbSoa aabb_soa = geom::AabbSoa::from_aabbs(aabbs);
+  aabb_soa.apply_trans(trans);
+  for (uint32_t i = 0; i < aabbs.size(); ++i) {
+    // The transform is a rotation by 90 degrees and a scaling, so the bounds
+    // stay tight.
+    glm::vec3 a = soa.get(i * 2);
+    glm::vec3 b = soa.get(i * 2 + 1);
+    geom::Aabb expected = geom::Aabb::from_min_max(glm::min(a, b),
+      glm::max(a, b));
+    geom::Aabb aabb = aabb_soa.get(i);
+    L_ASSERT(is_near(aabb.min, expected.min));
+    L_ASSERT(is_near(aabb.max, expected.max));
+  }
+
+  std::vector<geom::Triangle> tris;
+  for (uint32_t i = 0; i + 2 < points.size(); i += 3) {
+    tris.emplace_back(geom::Triangle { points[i], points[i + 1],
+      points[i + 2] });
+  }
+  geom::TriangleSoa tri_soa = geom::TriangleSoa::from_tris(tris);
+  L_ASSERT(tri_soa.size() == tris.size());
+  geom::Aabb tri_bounds = geom::Aabb::from_points(&tris[0].a, 3);
+  for (uint32_t i = 0; i < tris.size(); ++i) {
+    geom::Triangle tri = tri_soa.get(i);
+    L_ASSERT(tri.a == tris[i].a && tri.b == tris[i].b && tri.c == tris[i].c);
+    geom::Aabb tri_aabb = geom::Aabb::from_points(&tris[i].a, 3);
+    tri_bounds.min = glm::min(tri_bounds.min, tri_aabb.min);
+    tri_bounds.max = glm::max(tri_bounds.max, tri_aabb.max);
+  }
+  geom::Aabb tri_soa_bounds = tri_soa.aabb();
+  L_ASSERT(tri_soa_bounds.min == tri_bounds.min);
+  L_ASSERT(tri_soa_bounds.max == tri_bounds.max);
+  tri_soa.apply_trans(trans);
+  for (uint32_t i = 0; i < tris.size(); ++i) {
+    geom::Triangle tri = tri_soa.get(i);
+    // The same points were transformed in `soa` above.
+    L_ASSERT(is_near(tri.a, soa.get(i * 3)));
+    L_ASSERT(is_near(tri.b, soa.get(i * 3 + 1)));
+    L_ASSERT(is_near(tri.c, soa.get(i * 3 + 2)));
+  }
+}
+
+L_TEST(GeomAabbGrid) {
+  auto is_same = [](const geom::Aabb& a, const geom::Aabb& b) {
+    return a.min.x == b.min.x && a.min.y == b.min.y && a.min.z == b.min.z &&
+      a.max.x == b.max.x && a.max.y == b.max.y && a.max.z == b.max.z;
+  };
+
+  geom::Aabb aabb = geom::Aabb::from_min_max(
+    glm::vec3(-1.0f, 0.1f, 3.0f),
+    glm::vec3(2.3f, 0.7f, 3.9f)
+  );
+  geom::AabbGrid grid { aabb, glm::uvec3(3, 4, 7) };
+  L_ASSERT(grid.size() == 84);
+
+  // Random access, iteration and ranged visits agree on every sub-box.
+  std::vector<geom::Aabb> sub_aabbs;
+  for (const geom::Aabb& sub_aabb : grid) {
+    sub_aabbs.emplace_back(sub_aabb);
+  }
+  L_ASSERT(sub_aabbs.size() == grid.size());
+  L_ASSERT(std::distance(grid.begin(), grid.end()) == (ptrdiff_t)grid.size());
+  std::vector<geom::Aabb> sub_aabbs2(grid.begin(), grid.end());
+  L_ASSERT(sub_aabbs2.size() == grid.size());
+  geom::AabbGrid::Iterator it = grid.begin();
+  L_ASSERT(is_same(*it++, sub_aabbs[0]) && is_same(*it, sub_aabbs[1]));
+  grid.for_each(17, 61, [&](size_t i, const geom::Aabb& sub_aabb) {
+    L_ASSERT(i >= 17 && i < 61);
+    L_ASSERT(is_same(sub_aabb, sub_aabbs[i]));
+  });
+
+  float volume = 0.0f;
+  for (uint32_t z = 0; z < grid.nslice.z; ++z) {
+    for (uint32_t y = 0; y < grid.nslice.y; ++y) {
+      for (uint32_t x = 0; x < grid.nslice.x; ++x) {
+        uint32_t i = (z * grid.nslice.y + y) * grid.nslice.x + x;
+        const geom::Aabb& sub_aabb = sub_aabbs[i];
+        L_ASSERT(is_same(sub_aabb, grid[i]));
+        L_ASSERT(is_same(sub_aabb, grid.get(x, y, z)));
+        glm::uvec3 coord = grid.get_coord(i);
+        L_ASSERT(coord.x == x && coord.y == y && coord.z == z);
+        glm::vec3 size = sub_aabb.size();
+        volume += size.x * size.y * size.z;
+
+        // No gaps between neighbours, and the outermost faces are exactly
+        // those of the box.
+        L_ASSERT(x > 0 || sub_aabb.min.x == aabb.min.x);
+        L_ASSERT(x + 1 < grid.nslice.x || sub_aabb.max.x == aabb.max.x);
+        L_ASSERT(x == 0 || sub_aabb.min.x == sub_aabbs[i - 1].max.x);
+        L_ASSERT(z > 0 || sub_aabb.min.z == aabb.min.z);
+        L_ASSERT(z + 1 < grid.nslice.z || sub_aabb.max.z == aabb.max.z);
+        L_ASSERT(z == 0 ||
+          sub_aabb.min.z == sub_aabbs[i - grid.nslice.x * grid.nslice.y].max.z);
+      }
+    }
+  }
+  glm::vec3 size = aabb.size();
+  L_ASSERT(std::abs(volume - size.x * size.y * size.z) < 1e-4f);
+
+  // Visiting in parallel chunks covers every sub-box exactly once.
+  std::vector<uint32_t> nvisit(grid.size());
+  parallel::parallel_for_range(0, grid.size(), [&](size_t beg, size_t end) {
+    grid.for_each(beg, end, [&](size_t i, const geom::Aabb& sub_aabb) {
+      L_ASSERT(is_same(sub_aabb, sub_aabbs[i]));
+      nvisit[i] += 1;
+    });
+  }, 5);
+  for (uint32_t n : nvisit) {
+    L_ASSERT(n == 1);
+  }
+
+  std::vector<geom::Aabb> out;
+  geom::subdivide_aabb(aabb, grid.nslice, out);
+  L_ASSERT(out.size() == sub_aabbs.size());
+  for (size_t i = 0; i < out.size(); ++i) {
+    L_ASSERT(is_same(out[i], sub_aabbs[i]));
+  }
+
+  // Tiles are centered on the box and cover it. Flat boxes still get a
+  // layer of tiles.
+  glm::vec3 tile_size(0.5f, 0.25f, 1.0f);
+  out.clear();
+  geom::tile_aabb_ceil(aabb, tile_size, out);
+  geom::AabbGrid tiles = geom::AabbGrid::from_tile_size(aabb, tile_size);
+  L_ASSERT(tiles.nslice.x == 7 && tiles.nslice.y == 3 && tiles.nslice.z == 1);
+  L_ASSERT(out.size() == tiles.size());
+  L_ASSERT(out.front().min.x <= aabb.min.x && out.back().max.x >= aabb.max.x);
+  L_ASSERT(out.front().min.y <= aabb.min.y && out.back().max.y >= aabb.max.y);
+  L_ASSERT(out.front().min.z <= aabb.min.z && out.back().max.z >= aabb.max.z);
+  for (const auto& tile : out) {
+    glm::vec3 d = tile.size() - tile_size;
+    L_ASSERT(std::abs(d.x) < 1e-5f && std::abs(d.y) < 1e-5f &&
+      std::abs(d.z) < 1e-5f);
+  }
+  geom::Aabb flat = geom::Aabb::from_min_max(
+    glm::vec3(0.0f, 0.0f, 1.0f),
+    glm::vec3(1.0f, 1.0f, 1.0f)
+  );
+  out.clear();
+  geom::tile_aabb_ceil(flat, glm::vec3(0.5f), out);
+  L_ASSERT(out.size() == 4);
+}
@@ -0,0 +1,197 @@
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "gft/log.hpp"
+
+#include "gft/assert.hpp"
+#include "gft/test.hpp"
+
+using namespace liong;
+
+namespace {
+
+std::mutex async_log_msgs_mutex_;
+std::vector<std::string> async_log_msgs_;
+
+// Records logged while async logging is being disabled are delivered on the
+// logging threads.
+void collect_async_log(log::LogLevel, const std::string& msg) {
+  std::lock_guard<std::mutex> guard(async_log_msgs_mutex_);
+  async_log_msgs_.emplace_back(msg);
+}
+void collect_async_log_and_flush(log::LogLevel lv, const std::string& msg) {
+  collect_async_log(lv, msg);
+  log::flush_log();
+}
+// Reaches a sampled log macro for the first time while logging.
+void collect_async_log_and_sample(log::LogLevel lv, const std::string& msg) {
+  thread_local bool is_collecting = false;
+  collect_async_log(lv, msg);
+  if (!is_collecting) {
+    is_collecting = true;
+    L_INFO_ONCE("sampled in callback");
+    is_collecting = false;
+  }
+}
+
+} // namespace
+
+L_SERIAL_TEST(AsyncLogKeepsPerThreadOrder) {
+  const uint32_t NTHREAD = 4;
+  const uint32_t NMSG = 1000;
+
+  log::LogCallback prev_cb = log::detail::l_log_callback__;
+  async_log_msgs_.clear();
+  log::set_log_callback(&collect_async_log);
+  log::enable_async_log(64, log::L_LOG_OVERFLOW_POLICY_BLOCK);
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < NTHREAD; ++i) {
+    threads.emplace_back([=]() {
+      log::push_indent();
+      for (uint32_t j = 0; j < NMSG; ++j) {
+        L_INFO(i, " ", j);
+      }
+      log::pop_indent();
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  log::disable_async_log();
+  log::set_log_callback(prev_cb);
+
+  L_ASSERT(async_log_msgs_.size() == NTHREAD * NMSG);
+  std::vector<uint32_t> next_j(NTHREAD, 0);
+  for (const auto& msg : async_log_msgs_) {
+    // Indentation is thread-local so every message has exactly one level.
+    L_ASSERT(msg.substr(0, 2) == "  " && msg[2] != ' ', msg);
+    uint32_t i = std::stoul(msg.substr(2));
+    uint32_t j = std::stoul(msg.substr(msg.find(' ', 2) + 1));
+    L_ASSERT(i < NTHREAD && j == next_j[i]++);
+  }
+}
+
+L_SERIAL_TEST(AsyncLogDropsOnOverflow) {
+  const uint32_t NMSG = 10000;
+
+  log::LogCallback prev_cb = log::detail::l_log_callback__;
+  async_log_msgs_.clear();
+  log::set_log_callback(&collect_async_log);
+  log::enable_async_log(4, log::L_LOG_OVERFLOW_POLICY_DROP);
+
+  std::thread thread([]() {
+    for (uint32_t j = 0; j < NMSG; ++j) {
+      L_INFO(j);
+    }
+  });
+  thread.join();
+  log::flush_log();
+  log::disable_async_log();
+  log::set_log_callback(prev_cb);
+
+  uint32_t nreceived = 0;
+  uint32_t ndropped = 0;
+  for (const auto& msg : async_log_msgs_) {
+    if (util::starts_with("dropped ", msg)) {
+      ndropped += std::stoul(msg.substr(8));
+    } else {
+      ++nreceived;
+    }
+  }
+  L_ASSERT(nreceived + ndropped == NMSG, nreceived, " + ", ndropped);
+}
+
+L_SERIAL_TEST(AsyncLogDeliversEverythingOnShutdown) {
+  const uint32_t NTHREAD = 4;
+  const uint32_t NMSG = 2000;
+
+  log::LogCallback prev_cb = log::detail::l_log_callback__;
+  for (uint32_t iround = 0; iround < 8; ++iround) {
+    async_log_msgs_.clear();
+    log::set_log_callback(&collect_async_log);
+    log::enable_async_log(16, log::L_LOG_OVERFLOW_POLICY_BLOCK);
+
+    // Disable async logging while the threads are still logging.
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < NTHREAD; ++i) {
+      threads.emplace_back([=]() {
+        for (uint32_t j = 0; j < NMSG; ++j) {
+          L_INFO(i, " ", j);
+        }
+      });
+    }
+    std::this_thread::yield();
+    log::disable_async_log();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    L_ASSERT(async_log_msgs_.size() == NTHREAD * NMSG);
+  }
+
+  // The callback may flush, e.g., through a failed assertion, without
+  // deadlocking.
+  async_log_msgs_.clear();
+  log::set_log_callback(&collect_async_log_and_flush);
+  log::enable_async_log();
+  L_INFO("reentrant");
+  log::flush_log();
+  log::disable_async_log();
+  log::set_log_callback(prev_cb);
+  L_ASSERT(async_log_msgs_.size() == 1);
+}
+
+L_SERIAL_TEST(SampledLogMacros) {
+  log::LogCallback prev_cb = log::detail::l_log_callback__;
+  async_log_msgs_.clear();
+  log::set_log_callback(&collect_async_log);
+
+  for (uint32_t i = 0; i < 10; ++i) {
+    L_INFO_EVERY_N(4, "every ", i);
+  }
+  for (uint32_t i = 0; i < 3; ++i) {
+    L_WARN_ONCE("once ", i);
+  }
+  // The bucket starts full with one token, and no more accumulates in this
+  // loop at such a low rate.
+  for (uint32_t i = 0; i < 5; ++i) {
+    L_INFO_RATE_LIMITED(0.001, "limited ", i);
+  }
+  log::set_log_callback(prev_cb);
+
+  std::vector<std::string> msgs;
+  for (const auto& msg : async_log_msgs_) {
+    msgs.emplace_back(util::trim(msg));
+  }
+  L_ASSERT(msgs.size() == 5);
+  L_ASSERT(msgs[0] == "every 0");
+  L_ASSERT(msgs[1] == "every 4 (3 similar messages suppressed)");
+  L_ASSERT(msgs[2] == "every 8 (3 similar messages suppressed)");
+  L_ASSERT(msgs[3] == "once 0");
+  L_ASSERT(msgs[4] == "limited 0");
+
+  // Destroyed call sites are not reported any more.
+  {
+    log::detail::LogSite site("destroyed-site", 1);
+    uint64_t nsuppressed;
+    site.sample_every_n(2, nsuppressed);
+    site.sample_every_n(2, nsuppressed);
+  }
+  async_log_msgs_.clear();
+  log::set_log_callback(&collect_async_log);
+  log::report_suppressed_logs();
+  log::set_log_callback(prev_cb);
+  for (const auto& msg : async_log_msgs_) {
+    L_ASSERT(msg.find("destroyed-site") == std::string::npos);
+  }
+
+  // Reporting doesn't hold the call site list while logging.
+  for (uint32_t i = 0; i < 3; ++i) {
+    L_INFO_ONCE("suppressed again");
+  }
+  async_log_msgs_.clear();
+  log::set_log_callback(&collect_async_log_and_sample);
+  log::report_suppressed_logs();
+  log::set_log_callback(prev_cb);
+  L_ASSERT(async_log_msgs_.size() >= 2);
+}
@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <cstdint>
+#include "gft/mesh.hpp"
+
+#include "gft/assert.hpp"
+#include "gft/test.hpp"
+
+using namespace liong;
+
+L_TEST(BinMeshExactOccupancy) {
+  geom::Aabb aabb =
+    geom::Aabb::from_min_max(glm::vec3(0.0f), glm::vec3(4.0f));
+  // A narrow triangle along the diagonal of the grid, whose bounds cover
+  // all 64 bins, and one far outside.
+  geom::Triangle diag {
+    { 0.0f, 0.0f, 0.0f },
+    { 4.0f, 4.0f, 4.0f },
+    { 4.0f, 4.0f, 3.9f },
+  };
+  geom::Triangle outside {
+    { 9.0f, 9.0f, 9.0f },
+    { 9.5f, 9.0f, 9.0f },
+    { 9.0f, 9.5f, 9.0f },
+  };
+  geom::Triangle corner {
+    { 3.5f, 3.5f, 3.5f },
+    { 4.0f, 3.5f, 3.5f },
+    { 3.5f, 4.0f, 4.0f },
+  };
+  mesh::Mesh mesh = mesh::Mesh::from_tris({ diag, outside, corner });
+  mesh::BinGrid grid = mesh::bin_mesh(aabb, glm::uvec3(4), mesh);
+
+  uint32_t nbin_diag = 0;
+  for (const auto& bin : grid.bins) {
+    bool has_diag =
+      std::find(bin.iprims.begin(), bin.iprims.end(), 0) != bin.iprims.end();
+    L_ASSERT(has_diag == geom::intersect_aabb_tri(diag, bin.aabb));
+    nbin_diag += has_diag ? 1 : 0;
+    // Triangles keep their indices in the mesh even if some are skipped.
+    L_ASSERT(std::find(bin.iprims.begin(), bin.iprims.end(), 1) ==
+      bin.iprims.end());
+  }
+  L_ASSERT(nbin_diag < 64);
+  const mesh::Bin& last_bin = grid.get_bin(3, 3, 3);
+  L_ASSERT(std::find(last_bin.iprims.begin(), last_bin.iprims.end(), 2) !=
+    last_bin.iprims.end());
+
+  // Points on the far boundary land in the last bins.
+  mesh::BinGrid point_grid =
+    mesh::bin_point_cloud(aabb, glm::uvec3(4), { { glm::vec3(4.0f) } });
+  L_ASSERT(point_grid.get_bin(3, 3, 3).iprims.size() == 1);
+}
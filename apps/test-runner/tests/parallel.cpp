@@ -0,0 +1,150 @@
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+#include "gft/parallel.hpp"
+
+#include "gft/assert.hpp"
+#include "gft/test.hpp"
+
+using namespace liong;
+
+L_TEST(ParallelForCoversRange) {
+  const size_t N = 100003;
+  std::vector<std::atomic<uint32_t>> hits(N);
+  parallel::parallel_for(0, N, [&](size_t i) { hits[i].fetch_add(1); });
+  size_t nmismatch = 0;
+  for (size_t i = 0; i < N; ++i) {
+    nmismatch += hits[i].load() == 1 ? 0 : 1;
+  }
+  L_ASSERT(nmismatch == 0);
+
+  std::atomic<size_t> ncovered { 0 };
+  parallel::parallel_for_range(
+    10,
+    1000,
+    [&](size_t beg, size_t end) {
+      L_ASSERT(beg < end && end - beg <= 7);
+      ncovered.fetch_add(end - beg);
+    },
+    7
+  );
+  L_ASSERT(ncovered.load() == 990);
+}
+
+L_TEST(ParallelReduceScanSort) {
+  const size_t N = 50000;
+  std::vector<uint64_t> xs(N);
+  for (size_t i = 0; i < N; ++i) {
+    xs[i] = (i * 2654435761u) % 1000;
+  }
+
+  uint64_t sum = parallel::parallel_reduce(
+    0,
+    N,
+    uint64_t(0),
+    [&](size_t beg, size_t end) {
+      return std::accumulate(xs.begin() + beg, xs.begin() + end, uint64_t(0));
+    },
+    [](uint64_t a, uint64_t b) { return a + b; }
+  );
+  L_ASSERT(sum == std::accumulate(xs.begin(), xs.end(), uint64_t(0)));
+
+  std::vector<uint64_t> scanned =
+    parallel::parallel_scan(xs, [](uint64_t a, uint64_t b) { return a + b; });
+  std::vector<uint64_t> expected(N);
+  std::partial_sum(xs.begin(), xs.end(), expected.begin());
+  L_ASSERT(scanned == expected);
+
+  std::vector<uint64_t> sorted = xs;
+  parallel::parallel_sort(sorted.begin(), sorted.end());
+  expected = xs;
+  std::sort(expected.begin(), expected.end());
+  L_ASSERT(sorted == expected);
+  // Uneven chunks, and a number of chunks that isn't a power of two.
+  sorted = xs;
+  parallel::parallel_sort(
+    sorted.begin(), sorted.end(), std::greater<uint64_t>(), 7001
+  );
+  L_ASSERT(std::is_sorted(sorted.begin(), sorted.end(), std::greater<>()));
+
+  std::vector<uint64_t> doubled = util::map<uint64_t, uint64_t>(
+    parallel::par, xs, [](const uint64_t& x) { return x * 2; }
+  );
+  size_t nmismatch = 0;
+  for (size_t i = 0; i < N; ++i) {
+    nmismatch += doubled[i] == xs[i] * 2 ? 0 : 1;
+  }
+  L_ASSERT(nmismatch == 0);
+
+  // Results don't have to be default-constructible.
+  struct Boxed {
+    uint64_t x;
+    Boxed(uint64_t x) : x(x) {}
+  };
+  std::vector<Boxed> boxed = util::map<uint64_t, Boxed>(
+    parallel::par, xs, [](const uint64_t& x) { return Boxed(x); }
+  );
+  nmismatch = 0;
+  for (size_t i = 0; i < N; ++i) {
+    nmismatch += boxed[i].x == xs[i] ? 0 : 1;
+  }
+  L_ASSERT(nmismatch == 0);
+}
+
+L_TEST(ParallelTaskGroupNestingAndExceptions) {
+  std::atomic<uint32_t> n { 0 };
+  parallel::TaskGroup group;
+  for (uint32_t i = 0; i < 16; ++i) {
+    group.run([&]() {
+      // Waiting inside a task must not deadlock the pool.
+      parallel::parallel_for(0, 64, [&](size_t) { n.fetch_add(1); });
+    });
+  }
+  group.wait();
+  L_ASSERT(n.load() == 16 * 64);
+
+  std::future<int> answer = parallel::get_default_pool().submit([]() {
+    return 42;
+  });
+  L_ASSERT(answer.get() == 42);
+
+  bool has_thrown = false;
+  try {
+    parallel::parallel_for(0, 1000, [](size_t i) {
+      if (i == 567) {
+        throw std::runtime_error("567");
+      }
+    });
+  } catch (const std::runtime_error& e) {
+    has_thrown = std::string(e.what()) == "567";
+  }
+  L_ASSERT(has_thrown);
+}
+
+L_SERIAL_TEST(ParallelDeterministicMode) {
+  parallel::enable_deterministic_mode();
+  std::vector<size_t> order;
+  parallel::parallel_for(0, 100, [&](size_t i) { order.emplace_back(i); });
+  parallel::disable_deterministic_mode();
+
+  L_ASSERT(order.size() == 100);
+  for (size_t i = 0; i < order.size(); ++i) {
+    L_ASSERT(order[i] == i);
+  }
+}
+
+L_TEST(ParallelPoolDrainsOnDestruction) {
+  std::atomic<uint32_t> n { 0 };
+  {
+    parallel::ThreadPool pool(2);
+    for (uint32_t i = 0; i < 256; ++i) {
+      pool.spawn([&pool, &n]() {
+        // Tasks spawned while the pool is shutting down are run too.
+        pool.spawn([&n]() { n.fetch_add(1); });
+        n.fetch_add(1);
+      });
+    }
+  }
+  L_ASSERT(n.load() == 512);
+}
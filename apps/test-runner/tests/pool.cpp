@@ -0,0 +1,149 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gft/pool.hpp"
+
+#include "gft/assert.hpp"
+#include "gft/test.hpp"
+
+using namespace liong;
+
+L_TEST(SyncPoolRecyclesValues) {
+  pool::SyncPool<std::string, int> pool(2);
+  L_ASSERT(!pool.has_free_item("a"));
+  {
+    auto a = pool.create("a", 1);
+    auto a2 = a;
+    L_ASSERT(a2.value() == 1);
+    a.release();
+    // Still referenced by the copy.
+    L_ASSERT(!pool.has_free_item("a"));
+  }
+  L_ASSERT(pool.has_free_item("a"));
+  L_ASSERT(!pool.has_free_item("b"));
+
+  pool::SyncPool<std::string, int>::Item item;
+  L_ASSERT(!pool.try_acquire("b", item));
+  L_ASSERT(pool.try_acquire("a", item));
+  L_ASSERT(item.key() == "a" && item.value() == 1);
+  L_ASSERT(!pool.has_free_item("a"));
+
+  auto b = pool.acquire_or_create("b", []() { return 2; });
+  L_ASSERT(b.value() == 2);
+}
+
+L_TEST(SyncPoolConcurrentAcquireRelease) {
+  const uint32_t NTHREAD = 4;
+  const uint32_t NITER = 2000;
+  pool::SyncPool<int, uint32_t> pool(2, 2);
+  std::atomic<uint32_t> ncreated { 0 };
+  // Values must never be handed out to two owners at once.
+  std::vector<std::atomic<bool>> is_owned(NTHREAD * NITER * 2);
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < NTHREAD; ++i) {
+    threads.emplace_back([&, i]() {
+      for (uint32_t j = 0; j < NITER; ++j) {
+        int key = (i + j) % 3;
+        auto a = pool.acquire_or_create(key, [&]() {
+          return ncreated.fetch_add(1);
+        });
+        auto b = pool.acquire_or_create(key, [&]() {
+          return ncreated.fetch_add(1);
+        });
+        L_ASSERT(a.key() == key && b.key() == key);
+        L_ASSERT(!is_owned[a.value()].exchange(true));
+        L_ASSERT(!is_owned[b.value()].exchange(true));
+        is_owned[a.value()].store(false);
+        is_owned[b.value()].store(false);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // At most two live values per thread at any time.
+  L_ASSERT(ncreated.load() <= NTHREAD * 2 * 3);
+}
+
+L_TEST(SyncPoolEvictsLeastRecentlyReleased) {
+  std::vector<int> destroyed;
+  pool::SyncPool<std::string, int>::Config cfg {};
+  cfg.nshard = 2;
+  cfg.max_idle = 3;
+  cfg.max_idle_per_key = 2;
+  cfg.on_destroy = [&](const std::string&, int& value) {
+    destroyed.emplace_back(value);
+  };
+  pool::SyncPool<std::string, int> pool(cfg);
+
+  {
+    auto a1 = pool.create("a", 1);
+    auto a2 = pool.create("a", 2);
+    auto a3 = pool.create("a", 3);
+    auto counters = pool.counters();
+    L_ASSERT(counters.nlive == 3 && counters.nidle == 0);
+    a1.release();
+    a2.release();
+    // Exceeds the per-key limit; the first released goes.
+    a3.release();
+  }
+  L_ASSERT(destroyed.size() == 1 && destroyed[0] == 1);
+  {
+    auto b1 = pool.create("b", 4);
+    auto b2 = pool.create("b", 5);
+    b1.release();
+    // Exceeds the total limit.
+    b2.release();
+  }
+  L_ASSERT(destroyed.size() == 2 && destroyed[1] == 2);
+
+  auto counters = pool.counters();
+  L_ASSERT(counters.nlive == 0);
+  L_ASSERT(counters.nidle == 3);
+  L_ASSERT(counters.nevicted == 2);
+
+  pool::SyncPool<std::string, int>::Item item;
+  L_ASSERT(pool.try_acquire("a", item) && item.value() == 3);
+  L_ASSERT(!pool.try_acquire("a", item));
+  counters = pool.counters();
+  L_ASSERT(counters.nhit == 1 && counters.nmiss == 1);
+  L_ASSERT(counters.nlive == 1 && counters.nidle == 2);
+  item.release();
+
+  // Values still idle are destroyed on clear as well.
+  pool.clear();
+  L_ASSERT(destroyed.size() == 5);
+  L_ASSERT(pool.counters().nidle == 0);
+}
+
+L_TEST(SyncPoolEvictsIdleValues) {
+  std::atomic<uint32_t> ndestroyed { 0 };
+  // A fake clock, so that idle times don't depend on the machine load.
+  std::atomic<uint64_t> now_ns { 1000000000 };
+  pool::SyncPool<int, int>::Config cfg {};
+  cfg.max_idle_time = std::chrono::milliseconds(10);
+  cfg.on_destroy = [&](const int&, int&) { ndestroyed.fetch_add(1); };
+  cfg.get_now_ns = [&]() { return now_ns.load(); };
+  pool::SyncPool<int, int> pool(cfg);
+
+  pool.create(0, 0);
+  now_ns.fetch_add(9000000);
+  pool.evict();
+  L_ASSERT(ndestroyed.load() == 0);
+  now_ns.fetch_add(11000000);
+  // Releasing after the limit passed also checks idle times.
+  pool.create(1, 1);
+  L_ASSERT(ndestroyed.load() == 1);
+  L_ASSERT(pool.has_free_item(1) && !pool.has_free_item(0));
+  L_ASSERT(pool.counters().nevicted == 1);
+
+  now_ns.fetch_add(20000000);
+  // So does acquiring, even if nothing is released afterwards.
+  pool::SyncPool<int, int>::Item item;
+  L_ASSERT(!pool.try_acquire(1, item));
+  L_ASSERT(ndestroyed.load() == 2);
+  L_ASSERT(pool.counters().nidle == 0);
+}
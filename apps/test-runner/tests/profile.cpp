@@ -0,0 +1,54 @@
+#include <thread>
+#include "gft/profile.hpp"
+
+#include "gft/assert.hpp"
+#include "gft/log.hpp"
+#include "gft/test.hpp"
+
+using namespace liong;
+
+L_SERIAL_TEST(ProfileSummaryAndTrace) {
+  profile::clear_profile_events();
+
+  // Scopes are instantiated directly so that they are recorded even if
+  // `L_PROFILE_SCOPE` is compiled out.
+  auto work = []() {
+    profile::ProfileScope outer("outer");
+    for (uint32_t i = 0; i < 3; ++i) {
+      profile::ProfileScope inner("inner");
+      util::sleep_for_us(100);
+    }
+  };
+  work();
+  std::thread(work).join();
+
+  std::vector<profile::ProfileEvent> events = profile::collect_profile_events();
+  L_ASSERT(events.size() == 8);
+  L_ASSERT(events[0].name == std::string("outer") && events[0].depth == 0);
+  L_ASSERT(events[1].name == std::string("inner") && events[1].depth == 1);
+  L_ASSERT(events[0].tid != events[4].tid);
+
+  std::vector<profile::ProfileSummaryEntry> flat =
+    profile::summarize_flat(events);
+  L_ASSERT(flat.size() == 2);
+  L_ASSERT(flat[0].name == "outer" && flat[0].ncall == 2);
+  L_ASSERT(flat[1].name == "inner" && flat[1].ncall == 6);
+  L_ASSERT(flat[0].self_ns + flat[1].total_ns == flat[0].total_ns);
+  L_ASSERT(flat[1].self_ns == flat[1].total_ns);
+  L_ASSERT(flat[1].min_ns >= 100000);
+
+  std::vector<profile::ProfileSummaryEntry> tree =
+    profile::summarize_hierarchical(events);
+  L_ASSERT(tree.size() == 2);
+  L_ASSERT(tree[0].name == "outer" && tree[0].depth == 0);
+  L_ASSERT(tree[1].name == "inner" && tree[1].depth == 1);
+  L_INFO("profile summary:\n", profile::print_profile_summary(tree));
+
+  json::JsonValue trace = profile::to_chrome_trace(events);
+  const json::JsonArray& trace_events = trace.obj.at("traceEvents").arr;
+  L_ASSERT(trace_events.size() == 8);
+  L_ASSERT(trace_events[0].obj.at("ph").str == "X");
+  L_ASSERT(trace_events[0].obj.at("ts").num_float == 0.0);
+
+  profile::clear_profile_events();
+}
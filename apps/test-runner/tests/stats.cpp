@@ -0,0 +1,179 @@
+#include <random>
+#include <thread>
+#include "gft/stats.hpp"
+
+#include "gft/assert.hpp"
+#include "gft/log.hpp"
+#include "gft/test.hpp"
+
+using namespace liong;
+
+L_TEST(StatsWelfordMatchesStd) {
+  stats::StdStats<double> std_stats {};
+  stats::WelfordStats<double> welford {};
+  stats::WelfordStats<double> welford_a {};
+  stats::WelfordStats<double> welford_b {};
+  for (uint32_t i = 0; i < 1000; ++i) {
+    double x = 1e6 + (i * 7919 % 1000) * 0.01;
+    std_stats.push(x);
+    welford.push(x);
+    (i < 300 ? welford_a : welford_b).push(x);
+  }
+  welford_a.merge(welford_b);
+  L_ASSERT(std::abs(welford.avg() - std_stats.avg()) < 1e-6);
+  L_ASSERT(std::abs((double)welford - (double)std_stats) < 1e-6);
+  L_ASSERT(std::abs(welford_a.avg() - welford.avg()) < 1e-6);
+  L_ASSERT(std::abs(welford_a.var() - welford.var()) < 1e-6);
+}
+
+L_TEST(StatsHistogramPercentiles) {
+  stats::HistogramStats<double> hist {};
+  stats::HistogramStats<double> hist_a {};
+  stats::HistogramStats<double> hist_b {};
+  for (uint32_t i = 1; i <= 10000; ++i) {
+    double x = i * 0.001;
+    hist.push(x);
+    (i % 2 ? hist_a : hist_b).push(x);
+  }
+  hist_a.merge(hist_b);
+
+  const double tolerance = 1.0 / 128;
+  for (double p : { 50.0, 95.0, 99.0, 99.9 }) {
+    double expect = p * 0.1;
+    double actual = hist.percentile(p);
+    L_ASSERT(std::abs(actual - expect) <= expect * tolerance, p, ": ", actual);
+    L_ASSERT(hist_a.percentile(p) == actual);
+  }
+  L_ASSERT(hist.percentile(0) == 0.001);
+  L_ASSERT(hist.percentile(100) == 10.0);
+  L_ASSERT(hist.count() == 10000 && hist_a.count() == 10000);
+}
+
+L_TEST(StatsP2Quantile) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> dist(0.0, 100.0);
+  stats::P2QuantileStats<double> median {};
+  stats::P2QuantileStats<double> p99(0.99);
+  for (uint32_t i = 0; i < 100000; ++i) {
+    double x = dist(rng);
+    median.push(x);
+    p99.push(x);
+  }
+  L_ASSERT(std::abs((double)median - 50.0) < 1.0, (double)median);
+  L_ASSERT(std::abs((double)p99 - 99.0) < 0.5, (double)p99);
+
+  stats::P2QuantileStats<int> few {};
+  few.push(3);
+  few.push(1);
+  few.push(2);
+  L_ASSERT((int)few == 2);
+}
+
+L_TEST(StatsWindowedAggregates) {
+  const uint32_t NSAMPLE = 16;
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> dist(-1000, 1000);
+
+  stats::WindowMinStats<int> mn(NSAMPLE);
+  stats::WindowMaxStats<int> mx(NSAMPLE);
+  stats::WindowAvgStats<int> avg(NSAMPLE);
+  stats::WindowPercentileStats<int> pct(NSAMPLE);
+  std::vector<int> xs;
+  for (uint32_t i = 0; i < 1000; ++i) {
+    int x = dist(rng);
+    xs.emplace_back(x);
+    mn.push(x);
+    mx.push(x);
+    avg.push(x);
+    pct.push(x);
+
+    std::vector<int> window(
+      xs.end() - std::min<size_t>(xs.size(), NSAMPLE), xs.end()
+    );
+    int sum = 0;
+    for (int y : window) {
+      sum += y;
+    }
+    std::sort(window.begin(), window.end());
+    L_ASSERT((int)mn == window.front());
+    L_ASSERT((int)mx == window.back());
+    L_ASSERT((int)avg == sum / (int)window.size());
+    L_ASSERT(pct.percentile(100) == window.back());
+    L_ASSERT(pct.quantile(0.5) == window[(window.size() + 1) / 2 - 1]);
+  }
+}
+
+L_TEST(StatsWindowExpiresByAge) {
+  stats::WindowMaxStats<int> mx(1024, std::chrono::milliseconds(20));
+  mx.push(100);
+  util::sleep_for_us(40000);
+  mx.push(1);
+  L_ASSERT((int)mx == 1);
+
+  // Samples also expire while nothing is pushed.
+  stats::WindowMinStats<int> mn(1024, std::chrono::milliseconds(20));
+  stats::WindowAvgStats<int> avg(1024, std::chrono::milliseconds(20));
+  stats::WindowPercentileStats<int> pct(1024, std::chrono::milliseconds(20));
+  mn.push(1);
+  avg.push(1);
+  pct.push(1);
+  L_ASSERT(mn.has_value() && avg.count() == 1 && pct.count() == 1);
+  util::sleep_for_us(40000);
+  L_ASSERT(!mx.has_value() && !mn.has_value());
+  L_ASSERT(avg.count() == 0 && !avg.has_value());
+  L_ASSERT(pct.count() == 0 && !pct.has_value());
+  avg.push(3);
+  L_ASSERT((int)avg == 3);
+}
+
+L_TEST(StatsEwma) {
+  stats::EwmaStats<double> ewma(0.5);
+  L_ASSERT(!ewma.has_value());
+  ewma.push(10.0);
+  L_ASSERT((double)ewma == 10.0 && ewma.var() == 0.0);
+  ewma.push(20.0);
+  L_ASSERT((double)ewma == 15.0 && ewma.var() == 25.0);
+  for (uint32_t i = 0; i < 100; ++i) {
+    ewma.push(4.0);
+  }
+  L_ASSERT(std::abs((double)ewma - 4.0) < 1e-9 && ewma.stddev() < 1e-9);
+}
+
+L_TEST(StatsShardedConcurrentPush) {
+  const uint32_t NTHREAD = 8;
+  const uint32_t NSAMPLE = 20000;
+
+  // Fewer shards than threads so that some threads share a shard.
+  stats::ShardedStats<stats::WelfordStats<double>> welford(4);
+  stats::ShardedStats<stats::HistogramStats<double>> hist(4);
+  stats::ShardedStats<stats::MaxStats<int>> mx(4);
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < NTHREAD; ++i) {
+    threads.emplace_back([&, i]() {
+      for (uint32_t j = 0; j < NSAMPLE; ++j) {
+        welford.push(i);
+        hist.push(i + 1);
+        mx.push(i * NSAMPLE + j);
+      }
+    });
+  }
+  // Snapshots can be taken while workers are pushing.
+  for (uint32_t i = 0; i < 10; ++i) {
+    welford.snapshot();
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  stats::WelfordStats<double> welford2 = welford.snapshot();
+  L_ASSERT(welford2.count() == NTHREAD * NSAMPLE);
+  L_ASSERT(std::abs(welford2.avg() - (NTHREAD - 1) / 2.0) < 1e-9);
+  stats::HistogramStats<double> hist2 = hist.snapshot();
+  L_ASSERT(hist2.count() == NTHREAD * NSAMPLE);
+  L_ASSERT(hist2.min() == 1.0 && hist2.max() == NTHREAD);
+  L_ASSERT((int)mx == NTHREAD * NSAMPLE - 1);
+
+  welford.reset();
+  L_ASSERT(!welford.has_value());
+}
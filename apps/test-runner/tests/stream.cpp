@@ -38,3 +38,160 @@ L_TEST(StreamReadWriteStructRoundTrip) {
   L_ASSERT(xw.b == xr.b);
   L_ASSERT(xw.c == xr.c);
 }
+
+L_TEST(StreamViewAlignedAndUnaligned) {
+  stream::WriteStream ws;
+  ws.append<uint32_t>(1);
+  ws.append<uint32_t>(2);
+  ws.append<uint32_t>(3);
+  ws.append<uint8_t>(4);
+
+  std::vector<uint8_t> data = ws.take();
+  {
+    stream::ReadStream rs(data.data(), data.size());
+    stream::ReadView<uint32_t> view = rs.view_all<uint32_t>();
+    L_ASSERT(view.is_borrowed());
+    L_ASSERT(view.data() == (const uint32_t*)data.data());
+    L_ASSERT(view.size() == 3);
+    L_ASSERT(view[0] == 1 && view[1] == 2 && view[2] == 3);
+    L_ASSERT(rs.size_remain() == 1);
+  }
+  {
+    // Misaligned data has to be copied.
+    stream::ReadStream rs(data.data() + 1, data.size() - 1);
+    stream::ReadView<uint32_t> view = rs.view<uint32_t>(3);
+    L_ASSERT(!view.is_borrowed());
+    L_ASSERT(view.size() == 3);
+    L_ASSERT(view[0] == 0x02000000 && view[2] == 0x04000000);
+    L_ASSERT(rs.ate());
+  }
+  {
+    stream::ReadStream rs(data.data(), data.size());
+    std::vector<float> out =
+      rs.extract_all_map<uint32_t>([](uint32_t x) { return x * 0.5f; });
+    L_ASSERT(out.size() == 3);
+    L_ASSERT(out[0] == 0.5f && out[1] == 1.0f && out[2] == 1.5f);
+  }
+}
+
+L_TEST(StreamChunkedWriteAndPatch) {
+  std::vector<uint8_t> ref { 7, 8, 9 };
+
+  stream::ChunkedWriteStream ws(4);
+  ws.reserve(6);
+  ws.append<uint16_t>(1);
+  size_t patch_offset = ws.size();
+  ws.append<uint32_t>(0);
+  ws.append_data_ref(ref.data(), ref.size());
+  ws.append<uint8_t>(10);
+  ws.append<uint64_t>(11);
+  L_ASSERT(ws.size() == 18);
+
+  // Patch a value across the chunk boundary.
+  ws.patch<uint32_t>(patch_offset, 0x12345678);
+
+  std::vector<uint8_t> data = ws.take();
+  L_ASSERT(data.size() == 18);
+  L_ASSERT(ws.size() == 0);
+  stream::ReadStream rs(data.data(), data.size());
+  L_ASSERT(rs.extract<uint16_t>() == 1);
+  L_ASSERT(rs.extract<uint32_t>() == 0x12345678);
+  L_ASSERT(rs.extract<uint8_t>() == 7);
+  L_ASSERT(rs.extract<uint8_t>() == 8);
+  L_ASSERT(rs.extract<uint8_t>() == 9);
+  L_ASSERT(rs.extract<uint8_t>() == 10);
+  L_ASSERT(rs.extract<uint64_t>() == 11);
+  L_ASSERT(rs.ate());
+}
+
+L_TEST(StreamEndianAndVarintRoundTrip) {
+  std::vector<uint64_t> uvalues { 0,          1,          127,
+                                  128,        300,        0xFFFFFFFF,
+                                  1ull << 63, ~uint64_t(0) };
+  std::vector<int64_t> ivalues { 0,  -1,        1,         -64,
+                                 64, -8193,     123456789, INT64_MIN,
+                                 INT64_MAX };
+
+  stream::WriteStream ws;
+  ws.append_le<uint32_t>(0x12345678);
+  ws.append_be<uint32_t>(0x12345678);
+  ws.append_be<double>(1.5);
+  for (uint64_t x : uvalues) {
+    ws.append_uleb128(x);
+  }
+  for (int64_t x : ivalues) {
+    ws.append_sleb128(x);
+    ws.append_zigzag(x);
+  }
+
+  std::vector<uint8_t> data = ws.take();
+  L_ASSERT(data.at(0) == 0x78 && data.at(4) == 0x12);
+  stream::ReadStream rs(data.data(), data.size());
+  L_ASSERT(rs.extract_le<uint32_t>() == 0x12345678);
+  L_ASSERT(rs.extract_be<uint32_t>() == 0x12345678);
+  L_ASSERT(rs.extract_be<double>() == 1.5);
+  for (uint64_t x : uvalues) {
+    L_ASSERT(rs.extract_uleb128() == x);
+  }
+  for (int64_t x : ivalues) {
+    L_ASSERT(rs.extract_sleb128() == x);
+    L_ASSERT(rs.extract_zigzag() == x);
+  }
+  L_ASSERT(rs.ate());
+
+  // Truncated and overlong encodings are rejected.
+  std::vector<uint8_t> bad { 0x80, 0x80 };
+  stream::ReadStream rs2(bad.data(), bad.size());
+  uint64_t x;
+  L_ASSERT(!rs2.try_extract_uleb128(x));
+  L_ASSERT(rs2.offset() == 0);
+  std::vector<uint8_t> overlong(11, 0xFF);
+  stream::ReadStream rs3(overlong.data(), overlong.size());
+  L_ASSERT(!rs3.try_extract_uleb128(x));
+  // The 10th byte of a signed value can't carry bits beyond 64.
+  int64_t y;
+  std::vector<uint8_t> overflow(10, 0x80);
+  for (uint8_t last : { 0x01, 0x3F, 0x40, 0x7E }) {
+    overflow.back() = last;
+    stream::ReadStream rs4(overflow.data(), overflow.size());
+    L_ASSERT(!rs4.try_extract_sleb128(y));
+    L_ASSERT(rs4.offset() == 0);
+  }
+  overflow.back() = 0x7F;
+  stream::ReadStream rs5(overflow.data(), overflow.size());
+  L_ASSERT(rs5.try_extract_sleb128(y) && y == INT64_MIN);
+}
+
+L_TEST(StreamBitPackingRoundTrip) {
+  stream::ChunkedWriteStream ws;
+  stream::BitWriter<stream::ChunkedWriteStream> bw(ws);
+  for (uint32_t i = 0; i < 1000; ++i) {
+    bw.write(i * 0x9E3779B97F4A7C15ull, i % 65);
+    bw.write_bit(i & 1);
+  }
+  bw.flush();
+  ws.append<uint8_t>(0xAB);
+
+  std::vector<uint8_t> data = ws.take();
+  stream::ReadStream rs(data.data(), data.size());
+  stream::BitReader br(rs);
+  for (uint32_t i = 0; i < 1000; ++i) {
+    uint32_t nbit = i % 65;
+    uint64_t mask = nbit == 64 ? ~uint64_t(0) : (uint64_t(1) << nbit) - 1;
+    L_ASSERT(br.read(nbit) == ((i * 0x9E3779B97F4A7C15ull) & mask));
+    L_ASSERT(br.read_bit() == ((i & 1) != 0));
+  }
+  br.align();
+  L_ASSERT(rs.extract<uint8_t>() == 0xAB);
+  L_ASSERT(rs.ate());
+
+  // Failed reads consume nothing, even when they span two words.
+  std::vector<uint8_t> short_data { 0x01, 0x23, 0x45, 0x67, 0x89 };
+  stream::ReadStream rs2(short_data.data(), short_data.size());
+  stream::BitReader br2(rs2);
+  uint64_t x;
+  L_ASSERT(br2.read(4) == 0x1);
+  L_ASSERT(!br2.try_read(37, x));
+  L_ASSERT(br2.try_read(36, x) && x == 0x896745230);
+  L_ASSERT(!br2.try_read(1, x));
+}
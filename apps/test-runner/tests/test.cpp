@@ -0,0 +1,33 @@
+#include "gft/assert.hpp"
+#include "gft/json.hpp"
+#include "gft/test.hpp"
+
+using namespace liong;
+
+L_TEST(TestReportDurations) {
+  test::TestReport report {};
+  report.nsucc = 1;
+  report.nfail = 1;
+  report.results.emplace_back(test::TestResult { "A", true, 1000, "" });
+  report.results.emplace_back(test::TestResult { "B", false, 20, "oops" });
+
+  std::map<std::string, uint64_t> durations =
+    test::json2durations(json::parse(json::print(test::report2json(report))));
+  L_ASSERT(durations.size() == 2);
+  L_ASSERT(durations.at("A") == 1000 && durations.at("B") == 20);
+
+  // Malformed reports are ignored instead of failing the run.
+  const char* bad_lits[] = {
+    "[]",
+    "{}",
+    "{\"tests\":{}}",
+    "{\"tests\":[1]}",
+    "{\"tests\":[{\"name\":\"A\"}]}",
+    "{\"tests\":[{\"name\":1,\"duration_ns\":1}]}",
+    "{\"tests\":[{\"name\":\"A\",\"duration_ns\":\"1\"}]}",
+    "{\"tests\":[{\"name\":\"A\",\"duration_ns\":-1}]}",
+  };
+  for (const char* lit : bad_lits) {
+    L_ASSERT(test::json2durations(json::parse(lit)).empty(), lit);
+  }
+}
@@ -1,3 +1,5 @@
+#include <cstdio>
+#include <stdexcept>
 #include "gft/util.hpp"
 
 #include "gft/assert.hpp"
@@ -9,3 +11,96 @@ L_TEST(Crc32Correctness) {
   uint32_t x = liong::util::crc32(data.data(), data.size());
   L_ASSERT(x == 0xc4c82680);
 }
+
+L_TEST(MappedFileAndAsyncLoad) {
+  using namespace liong;
+  std::string text = "penguinliong";
+  std::vector<std::string> paths;
+  for (uint32_t i = 0; i < 8; ++i) {
+    std::string path = util::format("mapped-file-", i, ".txt");
+    util::save_text(path.c_str(), util::format(text, i));
+    paths.emplace_back(path);
+  }
+  util::save_text("mapped-file-empty.txt", "");
+
+  {
+    util::MappedFile file(paths.at(0).c_str());
+    L_ASSERT(std::string(file.begin(), file.end()) == text + "0");
+    util::MappedFile file2 = std::move(file);
+    L_ASSERT(file.data() == nullptr);
+    L_ASSERT(file2.size() == text.size() + 1);
+
+    util::MappedFile empty("mapped-file-empty.txt");
+    L_ASSERT(empty.size() == 0);
+
+    util::MappedFile missing {};
+    L_ASSERT(!util::MappedFile::try_map(
+      "mapped-file-missing.txt", util::L_MAPPED_FILE_ACCESS_HINT_NORMAL, missing
+    ));
+  }
+
+  paths.emplace_back("mapped-file-missing.txt");
+  auto futs = util::load_files_async(paths);
+  L_ASSERT(futs.size() == paths.size());
+  for (uint32_t i = 0; i < 8; ++i) {
+    util::MappedFile file = futs.at(i).get();
+    L_ASSERT(std::string(file.begin(), file.end()) == util::format(text, i));
+  }
+  bool threw = false;
+  try {
+    futs.back().get();
+  } catch (const std::exception&) {
+    threw = true;
+  }
+  L_ASSERT(threw);
+
+  paths.pop_back();
+  paths.emplace_back("mapped-file-empty.txt");
+  for (const auto& path : paths) {
+    std::remove(path.c_str());
+  }
+}
+
+struct FormatTestStreamable {
+  int x;
+  friend std::ostream& operator<<(
+    std::ostream& out,
+    const FormatTestStreamable& x
+  ) {
+    return out << "streamable(" << liong::util::format(x.x) << ")";
+  }
+};
+
+struct FormatTestThrowing {
+  friend std::ostream& operator<<(
+    std::ostream&,
+    const FormatTestThrowing&
+  ) {
+    throw std::runtime_error("unformattable");
+  }
+};
+
+L_TEST(FormatMatchesStream) {
+  using liong::util::format;
+  L_ASSERT(format("a", 1, 'b', -2ll, 3u, true) == "a1b-231");
+  L_ASSERT(format(1.5f, " ", 0.1, " ", 1e20, " ", 123456789.0) ==
+    "1.5 0.1 1e+20 1.23457e+08");
+  L_ASSERT(format(std::string("str"), std::string_view("view")) == "strview");
+  L_ASSERT(format(FormatTestStreamable { 4 }) == "streamable(4)");
+  L_ASSERT(liong::util::join(", ", 1, 2, 3) == "1, 2, 3");
+  L_ASSERT(liong::util::join("-", std::vector<int> { 4, 5 }) == "4-5");
+
+  std::string out = "x=";
+  liong::util::format_to(out, 42);
+  L_ASSERT(out == "x=42");
+
+  // The thread-local stream is released when formatting throws.
+  bool threw = false;
+  try {
+    format(FormatTestThrowing {});
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  L_ASSERT(threw);
+  L_ASSERT(liong::util::detail::FormatFallbackStreamGuard {}.ss != nullptr);
+}
@@ -1,3 +1,6 @@
+#include <atomic>
+#include <thread>
+#include <vector>
 #include "gft/assert.hpp"
 #include "gft/log.hpp"
 #include "gft/test.hpp"
@@ -103,3 +106,115 @@ L_TEST(ZipExtractReal) {
     L_ASSERT(record.crc32 == 0x884863d2);
   }
 }
+
+L_TEST(ZipIndexLookup) {
+  std::vector<uint8_t> data { 1, 2, 3 };
+
+  zip::ZipArchive ar {};
+  ar.add_file("README.md", data.data(), data.size());
+  ar.add_file("shaders/a.spv", data.data(), data.size());
+  ar.add_file("shaders/b.spv", data.data(), data.size());
+  ar.add_file("shaders/b.glsl", data.data(), data.size());
+  ar.add_file("textures/", nullptr, 0);
+  ar.add_file("textures/a.png", data.data(), data.size());
+  ar.add_file("textures/ui/b.png", data.data(), data.size());
+  ar.add_file("c.spv", data.data(), data.size());
+
+  L_ASSERT(ar.try_get_file("shaders/a.spv") == &ar.records.at(1));
+  L_ASSERT(ar.try_get_file("shaders/c.spv") == nullptr);
+  bool threw = false;
+  try {
+    ar.get_file("shaders/c.spv");
+  } catch (const std::out_of_range&) {
+    threw = true;
+  }
+  L_ASSERT(threw);
+
+  std::vector<std::string> root = ar.list_dir("");
+  L_ASSERT(root.size() == 4);
+  L_ASSERT(root.at(0) == "README.md");
+  L_ASSERT(root.at(1) == "c.spv");
+  L_ASSERT(root.at(2) == "shaders/");
+  L_ASSERT(root.at(3) == "textures/");
+
+  std::vector<std::string> textures = ar.list_dir("textures");
+  L_ASSERT(textures.size() == 2);
+  L_ASSERT(textures.at(0) == "textures/a.png");
+  L_ASSERT(textures.at(1) == "textures/ui/");
+  L_ASSERT(ar.list_dir("fonts/").empty());
+
+  std::vector<std::string> spvs = ar.glob("*.spv");
+  L_ASSERT(spvs.size() == 1);
+  L_ASSERT(spvs.at(0) == "c.spv");
+  spvs = ar.glob("**/*.spv");
+  L_ASSERT(spvs.size() == 3);
+  L_ASSERT(spvs.at(0) == "c.spv");
+  L_ASSERT(spvs.at(1) == "shaders/a.spv");
+  L_ASSERT(spvs.at(2) == "shaders/b.spv");
+  L_ASSERT(ar.glob("shaders/?.*").size() == 3);
+  L_ASSERT(ar.glob("textures/**").size() == 2);
+  L_ASSERT(ar.glob("tex*/").size() == 1);
+
+  // The index is extended as more files are added.
+  ar.add_file("shaders/c.spv", data.data(), data.size());
+  L_ASSERT(ar.try_get_file("shaders/c.spv") != nullptr);
+  L_ASSERT(ar.glob("shaders/*.spv").size() == 3);
+
+  // Archives parsed from bytes are indexed on the first lookup.
+  std::vector<uint8_t> bytes;
+  ar.to_bytes(bytes);
+  zip::ZipArchive ar2 = zip::ZipArchive::from_bytes(bytes);
+  L_ASSERT(ar2.try_get_file("textures/ui/b.png") == &ar2.records.at(6));
+  L_ASSERT(ar2.list_dir("textures/").size() == 2);
+
+  // Adding or removing records from outside gets them reindexed, but renamed
+  // records are only found by their new names after reindexing.
+  ar2.records.pop_back();
+  L_ASSERT(ar2.try_get_file("shaders/c.spv") == nullptr);
+  L_ASSERT(ar2.glob("shaders/*.spv").size() == 2);
+  ar2.records.at(0).file_name = "README.txt";
+  L_ASSERT(ar2.try_get_file("README.md") == nullptr);
+  L_ASSERT(ar2.try_get_file("README.txt") == nullptr);
+  ar2.reindex();
+  L_ASSERT(ar2.try_get_file("README.md") == nullptr);
+  L_ASSERT(ar2.try_get_file("README.txt") == &ar2.records.at(0));
+  L_ASSERT(ar2.glob("*.txt").size() == 1);
+}
+
+L_TEST(ZipIndexConcurrentLookup) {
+  const uint32_t NTHREAD = 4;
+
+  std::vector<uint8_t> data { 1, 2, 3 };
+  zip::ZipArchive ar {};
+  for (uint32_t i = 0; i < 64; ++i) {
+    ar.add_file(
+      util::format("dir", i % 4, "/", i, ".bin"), data.data(), data.size());
+  }
+  std::vector<uint8_t> bytes;
+  ar.to_bytes(bytes);
+  const zip::ZipArchive ar2 = zip::ZipArchive::from_bytes(bytes);
+  // Copies share the index once it's built.
+  const zip::ZipArchive ar3 = ar2;
+
+  // The first lookups race to build the index.
+  std::atomic<uint32_t> nfound { 0 };
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < NTHREAD; ++i) {
+    threads.emplace_back([&, i]() {
+      const zip::ZipArchive& shared = i % 2 == 0 ? ar2 : ar3;
+      for (uint32_t j = 0; j < 64; ++j) {
+        std::string file_name = util::format("dir", j % 4, "/", j, ".bin");
+        if (shared.try_get_file(file_name) != nullptr) {
+          nfound.fetch_add(1);
+        }
+      }
+      if (shared.list_dir("dir1/").size() == 16) {
+        nfound.fetch_add(1);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  L_ASSERT(nfound.load() == NTHREAD * 65);
+}
@@ -0,0 +1,199 @@
+// Bump allocators for transient data.
+// @PENGUINLIONG
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace liong {
+
+namespace arena {
+
+// Linear allocator handing out memory from a list of blocks. Memory is never
+// freed individually; it's all given back at once by `reset` or by rewinding
+// to a marker. The blocks are kept for reuse, so once an arena has grown to
+// fit a workload, repeating the workload doesn't allocate from the heap.
+//
+// Destructors of objects placed in an arena are never called. Only put
+// trivially destructible objects there, or containers using `Allocator`.
+class Arena {
+  struct Block {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size;
+  };
+
+  size_t block_size_;
+  std::vector<Block> blocks_;
+  // The block currently allocated from, and the offset in it.
+  size_t iblock_;
+  size_t offset_;
+  // Bytes handed out since the last reset, including alignment padding.
+  size_t nbyte_used_;
+  size_t nbyte_peak_;
+  // Number of `ArenaScope`s currently open on the arena.
+  uint32_t nscope_;
+
+  void* alloc_slow(size_t size, size_t align);
+
+ public:
+  // Position in an arena to rewind to.
+  struct Marker {
+    size_t iblock;
+    size_t offset;
+    size_t nbyte_used;
+  };
+
+  Arena(size_t block_size = 64 * 1024);
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // `align` must be a power of two.
+  inline void* alloc(size_t size, size_t align = alignof(std::max_align_t)) {
+    if (iblock_ < blocks_.size()) {
+      const Block& block = blocks_[iblock_];
+      uintptr_t base = (uintptr_t)block.data.get();
+      uintptr_t beg = (base + offset_ + align - 1) & ~(uintptr_t)(align - 1);
+      size_t end = (size_t)(beg - base) + size;
+      if (end <= block.size) {
+        nbyte_used_ += end - offset_;
+        nbyte_peak_ = nbyte_used_ > nbyte_peak_ ? nbyte_used_ : nbyte_peak_;
+        offset_ = end;
+        return (void*)beg;
+      }
+    }
+    return alloc_slow(size, align);
+  }
+  // Uninitialized storage for `n` objects of type `T`.
+  template<typename T>
+  inline T* alloc_array(size_t n) {
+    return (T*)alloc(n * sizeof(T), alignof(T));
+  }
+
+  inline Marker mark() const {
+    return Marker { iblock_, offset_, nbyte_used_ };
+  }
+  // Give back everything allocated after `marker` was taken.
+  inline void rewind(const Marker& marker) {
+    iblock_ = marker.iblock;
+    offset_ = marker.offset;
+    nbyte_used_ = marker.nbyte_used;
+  }
+  // Give back everything but keep the blocks.
+  inline void reset() {
+    rewind(Marker { 0, 0, 0 });
+  }
+  // Free the blocks too.
+  void release();
+
+  inline size_t nbyte_used() const {
+    return nbyte_used_;
+  }
+  // The most bytes ever in use at once.
+  inline size_t nbyte_peak() const {
+    return nbyte_peak_;
+  }
+  size_t nbyte_reserved() const;
+
+  // Used by `ArenaScope` to check that scopes are strictly nested.
+  inline uint32_t nscope() const {
+    return nscope_;
+  }
+  inline uint32_t enter_scope() {
+    return nscope_++;
+  }
+  void leave_scope(uint32_t depth);
+};
+
+// Rewind an arena to where it was when the scope was entered. Containers
+// allocating from the arena must be destroyed before the scope ends, and
+// scopes on the same arena must end in the reverse order they were entered;
+// otherwise memory still in use by an inner scope would be handed out again.
+struct ArenaScope {
+  Arena& arena;
+  Arena::Marker marker;
+  uint32_t depth;
+
+  inline ArenaScope(Arena& arena) :
+    arena(arena), marker(arena.mark()), depth(arena.enter_scope()) {}
+  inline ~ArenaScope() {
+    arena.leave_scope(depth);
+    arena.rewind(marker);
+  }
+
+  ArenaScope(const ArenaScope&) = delete;
+  ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+// Per-thread arena for scratch data that doesn't outlive a function call. Use
+// it with an `ArenaScope`:
+//
+// ```cpp
+// arena::ArenaScope scope(arena::get_scratch_arena());
+// arena::Vector<VkFence> fences(scope.arena);
+// ```
+Arena& get_scratch_arena();
+
+// A ring of arenas, one per frame in flight. Data allocated during a frame
+// stays valid until the same slot comes around again, i.e., until the GPU is
+// done with the frame if `nframe` matches the number of frames in flight.
+class FrameArenas {
+  std::vector<std::unique_ptr<Arena>> arenas_;
+  uint64_t iframe_;
+
+ public:
+  FrameArenas(uint32_t nframe = 3, size_t block_size = 64 * 1024);
+
+  // Advance to the next frame and reset its arena. No `ArenaScope` may be
+  // open on that arena.
+  Arena& begin_frame();
+  // Arena of the current frame.
+  inline Arena& get() {
+    return *arenas_[iframe_ % arenas_.size()];
+  }
+  inline uint64_t iframe() const {
+    return iframe_;
+  }
+  inline uint32_t nframe() const {
+    return (uint32_t)arenas_.size();
+  }
+};
+
+// Per-thread frame arenas, advanced once per submission by the threads that
+// submit work to the device.
+FrameArenas& get_frame_arenas();
+
+// STL allocator drawing from an arena. Deallocation is a no-op.
+template<typename T>
+struct Allocator {
+  typedef T value_type;
+
+  Arena* arena;
+
+  inline Allocator(Arena& arena) : arena(&arena) {}
+  template<typename U>
+  inline Allocator(const Allocator<U>& b) : arena(b.arena) {}
+
+  inline T* allocate(size_t n) {
+    return arena->alloc_array<T>(n);
+  }
+  inline void deallocate(T*, size_t) {}
+
+  template<typename U>
+  inline bool operator==(const Allocator<U>& b) const {
+    return arena == b.arena;
+  }
+  template<typename U>
+  inline bool operator!=(const Allocator<U>& b) const {
+    return arena != b.arena;
+  }
+};
+
+template<typename T>
+using Vector = std::vector<T, Allocator<T>>;
+
+} // namespace arena
+
+} // namespace liong
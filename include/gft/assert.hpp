@@ -2,6 +2,7 @@
 // @PENGUINLIONG
 #pragma once
 #include "gft/util.hpp"
+#include "gft/log.hpp"
 
 namespace liong {
 
@@ -16,7 +17,11 @@ class AssertionFailedException : public std::exception {
     uint32_t line,
     const std::string& msg
   ) :
-    file(file), line(line), msg(msg) {}
+    file(file), line(line), msg(msg) {
+    // Make sure the logs leading to the failure are visible before anyone
+    // handles the exception.
+    log::flush_log();
+  }
 
   const char* what() const noexcept override {
     return msg.c_str();
@@ -0,0 +1,178 @@
+// Micro-benchmark infrastructure.
+// @PENGUINLIONG
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "gft/json.hpp"
+
+namespace liong {
+
+namespace bench {
+
+namespace detail {
+
+void use_char_pointer(const volatile char* x);
+
+} // namespace detail
+
+// Prevent the compiler from optimizing away the computation of `x`.
+template<typename T>
+inline void do_not_optimize(const T& x) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(x) : "memory");
+#else
+  detail::use_char_pointer(&reinterpret_cast<const volatile char&>(x));
+#endif
+}
+// Force all pending memory writes to be committed.
+inline void clobber_memory() {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : : "memory");
+#else
+  std::atomic_signal_fence(std::memory_order_acq_rel);
+#endif
+}
+
+// Passed to benchmark functions. The benchmarked code is placed in a
+// range-based for loop over the state, which runs as many iterations as the
+// runner asks for and times them:
+//
+// ```cpp
+// L_BENCH(Crc32) {
+//   std::vector<uint8_t> data(1024);
+//   for (auto _ : state) {
+//     bench::do_not_optimize(util::crc32(data.data(), data.size()));
+//   }
+// }
+// ```
+class BenchState {
+  uint64_t niter_;
+  uint64_t nbyte_per_iter_;
+  std::chrono::steady_clock::time_point beg_;
+  std::chrono::steady_clock::time_point end_;
+  bool is_iterated_;
+
+ public:
+  // Type of the loop variable. The user-provided destructor keeps compilers
+  // from warning about the loop variable being unused.
+  struct Value {
+    inline ~Value() {}
+  };
+  struct Iterator {
+    BenchState* state;
+    uint64_t i;
+
+    inline Value operator*() const {
+      return Value {};
+    }
+    inline Iterator& operator++() {
+      ++i;
+      return *this;
+    }
+    inline bool operator!=(const Iterator& end) {
+      if (i != end.i) {
+        return true;
+      }
+      state->end_ = std::chrono::steady_clock::now();
+      return false;
+    }
+  };
+
+  inline BenchState(uint64_t niter) :
+    niter_(niter), nbyte_per_iter_(0), beg_(), end_(), is_iterated_(false) {}
+
+  inline Iterator begin() {
+    is_iterated_ = true;
+    beg_ = std::chrono::steady_clock::now();
+    return Iterator { this, 0 };
+  }
+  inline Iterator end() {
+    return Iterator { this, niter_ };
+  }
+
+  inline uint64_t niter() const {
+    return niter_;
+  }
+  // Report throughput in addition to latency.
+  inline void set_nbyte_per_iter(uint64_t nbyte) {
+    nbyte_per_iter_ = nbyte;
+  }
+  inline uint64_t nbyte_per_iter() const {
+    return nbyte_per_iter_;
+  }
+  // Whether the benchmark entered its loop at all.
+  inline bool is_iterated() const {
+    return is_iterated_;
+  }
+  // Time spent in the loop, or zero if the benchmark never iterated.
+  inline uint64_t elapsed_ns() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end_ - beg_)
+      .count();
+  }
+};
+
+struct BenchConfig {
+  // Only benchmarks whose names match this wildcard pattern are run.
+  std::string filter = "*";
+  // Number of timed samples per benchmark.
+  uint32_t nsample = 30;
+  // Each sample runs enough iterations to take at least this long.
+  uint32_t min_sample_time_us = 5000;
+  // Untimed warm-up before sampling.
+  uint32_t warmup_time_us = 100000;
+};
+
+struct BenchResult {
+  std::string name;
+  // Iterations per sample.
+  uint64_t niter;
+  uint32_t nsample;
+  // Statistics of per-iteration time across samples, in nanoseconds.
+  double min_ns;
+  double median_ns;
+  double p99_ns;
+  double mean_ns;
+  // Half width of the 95% confidence interval of the mean.
+  double ci95_ns;
+  // Zero if the benchmark didn't report the number of bytes processed.
+  double nbyte_per_sec;
+};
+
+struct BenchRegistry {
+  struct Entry {
+    std::function<void(BenchState&)> f;
+  };
+  std::map<std::string, Entry> benches;
+
+  static BenchRegistry& get_inst();
+  static std::vector<BenchResult> run_all(const BenchConfig& cfg);
+
+  int reg(const std::string& name, std::function<void(BenchState&)>&& func);
+};
+
+json::JsonValue results2json(const std::vector<BenchResult>& results);
+std::vector<BenchResult> json2results(const json::JsonValue& json);
+
+// Log the median time change of each benchmark against a baseline. Returns
+// the number of benchmarks that are slower than the baseline by more than
+// `tolerance` (relative) and more than the confidence intervals.
+uint32_t compare_results(
+  const std::vector<BenchResult>& baseline,
+  const std::vector<BenchResult>& results,
+  double tolerance = 0.05
+);
+
+} // namespace bench
+
+} // namespace liong
+
+#define L_BENCH(name)                                                     \
+  extern void l_bench_##name(::liong::bench::BenchState& state);          \
+  int L_BENCH_MARKER_##name =                                             \
+    ::liong::bench::BenchRegistry::get_inst().reg(#name, l_bench_##name); \
+  void l_bench_##name(::liong::bench::BenchState& state)
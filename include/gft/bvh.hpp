@@ -0,0 +1,432 @@
+// Bounding volume hierarchies for ray and proximity queries.
+// @PENGUINLIONG
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "gft/geom.hpp"
+
+namespace liong {
+namespace geom {
+
+// Trees are never deeper than this, so traversals can keep their stacks on
+// the stack.
+constexpr uint32_t MAX_BVH_DEPTH = 64;
+
+// Flattened binary BVH node, two per cache line. Nodes are laid out in
+// depth-first order so the first child of an inner node immediately follows
+// it.
+struct BvhNode {
+  Aabb aabb;
+  // Index of the second child for inner nodes; index of the first primitive
+  // reference in `Bvh::iprims` for leaves.
+  uint32_t offset;
+  // Number of primitives in a leaf; zero for inner nodes.
+  uint32_t nprim;
+
+  inline bool is_leaf() const {
+    return nprim != 0;
+  }
+};
+static_assert(sizeof(BvhNode) == 32, "bvh node must be 32 bytes");
+
+struct BvhConfig {
+  // Number of bins per axis the surface area heuristic is evaluated at, at
+  // most 64.
+  uint32_t nbin = 16;
+  // Ranges of at most this many primitives become leaves if splitting them
+  // doesn't pay off. Larger ranges are always split.
+  uint32_t max_leaf_nprim = 8;
+  // Cost of visiting a node relative to testing a primitive.
+  float node_cost = 1.0f;
+  // Subtrees of fewer primitives are built on the calling thread.
+  uint32_t min_parallel_nprim = 4096;
+  // `TriangleBvh::refit` rebuilds the subtrees whose surface area heuristic
+  // cost grew past this factor of their cost when they were built, and the
+  // whole tree if its own cost grew past `max_refit_cost_ratio`. Deformations
+  // that keep neighbouring triangles together, like skinning, barely change
+  // the cost; parts moving through each other quickly do.
+  float max_refit_subtree_cost_ratio = 1.5f;
+  float max_refit_cost_ratio = 2.0f;
+};
+
+// Binary BVH over primitives given by their bounds, built top-down with the
+// binned surface area heuristic. Primitives are referred to by their indices
+// in the input.
+struct Bvh {
+  std::vector<BvhNode> nodes;
+  std::vector<uint32_t> iprims;
+
+  static Bvh build(const Aabb* aabbs, size_t naabb, const BvhConfig& cfg = {});
+  static inline Bvh build(
+    const std::vector<Aabb>& aabbs,
+    const BvhConfig& cfg = {}
+  ) {
+    return build(aabbs.data(), aabbs.size(), cfg);
+  }
+
+  inline bool empty() const {
+    return nodes.empty();
+  }
+  Aabb aabb() const;
+
+  // Subtrees occupy contiguous ranges of nodes; this is one past the last node
+  // of the subtree at `inode`.
+  uint32_t get_subtree_end(uint32_t inode) const;
+  // Expected cost of a ray hitting the bounds of the subtree at `inode`, in
+  // primitive tests, by the surface area heuristic. It is independent of the
+  // scale of the subtree, so the costs of a refit tree can be compared with
+  // the costs it was built with.
+  float get_sah_cost(float node_cost = 1.0f, uint32_t inode = 0) const;
+
+  // Recompute the bounds of all nodes bottom-up from the updated primitive
+  // bounds `aabbs`, keeping the topology. Subtrees are refit in parallel.
+  void refit(const Aabb* aabbs);
+  inline void refit(const std::vector<Aabb>& aabbs) {
+    refit(aabbs.data());
+  }
+  // Rebuild the subtree at `inode` from `aabbs` over the same primitives,
+  // leaving the other subtrees intact. Nodes after the subtree can move.
+  void rebuild_subtree(
+    uint32_t inode,
+    const Aabb* aabbs,
+    const BvhConfig& cfg = {}
+  );
+
+  // Visit the primitives whose bounds are hit by `ray` no farther than
+  // `t_max`, roughly nearest first. `f(iprim, t_max)` tests a primitive and
+  // can shrink `t_max` to cull farther subtrees. It returns true to stop the
+  // traversal.
+  template<typename F>
+  void traverse_ray(const Ray& ray, float t_max, F&& f) const;
+  // Visit the leaf primitives whose node bounds overlap `aabb`. `f(iprim)`
+  // returns true to stop the traversal.
+  template<typename F>
+  void traverse_aabb(const Aabb& aabb, F&& f) const;
+  // Visit the primitives in leaves closer to `point` than the square root of
+  // `max_dist2`, roughly nearest first. `f(iprim, max_dist2)` can shrink
+  // `max_dist2` like `traverse_ray` does with `t_max`.
+  template<typename F>
+  void traverse_point(const glm::vec3& point, float max_dist2, F&& f) const;
+};
+
+// `N`-wide BVH collapsed from a binary one, with child bounds stored in SIMD
+// packets so that all children of a node are tested at once.
+template<int N>
+struct WideBvhNode {
+  // Unused child slots are cleared.
+  AabbPacket<N> aabbs;
+  // Index of the child node for inner children; index of the first primitive
+  // reference in `WideBvh::iprims` for leaves.
+  uint32_t offsets[N];
+  // Number of primitives of leaf children; zero for inner children and
+  // unused slots.
+  uint32_t nprims[N];
+};
+template<int N>
+struct WideBvh {
+  std::vector<WideBvhNode<N>> nodes;
+  std::vector<uint32_t> iprims;
+
+  static WideBvh from_bvh(const Bvh& bvh);
+
+  inline bool empty() const {
+    return nodes.empty();
+  }
+
+  // Same as `Bvh::refit`, but on a single thread. It is cheaper than
+  // collapsing the refit binary tree again.
+  void refit(const Aabb* aabbs);
+
+  // Same as `Bvh::traverse_ray`.
+  template<typename F>
+  void traverse_ray(const Ray& ray, float t_max, F&& f) const;
+};
+
+struct BvhRayHit {
+  uint32_t iprim;
+  float t;
+  glm::vec2 bary;
+};
+struct BvhPointHit {
+  uint32_t iprim;
+  glm::vec3 point;
+  float dist;
+};
+
+// A subtree whose quality is watched through refits.
+struct BvhTreelet {
+  uint32_t inode;
+  // Cost of the subtree when it was last built.
+  float build_cost;
+};
+enum BvhUpdate {
+  L_BVH_UPDATE_REFIT,
+  L_BVH_UPDATE_PARTIAL_REBUILD,
+  L_BVH_UPDATE_FULL_REBUILD,
+};
+
+// BVH over a triangle soup, like the triangles of a `mesh::Mesh` or a
+// `mesh::IndexedMesh`. Queries report triangles by their indices in `tris`.
+// Ray queries follow the conventions of `raycast_tri`.
+struct TriangleBvh {
+  std::vector<Triangle> tris;
+  Bvh bvh;
+  WideBvh<4> wide_bvh;
+  BvhConfig cfg;
+  // Bounds of `tris`, kept for refits.
+  std::vector<Aabb> aabbs;
+  // Subtrees at a fixed depth, in depth-first order, and the cost of the
+  // whole tree when it was built.
+  std::vector<BvhTreelet> treelets;
+  float build_cost;
+
+  static TriangleBvh build(
+    std::vector<Triangle>&& tris,
+    const BvhConfig& cfg = {}
+  );
+
+  // Move the triangles to `tris`, which must be the same triangles in the same
+  // order as before, like the triangles of a mesh whose vertices are animated
+  // by `mesh::SkinnedMesh::animate` or `mesh::TetrahedralMesh::apply_trans`.
+  // The tree is refit, and the subtrees degraded past the thresholds in
+  // `cfg` are rebuilt.
+  BvhUpdate refit(const std::vector<Triangle>& tris);
+
+  // Closest hit.
+  bool raycast(
+    const Ray& ray,
+    BvhRayHit& hit,
+    float t_max = std::numeric_limits<float>::infinity()
+  ) const;
+  // Any hit, for occlusion tests.
+  bool raycast_any(
+    const Ray& ray,
+    float t_max = std::numeric_limits<float>::infinity()
+  ) const;
+  // Triangles overlapping `aabb`.
+  void query_aabb(const Aabb& aabb, std::vector<uint32_t>& itris) const;
+  // Point on the triangles nearest to `point` no farther than `max_dist`.
+  bool nearest_point(
+    const glm::vec3& point,
+    BvhPointHit& hit,
+    float max_dist = std::numeric_limits<float>::infinity()
+  ) const;
+};
+
+
+namespace detail {
+
+// Slab test with the reciprocal ray direction precomputed. Axes giving NaNs
+// are rays running along a slab boundary, which don't clip the ray.
+inline bool raycast_bvh_aabb(
+  const Aabb& aabb,
+  const glm::vec3& p,
+  const glm::vec3& inv_v,
+  float t_max,
+  float& t
+) {
+  float t_near = 0.0f;
+  float t_far = t_max;
+  for (glm::length_t i = 0; i < 3; ++i) {
+    float t1 = (aabb.min[i] - p[i]) * inv_v[i];
+    float t2 = (aabb.max[i] - p[i]) * inv_v[i];
+    if (t1 == t1 && t2 == t2) {
+      t_near = std::max(t_near, std::min(t1, t2));
+      t_far = std::min(t_far, std::max(t1, t2));
+    }
+  }
+  t = t_near;
+  return t_near <= t_far;
+}
+inline float get_bvh_aabb_dist2(const Aabb& aabb, const glm::vec3& point) {
+  glm::vec3 d = glm::max(glm::max(aabb.min - point, point - aabb.max), 0.0f);
+  return glm::dot(d, d);
+}
+
+} // namespace detail
+
+template<typename F>
+void Bvh::traverse_ray(const Ray& ray, float t_max, F&& f) const {
+  if (nodes.empty()) {
+    return;
+  }
+  glm::vec3 inv_v = 1.0f / ray.v;
+  float t;
+  if (!detail::raycast_bvh_aabb(nodes[0].aabb, ray.p, inv_v, t_max, t)) {
+    return;
+  }
+
+  struct Entry {
+    uint32_t inode;
+    float t;
+  };
+  Entry stack[MAX_BVH_DEPTH];
+  uint32_t nstack = 0;
+  stack[nstack++] = Entry { 0, t };
+  while (nstack != 0) {
+    Entry entry = stack[--nstack];
+    if (entry.t > t_max) {
+      continue;
+    }
+    const BvhNode& node = nodes[entry.inode];
+    if (node.is_leaf()) {
+      for (uint32_t i = 0; i < node.nprim; ++i) {
+        if (f(iprims[node.offset + i], t_max)) {
+          return;
+        }
+      }
+      continue;
+    }
+
+    uint32_t ichild1 = entry.inode + 1;
+    uint32_t ichild2 = node.offset;
+    float t1;
+    float t2;
+    bool is_hit1 =
+      detail::raycast_bvh_aabb(nodes[ichild1].aabb, ray.p, inv_v, t_max, t1);
+    bool is_hit2 =
+      detail::raycast_bvh_aabb(nodes[ichild2].aabb, ray.p, inv_v, t_max, t2);
+    // Push the farther child first so the nearer one is visited first.
+    if (is_hit1 && is_hit2 && t1 < t2) {
+      stack[nstack++] = Entry { ichild2, t2 };
+      stack[nstack++] = Entry { ichild1, t1 };
+    } else {
+      if (is_hit1) {
+        stack[nstack++] = Entry { ichild1, t1 };
+      }
+      if (is_hit2) {
+        stack[nstack++] = Entry { ichild2, t2 };
+      }
+    }
+  }
+}
+template<typename F>
+void Bvh::traverse_aabb(const Aabb& aabb, F&& f) const {
+  if (nodes.empty() || !intersect_aabb(nodes[0].aabb, aabb)) {
+    return;
+  }
+
+  uint32_t stack[MAX_BVH_DEPTH];
+  uint32_t nstack = 0;
+  stack[nstack++] = 0;
+  while (nstack != 0) {
+    uint32_t inode = stack[--nstack];
+    const BvhNode& node = nodes[inode];
+    if (node.is_leaf()) {
+      for (uint32_t i = 0; i < node.nprim; ++i) {
+        if (f(iprims[node.offset + i])) {
+          return;
+        }
+      }
+      continue;
+    }
+    if (intersect_aabb(nodes[node.offset].aabb, aabb)) {
+      stack[nstack++] = node.offset;
+    }
+    if (intersect_aabb(nodes[inode + 1].aabb, aabb)) {
+      stack[nstack++] = inode + 1;
+    }
+  }
+}
+template<typename F>
+void Bvh::traverse_point(
+  const glm::vec3& point,
+  float max_dist2,
+  F&& f
+) const {
+  if (nodes.empty()) {
+    return;
+  }
+
+  struct Entry {
+    uint32_t inode;
+    float dist2;
+  };
+  Entry stack[MAX_BVH_DEPTH];
+  uint32_t nstack = 0;
+  stack[nstack++] =
+    Entry { 0, detail::get_bvh_aabb_dist2(nodes[0].aabb, point) };
+  while (nstack != 0) {
+    Entry entry = stack[--nstack];
+    if (entry.dist2 > max_dist2) {
+      continue;
+    }
+    const BvhNode& node = nodes[entry.inode];
+    if (node.is_leaf()) {
+      for (uint32_t i = 0; i < node.nprim; ++i) {
+        if (f(iprims[node.offset + i], max_dist2)) {
+          return;
+        }
+      }
+      continue;
+    }
+
+    Entry child1 {
+      entry.inode + 1,
+      detail::get_bvh_aabb_dist2(nodes[entry.inode + 1].aabb, point),
+    };
+    Entry child2 {
+      node.offset,
+      detail::get_bvh_aabb_dist2(nodes[node.offset].aabb, point),
+    };
+    if (child1.dist2 < child2.dist2) {
+      std::swap(child1, child2);
+    }
+    stack[nstack++] = child1;
+    stack[nstack++] = child2;
+  }
+}
+
+template<int N>
+template<typename F>
+void WideBvh<N>::traverse_ray(const Ray& ray, float t_max, F&& f) const {
+  if (nodes.empty()) {
+    return;
+  }
+
+  struct Entry {
+    uint32_t offset;
+    uint32_t nprim;
+    float t;
+  };
+  // Each level leaves at most `N - 1` siblings behind.
+  Entry stack[MAX_BVH_DEPTH * (N - 1) + 1];
+  uint32_t nstack = 0;
+  stack[nstack++] = Entry { 0, 0, 0.0f };
+  RayHitPacket<N> hits;
+  while (nstack != 0) {
+    Entry entry = stack[--nstack];
+    if (entry.t > t_max) {
+      continue;
+    }
+    if (entry.nprim != 0) {
+      for (uint32_t i = 0; i < entry.nprim; ++i) {
+        if (f(iprims[entry.offset + i], t_max)) {
+          return;
+        }
+      }
+      continue;
+    }
+
+    const WideBvhNode<N>& node = nodes[entry.offset];
+    uint32_t mask = raycast_aabb(ray, node.aabbs, hits, t_max);
+    // Insertion sort the hit children by decreasing distance so that the
+    // nearest one is popped first.
+    uint32_t nstack_beg = nstack;
+    for (int i = 0; i < N; ++i) {
+      if ((mask >> i) & 1) {
+        Entry child { node.offsets[i], node.nprims[i], hits.t[i] };
+        uint32_t j = nstack++;
+        for (; j > nstack_beg && stack[j - 1].t < child.t; --j) {
+          stack[j] = stack[j - 1];
+        }
+        stack[j] = child;
+      }
+    }
+  }
+}
+
+} // namespace geom
+} // namespace liong
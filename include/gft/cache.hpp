@@ -0,0 +1,300 @@
+// Concurrent LRU cache.
+// @PENGUINLIONG
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace liong {
+
+namespace cache {
+
+template<typename TKey, typename TValue>
+struct LruCacheConfig {
+  // Number of independently locked shards. Keys are distributed by hash.
+  size_t nshard = 8;
+  // Total cost of the cached values. Each shard gets an equal share of the
+  // budget and evicts its least recently used values when exceeding it.
+  size_t nbyte_budget = SIZE_MAX;
+  // Cost of a value in bytes. Every value costs 1 if not specified, so the
+  // budget limits the number of values.
+  std::function<size_t(const TKey&, const TValue&)> get_nbyte;
+};
+
+// Snapshot of cache usage. Counts are exact when the cache is quiescent.
+struct LruCacheCounters {
+  // Lookups served from the cache, and ones that weren't.
+  uint64_t nhit;
+  uint64_t nmiss;
+  // Misses that waited for another thread computing the same key instead of
+  // computing it again.
+  uint64_t nshared;
+  // Values dropped to stay within the budget.
+  uint64_t nevicted;
+  uint64_t nentry;
+  uint64_t nbyte;
+};
+
+// Memoization table with a cost budget. Values are handed out as shared
+// pointers, so values evicted while in use stay alive until released.
+//
+// `get_or_compute` is single-flight: when several threads miss the same key
+// at once, one of them computes the value and the others wait for it. If the
+// computation throws, all of them receive the exception and nothing is
+// cached. A computation must not look up its own key, or it waits forever.
+template<typename TKey, typename TValue, typename THash = std::hash<TKey>>
+class LruCache {
+ public:
+  typedef LruCacheConfig<TKey, TValue> Config;
+  typedef std::shared_ptr<const TValue> ValueRef;
+
+ private:
+  struct Entry {
+    TKey key;
+    ValueRef value;
+    size_t nbyte;
+  };
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    // Most recently used first.
+    std::list<Entry> lru;
+    std::unordered_map<TKey, typename std::list<Entry>::iterator, THash> index;
+    size_t nbyte = 0;
+    // Computations in flight.
+    std::unordered_map<TKey, std::shared_future<ValueRef>, THash> flights;
+  };
+
+  Config cfg_;
+  THash hash_;
+  size_t nbyte_budget_per_shard_;
+  std::unique_ptr<Shard[]> shards_;
+
+  std::atomic<uint64_t> nhit_;
+  std::atomic<uint64_t> nmiss_;
+  std::atomic<uint64_t> nshared_;
+  std::atomic<uint64_t> nevicted_;
+  std::atomic<uint64_t> nentry_;
+  std::atomic<uint64_t> nbyte_;
+
+  inline Shard& get_shard(const TKey& key) {
+    // Mix the hash a little; `std::hash` of integers is the identity.
+    size_t h = hash_(key);
+    h ^= h >> 17;
+    h *= 0xed5ad4bb;
+    h ^= h >> 11;
+    return shards_[h % cfg_.nshard];
+  }
+
+  static Config make_config(size_t nbyte_budget) {
+    Config out {};
+    out.nbyte_budget = nbyte_budget;
+    return out;
+  }
+
+  size_t get_nbyte(const TKey& key, const TValue& value) const {
+    return cfg_.get_nbyte ? cfg_.get_nbyte(key, value) : 1;
+  }
+
+  // Must be called with the shard locked.
+  ValueRef find_locked(Shard& shard, const TKey& key) {
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+      return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return it->second->value;
+  }
+  // Must be called with the shard locked. Evicted values are moved to
+  // `evicted` to be released out of the lock.
+  void insert_locked(
+    Shard& shard,
+    const TKey& key,
+    const ValueRef& value,
+    size_t nbyte,
+    std::vector<ValueRef>& evicted
+  ) {
+    erase_locked(shard, key, evicted);
+    if (nbyte > nbyte_budget_per_shard_) {
+      // Would evict everything else and itself; don't cache at all.
+      return;
+    }
+    shard.lru.emplace_front(Entry { key, value, nbyte });
+    shard.index.emplace(key, shard.lru.begin());
+    shard.nbyte += nbyte;
+    nentry_.fetch_add(1, std::memory_order_relaxed);
+    nbyte_.fetch_add(nbyte, std::memory_order_relaxed);
+
+    while (shard.nbyte > nbyte_budget_per_shard_) {
+      Entry& victim = shard.lru.back();
+      evicted.emplace_back(std::move(victim.value));
+      remove_locked(shard, std::prev(shard.lru.end()));
+      nevicted_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  void erase_locked(
+    Shard& shard,
+    const TKey& key,
+    std::vector<ValueRef>& erased
+  ) {
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+      erased.emplace_back(std::move(it->second->value));
+      remove_locked(shard, it->second);
+    }
+  }
+  void remove_locked(Shard& shard, typename std::list<Entry>::iterator it) {
+    shard.nbyte -= it->nbyte;
+    nentry_.fetch_sub(1, std::memory_order_relaxed);
+    nbyte_.fetch_sub(it->nbyte, std::memory_order_relaxed);
+    shard.index.erase(it->key);
+    shard.lru.erase(it);
+  }
+
+ public:
+  LruCache(const Config& cfg) :
+    cfg_(cfg),
+    hash_(),
+    nbyte_budget_per_shard_(),
+    shards_(),
+    nhit_(0),
+    nmiss_(0),
+    nshared_(0),
+    nevicted_(0),
+    nentry_(0),
+    nbyte_(0) {
+    cfg_.nshard = std::max<size_t>(cfg_.nshard, 1);
+    nbyte_budget_per_shard_ = cfg_.nbyte_budget / cfg_.nshard;
+    shards_.reset(new Shard[cfg_.nshard]);
+  }
+  LruCache(size_t nbyte_budget = SIZE_MAX) :
+    LruCache(make_config(nbyte_budget)) {}
+
+  LruCache(const LruCache&) = delete;
+  LruCache& operator=(const LruCache&) = delete;
+
+  // Returns null on a miss.
+  ValueRef get(const TKey& key) {
+    Shard& shard = get_shard(key);
+    ValueRef out;
+    {
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      out = find_locked(shard, key);
+    }
+    (out != nullptr ? nhit_ : nmiss_).fetch_add(1, std::memory_order_relaxed);
+    return out;
+  }
+  // Insert or replace the value of `key`.
+  ValueRef put(const TKey& key, TValue&& value) {
+    size_t nbyte = get_nbyte(key, value);
+    ValueRef out = std::make_shared<const TValue>(std::move(value));
+    Shard& shard = get_shard(key);
+    std::vector<ValueRef> evicted;
+    {
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      insert_locked(shard, key, out, nbyte, evicted);
+    }
+    return out;
+  }
+
+  // Get the value of `key`, or compute it with `compute()` and cache it.
+  template<typename F>
+  ValueRef get_or_compute(const TKey& key, F&& compute) {
+    Shard& shard = get_shard(key);
+    std::promise<ValueRef> promise;
+    std::shared_future<ValueRef> flight;
+    {
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      ValueRef out = find_locked(shard, key);
+      if (out != nullptr) {
+        nhit_.fetch_add(1, std::memory_order_relaxed);
+        return out;
+      }
+      nmiss_.fetch_add(1, std::memory_order_relaxed);
+
+      auto it = shard.flights.find(key);
+      if (it != shard.flights.end()) {
+        flight = it->second;
+      } else {
+        shard.flights.emplace(key, promise.get_future().share());
+      }
+    }
+    if (flight.valid()) {
+      nshared_.fetch_add(1, std::memory_order_relaxed);
+      return flight.get();
+    }
+
+    ValueRef out;
+    std::exception_ptr exception;
+    size_t nbyte = 0;
+    try {
+      TValue value = compute();
+      nbyte = get_nbyte(key, value);
+      out = std::make_shared<const TValue>(std::move(value));
+    } catch (...) {
+      exception = std::current_exception();
+    }
+
+    std::vector<ValueRef> evicted;
+    {
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      shard.flights.erase(key);
+      if (exception == nullptr) {
+        insert_locked(shard, key, out, nbyte, evicted);
+      }
+    }
+    if (exception != nullptr) {
+      promise.set_exception(exception);
+      std::rethrow_exception(exception);
+    }
+    promise.set_value(out);
+    return out;
+  }
+
+  void erase(const TKey& key) {
+    Shard& shard = get_shard(key);
+    std::vector<ValueRef> erased;
+    {
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      erase_locked(shard, key, erased);
+    }
+  }
+  // Drop all cached values. Computations in flight are not affected.
+  void clear() {
+    for (size_t i = 0; i < cfg_.nshard; ++i) {
+      Shard& shard = shards_[i];
+      std::list<Entry> lru;
+      {
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        nentry_.fetch_sub(shard.index.size(), std::memory_order_relaxed);
+        nbyte_.fetch_sub(shard.nbyte, std::memory_order_relaxed);
+        shard.index.clear();
+        shard.nbyte = 0;
+        std::swap(lru, shard.lru);
+      }
+    }
+  }
+
+  LruCacheCounters counters() const {
+    LruCacheCounters out {};
+    out.nhit = nhit_.load(std::memory_order_relaxed);
+    out.nmiss = nmiss_.load(std::memory_order_relaxed);
+    out.nshared = nshared_.load(std::memory_order_relaxed);
+    out.nevicted = nevicted_.load(std::memory_order_relaxed);
+    out.nentry = nentry_.load(std::memory_order_relaxed);
+    out.nbyte = nbyte_.load(std::memory_order_relaxed);
+    return out;
+  }
+};
+
+} // namespace cache
+
+} // namespace liong
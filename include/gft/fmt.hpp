@@ -3,6 +3,7 @@
 #pragma once
 #include <cstdint>
 #include "gft/assert.hpp"
+#include "gft/util.hpp"
 #include "glm/glm.hpp"
 
 namespace liong {
@@ -26,6 +27,22 @@ enum DepthFormat {
   L_DEPTH_FORMAT_D32_SFLOAT,
 };
 
+constexpr const char* get_fmt_name(Format fmt) {
+  return fmt == L_FORMAT_R8G8B8A8_UNORM            ? "R8G8B8A8_UNORM"
+         : fmt == L_FORMAT_B8G8R8A8_UNORM          ? "B8G8R8A8_UNORM"
+         : fmt == L_FORMAT_B10G11R11_UFLOAT_PACK32 ? "B10G11R11_UFLOAT_PACK32"
+         : fmt == L_FORMAT_R16G16B16A16_SFLOAT     ? "R16G16B16A16_SFLOAT"
+         : fmt == L_FORMAT_R32_SFLOAT              ? "R32_SFLOAT"
+         : fmt == L_FORMAT_R32G32_SFLOAT           ? "R32G32_SFLOAT"
+         : fmt == L_FORMAT_R32G32B32A32_SFLOAT     ? "R32G32B32A32_SFLOAT"
+                                                   : "UNDEFINED";
+}
+constexpr const char* get_fmt_name(DepthFormat fmt) {
+  return fmt == L_DEPTH_FORMAT_D16_UNORM    ? "D16_UNORM"
+         : fmt == L_DEPTH_FORMAT_D32_SFLOAT ? "D32_SFLOAT"
+                                            : "UNDEFINED";
+}
+
 constexpr size_t get_fmt_size(Format fmt) {
   return fmt == L_FORMAT_R8G8B8A8_UNORM            ? 4
          : fmt == L_FORMAT_B8G8R8A8_UNORM          ? 4
@@ -195,4 +212,21 @@ enum ColorSpace {
 
 } // namespace fmt
 
+namespace util {
+
+template<>
+struct Formatter<fmt::Format> {
+  static void format(std::string& out, fmt::Format x) {
+    out.append(fmt::get_fmt_name(x));
+  }
+};
+template<>
+struct Formatter<fmt::DepthFormat> {
+  static void format(std::string& out, fmt::DepthFormat x) {
+    out.append(fmt::get_fmt_name(x));
+  }
+};
+
+} // namespace util
+
 } // namespace liong
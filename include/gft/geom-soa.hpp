@@ -0,0 +1,163 @@
+// Structure-of-arrays geometry with vectorized kernels.
+// @PENGUINLIONG
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "gft/geom.hpp"
+
+namespace liong {
+namespace geom {
+
+// Points stored component by component, so that kernels load a SIMD register
+// worth of points at once.
+struct PointSoa {
+  std::vector<float> xs;
+  std::vector<float> ys;
+  std::vector<float> zs;
+
+  static PointSoa from_points(const glm::vec3* points, size_t npoint);
+  static inline PointSoa from_points(const std::vector<glm::vec3>& points) {
+    return from_points(points.data(), points.size());
+  }
+  std::vector<glm::vec3> to_points() const;
+
+  inline size_t size() const {
+    return xs.size();
+  }
+  inline bool empty() const {
+    return xs.empty();
+  }
+  inline void resize(size_t n) {
+    xs.resize(n);
+    ys.resize(n);
+    zs.resize(n);
+  }
+  inline glm::vec3 get(size_t i) const {
+    return glm::vec3(xs[i], ys[i], zs[i]);
+  }
+  inline void set(size_t i, const glm::vec3& point) {
+    xs[i] = point.x;
+    ys[i] = point.y;
+    zs[i] = point.z;
+  }
+  inline void push_back(const glm::vec3& point) {
+    xs.push_back(point.x);
+    ys.push_back(point.y);
+    zs.push_back(point.z);
+  }
+
+  Aabb aabb() const;
+  // Transform the points like `mesh::TetrahedralMesh::apply_trans` does.
+  void apply_trans(const glm::mat4& trans);
+};
+
+struct TriangleSoa {
+  PointSoa as;
+  PointSoa bs;
+  PointSoa cs;
+
+  static TriangleSoa from_tris(const Triangle* tris, size_t ntri);
+  static inline TriangleSoa from_tris(const std::vector<Triangle>& tris) {
+    return from_tris(tris.data(), tris.size());
+  }
+
+  inline size_t size() const {
+    return as.size();
+  }
+  inline Triangle get(size_t i) const {
+    return Triangle { as.get(i), bs.get(i), cs.get(i) };
+  }
+  inline void set(size_t i, const Triangle& tri) {
+    as.set(i, tri.a);
+    bs.set(i, tri.b);
+    cs.set(i, tri.c);
+  }
+  inline void push_back(const Triangle& tri) {
+    as.push_back(tri.a);
+    bs.push_back(tri.b);
+    cs.push_back(tri.c);
+  }
+
+  Aabb aabb() const;
+  void apply_trans(const glm::mat4& trans);
+};
+
+struct AabbSoa {
+  PointSoa mins;
+  PointSoa maxs;
+
+  static AabbSoa from_aabbs(const Aabb* aabbs, size_t naabb);
+  static inline AabbSoa from_aabbs(const std::vector<Aabb>& aabbs) {
+    return from_aabbs(aabbs.data(), aabbs.size());
+  }
+
+  inline size_t size() const {
+    return mins.size();
+  }
+  inline Aabb get(size_t i) const {
+    return Aabb { mins.get(i), maxs.get(i) };
+  }
+  inline void set(size_t i, const Aabb& aabb) {
+    mins.set(i, aabb.min);
+    maxs.set(i, aabb.max);
+  }
+  inline void push_back(const Aabb& aabb) {
+    mins.push_back(aabb.min);
+    maxs.push_back(aabb.max);
+  }
+
+  // Union of the boxes.
+  Aabb aabb() const;
+  // Replace the boxes with the bounds of the transformed boxes.
+  void apply_trans(const glm::mat4& trans);
+};
+
+// Tetrahedra with the inverses of their edge matrices `[b - a, c - a, d - a]`
+// precomputed, so that barycentric coordinates take a matrix-vector product
+// rather than the five 4x4 determinants of `contains_point_tetra`. Degenerate
+// tetrahedra have NaN inverses and contain nothing.
+struct TetrahedronSoa {
+  PointSoa as;
+  // Rows of the inverses.
+  PointSoa inv_rows[3];
+
+  static TetrahedronSoa from_tetras(const Tetrahedron* tets, size_t ntet);
+  static inline TetrahedronSoa from_tetras(
+    const std::vector<Tetrahedron>& tets
+  ) {
+    return from_tetras(tets.data(), tets.size());
+  }
+
+  inline size_t size() const {
+    return as.size();
+  }
+  // Barycentric weights of the vertices `a`, `b`, `c` and `d` of tetrahedron
+  // `i` at `point`, like `contains_point_tetra` gives.
+  glm::vec4 get_bary(size_t i, const glm::vec3& point) const;
+};
+
+// Same as `Aabb::from_points`, vectorized over the interleaved components
+// without a conversion to `PointSoa`.
+extern Aabb get_points_aabb(const glm::vec3* points, size_t npoint);
+
+// Batched containment tests. Bit `i % 32` of `masks[i / 32]` is set if the
+// `i`-th point is contained, or if the `i`-th tetrahedron contains `point`.
+// Points on the faces of tetrahedra are contained up to rounding.
+extern void contains_point_aabb(
+  const Aabb& aabb,
+  const PointSoa& points,
+  std::vector<uint32_t>& masks
+);
+extern void contains_point_tetra(
+  const Tetrahedron& tet,
+  const PointSoa& points,
+  std::vector<uint32_t>& masks
+);
+extern void contains_point_tetra(
+  const TetrahedronSoa& tets,
+  const glm::vec3& point,
+  std::vector<uint32_t>& masks
+);
+
+} // namespace geom
+} // namespace liong
@@ -1,8 +1,14 @@
 // Geometry algorithms all in right-hand-side systems.
 // @PENGUINLIONG
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <utility>
 #include <vector>
 #include "glm/glm.hpp"
+#include "gft/util.hpp"
 
 namespace liong {
 namespace geom {
@@ -90,6 +96,12 @@ enum Facing {
 };
 
 
+// Ray queries return the hit distance `t` in units of `ray.v`, so the hit
+// point is `ray.p + t * ray.v`. Hits behind the ray origin are ignored. For
+// solids, `t` is where the ray enters, or zero if the ray starts inside.
+//
+// Triangles are double-sided. `bary` receives the barycentric weights of `b`
+// and `c`.
 extern bool raycast_tri(
   const Ray& ray,
   const Triangle& tri,
@@ -100,6 +112,171 @@ extern bool raycast_aabb(const Ray& ray, const Aabb& aabb, float& t);
 extern bool raycast_sphere(const Ray& ray, const Sphere& sphere, float& t);
 extern bool raycast_tet(const Ray& ray, const Tetrahedron& tet, float& t);
 
+// `N` rays or primitives in SoA layout for batched queries. Lanes not in use
+// should be `clear`ed so they never report hits.
+template<int N>
+struct RayPacket {
+  float px[N];
+  float py[N];
+  float pz[N];
+  float vx[N];
+  float vy[N];
+  float vz[N];
+
+  inline void set(int i, const Ray& ray) {
+    px[i] = ray.p.x;
+    py[i] = ray.p.y;
+    pz[i] = ray.p.z;
+    vx[i] = ray.v.x;
+    vy[i] = ray.v.y;
+    vz[i] = ray.v.z;
+  }
+  inline void clear(int i) {
+    // Rays from infinitely far away never hit anything.
+    set(
+      i,
+      Ray {
+        glm::vec3(std::numeric_limits<float>::infinity()),
+        glm::vec3(1.0f),
+      }
+    );
+  }
+};
+template<int N>
+struct TrianglePacket {
+  float ax[N];
+  float ay[N];
+  float az[N];
+  float bx[N];
+  float by[N];
+  float bz[N];
+  float cx[N];
+  float cy[N];
+  float cz[N];
+
+  inline void set(int i, const Triangle& tri) {
+    ax[i] = tri.a.x;
+    ay[i] = tri.a.y;
+    az[i] = tri.a.z;
+    bx[i] = tri.b.x;
+    by[i] = tri.b.y;
+    bz[i] = tri.b.z;
+    cx[i] = tri.c.x;
+    cy[i] = tri.c.y;
+    cz[i] = tri.c.z;
+  }
+  inline Triangle get(int i) const {
+    return Triangle {
+      glm::vec3(ax[i], ay[i], az[i]),
+      glm::vec3(bx[i], by[i], bz[i]),
+      glm::vec3(cx[i], cy[i], cz[i]),
+    };
+  }
+  inline void clear(int i) {
+    // NaN triangles fail every test, whereas a degenerate one could still
+    // overlap a box.
+    glm::vec3 nan(std::numeric_limits<float>::quiet_NaN());
+    set(i, Triangle { nan, nan, nan });
+  }
+};
+template<int N>
+struct AabbPacket {
+  float min_x[N];
+  float min_y[N];
+  float min_z[N];
+  float max_x[N];
+  float max_y[N];
+  float max_z[N];
+
+  inline void set(int i, const Aabb& aabb) {
+    min_x[i] = aabb.min.x;
+    min_y[i] = aabb.min.y;
+    min_z[i] = aabb.min.z;
+    max_x[i] = aabb.max.x;
+    max_y[i] = aabb.max.y;
+    max_z[i] = aabb.max.z;
+  }
+  inline Aabb get(int i) const {
+    return Aabb {
+      glm::vec3(min_x[i], min_y[i], min_z[i]),
+      glm::vec3(max_x[i], max_y[i], max_z[i]),
+    };
+  }
+  inline void clear(int i) {
+    // Empty boxes are never hit.
+    set(
+      i,
+      Aabb {
+        glm::vec3(std::numeric_limits<float>::infinity()),
+        glm::vec3(-std::numeric_limits<float>::infinity()),
+      }
+    );
+  }
+};
+// Per-lane results of a batched query; only valid in lanes reported as hit.
+// `u` and `v` are the barycentric weights of `b` and `c` for triangles.
+template<int N>
+struct RayHitPacket {
+  float t[N];
+  float u[N];
+  float v[N];
+};
+
+// Batched ray queries returning a bit mask of the lanes hit. Hits farther
+// than `t_max` are ignored in all lanes. Lanes are processed with SSE and AVX
+// where available and with scalar code otherwise.
+extern uint32_t raycast_tri(
+  const RayPacket<4>& rays,
+  const Triangle& tri,
+  RayHitPacket<4>& hits,
+  float t_max = std::numeric_limits<float>::infinity()
+);
+extern uint32_t raycast_tri(
+  const RayPacket<8>& rays,
+  const Triangle& tri,
+  RayHitPacket<8>& hits,
+  float t_max = std::numeric_limits<float>::infinity()
+);
+extern uint32_t raycast_tri(
+  const Ray& ray,
+  const TrianglePacket<4>& tris,
+  RayHitPacket<4>& hits,
+  float t_max = std::numeric_limits<float>::infinity()
+);
+extern uint32_t raycast_tri(
+  const Ray& ray,
+  const TrianglePacket<8>& tris,
+  RayHitPacket<8>& hits,
+  float t_max = std::numeric_limits<float>::infinity()
+);
+extern uint32_t raycast_aabb(
+  const RayPacket<4>& rays,
+  const Aabb& aabb,
+  RayHitPacket<4>& hits,
+  float t_max = std::numeric_limits<float>::infinity()
+);
+extern uint32_t raycast_aabb(
+  const RayPacket<8>& rays,
+  const Aabb& aabb,
+  RayHitPacket<8>& hits,
+  float t_max = std::numeric_limits<float>::infinity()
+);
+extern uint32_t raycast_aabb(
+  const Ray& ray,
+  const AabbPacket<4>& aabbs,
+  RayHitPacket<4>& hits,
+  float t_max = std::numeric_limits<float>::infinity()
+);
+extern uint32_t raycast_aabb(
+  const Ray& ray,
+  const AabbPacket<8>& aabbs,
+  RayHitPacket<8>& hits,
+  float t_max = std::numeric_limits<float>::infinity()
+);
+
+// Point on `tri` nearest to `point`.
+extern glm::vec3 nearest_point_tri(const Triangle& tri, const glm::vec3& point);
+
 extern bool contains_point_aabb(const Aabb& aabb, const glm::vec3& point);
 extern bool contains_point_sphere(const Sphere& sphere, const glm::vec3& point);
 extern bool contains_point_tetra(
@@ -108,10 +285,39 @@ extern bool contains_point_tetra(
   glm::vec4& bary
 );
 
+// Intersections include touching boundaries. Degenerate triangles never
+// intersect other triangles, but do overlap boxes they touch.
 extern bool intersect_tri(const Triangle& tri1, const Triangle& tri2);
 extern bool intersect_aabb_tri(const Triangle& tri, const Aabb& aabb);
 extern bool intersect_aabb(const Aabb& aabb1, const Aabb& aabb2);
 
+// Batched intersections returning a mask of the intersecting lanes, like the
+// batched ray casts.
+extern uint32_t intersect_tri(
+  const Triangle& tri,
+  const TrianglePacket<4>& tris
+);
+extern uint32_t intersect_tri(
+  const Triangle& tri,
+  const TrianglePacket<8>& tris
+);
+extern uint32_t intersect_aabb_tri(
+  const TrianglePacket<4>& tris,
+  const Aabb& aabb
+);
+extern uint32_t intersect_aabb_tri(
+  const TrianglePacket<8>& tris,
+  const Aabb& aabb
+);
+extern uint32_t intersect_aabb_tri(
+  const Triangle& tri,
+  const AabbPacket<4>& aabbs
+);
+extern uint32_t intersect_aabb_tri(
+  const Triangle& tri,
+  const AabbPacket<8>& aabbs
+);
+
 extern void split_tetra2tris(
   const Tetrahedron& tet,
   std::vector<Triangle>& tris
@@ -119,11 +325,149 @@ extern void split_tetra2tris(
 extern void split_aabb2tetras(const Aabb& aabb, std::vector<Tetrahedron>& tets);
 extern void split_aabb2points(const Aabb& aabb, std::vector<glm::vec3>& out);
 
+// `aabb` cut into `nslice` sub-boxes, computed on demand in x-major order.
+// Neighbouring sub-boxes share bit-exact boundaries and the last slice along
+// each axis ends exactly at `aabb.max`.
+struct AabbGrid {
+  Aabb aabb;
+  glm::uvec3 nslice;
+
+  // Sub-boxes are computed on dereference rather than referred to, so this is
+  // only an input iterator.
+  struct Iterator {
+    typedef std::input_iterator_tag iterator_category;
+    typedef Aabb value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef Aabb reference;
+    typedef void pointer;
+
+    const AabbGrid* grid;
+    size_t i;
+
+    inline Aabb operator*() const {
+      return (*grid)[i];
+    }
+    inline Iterator& operator++() {
+      ++i;
+      return *this;
+    }
+    inline Iterator operator++(int) {
+      Iterator out = *this;
+      ++i;
+      return out;
+    }
+    inline bool operator==(const Iterator& other) const {
+      return i == other.i;
+    }
+    inline bool operator!=(const Iterator& other) const {
+      return i != other.i;
+    }
+  };
+
+  // Tiles of `tile_size` covering `aabb`, centered on it. Each axis has at
+  // least one tile so that flat boxes are still covered.
+  static inline AabbGrid from_tile_size(
+    const Aabb& aabb,
+    const glm::vec3& tile_size
+  ) {
+    glm::uvec3 nslice = glm::max(
+      glm::uvec3(glm::ceil(aabb.size() / tile_size)),
+      glm::uvec3(1)
+    );
+    glm::vec3 size = glm::vec3(nslice) * tile_size;
+    return AabbGrid { Aabb::from_center_size(aabb.center(), size), nslice };
+  }
+
+  constexpr size_t size() const {
+    return size_t(nslice.x) * nslice.y * nslice.z;
+  }
+  constexpr bool empty() const {
+    return size() == 0;
+  }
+  inline glm::vec3 get_slice_size() const {
+    return aabb.size() / glm::vec3(nslice);
+  }
+  // Lower bound of slice `i` along `axis`, or the upper bound of slice
+  // `i - 1`.
+  inline float get_bound(
+    const glm::vec3& slice_size,
+    int axis,
+    uint32_t i
+  ) const {
+    return i >= nslice[axis] ?
+      aabb.max[axis] : aabb.min[axis] + i * slice_size[axis];
+  }
+
+  inline glm::uvec3 get_coord(size_t i) const {
+    uint32_t x = uint32_t(i % nslice.x);
+    i /= nslice.x;
+    uint32_t y = uint32_t(i % nslice.y);
+    uint32_t z = uint32_t(i / nslice.y);
+    return glm::uvec3(x, y, z);
+  }
+  inline Aabb get(const glm::uvec3& coord) const {
+    glm::vec3 slice_size = get_slice_size();
+    Aabb out {};
+    for (int axis = 0; axis < 3; ++axis) {
+      out.min[axis] = get_bound(slice_size, axis, coord[axis]);
+      out.max[axis] = get_bound(slice_size, axis, coord[axis] + 1);
+    }
+    return out;
+  }
+  inline Aabb get(uint32_t x, uint32_t y, uint32_t z) const {
+    return get(glm::uvec3(x, y, z));
+  }
+  inline Aabb operator[](size_t i) const {
+    return get(get_coord(i));
+  }
+
+  inline Iterator begin() const {
+    return Iterator { this, 0 };
+  }
+  inline Iterator end() const {
+    return Iterator { this, size() };
+  }
+
+  // Call `f(i, sub_aabb)` for the sub-boxes in `[beg, end)`, which are the
+  // same as `(*this)[i]`. Coordinates are stepped instead of being divided
+  // out of each index, so this is cheap as the chunk body of
+  // `parallel_for_range`.
+  template<typename F>
+  void for_each(size_t beg, size_t end, F&& f) const {
+    if (end <= beg) {
+      return;
+    }
+    glm::vec3 slice_size = get_slice_size();
+    glm::uvec3 coord = get_coord(beg);
+    Aabb sub_aabb = get(coord);
+    for (size_t i = beg; i < end; ++i) {
+      f(i, static_cast<const Aabb&>(sub_aabb));
+      // Carry over to the next axis when an axis wraps around.
+      for (int axis = 0; axis < 3; ++axis) {
+        if (++coord[axis] < nslice[axis] || axis == 2) {
+          sub_aabb.min[axis] = sub_aabb.max[axis];
+          sub_aabb.max[axis] = get_bound(slice_size, axis, coord[axis] + 1);
+          break;
+        }
+        coord[axis] = 0;
+        sub_aabb.min[axis] = aabb.min[axis];
+        sub_aabb.max[axis] = get_bound(slice_size, axis, 1);
+      }
+    }
+  }
+  template<typename F>
+  inline void for_each(F&& f) const {
+    for_each(0, size(), std::forward<F>(f));
+  }
+};
+
+// Append the sub-boxes of `AabbGrid { aabb, nslice }`.
 extern void subdivide_aabb(
   const Aabb& aabb,
   const glm::uvec3& nslice,
   std::vector<Aabb>& out
 );
+// Append the tiles of `AabbGrid::from_tile_size(aabb, tile_size)`.
 extern void tile_aabb_ceil(
   const Aabb& aabb,
   const glm::vec3& tile_size,
@@ -131,4 +475,36 @@ extern void tile_aabb_ceil(
 );
 
 } // namespace geom
+
+namespace util {
+
+// Vectors are formatted as `(x, y, z)` and matrices as a list of columns.
+template<glm::length_t L, typename T, glm::qualifier Q>
+struct Formatter<glm::vec<L, T, Q>> {
+  static void format(std::string& out, const glm::vec<L, T, Q>& x) {
+    out.push_back('(');
+    for (glm::length_t i = 0; i < L; ++i) {
+      if (i != 0) {
+        out.append(", ");
+      }
+      Formatter<T>::format(out, x[i]);
+    }
+    out.push_back(')');
+  }
+};
+template<glm::length_t C, glm::length_t R, typename T, glm::qualifier Q>
+struct Formatter<glm::mat<C, R, T, Q>> {
+  static void format(std::string& out, const glm::mat<C, R, T, Q>& x) {
+    out.push_back('[');
+    for (glm::length_t i = 0; i < C; ++i) {
+      if (i != 0) {
+        out.append(", ");
+      }
+      Formatter<glm::vec<R, T, Q>>::format(out, x[i]);
+    }
+    out.push_back(']');
+  }
+};
+
+} // namespace util
 } // namespace liong
@@ -80,7 +80,7 @@ struct Buffer : public std::enable_shared_from_this<Buffer> {
 
   inline void copy_to(void* dst, size_t size) {
     if (size == 0) {
-      L_WARN("zero-sized copy is ignored");
+      L_WARN_RATE_LIMITED(1, "zero-sized copy is ignored");
       return;
     }
     L_ASSERT(info.size >= size, "buffser size is small than dst buffer size");
@@ -101,7 +101,7 @@ struct Buffer : public std::enable_shared_from_this<Buffer> {
 
   inline void copy_from(const void* src, size_t size) {
     if (size == 0) {
-      L_WARN("zero-sized copy is ignored");
+      L_WARN_RATE_LIMITED(1, "zero-sized copy is ignored");
       return;
     }
     L_ASSERT(info.size >= size, "buffser size is small than src buffer size");
@@ -125,6 +125,14 @@ enum ResourceType {
   L_RESOURCE_TYPE_STORAGE_IMAGE,
 };
 
+constexpr const char* get_rsc_ty_name(ResourceType rsc_ty) {
+  return rsc_ty == L_RESOURCE_TYPE_UNIFORM_BUFFER   ? "UNIFORM_BUFFER"
+         : rsc_ty == L_RESOURCE_TYPE_STORAGE_BUFFER ? "STORAGE_BUFFER"
+         : rsc_ty == L_RESOURCE_TYPE_SAMPLED_IMAGE  ? "SAMPLED_IMAGE"
+         : rsc_ty == L_RESOURCE_TYPE_STORAGE_IMAGE  ? "STORAGE_IMAGE"
+                                                    : "UNKNOWN";
+}
+
 enum ResourceViewType {
   L_RESOURCE_VIEW_TYPE_BUFFER,
   L_RESOURCE_VIEW_TYPE_IMAGE,
@@ -158,6 +166,15 @@ enum SubmitType {
   L_SUBMIT_TYPE_PRESENT,
 };
 
+constexpr const char* get_submit_ty_name(SubmitType submit_ty) {
+  return submit_ty == L_SUBMIT_TYPE_ANY        ? "ANY"
+         : submit_ty == L_SUBMIT_TYPE_COMPUTE  ? "COMPUTE"
+         : submit_ty == L_SUBMIT_TYPE_GRAPHICS ? "GRAPHICS"
+         : submit_ty == L_SUBMIT_TYPE_TRANSFER ? "TRANSFER"
+         : submit_ty == L_SUBMIT_TYPE_PRESENT  ? "PRESENT"
+                                               : "UNKNOWN";
+}
+
 struct DispatchSize {
   uint32_t x, y, z;
 };
@@ -491,4 +508,21 @@ struct TransactionConfig {
 };
 
 } // namespace hal
+
+namespace util {
+
+template<>
+struct Formatter<hal::SubmitType> {
+  static void format(std::string& out, hal::SubmitType x) {
+    out.append(hal::get_submit_ty_name(x));
+  }
+};
+template<>
+struct Formatter<hal::ResourceType> {
+  static void format(std::string& out, hal::ResourceType x) {
+    out.append(hal::get_rsc_ty_name(x));
+  }
+};
+
+} // namespace util
 } // namespace liong
@@ -1,6 +1,8 @@
 // Logging infrastructure.
 // @PENGUINLIONG
 #pragma once
+#include <atomic>
+#include <mutex>
 #include <string>
 #include "gft/util.hpp"
 
@@ -20,11 +22,38 @@ enum LogLevel {
 
 typedef void (*LogCallback)(LogLevel lv, const std::string& msg);
 
+// What to do when a thread's async log buffer is full.
+enum LogOverflowPolicy {
+  // Discard the record. The number of discarded records is reported by a
+  // warning once the backend catches up.
+  L_LOG_OVERFLOW_POLICY_DROP,
+  // Wait until the background thread frees up a slot.
+  L_LOG_OVERFLOW_POLICY_BLOCK,
+};
+
 namespace detail {
 
 extern LogCallback l_log_callback__;
 extern LogLevel l_filter_lv__;
-extern std::string l_indent__;
+// Indentation is tracked per thread so that concurrent scopes don't interleave.
+extern thread_local std::string l_indent__;
+extern std::atomic<bool> l_is_async__;
+
+// Hand a formatted message over to the background thread. `msg` is swapped
+// with a recycled buffer so no allocation happens in steady state.
+void push_async_log(LogLevel lv, std::string& msg);
+
+// Thread-local message buffer reused across log calls so that logging doesn't
+// allocate once the buffer has grown large enough. A log call nested in
+// another one (e.g., from an `operator<<` or the callback) gets a temporary
+// buffer instead.
+struct LogBuffer {
+  std::string* buf;
+  std::string fallback;
+
+  LogBuffer();
+  ~LogBuffer();
+};
 
 } // namespace detail
 
@@ -33,10 +62,81 @@ void set_log_filter_level(LogLevel lv);
 template<typename... TArgs>
 void log(LogLevel lv, const TArgs&... msg) {
   if (detail::l_log_callback__ != nullptr && lv >= detail::l_filter_lv__) {
-    detail::l_log_callback__(lv, util::format(detail::l_indent__, msg...));
+    detail::LogBuffer buf {};
+    util::format_to(*buf.buf, detail::l_indent__, msg...);
+    if (detail::l_is_async__.load(std::memory_order_relaxed)) {
+      detail::push_async_log(lv, *buf.buf);
+    } else {
+      detail::l_log_callback__(lv, *buf.buf);
+    }
   }
 }
 
+// - [Sampled Logging] ---------------------------------------------------------
+//
+// Hot paths can use the `L_*_EVERY_N`, `L_*_ONCE` and `L_*_RATE_LIMITED`
+// macros to avoid flooding the log. Each call site keeps its own state, and
+// suppressed messages are never formatted. When a call site logs again, the
+// message is suffixed with the number of messages suppressed in between.
+
+namespace detail {
+
+// Per-call-site state of sampled logging macros. Instances are static locals
+// that register themselves so `report_suppressed_logs` can find them, and
+// unregister when they are destroyed at exit.
+struct LogSite {
+  const char* file;
+  uint32_t line;
+  std::atomic<uint64_t> ncall;
+  std::atomic<uint64_t> nsuppressed;
+  // Token bucket of rate-limited call sites.
+  std::mutex bucket_mutex;
+  double ntoken;
+  uint64_t last_refill_ns;
+  LogSite* next;
+
+  LogSite(const char* file, uint32_t line);
+  ~LogSite();
+  LogSite(const LogSite&) = delete;
+  LogSite& operator=(const LogSite&) = delete;
+
+  // Each function returns whether the call site should log this time. If so,
+  // `nsuppressed_out` is the number of messages skipped since the last one.
+  bool sample_every_n(uint64_t n, uint64_t& nsuppressed_out);
+  bool sample_once(uint64_t& nsuppressed_out);
+  bool sample_rate_limited(double nmsg_per_sec, uint64_t& nsuppressed_out);
+};
+
+// Formatted as a suffix of a sampled message.
+struct LogSuppression {
+  uint64_t nsuppressed;
+};
+
+inline bool is_log_enabled(LogLevel lv) {
+  return l_log_callback__ != nullptr && lv >= l_filter_lv__;
+}
+
+} // namespace detail
+
+// Log the number of messages suppressed by each sampled call site since it
+// last logged, e.g., before exit. This is the only place where `L_*_ONCE`
+// call sites report their suppressed counts.
+void report_suppressed_logs();
+
+// Switch to asynchronous logging. Each logging thread gets a lock-free ring
+// buffer of `nrecord_per_thread` records (rounded up to a power of two), and a
+// background thread drains them to the log callback. Records from the same
+// thread keep their order; records from different threads may interleave.
+void enable_async_log(
+  size_t nrecord_per_thread = 1024,
+  LogOverflowPolicy overflow_policy = L_LOG_OVERFLOW_POLICY_DROP
+);
+// Flush all pending records and switch back to synchronous logging.
+void disable_async_log();
+// Block until all records logged so far have been delivered to the callback.
+// It's a no-op in synchronous mode and when called from the callback itself.
+void flush_log();
+
 void push_indent();
 void pop_indent();
 
@@ -70,28 +170,103 @@ inline void error(const TArgs&... msg) {
 }
 
 } // namespace log
+
+namespace util {
+
+template<>
+struct Formatter<log::detail::LogSuppression> {
+  static void format(std::string& out, log::detail::LogSuppression x) {
+    if (x.nsuppressed != 0) {
+      out.append(" (");
+      Formatter<uint64_t>::format(out, x.nsuppressed);
+      out.append(" similar messages suppressed)");
+    }
+  }
+};
+
+} // namespace util
 } // namespace liong
 
+#define L_LOG_SAMPLED__(lv, fn, sample, ...)                           \
+  do {                                                                 \
+    if (::liong::log::detail::is_log_enabled(::liong::log::lv)) {      \
+      static ::liong::log::detail::LogSite l_site__(__FILE__, __LINE__); \
+      uint64_t l_nsuppressed__;                                        \
+      if (l_site__.sample) {                                           \
+        ::liong::log::fn(                                              \
+          __VA_ARGS__,                                                 \
+          ::liong::log::detail::LogSuppression { l_nsuppressed__ }     \
+        );                                                             \
+      }                                                                \
+    }                                                                  \
+  } while (0)
+#define L_LOG_EVERY_N__(lv, fn, n, ...) \
+  L_LOG_SAMPLED__(lv, fn, sample_every_n(n, l_nsuppressed__), __VA_ARGS__)
+#define L_LOG_ONCE__(lv, fn, ...) \
+  L_LOG_SAMPLED__(lv, fn, sample_once(l_nsuppressed__), __VA_ARGS__)
+#define L_LOG_RATE_LIMITED__(lv, fn, nmsg_per_sec, ...) \
+  L_LOG_SAMPLED__(                                      \
+    lv,                                                 \
+    fn,                                                 \
+    sample_rate_limited(nmsg_per_sec, l_nsuppressed__), \
+    __VA_ARGS__                                         \
+  )
+
 #if !defined(L_MIN_LOG_LEVEL) || L_MIN_LOG_LEVEL <= 0
 #define L_DEBUG(...) ::liong::log::debug(__VA_ARGS__)
+// Log the first of every `n` messages.
+#define L_DEBUG_EVERY_N(n, ...) \
+  L_LOG_EVERY_N__(L_LOG_LEVEL_DEBUG, debug, n, __VA_ARGS__)
+// Log only the first message.
+#define L_DEBUG_ONCE(...) L_LOG_ONCE__(L_LOG_LEVEL_DEBUG, debug, __VA_ARGS__)
+// Log at most `nmsg_per_sec` messages per second on average.
+#define L_DEBUG_RATE_LIMITED(nmsg_per_sec, ...) \
+  L_LOG_RATE_LIMITED__(L_LOG_LEVEL_DEBUG, debug, nmsg_per_sec, __VA_ARGS__)
 #else
 #define L_DEBUG(...)
+#define L_DEBUG_EVERY_N(n, ...)
+#define L_DEBUG_ONCE(...)
+#define L_DEBUG_RATE_LIMITED(nmsg_per_sec, ...)
 #endif // defined(L_MIN_LOG_LEVEL) && L_MIN_LOG_LEVEL >= 0
 
 #if !defined(L_MIN_LOG_LEVEL) || L_MIN_LOG_LEVEL <= 1
 #define L_INFO(...) ::liong::log::info(__VA_ARGS__)
+#define L_INFO_EVERY_N(n, ...) \
+  L_LOG_EVERY_N__(L_LOG_LEVEL_INFO, info, n, __VA_ARGS__)
+#define L_INFO_ONCE(...) L_LOG_ONCE__(L_LOG_LEVEL_INFO, info, __VA_ARGS__)
+#define L_INFO_RATE_LIMITED(nmsg_per_sec, ...) \
+  L_LOG_RATE_LIMITED__(L_LOG_LEVEL_INFO, info, nmsg_per_sec, __VA_ARGS__)
 #else
 #define L_INFO(...)
+#define L_INFO_EVERY_N(n, ...)
+#define L_INFO_ONCE(...)
+#define L_INFO_RATE_LIMITED(nmsg_per_sec, ...)
 #endif // defined(L_MIN_LOG_LEVEL) && L_MIN_LOG_LEVEL >= 1
 
 #if !defined(L_MIN_LOG_LEVEL) || L_MIN_LOG_LEVEL <= 2
 #define L_WARN(...) ::liong::log::warn(__VA_ARGS__)
+#define L_WARN_EVERY_N(n, ...) \
+  L_LOG_EVERY_N__(L_LOG_LEVEL_WARNING, warn, n, __VA_ARGS__)
+#define L_WARN_ONCE(...) L_LOG_ONCE__(L_LOG_LEVEL_WARNING, warn, __VA_ARGS__)
+#define L_WARN_RATE_LIMITED(nmsg_per_sec, ...) \
+  L_LOG_RATE_LIMITED__(L_LOG_LEVEL_WARNING, warn, nmsg_per_sec, __VA_ARGS__)
 #else
 #define L_WARN(...)
+#define L_WARN_EVERY_N(n, ...)
+#define L_WARN_ONCE(...)
+#define L_WARN_RATE_LIMITED(nmsg_per_sec, ...)
 #endif // defined(L_MIN_LOG_LEVEL) && L_MIN_LOG_LEVEL >= 2
 
 #if !defined(L_MIN_LOG_LEVEL) || L_MIN_LOG_LEVEL <= 3
 #define L_ERROR(...) ::liong::log::error(__VA_ARGS__)
+#define L_ERROR_EVERY_N(n, ...) \
+  L_LOG_EVERY_N__(L_LOG_LEVEL_ERROR, error, n, __VA_ARGS__)
+#define L_ERROR_ONCE(...) L_LOG_ONCE__(L_LOG_LEVEL_ERROR, error, __VA_ARGS__)
+#define L_ERROR_RATE_LIMITED(nmsg_per_sec, ...) \
+  L_LOG_RATE_LIMITED__(L_LOG_LEVEL_ERROR, error, nmsg_per_sec, __VA_ARGS__)
 #else
 #define L_ERROR(...)
+#define L_ERROR_EVERY_N(n, ...)
+#define L_ERROR_ONCE(...)
+#define L_ERROR_RATE_LIMITED(nmsg_per_sec, ...)
 #endif // defined(L_MIN_LOG_LEVEL) && L_MIN_LOG_LEVEL >= 3
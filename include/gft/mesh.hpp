@@ -38,6 +38,7 @@ struct IndexedMesh {
   std::vector<glm::uvec3> idxs;
 
   static IndexedMesh from_mesh(const Mesh& mesh);
+  std::vector<geom::Triangle> to_tris() const;
 
   inline geom::Aabb aabb() const {
     return mesh.aabb();
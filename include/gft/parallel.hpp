@@ -0,0 +1,443 @@
+// Work-stealing task scheduler and parallel algorithms.
+// @PENGUINLIONG
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "gft/util.hpp"
+
+namespace liong {
+
+namespace parallel {
+
+typedef std::function<void()> Task;
+
+// A fixed set of worker threads, each owning a task deque. Workers push and
+// pop tasks at the back of their own deques and steal from the front of the
+// others' when they run out of work. Tasks spawned from outside the pool go to
+// a shared injection queue.
+class ThreadPool {
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+  std::mutex inject_mutex_;
+  std::deque<Task> inject_tasks_;
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+  // Number of tasks queued but not yet picked up.
+  std::atomic<size_t> npending_;
+  std::atomic<bool> is_stopping_;
+
+  bool try_pop(size_t iworker, Task& task);
+  bool try_steal(size_t iworker, Task& task);
+  void work(size_t iworker);
+
+ public:
+  // `nthread` of zero creates one worker per hardware thread.
+  ThreadPool(uint32_t nthread = 0);
+  // Runs all the tasks still queued before returning.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  inline uint32_t nthread() const {
+    return (uint32_t)threads_.size();
+  }
+
+  // Queue a task. Exceptions escaping from `task` terminate the process; use
+  // `TaskGroup` or `submit` to propagate them.
+  void spawn(Task&& task);
+  // Run one queued task on the calling thread, if any. Threads waiting for
+  // tasks call this to help instead of blocking, so tasks can wait for
+  // subtasks without deadlocking the pool.
+  bool try_run_one();
+
+  // Run `f` in the pool and get its result through a future.
+  template<typename F>
+  std::future<typename std::invoke_result<F>::type> submit(F&& f);
+};
+
+// Process-wide pool used by the parallel algorithms. It's created on first use
+// with one worker less than the hardware threads, because the calling thread
+// helps while it waits.
+ThreadPool& get_default_pool();
+
+// In deterministic mode all tasks are run inline on the spawning thread, in
+// spawning order, so that tests and debugging sessions are reproducible.
+void enable_deterministic_mode();
+void disable_deterministic_mode();
+bool is_deterministic_mode();
+
+// A set of tasks that can be waited for as a whole. The first exception thrown
+// by any of the tasks is rethrown by `wait`.
+class TaskGroup {
+  ThreadPool& pool_;
+  std::atomic<size_t> nrunning_;
+  std::mutex exception_mutex_;
+  std::exception_ptr exception_;
+
+  void set_exception(std::exception_ptr exception);
+
+ public:
+  TaskGroup(ThreadPool& pool = get_default_pool());
+  // Waits for the remaining tasks but doesn't rethrow.
+  ~TaskGroup();
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  inline ThreadPool& pool() {
+    return pool_;
+  }
+
+  template<typename F>
+  void run(F&& f) {
+    if (is_deterministic_mode()) {
+      try {
+        f();
+      } catch (...) {
+        set_exception(std::current_exception());
+      }
+      return;
+    }
+    nrunning_.fetch_add(1, std::memory_order_relaxed);
+    pool_.spawn([this, f = std::forward<F>(f)]() mutable {
+      try {
+        f();
+      } catch (...) {
+        set_exception(std::current_exception());
+      }
+      nrunning_.fetch_sub(1, std::memory_order_release);
+    });
+  }
+
+  // Block until all tasks have finished, running queued tasks in the meantime.
+  void wait();
+};
+
+template<typename F>
+std::future<typename std::invoke_result<F>::type> ThreadPool::submit(F&& f) {
+  typedef typename std::invoke_result<F>::type TResult;
+  auto task =
+    std::make_shared<std::packaged_task<TResult()>>(std::forward<F>(f));
+  std::future<TResult> out = task->get_future();
+  if (is_deterministic_mode()) {
+    (*task)();
+  } else {
+    spawn([task]() { (*task)(); });
+  }
+  return out;
+}
+
+// Number of threads that can work on a parallel algorithm at the same time,
+// i.e., the workers and the waiting thread.
+inline size_t get_nworker(ThreadPool& pool) {
+  return is_deterministic_mode() ? 1 : (size_t)pool.nthread() + 1;
+}
+// The default pool isn't created in deterministic mode.
+inline size_t get_nworker() {
+  return is_deterministic_mode() ? 1 : get_nworker(get_default_pool());
+}
+// Split `n` items into about four chunks per worker, so that workers done
+// early can pick up the remainder of an unbalanced workload. Loops with very
+// cheap bodies should pass an explicit, larger grain size.
+inline size_t get_grain_size(size_t n, size_t min_grain = 1) {
+  size_t nchunk = get_nworker() * 4;
+  return std::max(util::div_up(n, nchunk), std::max<size_t>(min_grain, 1));
+}
+
+// Call `f(chunk_beg, chunk_end)` over disjoint chunks covering `[beg, end)`.
+// `grain` of zero chooses one with `get_grain_size`.
+template<typename F>
+void parallel_for_range(size_t beg, size_t end, F&& f, size_t grain = 0) {
+  if (end <= beg) {
+    return;
+  }
+  size_t n = end - beg;
+  if (grain == 0) {
+    grain = get_grain_size(n);
+  }
+  size_t nchunk = util::div_up(n, grain);
+  size_t ntask = std::min(nchunk, get_nworker());
+  if (ntask <= 1) {
+    for (size_t i = beg; i < end; i += grain) {
+      f(i, std::min(i + grain, end));
+    }
+    return;
+  }
+
+  // Chunks are handed out dynamically so that the tasks finishing early take
+  // over the rest.
+  std::atomic<size_t> ichunk { 0 };
+  TaskGroup group;
+  for (size_t i = 0; i < ntask; ++i) {
+    group.run([&]() {
+      for (;;) {
+        size_t j = ichunk.fetch_add(1, std::memory_order_relaxed);
+        if (j >= nchunk) {
+          break;
+        }
+        size_t chunk_beg = beg + j * grain;
+        f(chunk_beg, std::min(chunk_beg + grain, end));
+      }
+    });
+  }
+  group.wait();
+}
+// Call `f(i)` for each `i` in `[beg, end)`.
+template<typename F>
+void parallel_for(size_t beg, size_t end, F&& f, size_t grain = 0) {
+  parallel_for_range(
+    beg,
+    end,
+    [&](size_t chunk_beg, size_t chunk_end) {
+      for (size_t i = chunk_beg; i < chunk_end; ++i) {
+        f(i);
+      }
+    },
+    grain
+  );
+}
+
+// Reduce `[beg, end)` chunk by chunk with `map(chunk_beg, chunk_end)` and fold
+// the partial results with `combine(a, b)` in chunk order. The result is
+// reproducible for a given grain size even if `combine` is only approximately
+// associative, like floating-point additions.
+template<typename T, typename TMap, typename TCombine>
+T parallel_reduce(
+  size_t beg,
+  size_t end,
+  T identity,
+  TMap&& map,
+  TCombine&& combine,
+  size_t grain = 0
+) {
+  if (end <= beg) {
+    return identity;
+  }
+  size_t n = end - beg;
+  if (grain == 0) {
+    grain = get_grain_size(n);
+  }
+  size_t nchunk = util::div_up(n, grain);
+  std::vector<T> partials(nchunk, identity);
+  parallel_for(
+    0,
+    nchunk,
+    [&](size_t i) {
+      size_t chunk_beg = beg + i * grain;
+      partials[i] = map(chunk_beg, std::min(chunk_beg + grain, end));
+    },
+    1
+  );
+
+  T out = std::move(identity);
+  for (auto& partial : partials) {
+    out = combine(std::move(out), std::move(partial));
+  }
+  return out;
+}
+
+// Inclusive prefix scan of `in` into `out` with an associative `op`. `in` and
+// `out` can be the same buffer.
+template<typename T, typename TOp>
+void parallel_scan(const T* in, T* out, size_t n, TOp&& op, size_t grain = 0) {
+  if (n == 0) {
+    return;
+  }
+  if (grain == 0) {
+    grain = get_grain_size(n);
+  }
+  size_t nchunk = util::div_up(n, grain);
+  if (nchunk <= 1) {
+    T acc = in[0];
+    out[0] = acc;
+    for (size_t i = 1; i < n; ++i) {
+      acc = op(acc, in[i]);
+      out[i] = acc;
+    }
+    return;
+  }
+
+  // Reduce each chunk, scan the chunk totals, then scan each chunk again
+  // starting from the total of all preceding chunks.
+  std::vector<T> totals(nchunk);
+  parallel_for(
+    0,
+    nchunk,
+    [&](size_t i) {
+      size_t beg = i * grain;
+      size_t end = std::min(beg + grain, n);
+      T acc = in[beg];
+      for (size_t j = beg + 1; j < end; ++j) {
+        acc = op(acc, in[j]);
+      }
+      totals[i] = acc;
+    },
+    1
+  );
+  for (size_t i = 1; i < nchunk; ++i) {
+    totals[i] = op(totals[i - 1], totals[i]);
+  }
+  parallel_for(
+    0,
+    nchunk,
+    [&](size_t i) {
+      size_t beg = i * grain;
+      size_t end = std::min(beg + grain, n);
+      T acc = i == 0 ? in[beg] : op(totals[i - 1], in[beg]);
+      out[beg] = acc;
+      for (size_t j = beg + 1; j < end; ++j) {
+        acc = op(acc, in[j]);
+        out[j] = acc;
+      }
+    },
+    1
+  );
+}
+template<typename T, typename TOp>
+std::vector<T> parallel_scan(
+  const std::vector<T>& in,
+  TOp&& op,
+  size_t grain = 0
+) {
+  std::vector<T> out(in.size());
+  parallel_scan(in.data(), out.data(), in.size(), std::forward<TOp>(op), grain);
+  return out;
+}
+
+// Sort chunks in parallel and merge them pairwise in parallel rounds. Not
+// stable.
+template<typename TIter, typename TCompare = std::less<>>
+void parallel_sort(
+  TIter beg,
+  TIter end,
+  TCompare comp = TCompare {},
+  size_t grain = 0
+) {
+  typedef typename std::iterator_traits<TIter>::value_type T;
+  size_t n = (size_t)std::distance(beg, end);
+  if (grain == 0) {
+    // Each merge round is a full pass over the data, so keep the number of
+    // chunks to the number of workers.
+    grain = std::max<size_t>(util::div_up(n, get_nworker()), 1);
+  }
+  size_t nchunk = n == 0 ? 0 : util::div_up(n, grain);
+  if (nchunk <= 1) {
+    std::sort(beg, end, comp);
+    return;
+  }
+
+  std::vector<size_t> bounds(nchunk + 1);
+  for (size_t i = 0; i < nchunk; ++i) {
+    bounds[i] = i * grain;
+  }
+  bounds[nchunk] = n;
+  parallel_for(
+    0,
+    nchunk,
+    [&](size_t i) { std::sort(beg + bounds[i], beg + bounds[i + 1], comp); },
+    1
+  );
+
+  std::vector<T> buf(
+    std::make_move_iterator(beg),
+    std::make_move_iterator(end)
+  );
+  // Runs are merged from `buf` back to the sequence in the first round, then
+  // back and forth.
+  bool is_in_buf = true;
+  for (size_t width = 1; width < nchunk; width *= 2) {
+    size_t nmerge = util::div_up(nchunk, width * 2);
+    parallel_for(
+      0,
+      nmerge,
+      [&](size_t i) {
+        size_t ilo = i * width * 2;
+        size_t imid = std::min(ilo + width, nchunk);
+        size_t ihi = std::min(ilo + width * 2, nchunk);
+        size_t lo = bounds[ilo];
+        size_t mid = bounds[imid];
+        size_t hi = bounds[ihi];
+        if (is_in_buf) {
+          std::merge(
+            std::make_move_iterator(buf.begin() + lo),
+            std::make_move_iterator(buf.begin() + mid),
+            std::make_move_iterator(buf.begin() + mid),
+            std::make_move_iterator(buf.begin() + hi),
+            beg + lo,
+            comp
+          );
+        } else {
+          std::merge(
+            std::make_move_iterator(beg + lo),
+            std::make_move_iterator(beg + mid),
+            std::make_move_iterator(beg + mid),
+            std::make_move_iterator(beg + hi),
+            buf.begin() + lo,
+            comp
+          );
+        }
+      },
+      1
+    );
+    is_in_buf = !is_in_buf;
+  }
+  if (is_in_buf) {
+    std::move(buf.begin(), buf.end(), beg);
+  }
+}
+
+// Tag to select the parallel overloads of `util` algorithms.
+struct ParallelTag {};
+constexpr ParallelTag par {};
+
+} // namespace parallel
+
+namespace util {
+
+template<typename T, typename U>
+std::vector<U> map(
+  parallel::ParallelTag,
+  const std::vector<T>& xs,
+  const std::function<U(const T&)>& f
+) {
+  if constexpr (std::is_default_constructible<U>::value) {
+    std::vector<U> out(xs.size());
+    parallel::parallel_for(0, xs.size(), [&](size_t i) { out[i] = f(xs[i]); });
+    return out;
+  } else {
+    // Like the serial overload, `U` only needs to be movable.
+    std::vector<std::optional<U>> slots(xs.size());
+    parallel::parallel_for(0, xs.size(), [&](size_t i) {
+      slots[i].emplace(f(xs[i]));
+    });
+    std::vector<U> out;
+    out.reserve(xs.size());
+    for (auto& slot : slots) {
+      out.emplace_back(std::move(*slot));
+    }
+    return out;
+  }
+}
+
+} // namespace util
+
+} // namespace liong
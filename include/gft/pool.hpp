@@ -1,8 +1,17 @@
 // General purpose object pool.
 // @PENGUINLIONG
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <array>
 
@@ -77,5 +86,553 @@ struct Pool {
   }
 };
 
+
+namespace detail {
+
+inline uint32_t get_pool_thread_index() {
+  static std::atomic<uint32_t> counter { 0 };
+  thread_local uint32_t index = counter.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+inline uint64_t get_pool_timestamp_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()
+  ).count();
+}
+
+} // namespace detail
+
+template<typename TKey, typename TValue, typename THash>
+class SyncPool;
+
+// Per-key bookkeeping shared by all values of the same key.
+struct SyncPoolKeyState {
+  std::atomic<size_t> nidle { 0 };
+};
+
+// Pooled value with an intrusive reference count. Nodes are allocated when
+// values are created and are recycled with the values afterwards, so
+// acquiring a pooled value doesn't allocate.
+template<typename TKey, typename TValue, typename THash>
+struct SyncPoolNode {
+  SyncPool<TKey, TValue, THash>* pool;
+  SyncPoolKeyState* key_state;
+  std::atomic<uint32_t> nref;
+  // Next node in the free list while the node is idle.
+  SyncPoolNode* next;
+  // When the node last became idle.
+  uint64_t release_ns;
+  bool is_evicted;
+  TKey key;
+  TValue value;
+
+  SyncPoolNode(
+    SyncPool<TKey, TValue, THash>* pool,
+    SyncPoolKeyState* key_state,
+    TKey&& key,
+    TValue&& value
+  ) :
+    pool(pool),
+    key_state(key_state),
+    nref(0),
+    next(nullptr),
+    release_ns(0),
+    is_evicted(false),
+    key(std::move(key)),
+    value(std::move(value)) {}
+};
+
+// Handle to a value acquired from a `SyncPool`. Copies share the value, which
+// returns to the pool when the last handle is released or destroyed.
+template<typename TKey, typename TValue, typename THash = std::hash<TKey>>
+class SyncPoolItem {
+  typedef SyncPoolNode<TKey, TValue, THash> Node;
+  Node* node_;
+
+  inline void retain() {
+    if (node_ != nullptr) {
+      node_->nref.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+ public:
+  inline SyncPoolItem() : node_(nullptr) {}
+  // Takes a reference.
+  inline explicit SyncPoolItem(Node* node) : node_(node) {
+    retain();
+  }
+  inline SyncPoolItem(const SyncPoolItem& b) : node_(b.node_) {
+    retain();
+  }
+  inline SyncPoolItem(SyncPoolItem&& b) : node_(b.node_) {
+    b.node_ = nullptr;
+  }
+  inline ~SyncPoolItem() {
+    release();
+  }
+
+  inline SyncPoolItem& operator=(const SyncPoolItem& b) {
+    if (this != &b) {
+      release();
+      node_ = b.node_;
+      retain();
+    }
+    return *this;
+  }
+  inline SyncPoolItem& operator=(SyncPoolItem&& b) {
+    if (this != &b) {
+      release();
+      node_ = b.node_;
+      b.node_ = nullptr;
+    }
+    return *this;
+  }
+
+  inline bool is_valid() const {
+    return node_ != nullptr;
+  }
+
+  inline const TKey& key() const {
+    return node_->key;
+  }
+  inline TValue& value() {
+    return node_->value;
+  }
+  inline const TValue& value() const {
+    return node_->value;
+  }
+
+  inline void release() {
+    if (node_ == nullptr) {
+      return;
+    }
+    if (node_->nref.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      node_->pool->recycle(node_);
+    }
+    node_ = nullptr;
+  }
+};
+
+template<typename TKey, typename TValue>
+struct SyncPoolConfig {
+  // Number of free-list shards. Defaults to the number of hardware threads.
+  size_t nshard = 0;
+  // Idle values of the same key kept in a shard before the rest spill to the
+  // shared overflow list.
+  size_t nlocal_per_key = 8;
+  // Idle values kept in total and per key. The least recently released values
+  // are evicted first.
+  size_t max_idle = SIZE_MAX;
+  size_t max_idle_per_key = SIZE_MAX;
+  // Idle values released longer ago than this are evicted. Zero keeps idle
+  // values indefinitely.
+  std::chrono::nanoseconds max_idle_time { 0 };
+  // Called on values being evicted or cleared, before they are destroyed. It
+  // can be called on any thread acquiring or releasing values.
+  std::function<void(const TKey&, TValue&)> on_destroy;
+  // Monotonic time in nanoseconds. Defaults to the steady clock; tests can
+  // drive idle times with it.
+  std::function<uint64_t()> get_now_ns;
+};
+
+// Snapshot of pool usage. Counts are exact when the pool is quiescent.
+struct SyncPoolCounters {
+  // Acquisitions served by an idle value, and ones that found none.
+  uint64_t nhit;
+  uint64_t nmiss;
+  // Values currently held by items.
+  uint64_t nlive;
+  // Values currently parked in the pool.
+  uint64_t nidle;
+  // Values destroyed to honor the capacity and idle-time limits.
+  uint64_t nevicted;
+};
+
+// Thread-safe variant of `Pool`. Idle values are kept in hashed free lists in
+// a few shards, one of which is picked by the releasing thread, so threads
+// mostly recycle their own values without contention. Shards keep a bounded
+// number of values per key and spill the rest to a shared overflow list.
+//
+// When a release exceeds a capacity limit, or the idle time limit is due for
+// a check on a release or an acquisition, all shards are locked and the least
+// recently released values are evicted. Steady-state workloads that hit the
+// pool never take this path. A pool that is no longer used at all keeps its
+// idle values until `evict` or `clear` is called.
+//
+// Values are evicted, i.e., `on_destroy` is called and the values are
+// destroyed, on whichever thread is acquiring or releasing at the time, so
+// values must be destructible from any thread that uses the pool.
+//
+// The pool must outlive all the items acquired from it.
+template<typename TKey, typename TValue, typename THash = std::hash<TKey>>
+class SyncPool {
+ public:
+  typedef SyncPoolItem<TKey, TValue, THash> Item;
+  typedef SyncPoolConfig<TKey, TValue> Config;
+
+ private:
+  typedef SyncPoolNode<TKey, TValue, THash> Node;
+  friend class SyncPoolItem<TKey, TValue, THash>;
+
+  struct FreeList {
+    // Most recently released first.
+    Node* head = nullptr;
+    size_t nnode = 0;
+
+    inline void push(Node* node) {
+      node->next = head;
+      head = node;
+      ++nnode;
+    }
+    inline Node* pop() {
+      Node* node = head;
+      head = node->next;
+      node->next = nullptr;
+      --nnode;
+      return node;
+    }
+  };
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::unordered_map<TKey, FreeList, THash> free_lists;
+
+    inline Node* try_pop(const TKey& key) {
+      auto it = free_lists.find(key);
+      if (it == free_lists.end() || it->second.head == nullptr) {
+        return nullptr;
+      }
+      Node* node = it->second.pop();
+      node->key_state->nidle.fetch_sub(1, std::memory_order_relaxed);
+      return node;
+    }
+  };
+
+  Config cfg_;
+  size_t nshard_;
+  std::unique_ptr<Shard[]> shards_;
+  Shard overflow_;
+
+  std::mutex key_state_mutex_;
+  std::unordered_map<TKey, std::unique_ptr<SyncPoolKeyState>, THash>
+    key_states_;
+
+  std::atomic<uint64_t> nhit_;
+  std::atomic<uint64_t> nmiss_;
+  std::atomic<uint64_t> nlive_;
+  std::atomic<uint64_t> nidle_;
+  std::atomic<uint64_t> nevicted_;
+  std::atomic<uint64_t> last_evict_ns_;
+
+  inline uint64_t get_now_ns() const {
+    return cfg_.get_now_ns ? cfg_.get_now_ns()
+                           : detail::get_pool_timestamp_ns();
+  }
+  inline Shard& get_shard() {
+    return shards_[detail::get_pool_thread_index() % nshard_];
+  }
+
+  SyncPoolKeyState* get_key_state(const TKey& key) {
+    std::lock_guard<std::mutex> guard(key_state_mutex_);
+    auto it = key_states_.find(key);
+    if (it == key_states_.end()) {
+      it = key_states_.emplace(key, std::make_unique<SyncPoolKeyState>())
+             .first;
+    }
+    return it->second.get();
+  }
+
+  static Config make_config(size_t nshard, size_t nlocal_per_key) {
+    Config out {};
+    out.nshard = nshard;
+    out.nlocal_per_key = nlocal_per_key;
+    return out;
+  }
+
+  void recycle(Node* node) {
+    uint64_t now_ns = get_now_ns();
+    node->release_ns = now_ns;
+    nlive_.fetch_sub(1, std::memory_order_relaxed);
+
+    // Count the node as idle before it becomes visible to `try_pop`, so that
+    // the counts never underflow.
+    size_t nidle = nidle_.fetch_add(1, std::memory_order_relaxed) + 1;
+    size_t nidle_key =
+      node->key_state->nidle.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    Shard* shard = &get_shard();
+    {
+      std::lock_guard<std::mutex> guard(shard->mutex);
+      FreeList& free_list = shard->free_lists[node->key];
+      if (free_list.nnode < cfg_.nlocal_per_key) {
+        free_list.push(node);
+        shard = nullptr;
+      }
+    }
+    if (shard != nullptr) {
+      std::lock_guard<std::mutex> guard(overflow_.mutex);
+      overflow_.free_lists[node->key].push(node);
+    }
+
+    if (nidle > cfg_.max_idle || nidle_key > cfg_.max_idle_per_key) {
+      evict(now_ns);
+    } else if (is_idle_check_due(now_ns)) {
+      evict(now_ns);
+    }
+  }
+  // Acquisitions check idle times too, so that values released in a burst
+  // are evicted even if nothing is released afterwards.
+  void evict_idle_if_due() {
+    if (cfg_.max_idle_time.count() == 0) {
+      return;
+    }
+    uint64_t now_ns = get_now_ns();
+    if (is_idle_check_due(now_ns)) {
+      evict(now_ns);
+    }
+  }
+
+  // Check idle times twice per `max_idle_time`, by one thread at a time.
+  bool is_idle_check_due(uint64_t now_ns) {
+    uint64_t max_idle_ns = cfg_.max_idle_time.count();
+    if (max_idle_ns == 0) {
+      return false;
+    }
+    uint64_t last_ns = last_evict_ns_.load(std::memory_order_relaxed);
+    if (now_ns - last_ns < max_idle_ns / 2) {
+      return false;
+    }
+    return last_evict_ns_.compare_exchange_strong(last_ns, now_ns);
+  }
+
+  Node* try_pop(const TKey& key) {
+    Node* node = nullptr;
+    Shard& local_shard = get_shard();
+    {
+      std::lock_guard<std::mutex> guard(local_shard.mutex);
+      node = local_shard.try_pop(key);
+    }
+    if (node == nullptr) {
+      std::lock_guard<std::mutex> guard(overflow_.mutex);
+      node = overflow_.try_pop(key);
+    }
+    // Values released on other threads, e.g., by a thread waiting for
+    // submitted work, are parked in other shards.
+    for (size_t i = 0; node == nullptr && i < nshard_; ++i) {
+      Shard& shard = shards_[i];
+      if (&shard == &local_shard) {
+        continue;
+      }
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      node = shard.try_pop(key);
+    }
+    if (node != nullptr) {
+      nidle_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return node;
+  }
+
+  template<typename F>
+  void for_each_free_list(F&& f) {
+    for (size_t i = 0; i < nshard_; ++i) {
+      for (auto& pair : shards_[i].free_lists) {
+        f(pair.second);
+      }
+    }
+    for (auto& pair : overflow_.free_lists) {
+      f(pair.second);
+    }
+  }
+  std::vector<std::unique_lock<std::mutex>> lock_all_shards() {
+    std::vector<std::unique_lock<std::mutex>> out;
+    out.reserve(nshard_ + 1);
+    for (size_t i = 0; i < nshard_; ++i) {
+      out.emplace_back(shards_[i].mutex);
+    }
+    out.emplace_back(overflow_.mutex);
+    return out;
+  }
+
+  void destroy(Node* node) {
+    if (cfg_.on_destroy) {
+      cfg_.on_destroy(node->key, node->value);
+    }
+    delete node;
+  }
+
+  // Evict the least recently released values until the pool is within its
+  // capacity limits, and all values idle for too long.
+  void evict(uint64_t now_ns) {
+    std::vector<Node*> victims;
+    {
+      auto locks = lock_all_shards();
+
+      std::vector<Node*> idle_nodes;
+      for_each_free_list([&](FreeList& free_list) {
+        for (Node* node = free_list.head; node != nullptr; node = node->next) {
+          idle_nodes.emplace_back(node);
+        }
+      });
+      std::sort(
+        idle_nodes.begin(),
+        idle_nodes.end(),
+        [](const Node* a, const Node* b) {
+          return a->release_ns < b->release_ns;
+        }
+      );
+
+      uint64_t max_idle_ns = cfg_.max_idle_time.count();
+      size_t nidle = idle_nodes.size();
+      for (Node* node : idle_nodes) {
+        bool should_evict = nidle > cfg_.max_idle ||
+          node->key_state->nidle.load(std::memory_order_relaxed) >
+            cfg_.max_idle_per_key ||
+          (max_idle_ns != 0 && now_ns - node->release_ns > max_idle_ns);
+        if (should_evict) {
+          node->is_evicted = true;
+          node->key_state->nidle.fetch_sub(1, std::memory_order_relaxed);
+          --nidle;
+          victims.emplace_back(node);
+        }
+      }
+      if (victims.empty()) {
+        return;
+      }
+
+      // Unlink the victims, keeping the order of the rest.
+      for_each_free_list([&](FreeList& free_list) {
+        Node** link = &free_list.head;
+        while (*link != nullptr) {
+          Node* node = *link;
+          if (node->is_evicted) {
+            *link = node->next;
+            --free_list.nnode;
+          } else {
+            link = &node->next;
+          }
+        }
+      });
+      nidle_.fetch_sub(victims.size(), std::memory_order_relaxed);
+      nevicted_.fetch_add(victims.size(), std::memory_order_relaxed);
+    }
+    // Destroy out of the locks in case the callback touches the pool.
+    for (Node* node : victims) {
+      destroy(node);
+    }
+  }
+
+ public:
+  SyncPool(const Config& cfg) :
+    cfg_(cfg),
+    nshard_(
+      cfg.nshard != 0 ? cfg.nshard
+                      : std::max(std::thread::hardware_concurrency(), 1u)
+    ),
+    shards_(new Shard[nshard_]),
+    overflow_(),
+    key_state_mutex_(),
+    key_states_(),
+    nhit_(0),
+    nmiss_(0),
+    nlive_(0),
+    nidle_(0),
+    nevicted_(0),
+    last_evict_ns_(get_now_ns()) {}
+  // `nshard` defaults to the number of hardware threads. Each shard keeps at
+  // most `nlocal_per_key` idle values of the same key.
+  SyncPool(size_t nshard = 0, size_t nlocal_per_key = 8) :
+    SyncPool(make_config(nshard, nlocal_per_key)) {}
+  ~SyncPool() {
+    clear();
+  }
+
+  SyncPool(const SyncPool&) = delete;
+  SyncPool& operator=(const SyncPool&) = delete;
+
+  // Only a hint when other threads are releasing or acquiring values.
+  bool has_free_item(const TKey& key) {
+    auto has_free_node = [&](Shard& shard) {
+      std::lock_guard<std::mutex> guard(shard.mutex);
+      auto it = shard.free_lists.find(key);
+      return it != shard.free_lists.end() && it->second.head != nullptr;
+    };
+    for (size_t i = 0; i < nshard_; ++i) {
+      if (has_free_node(shards_[i])) {
+        return true;
+      }
+    }
+    return has_free_node(overflow_);
+  }
+
+  // Wrap a newly created value; it joins the pool when released.
+  Item create(TKey&& key, TValue&& value) {
+    SyncPoolKeyState* key_state = get_key_state(key);
+    nlive_.fetch_add(1, std::memory_order_relaxed);
+    return Item(new Node(this, key_state, std::move(key), std::move(value)));
+  }
+  // Returns false if there is no idle value of `key`.
+  bool try_acquire(const TKey& key, Item& out) {
+    evict_idle_if_due();
+    Node* node = try_pop(key);
+    if (node == nullptr) {
+      nmiss_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    nhit_.fetch_add(1, std::memory_order_relaxed);
+    nlive_.fetch_add(1, std::memory_order_relaxed);
+    out = Item(node);
+    return true;
+  }
+  // Throws `std::out_of_range` if there is no idle value of `key`.
+  Item acquire(const TKey& key) {
+    Item out;
+    if (!try_acquire(key, out)) {
+      throw std::out_of_range("no idle value of the key in the pool");
+    }
+    return out;
+  }
+  // Reuse an idle value of `key` or create one with `create_value()`.
+  template<typename F>
+  Item acquire_or_create(const TKey& key, F&& create_value) {
+    Item out;
+    if (!try_acquire(key, out)) {
+      out = create(TKey(key), create_value());
+    }
+    return out;
+  }
+
+  // Evict idle values beyond the limits now, instead of on the next release.
+  void evict() {
+    evict(get_now_ns());
+  }
+  // Destroy all idle values.
+  void clear() {
+    std::vector<Node*> nodes;
+    {
+      auto locks = lock_all_shards();
+      for_each_free_list([&](FreeList& free_list) {
+        while (free_list.head != nullptr) {
+          Node* node = free_list.pop();
+          node->key_state->nidle.fetch_sub(1, std::memory_order_relaxed);
+          nodes.emplace_back(node);
+        }
+      });
+      nidle_.fetch_sub(nodes.size(), std::memory_order_relaxed);
+    }
+    for (Node* node : nodes) {
+      destroy(node);
+    }
+  }
+
+  SyncPoolCounters counters() const {
+    SyncPoolCounters out {};
+    out.nhit = nhit_.load(std::memory_order_relaxed);
+    out.nmiss = nmiss_.load(std::memory_order_relaxed);
+    out.nlive = nlive_.load(std::memory_order_relaxed);
+    out.nidle = nidle_.load(std::memory_order_relaxed);
+    out.nevicted = nevicted_.load(std::memory_order_relaxed);
+    return out;
+  }
+};
+
 } // namespace pool
 } // namespace liong
@@ -0,0 +1,109 @@
+// Scoped CPU profiler.
+// @PENGUINLIONG
+//
+// Profile scopes are only recorded when `L_ENABLE_PROFILE` is defined (i.e.,
+// the `GFT_ENABLE_PROFILE` CMake option is on); otherwise `L_PROFILE_SCOPE`
+// compiles to nothing.
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "gft/json.hpp"
+
+namespace liong {
+namespace profile {
+
+// A closed profile scope.
+struct ProfileEvent {
+  // Must be a string with static storage duration, e.g., a string literal.
+  const char* name;
+  // Index of the recording thread in the order threads first record events.
+  uint32_t tid;
+  // Number of enclosing scopes on the same thread.
+  uint32_t depth;
+  // Nanoseconds since an arbitrary epoch.
+  uint64_t begin_ns;
+  uint64_t end_ns;
+};
+
+namespace detail {
+
+uint64_t get_profile_timestamp_ns();
+uint32_t enter_profile_scope();
+void exit_profile_scope(const char* name, uint32_t depth, uint64_t begin_ns);
+
+} // namespace detail
+
+// Record a profile event from the constructor to the destructor. Events are
+// buffered per thread so recording never blocks on other threads.
+struct ProfileScope {
+  const char* name;
+  uint32_t depth;
+  uint64_t begin_ns;
+
+  inline ProfileScope(const char* name) :
+    name(name),
+    depth(detail::enter_profile_scope()),
+    begin_ns(detail::get_profile_timestamp_ns()) {}
+  inline ~ProfileScope() {
+    detail::exit_profile_scope(name, depth, begin_ns);
+  }
+
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+// Copy out all events recorded so far, from all threads, ordered by thread and
+// then by beginning time.
+std::vector<ProfileEvent> collect_profile_events();
+// Discard all recorded events.
+void clear_profile_events();
+
+// Chrome `trace_event` format, which can be loaded by `chrome://tracing` and
+// Perfetto.
+json::JsonValue to_chrome_trace(const std::vector<ProfileEvent>& events);
+void save_chrome_trace(
+  const char* path,
+  const std::vector<ProfileEvent>& events
+);
+
+struct ProfileSummaryEntry {
+  std::string name;
+  // Nesting level in hierarchical summaries; always zero in flat summaries.
+  uint32_t depth;
+  uint64_t ncall;
+  // Time spent in the scope, including its children.
+  uint64_t total_ns;
+  // Time spent in the scope, excluding its children.
+  uint64_t self_ns;
+  uint64_t min_ns;
+  uint64_t max_ns;
+};
+
+// One entry per scope name, ordered by total time in descending order.
+std::vector<ProfileSummaryEntry> summarize_flat(
+  const std::vector<ProfileEvent>& events
+);
+// One entry per call path, in depth-first order. Siblings are ordered by total
+// time in descending order. Call paths from different threads are merged.
+std::vector<ProfileSummaryEntry> summarize_hierarchical(
+  const std::vector<ProfileEvent>& events
+);
+// Human-readable table of summary entries.
+std::string print_profile_summary(
+  const std::vector<ProfileSummaryEntry>& entries
+);
+
+} // namespace profile
+} // namespace liong
+
+#ifdef L_ENABLE_PROFILE
+#define L_PROFILE_CONCAT_IMPL__(a, b) a##b
+#define L_PROFILE_CONCAT__(a, b) L_PROFILE_CONCAT_IMPL__(a, b)
+#define L_PROFILE_SCOPE(name)                       \
+  ::liong::profile::ProfileScope L_PROFILE_CONCAT__( \
+    l_profile_scope_, __LINE__                      \
+  )(name)
+#else
+#define L_PROFILE_SCOPE(name)
+#endif // L_ENABLE_PROFILE
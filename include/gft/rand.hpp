@@ -0,0 +1,40 @@
+// Deterministic pseudo-random numbers for tests and benchmarks.
+// @PENGUINLIONG
+#pragma once
+#include <cstdint>
+#include "glm/glm.hpp"
+
+namespace liong {
+namespace rand {
+
+// Linear congruential generator. It gives the same sequence on every platform,
+// so that tests and benchmarks are reproducible; it's not meant for anything
+// that needs good statistical properties.
+struct Lcg {
+  uint32_t seed;
+
+  inline Lcg(uint32_t seed = 0x12345678) : seed(seed) {}
+
+  inline uint32_t next_u32() {
+    seed = seed * 1664525u + 1013904223u;
+    return seed;
+  }
+  // In `[0, 1)`.
+  inline float unorm() {
+    return (next_u32() >> 8) * (1.0f / (1 << 24));
+  }
+  // In `[-1, 1)`.
+  inline float snorm() {
+    return (next_u32() >> 8) * (2.0f / (1 << 24)) - 1.0f;
+  }
+  // In `[-1, 1)` on each axis.
+  inline glm::vec3 vec3() {
+    float x = snorm();
+    float y = snorm();
+    float z = snorm();
+    return glm::vec3(x, y, z);
+  }
+};
+
+} // namespace rand
+} // namespace liong
@@ -4,6 +4,12 @@
 #include <cmath>
 #include <limits>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
 #include "gft/log.hpp"
 
 namespace liong {
@@ -29,6 +35,9 @@ class MinStats {
   inline bool has_value() const {
     return mn_ != std::numeric_limits<T>::max();
   }
+  void merge(const MinStats<T>& x) {
+    push(x.mn_);
+  }
   operator T() const {
     if (!has_value()) {
       L_WARN("`MinStats` has not collected any data yet");
@@ -59,6 +68,9 @@ class MaxStats {
   inline bool has_value() const {
     return mx_ != -std::numeric_limits<T>::max();
   }
+  void merge(const MaxStats<T>& x) {
+    push(x.mx_);
+  }
   operator T() const {
     if (!has_value()) {
       L_WARN("`MaxStats` has not collected any data yet");
@@ -85,6 +97,10 @@ class AvgStats {
   inline bool has_value() const {
     return n_ != 0;
   }
+  void merge(const AvgStats<T>& x) {
+    sum_ += x.sum_;
+    n_ += x.n_;
+  }
   operator T() const {
     if (!has_value()) {
       L_WARN("`AvgStats` has not collected any data yet");
@@ -156,7 +172,7 @@ class MedianStats {
     if (values_.size() & 1) {
       return values_[imid];
     } else {
-      return (values_[imid] + values_[imid + 1]) / 2;
+      return (values_[imid - 1] + values_[imid]) / 2;
     }
   }
   friend std::ostream& operator<<(std::ostream& out, const MedianStats<T>& x) {
@@ -165,6 +181,735 @@ class MedianStats {
   }
 };
 
+// Online mean and variance with Welford's algorithm. It's a constant-memory
+// alternative to `StdStats`.
+template<typename T>
+class WelfordStats {
+  uint64_t n_ = 0;
+  double mean_ = 0.0;
+  double m2_ = 0.0;
+
+ public:
+  typedef T value_t;
+
+  void push(T value) {
+    n_ += 1;
+    double delta = (double)value - mean_;
+    mean_ += delta / n_;
+    m2_ += delta * ((double)value - mean_);
+  }
+  // Combine with statistics collected elsewhere, e.g., on another thread.
+  void merge(const WelfordStats<T>& x) {
+    if (x.n_ == 0) {
+      return;
+    }
+    if (n_ == 0) {
+      *this = x;
+      return;
+    }
+    uint64_t n = n_ + x.n_;
+    double delta = x.mean_ - mean_;
+    mean_ += delta * x.n_ / n;
+    m2_ += x.m2_ + delta * delta * ((double)n_ * x.n_ / n);
+    n_ = n;
+  }
+  inline bool has_value() const {
+    return n_ != 0;
+  }
+  // Standard deviation, same as `StdStats`.
+  operator T() const {
+    if (!has_value()) {
+      L_WARN("`WelfordStats` has not collected any data yet");
+    }
+    return (T)std::sqrt(var());
+  }
+  friend std::ostream& operator<<(std::ostream& out, const WelfordStats<T>& x) {
+    out << (T)(x);
+    return out;
+  }
+  inline uint64_t count() const {
+    return n_;
+  }
+  inline T avg() const {
+    return (T)mean_;
+  }
+  // Population variance.
+  inline double var() const {
+    return n_ != 0 ? m2_ / n_ : 0.0;
+  }
+};
+
+// HDR-style log-bucketed histogram. Positive values are bucketed by their
+// binary exponent, and each power-of-two range is further split into
+// `2^NSubBucketBit` linear sub-buckets, so any quantile is reported with a
+// relative error less than `2^-NSubBucketBit`. Memory usage only depends on
+// the range of values, not the number of samples. Zero and negative values
+// are counted as zero; non-finite values are ignored.
+template<typename T, uint32_t NSubBucketBit = 7>
+class HistogramStats {
+  static constexpr uint32_t NSUB_BUCKET = 1 << NSubBucketBit;
+
+  // Binary exponent of the first group of sub-buckets in `counts_`.
+  int32_t exp_beg_ = 0;
+  std::vector<uint64_t> counts_ {};
+  uint64_t nzero_ = 0;
+  uint64_t n_ = 0;
+  double sum_ = 0.0;
+  T mn_ = std::numeric_limits<T>::max();
+  T mx_ = std::numeric_limits<T>::lowest();
+
+  uint64_t& bucket(int32_t exp, uint32_t isub) {
+    if (counts_.empty()) {
+      exp_beg_ = exp;
+    }
+    if (exp < exp_beg_) {
+      counts_.insert(counts_.begin(), (exp_beg_ - exp) * NSUB_BUCKET, 0);
+      exp_beg_ = exp;
+    }
+    size_t i = (exp - exp_beg_) * NSUB_BUCKET + isub;
+    if (i >= counts_.size()) {
+      counts_.resize((exp - exp_beg_ + 1) * NSUB_BUCKET, 0);
+    }
+    return counts_[i];
+  }
+
+ public:
+  typedef T value_t;
+
+  void push(T value) {
+    double x = (double)value;
+    if (!std::isfinite(x)) {
+      return;
+    }
+    n_ += 1;
+    sum_ += x;
+    mn_ = std::min(mn_, value);
+    mx_ = std::max(mx_, value);
+    if (x <= 0.0) {
+      nzero_ += 1;
+      return;
+    }
+    // `x = m * 2^exp` where `m` is in [0.5, 1).
+    int exp;
+    double m = std::frexp(x, &exp);
+    uint32_t isub = std::min<uint32_t>(
+      (uint32_t)((m * 2.0 - 1.0) * NSUB_BUCKET), NSUB_BUCKET - 1
+    );
+    bucket(exp, isub) += 1;
+  }
+  // Add up the samples of another histogram.
+  void merge(const HistogramStats<T, NSubBucketBit>& x) {
+    for (size_t i = 0; i < x.counts_.size(); ++i) {
+      if (x.counts_[i] != 0) {
+        int32_t exp = x.exp_beg_ + (int32_t)(i / NSUB_BUCKET);
+        bucket(exp, i % NSUB_BUCKET) += x.counts_[i];
+      }
+    }
+    nzero_ += x.nzero_;
+    n_ += x.n_;
+    sum_ += x.sum_;
+    mn_ = std::min(mn_, x.mn_);
+    mx_ = std::max(mx_, x.mx_);
+  }
+  inline bool has_value() const {
+    return n_ != 0;
+  }
+  // Median.
+  operator T() const {
+    if (!has_value()) {
+      L_WARN("`HistogramStats` has not collected any data yet");
+    }
+    return quantile(0.5);
+  }
+  friend std::ostream& operator<<(
+    std::ostream& out,
+    const HistogramStats<T, NSubBucketBit>& x
+  ) {
+    out << (T)(x);
+    return out;
+  }
+
+  // `q` is in [0, 1].
+  T quantile(double q) const {
+    if (n_ == 0) {
+      return T {};
+    }
+    // The extremes are tracked exactly.
+    if (q <= 0.0) {
+      return mn_;
+    }
+    if (q >= 1.0) {
+      return mx_;
+    }
+    uint64_t rank = std::max<uint64_t>((uint64_t)std::ceil(q * n_), 1);
+    uint64_t acc = nzero_;
+    if (acc >= rank) {
+      return std::max(mn_, T {});
+    }
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      acc += counts_[i];
+      if (acc >= rank) {
+        // Report the center of the sub-bucket.
+        int32_t exp = exp_beg_ + (int32_t)(i / NSUB_BUCKET);
+        double m = 0.5 * (1.0 + ((i % NSUB_BUCKET) + 0.5) / NSUB_BUCKET);
+        double x = std::ldexp(m, exp);
+        return std::clamp((T)x, mn_, mx_);
+      }
+    }
+    return mx_;
+  }
+  // `p` is in [0, 100], e.g., `percentile(99.9)`.
+  inline T percentile(double p) const {
+    return quantile(p / 100.0);
+  }
+  inline uint64_t count() const {
+    return n_;
+  }
+  inline T avg() const {
+    return (T)(sum_ / n_);
+  }
+  inline T min() const {
+    return mn_;
+  }
+  inline T max() const {
+    return mx_;
+  }
+};
+
+// Single-quantile estimate with the P-square algorithm by Jain and Chlamtac.
+// It tracks five markers so the memory usage is constant. Unlike
+// `HistogramStats` the estimates cannot be merged.
+template<typename T>
+class P2QuantileStats {
+  double p_;
+  uint64_t n_ = 0;
+  // Marker heights.
+  double q_[5];
+  // Actual and desired marker positions, and desired position increments.
+  double pos_[5];
+  double desired_[5];
+  double incr_[5];
+
+  double parabolic(int i, double d) const {
+    return q_[i] + d / (pos_[i + 1] - pos_[i - 1]) *
+      ((pos_[i] - pos_[i - 1] + d) * (q_[i + 1] - q_[i]) /
+         (pos_[i + 1] - pos_[i]) +
+       (pos_[i + 1] - pos_[i] - d) * (q_[i] - q_[i - 1]) /
+         (pos_[i] - pos_[i - 1]));
+  }
+  double linear(int i, int d) const {
+    return q_[i] + d * (q_[i + d] - q_[i]) / (pos_[i + d] - pos_[i]);
+  }
+
+ public:
+  typedef T value_t;
+
+  // `p` is the quantile to be estimated, in (0, 1).
+  P2QuantileStats(double p = 0.5) : p_(p) {}
+
+  void push(T value) {
+    double x = (double)value;
+    if (n_ < 5) {
+      q_[n_++] = x;
+      if (n_ == 5) {
+        std::sort(q_, q_ + 5);
+        for (int i = 0; i < 5; ++i) {
+          pos_[i] = i + 1;
+        }
+        desired_[0] = 1.0;
+        desired_[1] = 1.0 + 2.0 * p_;
+        desired_[2] = 1.0 + 4.0 * p_;
+        desired_[3] = 3.0 + 2.0 * p_;
+        desired_[4] = 5.0;
+        incr_[0] = 0.0;
+        incr_[1] = p_ / 2.0;
+        incr_[2] = p_;
+        incr_[3] = (1.0 + p_) / 2.0;
+        incr_[4] = 1.0;
+      }
+      return;
+    }
+    n_ += 1;
+
+    // Find the cell the sample falls in, extending the extremes if needed.
+    int k;
+    if (x < q_[0]) {
+      q_[0] = x;
+      k = 0;
+    } else if (x >= q_[4]) {
+      q_[4] = x;
+      k = 3;
+    } else {
+      k = 0;
+      while (k < 3 && x >= q_[k + 1]) {
+        ++k;
+      }
+    }
+    for (int i = k + 1; i < 5; ++i) {
+      pos_[i] += 1.0;
+    }
+    for (int i = 0; i < 5; ++i) {
+      desired_[i] += incr_[i];
+    }
+
+    // Adjust the heights of the middle markers.
+    for (int i = 1; i < 4; ++i) {
+      double d = desired_[i] - pos_[i];
+      if ((d >= 1.0 && pos_[i + 1] - pos_[i] > 1.0) ||
+          (d <= -1.0 && pos_[i - 1] - pos_[i] < -1.0)) {
+        int di = d >= 0.0 ? 1 : -1;
+        double qi = parabolic(i, di);
+        if (q_[i - 1] < qi && qi < q_[i + 1]) {
+          q_[i] = qi;
+        } else {
+          q_[i] = linear(i, di);
+        }
+        pos_[i] += di;
+      }
+    }
+  }
+  inline bool has_value() const {
+    return n_ != 0;
+  }
+  operator T() const {
+    if (!has_value()) {
+      L_WARN("`P2QuantileStats` has not collected any data yet");
+      return T {};
+    }
+    if (n_ < 5) {
+      // Too few samples for the markers; pick from the sorted samples.
+      double q[5];
+      std::copy(q_, q_ + n_, q);
+      std::sort(q, q + n_);
+      return (T)q[(size_t)std::round(p_ * (n_ - 1))];
+    }
+    return (T)q_[2];
+  }
+  friend std::ostream& operator<<(
+    std::ostream& out,
+    const P2QuantileStats<T>& x
+  ) {
+    out << (T)(x);
+    return out;
+  }
+  inline uint64_t count() const {
+    return n_;
+  }
+};
+
+namespace detail {
+
+// Growable ring buffer used as a double-ended queue. Unlike `std::deque` it
+// stops allocating once it has grown to the window size.
+template<typename T>
+class StatsRing {
+  std::vector<T> buf_ {};
+  size_t beg_ = 0;
+  size_t size_ = 0;
+
+  void grow() {
+    std::vector<T> buf(std::max<size_t>(buf_.size() * 2, 16));
+    for (size_t i = 0; i < size_; ++i) {
+      buf[i] = std::move((*this)[i]);
+    }
+    buf_ = std::move(buf);
+    beg_ = 0;
+  }
+
+ public:
+  inline size_t size() const {
+    return size_;
+  }
+  inline bool empty() const {
+    return size_ == 0;
+  }
+  inline T& operator[](size_t i) {
+    return buf_[(beg_ + i) & (buf_.size() - 1)];
+  }
+  inline const T& operator[](size_t i) const {
+    return buf_[(beg_ + i) & (buf_.size() - 1)];
+  }
+  inline T& front() {
+    return (*this)[0];
+  }
+  inline T& back() {
+    return (*this)[size_ - 1];
+  }
+
+  void push_back(T x) {
+    if (size_ == buf_.size()) {
+      grow();
+    }
+    size_ += 1;
+    back() = std::move(x);
+  }
+  inline void pop_front() {
+    beg_ = (beg_ + 1) & (buf_.size() - 1);
+    size_ -= 1;
+  }
+  inline void pop_back() {
+    size_ -= 1;
+  }
+};
+
+// A sample in a window, tagged with its sequence number and push time.
+template<typename T>
+struct WindowEntry {
+  uint64_t seq;
+  int64_t time_ns;
+  T value;
+};
+
+// Window of the most recent samples, bounded by the number of samples and
+// optionally by their age.
+class StatsWindow {
+  size_t nsample_;
+  int64_t max_age_ns_;
+  uint64_t seq_ = 0;
+
+ public:
+  StatsWindow(size_t nsample, std::chrono::nanoseconds max_age) :
+    nsample_(nsample), max_age_ns_(max_age.count()) {}
+
+  inline bool has_max_age() const {
+    return max_age_ns_ != 0;
+  }
+  // Current time, or zero if samples never age out.
+  inline int64_t get_now_ns() const {
+    if (!has_max_age()) {
+      return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+  }
+
+  template<typename T>
+  WindowEntry<T> make_entry(T value) {
+    return WindowEntry<T> { seq_++, get_now_ns(), value };
+  }
+  // Whether `entry` is older than the maximal age at `now_ns`.
+  template<typename T>
+  inline bool is_too_old(const WindowEntry<T>& entry, int64_t now_ns) const {
+    return has_max_age() && entry.time_ns + max_age_ns_ < now_ns;
+  }
+  // Whether `entry` has fallen out of the window after `latest` was pushed.
+  template<typename T>
+  inline bool is_expired(
+    const WindowEntry<T>& entry,
+    const WindowEntry<T>& latest
+  ) const {
+    return entry.seq + nsample_ <= latest.seq ||
+      is_too_old(entry, latest.time_ns);
+  }
+
+  // Drop the samples at the front of `entries` that are too old now, calling
+  // `on_drop` on each. Samples are in push order, so the oldest ones are at
+  // the front.
+  template<typename T, typename F>
+  void drop_too_old(StatsRing<WindowEntry<T>>& entries, F&& on_drop) const {
+    if (!has_max_age() || entries.empty()) {
+      return;
+    }
+    int64_t now_ns = get_now_ns();
+    while (!entries.empty() && is_too_old(entries.front(), now_ns)) {
+      on_drop(entries.front());
+      entries.pop_front();
+    }
+  }
+  template<typename T>
+  inline void drop_too_old(StatsRing<WindowEntry<T>>& entries) const {
+    drop_too_old(entries, [](const WindowEntry<T>&) {});
+  }
+};
+
+// Monotonic queue of window samples. The front is always the extremum, i.e.,
+// the minimum with `std::less` and the maximum with `std::greater`.
+template<typename T, typename TCompare>
+class MonotonicWindow {
+  StatsWindow window_;
+  // Samples that aged out are dropped lazily, also when reading.
+  mutable StatsRing<WindowEntry<T>> entries_ {};
+
+ public:
+  MonotonicWindow(size_t nsample, std::chrono::nanoseconds max_age) :
+    window_(nsample, max_age) {}
+
+  // Amortized O(1).
+  void push(T value) {
+    WindowEntry<T> entry = window_.make_entry(value);
+    // Samples dominated by the new one can never be the extremum again.
+    while (!entries_.empty() && !TCompare()(entries_.back().value, value)) {
+      entries_.pop_back();
+    }
+    entries_.push_back(entry);
+    while (window_.is_expired(entries_.front(), entry)) {
+      entries_.pop_front();
+    }
+  }
+  inline bool has_value() const {
+    window_.drop_too_old(entries_);
+    return !entries_.empty();
+  }
+  inline T value() const {
+    window_.drop_too_old(entries_);
+    return entries_[0].value;
+  }
+};
+
+} // namespace detail
+
+// Minimum of the last `nsample` samples. If `max_age` is non-zero, samples
+// older than `max_age` at the time of reading are also excluded.
+template<typename T>
+class WindowMinStats {
+  detail::MonotonicWindow<T, std::less<T>> window_;
+
+ public:
+  typedef T value_t;
+
+  WindowMinStats(
+    size_t nsample = 64,
+    std::chrono::nanoseconds max_age = std::chrono::nanoseconds::zero()
+  ) :
+    window_(nsample, max_age) {}
+
+  void push(T value) {
+    window_.push(value);
+  }
+  inline bool has_value() const {
+    return window_.has_value();
+  }
+  operator T() const {
+    if (!has_value()) {
+      L_WARN("`WindowMinStats` has not collected any data yet");
+      return std::numeric_limits<T>::max();
+    }
+    return window_.value();
+  }
+  friend std::ostream& operator<<(
+    std::ostream& out,
+    const WindowMinStats<T>& x
+  ) {
+    out << (T)(x);
+    return out;
+  }
+};
+// Maximum of the last `nsample` samples. If `max_age` is non-zero, samples
+// older than `max_age` at the time of reading are also excluded.
+template<typename T>
+class WindowMaxStats {
+  detail::MonotonicWindow<T, std::greater<T>> window_;
+
+ public:
+  typedef T value_t;
+
+  WindowMaxStats(
+    size_t nsample = 64,
+    std::chrono::nanoseconds max_age = std::chrono::nanoseconds::zero()
+  ) :
+    window_(nsample, max_age) {}
+
+  void push(T value) {
+    window_.push(value);
+  }
+  inline bool has_value() const {
+    return window_.has_value();
+  }
+  operator T() const {
+    if (!has_value()) {
+      L_WARN("`WindowMaxStats` has not collected any data yet");
+      return -std::numeric_limits<T>::max();
+    }
+    return window_.value();
+  }
+  friend std::ostream& operator<<(
+    std::ostream& out,
+    const WindowMaxStats<T>& x
+  ) {
+    out << (T)(x);
+    return out;
+  }
+};
+// Mean of the last `nsample` samples. If `max_age` is non-zero, samples older
+// than `max_age` at the time of reading are also excluded.
+template<typename T>
+class WindowAvgStats {
+  detail::StatsWindow window_;
+  // Samples that aged out are dropped lazily, also when reading.
+  mutable detail::StatsRing<detail::WindowEntry<T>> entries_ {};
+  mutable T sum_ = 0;
+
+  inline void drop_too_old() const {
+    window_.drop_too_old(entries_, [&](const detail::WindowEntry<T>& entry) {
+      sum_ -= entry.value;
+    });
+  }
+
+ public:
+  typedef T value_t;
+
+  WindowAvgStats(
+    size_t nsample = 64,
+    std::chrono::nanoseconds max_age = std::chrono::nanoseconds::zero()
+  ) :
+    window_(nsample, max_age) {}
+
+  // Amortized O(1).
+  void push(T value) {
+    detail::WindowEntry<T> entry = window_.make_entry(value);
+    entries_.push_back(entry);
+    sum_ += value;
+    while (window_.is_expired(entries_.front(), entry)) {
+      sum_ -= entries_.front().value;
+      entries_.pop_front();
+    }
+  }
+  inline bool has_value() const {
+    drop_too_old();
+    return !entries_.empty();
+  }
+  operator T() const {
+    if (!has_value()) {
+      L_WARN("`WindowAvgStats` has not collected any data yet");
+      return T {};
+    }
+    return sum_ / (T)entries_.size();
+  }
+  friend std::ostream& operator<<(
+    std::ostream& out,
+    const WindowAvgStats<T>& x
+  ) {
+    out << (T)(x);
+    return out;
+  }
+  inline size_t count() const {
+    drop_too_old();
+    return entries_.size();
+  }
+};
+// Quantiles of the last `nsample` samples. If `max_age` is non-zero, samples
+// older than `max_age` at the time of reading are also excluded. Pushing is
+// amortized O(1) while querying is linear in the window size.
+template<typename T>
+class WindowPercentileStats {
+  detail::StatsWindow window_;
+  // Samples that aged out are dropped lazily, also when reading.
+  mutable detail::StatsRing<detail::WindowEntry<T>> entries_ {};
+  mutable std::vector<T> scratch_ {};
+
+ public:
+  typedef T value_t;
+
+  WindowPercentileStats(
+    size_t nsample = 64,
+    std::chrono::nanoseconds max_age = std::chrono::nanoseconds::zero()
+  ) :
+    window_(nsample, max_age) {}
+
+  void push(T value) {
+    detail::WindowEntry<T> entry = window_.make_entry(value);
+    entries_.push_back(entry);
+    while (window_.is_expired(entries_.front(), entry)) {
+      entries_.pop_front();
+    }
+  }
+  inline bool has_value() const {
+    window_.drop_too_old(entries_);
+    return !entries_.empty();
+  }
+  // Median.
+  operator T() const {
+    if (!has_value()) {
+      L_WARN("`WindowPercentileStats` has not collected any data yet");
+      return T {};
+    }
+    return quantile(0.5);
+  }
+  friend std::ostream& operator<<(
+    std::ostream& out,
+    const WindowPercentileStats<T>& x
+  ) {
+    out << (T)(x);
+    return out;
+  }
+
+  // Nearest-rank quantile, `q` is in [0, 1].
+  T quantile(double q) const {
+    window_.drop_too_old(entries_);
+    if (entries_.empty()) {
+      return T {};
+    }
+    scratch_.clear();
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      scratch_.emplace_back(entries_[i].value);
+    }
+    size_t rank = (size_t)std::ceil(std::clamp(q, 0.0, 1.0) * scratch_.size());
+    size_t i = rank == 0 ? 0 : rank - 1;
+    std::nth_element(scratch_.begin(), scratch_.begin() + i, scratch_.end());
+    return scratch_[i];
+  }
+  // `p` is in [0, 100].
+  inline T percentile(double p) const {
+    return quantile(p / 100.0);
+  }
+  inline size_t count() const {
+    window_.drop_too_old(entries_);
+    return entries_.size();
+  }
+};
+
+// Exponentially weighted moving average and variance. Each new sample has a
+// weight of `alpha`, so older samples decay geometrically.
+template<typename T>
+class EwmaStats {
+  double alpha_;
+  bool has_value_ = false;
+  double mean_ = 0.0;
+  double var_ = 0.0;
+
+ public:
+  typedef T value_t;
+
+  EwmaStats(double alpha = 0.1) : alpha_(alpha) {}
+
+  void push(T value) {
+    double x = (double)value;
+    if (!has_value_) {
+      mean_ = x;
+      has_value_ = true;
+      return;
+    }
+    double diff = x - mean_;
+    double incr = alpha_ * diff;
+    mean_ += incr;
+    var_ = (1.0 - alpha_) * (var_ + diff * incr);
+  }
+  inline bool has_value() const {
+    return has_value_;
+  }
+  // Moving average.
+  operator T() const {
+    if (!has_value()) {
+      L_WARN("`EwmaStats` has not collected any data yet");
+    }
+    return (T)mean_;
+  }
+  friend std::ostream& operator<<(std::ostream& out, const EwmaStats<T>& x) {
+    out << (T)(x);
+    return out;
+  }
+  inline T avg() const {
+    return (T)mean_;
+  }
+  inline double var() const {
+    return var_;
+  }
+  inline T stddev() const {
+    return (T)std::sqrt(var_);
+  }
+};
+
 template<typename TStats>
 class GeomDeltaStats {
   TStats stats_ {};
@@ -236,6 +981,101 @@ class ArithDeltaStats {
   }
 };
 
+namespace detail {
+
+// Small sequential index of the calling thread.
+inline uint32_t get_stats_thread_index() {
+  static std::atomic<uint32_t> counter { 0 };
+  thread_local uint32_t index = counter.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+} // namespace detail
+
+// Concurrent wrapper of any stats type with a `merge` method. Each thread
+// pushes into its own shard, padded to a cache line so that shards don't
+// false-share, and `snapshot` merges the shards on demand.
+//
+// Each shard is guarded by a spinlock that is only contended when threads
+// outnumber the shards or while a snapshot is being taken.
+template<typename TStats>
+class ShardedStats {
+  struct alignas(64) Shard {
+    std::atomic<bool> is_locked { false };
+    TStats stats {};
+
+    inline void lock() {
+      while (is_locked.exchange(true, std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+    }
+    inline void unlock() {
+      is_locked.store(false, std::memory_order_release);
+    }
+  };
+
+  TStats proto_;
+  size_t nshard_;
+  std::unique_ptr<Shard[]> shards_;
+
+  inline Shard& get_shard() const {
+    return shards_[detail::get_stats_thread_index() % nshard_];
+  }
+
+ public:
+  typedef typename TStats::value_t value_t;
+
+  // `nshard` defaults to the number of hardware threads. All shards start as
+  // copies of `proto`, so stats with constructor arguments can be used.
+  ShardedStats(size_t nshard = 0, const TStats& proto = TStats {}) :
+    proto_(proto),
+    nshard_(
+      nshard != 0 ? nshard : std::max(std::thread::hardware_concurrency(), 1u)
+    ),
+    shards_(new Shard[nshard_]) {
+    reset();
+  }
+
+  void push(value_t value) {
+    Shard& shard = get_shard();
+    shard.lock();
+    shard.stats.push(value);
+    shard.unlock();
+  }
+  // Merge all shards into a single stats object.
+  TStats snapshot() const {
+    TStats out = proto_;
+    for (size_t i = 0; i < nshard_; ++i) {
+      Shard& shard = shards_[i];
+      shard.lock();
+      out.merge(shard.stats);
+      shard.unlock();
+    }
+    return out;
+  }
+  void reset() {
+    for (size_t i = 0; i < nshard_; ++i) {
+      Shard& shard = shards_[i];
+      shard.lock();
+      shard.stats = proto_;
+      shard.unlock();
+    }
+  }
+  inline bool has_value() const {
+    return snapshot().has_value();
+  }
+  operator value_t() const {
+    return (value_t)snapshot();
+  }
+  friend std::ostream& operator<<(
+    std::ostream& out,
+    const ShardedStats<TStats>& x
+  ) {
+    out << x.snapshot();
+    return out;
+  }
+};
+
 } // namespace stats
 
 } // namespace liong
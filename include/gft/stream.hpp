@@ -2,12 +2,159 @@
 // @PENGUINLIONG
 #pragma once
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
 #include <vector>
 #include <functional>
+#include <type_traits>
+#include "gft/assert.hpp"
 
 namespace liong {
 namespace stream {
 
+namespace detail {
+
+constexpr bool is_host_little_endian() {
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+  return __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__;
+#else
+  // MSVC only targets little-endian platforms.
+  return true;
+#endif
+}
+
+template<typename T>
+inline T byte_swap(const T& x) {
+  static_assert(std::is_arithmetic<T>::value, "can only swap scalar bytes");
+  uint8_t bytes[sizeof(T)];
+  std::memcpy(bytes, &x, sizeof(T));
+  for (size_t i = 0; i < sizeof(T) / 2; ++i) {
+    std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+  }
+  T out;
+  std::memcpy(&out, bytes, sizeof(T));
+  return out;
+}
+template<typename T>
+inline T to_le(const T& x) {
+  return is_host_little_endian() ? x : byte_swap(x);
+}
+template<typename T>
+inline T to_be(const T& x) {
+  return is_host_little_endian() ? byte_swap(x) : x;
+}
+
+// Maximal number of bytes a 64-bit LEB128 integer can take.
+constexpr size_t MAX_LEB128_SIZE = 10;
+
+inline size_t encode_uleb128(uint64_t x, uint8_t* out) {
+  size_t n = 0;
+  while (x >= 0x80) {
+    out[n++] = (uint8_t)(x | 0x80);
+    x >>= 7;
+  }
+  out[n++] = (uint8_t)x;
+  return n;
+}
+inline size_t encode_sleb128(int64_t x, uint8_t* out) {
+  size_t n = 0;
+  for (;;) {
+    uint8_t byte = (uint8_t)(x & 0x7F);
+    // Arithmetic shift keeps the sign.
+    x >>= 7;
+    if ((x == 0 && (byte & 0x40) == 0) || (x == -1 && (byte & 0x40) != 0)) {
+      out[n++] = byte;
+      return n;
+    }
+    out[n++] = byte | 0x80;
+  }
+}
+
+} // namespace detail
+
+// Map signed integers to unsigned ones so that values of small magnitudes have
+// small encodings, i.e., 0, -1, 1, -2, 2, ... are mapped to 0, 1, 2, 3, 4, ...
+constexpr uint64_t zigzag_encode(int64_t x) {
+  return ((uint64_t)x << 1) ^ (uint64_t)(x >> 63);
+}
+constexpr int64_t zigzag_decode(uint64_t x) {
+  return (int64_t)(x >> 1) ^ -(int64_t)(x & 1);
+}
+
+// Typed read-only view of a range of bytes. The view borrows the underlying
+// buffer if the range is properly aligned for `T`; otherwise the data is copied
+// into a buffer owned by the view. In either case the underlying buffer has to
+// be kept alive through out the view's lifetime.
+template<typename T>
+struct ReadView {
+  static_assert(
+    std::is_trivially_copyable<T>::value,
+    "stream data can only be viewed as trivially copyable types"
+  );
+
+ private:
+  // `nullptr` if the data is copied into `owned_`.
+  const T* borrowed_;
+  size_t size_;
+  std::vector<T> owned_;
+
+ public:
+  ReadView() : borrowed_(nullptr), size_(0), owned_() {}
+  ReadView(const void* data, size_t count) :
+    borrowed_(nullptr), size_(count), owned_() {
+    if ((uintptr_t)data % alignof(T) == 0) {
+      borrowed_ = (const T*)data;
+    } else {
+      owned_.resize(count);
+      std::memcpy(owned_.data(), data, count * sizeof(T));
+    }
+  }
+
+  inline const T* data() const {
+    return borrowed_ != nullptr ? borrowed_ : owned_.data();
+  }
+  inline size_t size() const {
+    return size_;
+  }
+  inline bool empty() const {
+    return size_ == 0;
+  }
+  // Returns true if no copy has been made to create this view.
+  inline bool is_borrowed() const {
+    return borrowed_ != nullptr || size_ == 0;
+  }
+
+  inline const T& operator[](size_t i) const {
+    L_ASSERT(i < size_, "view index out of range");
+    return data()[i];
+  }
+  inline const T* begin() const {
+    return data();
+  }
+  inline const T* end() const {
+    return data() + size_;
+  }
+
+  inline std::vector<T> to_vector() const {
+    return std::vector<T>(begin(), end());
+  }
+  template<typename F>
+  using map_result_t = typename std::decay<
+    decltype(std::declval<F>()(std::declval<const T&>()))>::type;
+
+  // Apply `f` on each element and collect the results.
+  template<typename F>
+  std::vector<map_result_t<F>> map(F&& f) const {
+    std::vector<map_result_t<F>> out {};
+    out.reserve(size_);
+    for (const T& x : *this) {
+      out.emplace_back(f(x));
+    }
+    return out;
+  }
+};
+
 struct ReadStream {
  private:
   const void* data_;
@@ -51,7 +198,7 @@ struct ReadStream {
   template<typename T>
   inline T peek() {
     T out {};
-    peek_data(&out);
+    peek_data(&out, sizeof(T));
     return out;
   }
   template<typename T>
@@ -74,10 +221,56 @@ struct ReadStream {
     if (size_remain() < sizeof(T)) {
       return false;
     } else {
-      extract_data(&out);
+      extract_data(&out, sizeof(T));
       return true;
     }
   }
+
+  // Extract scalars stored in a specific byte order.
+  template<typename T>
+  inline T extract_le() {
+    return detail::to_le(extract<T>());
+  }
+  template<typename T>
+  inline T extract_be() {
+    return detail::to_be(extract<T>());
+  }
+
+  // Extract LEB128 variable-length integers. Returns false if the stream ends
+  // in the middle of the integer or the integer doesn't fit in 64 bits.
+  bool try_extract_uleb128(uint64_t& out);
+  bool try_extract_sleb128(int64_t& out);
+  inline uint64_t extract_uleb128() {
+    uint64_t out = 0;
+    bool succ = try_extract_uleb128(out);
+    L_ASSERT(succ, "malformed uleb128 integer");
+    return out;
+  }
+  inline int64_t extract_sleb128() {
+    int64_t out = 0;
+    bool succ = try_extract_sleb128(out);
+    L_ASSERT(succ, "malformed sleb128 integer");
+    return out;
+  }
+  // Zigzag-encoded signed integer in unsigned LEB128.
+  inline int64_t extract_zigzag() {
+    return zigzag_decode(extract_uleb128());
+  }
+  // Extract `count` elements of `T` without copying if possible. The returned
+  // view refers to the underlying buffer of this stream.
+  template<typename T>
+  ReadView<T> view(size_t count) {
+    L_ASSERT(count <= size_remain() / sizeof(T), "view out of range");
+    ReadView<T> out(pos(), count);
+    offset_ += count * sizeof(T);
+    return out;
+  }
+  // Extract as many elements of `T` as possible without copying if possible.
+  template<typename T>
+  ReadView<T> view_all() {
+    return view<T>(size_remain() / sizeof(T));
+  }
+
   template<typename T>
   std::vector<T> extract_all() {
     std::vector<T> out {};
@@ -88,16 +281,11 @@ struct ReadStream {
   }
   template<typename T, typename U>
   std::vector<U> extract_all_map(const std::function<U(const T&)>& f) {
-    std::vector<T> tmp {};
-    std::vector<U> out {};
-    size_t n = size_remain() / sizeof(T);
-    tmp.resize(n);
-    out.resize(n);
-    extract_data(tmp.data(), n * sizeof(T));
-    for (size_t i = 0; i < tmp.size(); ++i) {
-      out[i] = f(tmp[i]);
-    }
-    return out;
+    return view_all<T>().map(f);
+  }
+  template<typename T, typename F>
+  auto extract_all_map(F&& f) {
+    return view_all<T>().map(std::forward<F>(f));
   }
 };
 
@@ -121,10 +309,243 @@ struct WriteStream {
     append_data(data.data(), data.size() * sizeof(T));
   }
 
+  template<typename T>
+  inline void append_le(const T& x) {
+    append(detail::to_le(x));
+  }
+  template<typename T>
+  inline void append_be(const T& x) {
+    append(detail::to_be(x));
+  }
+  inline void append_uleb128(uint64_t x) {
+    uint8_t buf[detail::MAX_LEB128_SIZE];
+    append_data(buf, detail::encode_uleb128(x, buf));
+  }
+  inline void append_sleb128(int64_t x) {
+    uint8_t buf[detail::MAX_LEB128_SIZE];
+    append_data(buf, detail::encode_sleb128(x, buf));
+  }
+  inline void append_zigzag(int64_t x) {
+    append_uleb128(zigzag_encode(x));
+  }
+
   inline std::vector<uint8_t> take() {
     return std::move(data_);
   }
 };
 
+// Write stream appending data into a list of separately allocated chunks.
+// Unlike `WriteStream` it never zero-fills, reallocates or moves data already
+// written, so offsets recorded in the middle of writing can be used to patch
+// the data in place later. Large buffers can also be spliced into the stream
+// by reference without copy.
+struct ChunkedWriteStream {
+ private:
+  struct Chunk {
+    // `nullptr` if the chunk refers to an external buffer.
+    std::unique_ptr<uint8_t[]> owned;
+    const uint8_t* data;
+    // Offset of the first byte of this chunk in the stream.
+    size_t offset;
+    size_t size;
+    // Always equal to `size` if the chunk refers to an external buffer.
+    size_t capacity;
+  };
+
+  size_t chunk_size_;
+  size_t size_;
+  // Chunks after `ichunk_` are reserved but not written yet.
+  std::vector<Chunk> chunks_;
+  size_t ichunk_;
+
+  Chunk& next_writable_chunk(size_t size_hint);
+  Chunk& locate_chunk(size_t offset);
+
+ public:
+  static const size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+  ChunkedWriteStream(size_t chunk_size = DEFAULT_CHUNK_SIZE) :
+    chunk_size_(chunk_size), size_(0), chunks_(), ichunk_(0) {}
+
+  inline size_t size() const {
+    return size_;
+  }
+  inline size_t nchunk() const {
+    return chunks_.size();
+  }
+
+  // Ensure at least `size` bytes can be appended without further allocation.
+  void reserve(size_t size);
+
+  void append_data(const void* data, size_t size);
+  // Splice `data` into the stream by reference. `data` has to be kept alive
+  // through out the stream's lifetime and it cannot be patched.
+  void append_data_ref(const void* data, size_t size);
+
+  template<typename T>
+  inline void append(const T& x) {
+    append_data(&x, sizeof(T));
+  }
+  template<typename T>
+  inline void append(const std::vector<T>& data) {
+    append_data(data.data(), data.size() * sizeof(T));
+  }
+
+  template<typename T>
+  inline void append_le(const T& x) {
+    append(detail::to_le(x));
+  }
+  template<typename T>
+  inline void append_be(const T& x) {
+    append(detail::to_be(x));
+  }
+  inline void append_uleb128(uint64_t x) {
+    uint8_t buf[detail::MAX_LEB128_SIZE];
+    append_data(buf, detail::encode_uleb128(x, buf));
+  }
+  inline void append_sleb128(int64_t x) {
+    uint8_t buf[detail::MAX_LEB128_SIZE];
+    append_data(buf, detail::encode_sleb128(x, buf));
+  }
+  inline void append_zigzag(int64_t x) {
+    append_uleb128(zigzag_encode(x));
+  }
+
+  // Overwrite data previously written at `offset`.
+  void patch_data(size_t offset, const void* data, size_t size);
+  template<typename T>
+  inline void patch(size_t offset, const T& x) {
+    patch_data(offset, &x, sizeof(T));
+  }
+
+  // Write all chunks to file at `path` with scatter-gather I/O.
+  void save(const char* path) const;
+  // Flatten all chunks into a single buffer. The stream is emptied.
+  std::vector<uint8_t> take();
+};
+
+// Pack integers of arbitrary bit widths LSB-first into a write stream. Bits are
+// buffered in a 64-bit accumulator and written in 32-bit little-endian words;
+// call `flush` to write the remaining bits padded with zeros to whole bytes.
+template<typename TWriteStream>
+struct BitWriter {
+ private:
+  TWriteStream& stream_;
+  uint64_t acc_;
+  uint32_t nbit_acc_;
+
+  inline void write_bits32(uint32_t bits, uint32_t nbit) {
+    uint64_t mask = (uint64_t(1) << nbit) - 1;
+    acc_ |= (bits & mask) << nbit_acc_;
+    nbit_acc_ += nbit;
+    if (nbit_acc_ >= 32) {
+      stream_.append_le((uint32_t)acc_);
+      acc_ >>= 32;
+      nbit_acc_ -= 32;
+    }
+  }
+
+ public:
+  BitWriter(TWriteStream& stream) : stream_(stream), acc_(0), nbit_acc_(0) {}
+
+  // Write the lowest `nbit` bits of `bits`; `nbit` can be at most 64.
+  inline void write(uint64_t bits, uint32_t nbit) {
+    L_ASSERT(nbit <= 64, "cannot write more than 64 bits at once");
+    if (nbit > 32) {
+      write_bits32((uint32_t)bits, 32);
+      write_bits32((uint32_t)(bits >> 32), nbit - 32);
+    } else {
+      write_bits32((uint32_t)bits, nbit);
+    }
+  }
+  inline void write_bit(bool bit) {
+    write_bits32(bit ? 1 : 0, 1);
+  }
+
+  void flush() {
+    while (nbit_acc_ > 0) {
+      stream_.template append<uint8_t>((uint8_t)acc_);
+      acc_ >>= 8;
+      nbit_acc_ = nbit_acc_ > 8 ? nbit_acc_ - 8 : 0;
+    }
+    acc_ = 0;
+  }
+};
+
+// Unpack bits written by `BitWriter`. Bytes are consumed from the underlying
+// stream only when needed, so after `align` the stream is positioned right
+// after the last byte that holds any bit read.
+struct BitReader {
+ private:
+  ReadStream& stream_;
+  uint64_t acc_;
+  uint32_t nbit_acc_;
+
+  inline bool try_read_bits32(uint32_t nbit, uint32_t& out) {
+    if (nbit_acc_ < nbit) {
+      size_t nbyte = (nbit - nbit_acc_ + 7) / 8;
+      if (stream_.size_remain() < nbyte) {
+        return false;
+      }
+      uint64_t word = 0;
+      if (stream_.size_remain() >= sizeof(uint64_t)) {
+        // Load a whole word at once and keep the bytes we need.
+        std::memcpy(&word, stream_.pos(), sizeof(uint64_t));
+        word = detail::to_le(word) & ((uint64_t(1) << (nbyte * 8)) - 1);
+      } else {
+        std::memcpy(&word, stream_.pos(), nbyte);
+        word = detail::to_le(word);
+      }
+      stream_.skip(nbyte);
+      acc_ |= word << nbit_acc_;
+      nbit_acc_ += (uint32_t)nbyte * 8;
+    }
+    out = (uint32_t)(acc_ & ((uint64_t(1) << nbit) - 1));
+    acc_ >>= nbit;
+    nbit_acc_ -= nbit;
+    return true;
+  }
+
+ public:
+  BitReader(ReadStream& stream) : stream_(stream), acc_(0), nbit_acc_(0) {}
+
+  // Read `nbit` bits; `nbit` can be at most 64. Returns false without
+  // consuming anything if the stream has no enough data.
+  inline bool try_read(uint32_t nbit, uint64_t& out) {
+    L_ASSERT(nbit <= 64, "cannot read more than 64 bits at once");
+    // Nothing is consumed unless all bits are available.
+    if (nbit > nbit_acc_ &&
+      stream_.size_remain() < (nbit - nbit_acc_ + 7) / 8) {
+      return false;
+    }
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+    if (nbit > 32) {
+      if (!try_read_bits32(32, lo) || !try_read_bits32(nbit - 32, hi)) {
+        return false;
+      }
+    } else if (!try_read_bits32(nbit, lo)) {
+      return false;
+    }
+    out = ((uint64_t)hi << 32) | lo;
+    return true;
+  }
+  inline uint64_t read(uint32_t nbit) {
+    uint64_t out = 0;
+    bool succ = try_read(nbit, out);
+    L_ASSERT(succ, "bit stream is exhausted");
+    return out;
+  }
+  inline bool read_bit() {
+    return read(1) != 0;
+  }
+
+  // Discard the bits remaining in the current byte.
+  inline void align() {
+    acc_ = 0;
+    nbit_acc_ = 0;
+  }
+};
+
 } // namespace stream
 } // namespace liong
@@ -1,22 +1,52 @@
 // Unit test infrastructure.
 // @PENGUINLIONG
+#pragma once
 #include <map>
 #include <memory>
 #include <string>
 #include <functional>
+#include <vector>
+#include "gft/json.hpp"
 
 namespace liong {
 
 namespace test {
 
+struct TestResult {
+  std::string name;
+  bool is_succ;
+  // Wall-clock time spent in the test.
+  uint64_t duration_ns;
+  // Exception message if the test failed.
+  std::string error;
+};
+
 struct TestReport {
   uint64_t nsucc;
   uint64_t nfail;
+  // In the order the tests finished.
+  std::vector<TestResult> results;
+};
+
+struct TestConfig {
+  // Only tests whose names match this wildcard pattern are run.
+  std::string filter = "*";
+  // Number of threads running tests concurrently. `0` means one thread per
+  // hardware thread. Logs of concurrent tests are buffered and printed test
+  // by test as they finish.
+  uint32_t nthread = 1;
+  // Durations recorded by a previous run. Tests are started in descending
+  // order of these, so that the slowest tests don't end up running alone at
+  // the end. Tests without a record are assumed to be the slowest.
+  std::map<std::string, uint64_t> name2duration_ns;
 };
 
 struct TestRegistry {
   struct Entry {
     std::function<void()> f;
+    // Serial tests mutate process-wide states like the log callback, so they
+    // are run one by one after all the other tests have finished.
+    bool is_serial;
   };
   std::map<std::string, Entry> tests;
 
@@ -24,10 +54,18 @@ struct TestRegistry {
 
   static TestRegistry& get_inst();
   static TestReport run_all();
+  static TestReport run_all(const TestConfig& cfg);
 
   int reg(const std::string& name, std::function<void()>&& func);
+  int reg_serial(const std::string& name, std::function<void()>&& func);
 };
 
+json::JsonValue report2json(const TestReport& report);
+// Extract test durations from a report saved by a previous run, to be used as
+// `TestConfig::name2duration_ns`. Malformed reports are ignored with a
+// warning.
+std::map<std::string, uint64_t> json2durations(const json::JsonValue& json);
+
 } // namespace test
 
 } // namespace liong
@@ -37,3 +75,11 @@ struct TestRegistry {
   int L_TEST_MARKER_##name =                                           \
     ::liong::test::TestRegistry::get_inst().reg(#name, l_test_##name); \
   void l_test_##name()
+// A test that must not run concurrently with any other test.
+#define L_SERIAL_TEST(name)                                          \
+  extern void l_test_##name();                                       \
+  int L_TEST_MARKER_##name =                                         \
+    ::liong::test::TestRegistry::get_inst().reg_serial(              \
+      #name, l_test_##name                                           \
+    );                                                               \
+  void l_test_##name()
@@ -1,14 +1,20 @@
 // # HAL independent utilities
 // @PENGUINLIONG
 #pragma once
+#include <array>
+#include <charconv>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <vector>
 #include <map>
 #include <string>
+#include <string_view>
 #include <sstream>
+#include <type_traits>
 #include <fstream>
 #include <functional>
+#include <future>
 #include <chrono>
 #include <cstring>
 
@@ -20,6 +26,8 @@ namespace util {
 
 bool starts_with(const std::string& start, const std::string& str);
 bool ends_with(const std::string& end, const std::string& str);
+// `*` matches any sequence of characters and `?` matches any single character.
+bool match_wildcard(const std::string& pattern, const std::string& str);
 std::vector<std::string> split(char sep, const std::string& str);
 std::string trim(const std::string& str);
 std::string replace_all(const std::string& str, const std::string& from, const std::string& to);
@@ -27,83 +35,207 @@ std::string replace_all(const std::string& str, const std::string& from, const s
 // The placeholder is in the form of "${name}".
 std::string fill_template(const std::string& templ, const std::map<std::string, std::string>& args);
 
-namespace {
+// - [Formatting] --------------------------------------------------------------
 
-template<typename... TArgs>
-struct format_impl_t;
-template<>
-struct format_impl_t<> {
-  static inline void format_impl(std::stringstream& ss) {}
+namespace detail {
+
+// Thread-local stream reused by types formatted with `operator<<`. Returns
+// `nullptr` if the stream is already in use by an enclosing `operator<<`.
+std::ostringstream* acquire_format_fallback_stream();
+void release_format_fallback_stream();
+
+// Holds the thread-local stream for a scope, so that it's released even if an
+// `operator<<` throws.
+struct FormatFallbackStreamGuard {
+  std::ostringstream* ss;
+
+  FormatFallbackStreamGuard() : ss(acquire_format_fallback_stream()) {}
+  ~FormatFallbackStreamGuard() {
+    if (ss != nullptr) {
+      release_format_fallback_stream();
+    }
+  }
+  FormatFallbackStreamGuard(const FormatFallbackStreamGuard&) = delete;
+  FormatFallbackStreamGuard& operator=(const FormatFallbackStreamGuard&) =
+    delete;
+};
+
+} // namespace detail
+
+// Appends the textual representation of `T` to a string. Numbers are converted
+// with `std::to_chars` and strings are appended directly; other types fall back
+// to `operator<<` on a reused thread-local `std::ostringstream`. Specialize it
+// to support more types:
+//
+// ```cpp
+// template<>
+// struct Formatter<MyType> {
+//   static void format(std::string& out, const MyType& x) { ... }
+// };
+// ```
+template<typename T, typename Enable = void>
+struct Formatter {
+  static void format(std::string& out, const T& x) {
+    detail::FormatFallbackStreamGuard guard {};
+    std::ostringstream* ss = guard.ss;
+    if (ss == nullptr) {
+      std::ostringstream ss2;
+      ss2 << x;
+      out += ss2.str();
+      return;
+    }
+    ss->str(std::string());
+    ss->clear();
+    *ss << x;
+    out += ss->str();
+  }
 };
 template<typename T>
-struct format_impl_t<T> {
-  static inline void format_impl(std::stringstream& ss, const T& x) {
-    ss << x;
+struct Formatter<
+  T,
+  typename std::enable_if<
+    std::is_integral<T>::value && !std::is_same<T, bool>::value &&
+    !std::is_same<T, char>::value && !std::is_same<T, signed char>::value &&
+    !std::is_same<T, unsigned char>::value>::type> {
+  static void format(std::string& out, const T& x) {
+    char buf[24];
+    std::to_chars_result res = std::to_chars(buf, buf + sizeof(buf), x);
+    out.append(buf, res.ptr);
   }
 };
-template<typename T, typename... TArgs>
-struct format_impl_t<T, TArgs...> {
-  static inline void format_impl(
-    std::stringstream& ss,
-    const T& x,
-    const TArgs&... others
-  ) {
-    format_impl_t<T>::format_impl(ss, x);
-    format_impl_t<TArgs...>::format_impl(ss, others...);
+template<typename T>
+struct Formatter<
+  T,
+  typename std::enable_if<std::is_floating_point<T>::value>::type> {
+  static void format(std::string& out, const T& x) {
+    // Same as the default `std::ostream` representation, i.e., `%g`.
+    char buf[32];
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    std::to_chars_result res =
+      std::to_chars(buf, buf + sizeof(buf), x, std::chars_format::general, 6);
+    out.append(buf, res.ptr);
+#else
+    int n = std::snprintf(buf, sizeof(buf), "%g", (double)x);
+    out.append(buf, n);
+#endif
+  }
+};
+template<typename T>
+struct Formatter<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+  static void format(std::string& out, const T& x) {
+    typedef typename std::underlying_type<T>::type underlying_t;
+    Formatter<underlying_t>::format(out, (underlying_t)x);
   }
-  static inline void join_impl(
-    std::stringstream& ss,
-    const std::string& sep,
-    const T& x,
-    const TArgs&... others
-  ) {
-    format_impl_t<T>::format_impl(ss, x);
-    ss << sep;
-    format_impl_t<TArgs...>::format_impl(ss, others...);
+};
+template<>
+struct Formatter<bool> {
+  static void format(std::string& out, bool x) {
+    out.push_back(x ? '1' : '0');
+  }
+};
+template<>
+struct Formatter<char> {
+  static void format(std::string& out, char x) {
+    out.push_back(x);
+  }
+};
+template<>
+struct Formatter<signed char> {
+  static void format(std::string& out, signed char x) {
+    out.push_back((char)x);
+  }
+};
+template<>
+struct Formatter<unsigned char> {
+  static void format(std::string& out, unsigned char x) {
+    out.push_back((char)x);
+  }
+};
+template<>
+struct Formatter<const char*> {
+  static void format(std::string& out, const char* x) {
+    out.append(x != nullptr ? x : "(null)");
+  }
+};
+template<>
+struct Formatter<char*> {
+  static void format(std::string& out, const char* x) {
+    Formatter<const char*>::format(out, x);
+  }
+};
+template<size_t N>
+struct Formatter<char[N]> {
+  static void format(std::string& out, const char (&x)[N]) {
+    out.append(x, strnlen(x, N));
+  }
+};
+template<>
+struct Formatter<std::string> {
+  static void format(std::string& out, const std::string& x) {
+    out.append(x);
+  }
+};
+template<>
+struct Formatter<std::string_view> {
+  static void format(std::string& out, const std::string_view& x) {
+    out.append(x.data(), x.size());
+  }
+};
+template<typename T>
+struct Formatter<T*> {
+  static void format(std::string& out, const T* x) {
+    char buf[24];
+    std::to_chars_result res =
+      std::to_chars(buf, buf + sizeof(buf), (uintptr_t)x, 16);
+    out.append("0x");
+    out.append(buf, res.ptr);
   }
 };
 
-} // namespace
+// Append all arguments to `out`.
+template<typename... TArgs>
+inline void format_to(std::string& out, const TArgs&... args) {
+  (Formatter<TArgs>::format(out, args), ...);
+}
+template<typename... TArgs>
+inline std::string format(const TArgs&... args) {
+  std::string out {};
+  format_to(out, args...);
+  return out;
+}
 
-template<typename T, size_t N>
-std::string join(const std::string& sep, const std::array<T, N>& strs) {
-  std::stringstream ss {};
-  bool first = true;
-  for (const auto& str : strs) {
-    if (first) {
-      first = false;
-    } else {
-      ss << sep;
+template<typename TIter>
+void join_to(std::string& out, const std::string& sep, TIter beg, TIter end) {
+  typedef typename std::decay<decltype(*beg)>::type value_t;
+  for (TIter it = beg; it != end; ++it) {
+    if (it != beg) {
+      out.append(sep);
     }
-    ss << str;
+    Formatter<value_t>::format(out, *it);
   }
-  return ss.str();
+}
+template<typename T, size_t N>
+std::string join(const std::string& sep, const std::array<T, N>& strs) {
+  std::string out {};
+  join_to(out, sep, strs.begin(), strs.end());
+  return out;
 }
 template<typename T>
 std::string join(const std::string& sep, const std::vector<T>& strs) {
-  std::stringstream ss {};
-  bool first = true;
-  for (const auto& str : strs) {
-    if (first) {
-      first = false;
-    } else {
-      ss << sep;
-    }
-    ss << str;
-  }
-  return ss.str();
-}
-template<typename... TArgs>
-inline std::string join(const std::string& sep, const TArgs&... args) {
-  std::stringstream ss {};
-  format_impl_t<TArgs...>::join_impl(ss, sep, args...);
-  return ss.str();
+  std::string out {};
+  join_to(out, sep, strs.begin(), strs.end());
+  return out;
 }
-template<typename... TArgs>
-inline std::string format(const TArgs&... args) {
-  std::stringstream ss {};
-  format_impl_t<TArgs...>::format_impl(ss, args...);
-  return ss.str();
+template<typename T, typename... TArgs>
+inline std::string join(
+  const std::string& sep,
+  const T& first,
+  const TArgs&... others
+) {
+  std::string out {};
+  Formatter<T>::format(out, first);
+  ((out.append(sep), Formatter<TArgs>::format(out, others)), ...);
+  return out;
 }
 
 // - [File I/O] ----------------------------------------------------------------
@@ -113,6 +245,72 @@ extern std::string load_text(const char* path);
 extern void save_file(const char* path, const void* data, size_t size);
 extern void save_text(const char* path, const std::string& txt);
 
+enum MappedFileAccessHint {
+  L_MAPPED_FILE_ACCESS_HINT_NORMAL,
+  // The file is read from the beginning to the end; pages can be read ahead
+  // aggressively and dropped soon after use.
+  L_MAPPED_FILE_ACCESS_HINT_SEQUENTIAL,
+  // The file is read in random order; reading ahead is wasteful.
+  L_MAPPED_FILE_ACCESS_HINT_RANDOM,
+  // The whole file will be needed soon; start loading it in background now.
+  L_MAPPED_FILE_ACCESS_HINT_WILL_NEED,
+};
+
+// Read-only memory-mapped file. File content is paged in on demand so nothing
+// is copied until it's actually accessed.
+struct MappedFile {
+ private:
+  const void* data_;
+  size_t size_;
+#ifdef _WIN32
+  void* file_handle_;
+  void* mapping_handle_;
+#endif // _WIN32
+
+  void unmap();
+
+ public:
+  MappedFile();
+  MappedFile(
+    const char* path,
+    MappedFileAccessHint hint = L_MAPPED_FILE_ACCESS_HINT_NORMAL
+  );
+  MappedFile(const MappedFile&) = delete;
+  MappedFile(MappedFile&& x);
+  ~MappedFile();
+
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile& operator=(MappedFile&& x);
+
+  // Returns false if the file cannot be opened or mapped.
+  static bool try_map(
+    const char* path,
+    MappedFileAccessHint hint,
+    MappedFile& out
+  );
+
+  inline const void* data() const {
+    return data_;
+  }
+  inline size_t size() const {
+    return size_;
+  }
+  inline const char* begin() const {
+    return (const char*)data_;
+  }
+  inline const char* end() const {
+    return (const char*)data_ + size_;
+  }
+};
+
+// Map files in the default thread pool so that opening the files and reading
+// them ahead can overlap with processing of the files already mapped. Nothing
+// is copied. Errors are reported through the futures.
+extern std::vector<std::future<MappedFile>> load_files_async(
+  const std::vector<std::string>& paths,
+  MappedFileAccessHint hint = L_MAPPED_FILE_ACCESS_HINT_WILL_NEED
+);
+
 void save_bmp(const uint32_t* pxs, uint32_t w, uint32_t h, const char* path);
 void save_bmp(const float* pxs, uint32_t w, uint32_t h, const char* path);
 
@@ -182,7 +380,7 @@ std::vector<T> reinterpret_data(const void* data, size_t size) {
 }
 template<typename T, typename U>
 std::vector<U> reinterpret_data(const std::vector<T>& x) {
-  return reinterpret_data<U>(x.data(), x.size());
+  return reinterpret_data<U>(x.data(), x.size() * sizeof(T));
 }
 
 // - [Timing & Temporal Control] -----------------------------------------------
@@ -1,6 +1,7 @@
 #pragma once
 #include "gft/hal/context.hpp"
 #include "gft/vk/vk-instance.hpp"
+#include "gft/cache.hpp"
 #include "gft/pool.hpp"
 #include "gft/vk-sys.hpp"
 
@@ -10,8 +11,8 @@ namespace vk {
 struct VulkanContext;
 typedef std::shared_ptr<VulkanContext> VulkanContextRef;
 
-typedef pool::Pool<SubmitType, sys::CommandPoolRef> CommandPoolPool;
-typedef pool::PoolItem<SubmitType, sys::CommandPoolRef> CommandPoolPoolItem;
+typedef pool::SyncPool<SubmitType, sys::CommandPoolRef> CommandPoolPool;
+typedef CommandPoolPool::Item CommandPoolPoolItem;
 
 struct DescriptorSetKey {
   std::string inner;
@@ -24,22 +25,46 @@ struct DescriptorSetKey {
   ) {
     return a.inner < b.inner;
   }
+  inline friend bool operator==(
+    const DescriptorSetKey& a,
+    const DescriptorSetKey& b
+  ) {
+    return a.inner == b.inner;
+  }
+
+  struct Hash {
+    inline size_t operator()(const DescriptorSetKey& x) const {
+      return std::hash<std::string>()(x.inner);
+    }
+  };
 };
-typedef pool::Pool<DescriptorSetKey, sys::DescriptorSetRef> DescriptorSetPool;
-typedef pool::PoolItem<DescriptorSetKey, sys::DescriptorSetRef>
-  DescriptorSetPoolItem;
+typedef pool::SyncPool<
+  DescriptorSetKey,
+  sys::DescriptorSetRef,
+  DescriptorSetKey::Hash>
+  DescriptorSetPool;
+typedef DescriptorSetPool::Item DescriptorSetPoolItem;
 
-typedef pool::Pool<int, sys::QueryPoolRef> QueryPoolPool;
-typedef pool::PoolItem<int, sys::QueryPoolRef> QueryPoolPoolItem;
+typedef pool::SyncPool<int, sys::QueryPoolRef> QueryPoolPool;
+typedef QueryPoolPool::Item QueryPoolPoolItem;
 
 struct ContextSubmitDetail {
   uint32_t qfam_idx;
   VkQueue queue;
 };
 struct ContextDescriptorSetDetail {
-  std::map<DescriptorSetKey, sys::DescriptorSetLayoutRef> desc_set_layouts;
-  // Descriptor pools to hold references.
-  std::vector<sys::DescriptorPoolRef> desc_pools;
+  // Layouts are small and few; the cache is unbounded and only used for
+  // thread-safe memoization.
+  cache::LruCache<
+    DescriptorSetKey,
+    sys::DescriptorSetLayoutRef,
+    DescriptorSetKey::Hash>
+    desc_set_layouts;
+  // Each descriptor set is allocated from a dedicated descriptor pool. Sets
+  // are freed by destroying their pools when they are evicted from
+  // `desc_set_pool`.
+  std::mutex desc_pools_mutex;
+  std::map<VkDescriptorSet, sys::DescriptorPoolRef> desc_pools;
   DescriptorSetPool desc_set_pool;
 };
 struct VulkanContext : public Context {
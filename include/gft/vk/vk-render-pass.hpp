@@ -23,10 +23,26 @@ struct FramebufferKey {
   ) {
     return a.inner < b.inner;
   }
+  friend inline bool operator==(
+    const FramebufferKey& a,
+    const FramebufferKey& b
+  ) {
+    return a.inner == b.inner;
+  }
+
+  struct Hash {
+    inline size_t operator()(const FramebufferKey& x) const {
+      return std::hash<std::string>()(x.inner);
+    }
+  };
 };
 
-typedef pool::Pool<FramebufferKey, sys::FramebufferRef> FramebufferPool;
-typedef pool::PoolItem<FramebufferKey, sys::FramebufferRef> FramebufferPoolItem;
+typedef pool::SyncPool<
+  FramebufferKey,
+  sys::FramebufferRef,
+  FramebufferKey::Hash>
+  FramebufferPool;
+typedef FramebufferPool::Item FramebufferPoolItem;
 
 struct VulkanRenderPass : public RenderPass {
   VulkanContextRef ctxt;
@@ -1,9 +1,12 @@
 // Uncompressed Zip archive I/O.
 // @PENGUINLIONG
 #pragma once
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 namespace liong {
 namespace zip {
@@ -15,20 +18,84 @@ struct ZipFileRecord {
   uint32_t crc32;
 };
 
+// A node in the path trie. Each node represents a path segment; the root node
+// represents the archive root.
+struct ZipPathTrieNode {
+  // Index to the file record if a record is named after the path to this
+  // node; `-1` otherwise.
+  size_t irecord;
+  // Child path segment -> node index. Directory segments keep the trailing
+  // slash so that files and directories of the same name don't collide.
+  std::map<std::string, size_t> children;
+};
+
+// Lookup structures over `ZipArchive::records`.
+struct ZipArchiveIndex {
+  // Number of records indexed.
+  size_t nrecord = 0;
+  std::unordered_map<std::string, size_t> file_name2irecord;
+  std::vector<ZipPathTrieNode> trie_nodes;
+};
+
+// `ZipArchiveIndex` built on the first lookup rather than when an archive is
+// opened, so that archives only read a few files from don't pay for indexing
+// all their records. Built indices are immutable and shared by copies of the
+// archive, so concurrent lookups only take a lock to fetch the index.
+class ZipArchiveIndexCache {
+  mutable std::mutex mutex_;
+  mutable std::shared_ptr<ZipArchiveIndex> index_;
+
+ public:
+  ZipArchiveIndexCache() = default;
+  ZipArchiveIndexCache(const ZipArchiveIndexCache& b);
+  ZipArchiveIndexCache& operator=(const ZipArchiveIndexCache& b);
+
+  // Index of `records`. It's built if there is none or if the number of
+  // records changed since it was built.
+  std::shared_ptr<const ZipArchiveIndex> get(
+    const std::vector<ZipFileRecord>& records
+  ) const;
+  // Index `records.back()` if the index is up to date with the rest of the
+  // records and isn't shared; drop the index otherwise.
+  void add_last(const std::vector<ZipFileRecord>& records);
+  void invalidate();
+};
+
 struct ZipArchive {
   std::vector<ZipFileRecord> records;
-  std::map<std::string, size_t> file_name2irecord;
 
   static ZipArchive from_bytes(const uint8_t* data, size_t size);
   static ZipArchive from_bytes(const std::vector<uint8_t>& out);
 
-  inline const ZipFileRecord& get_file(const std::string& file_name) const {
-    return records.at(file_name2irecord.at(file_name));
-  }
+  // Throws `std::out_of_range` if there is no such file.
+  const ZipFileRecord& get_file(const std::string& file_name) const;
+  // Returns `nullptr` if there is no such file.
+  const ZipFileRecord* try_get_file(const std::string& file_name) const;
+
+  // List the files and directories directly under `dir` in lexicographical
+  // order. `dir` is a directory path like `textures/`; an empty string lists
+  // the archive root. Directories are returned with a trailing slash.
+  std::vector<std::string> list_dir(const std::string& dir) const;
+  // Find all files whose names match `pattern`, in lexicographical order. `*`
+  // matches any sequence of characters and `?` matches any single character
+  // except `/`. A `**` path segment matches any number of directories, so
+  // `**/*.spv` finds SPIR-V files anywhere in the archive while `*.spv` only
+  // looks at the archive root.
+  std::vector<std::string> glob(const std::string& pattern) const;
 
   // `data` has to be kept alive through out the archive's lifetime.
   void add_file(const std::string& file_name, const void* data, size_t size);
+  // Drop the lookup index so that the next lookup rebuilds it. Call this after
+  // editing `records` directly. Until then, the index is only rebuilt if the
+  // number of records changed, so renamed records are not found by their new
+  // names.
+  void reindex();
   void to_bytes(std::vector<uint8_t>& out) const;
+  // Write the archive to file without flattening it in memory.
+  void to_file(const char* path) const;
+
+ private:
+  ZipArchiveIndexCache index_cache_;
 };
 
 } // namespace zip
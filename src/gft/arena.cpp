@@ -0,0 +1,105 @@
+#include "gft/arena.hpp"
+#include <algorithm>
+#include "gft/assert.hpp"
+
+namespace liong {
+
+namespace arena {
+
+Arena::Arena(size_t block_size) :
+  block_size_(block_size),
+  blocks_(),
+  iblock_(0),
+  offset_(0),
+  nbyte_used_(0),
+  nbyte_peak_(0),
+  nscope_(0) {
+  L_ASSERT(block_size > 0);
+}
+
+void* Arena::alloc_slow(size_t size, size_t align) {
+  L_ASSERT((align & (align - 1)) == 0, "alignment must be a power of two");
+  // The current block is exhausted; count its tail as used so rewinding
+  // restores the counts consistently.
+  if (iblock_ < blocks_.size()) {
+    nbyte_used_ += blocks_[iblock_].size - offset_;
+    ++iblock_;
+  }
+  // Blocks are aligned for `std::max_align_t`; over-aligned requests might
+  // need padding at the beginning.
+  size_t size_needed = size + std::max(align, alignof(std::max_align_t));
+
+  // Skip retained blocks too small for this request rather than dropping
+  // them; they are likely used by smaller allocations in other rounds.
+  while (iblock_ < blocks_.size() && blocks_[iblock_].size < size_needed) {
+    nbyte_used_ += blocks_[iblock_].size;
+    ++iblock_;
+  }
+  if (iblock_ == blocks_.size()) {
+    Block block {};
+    block.size = std::max(block_size_, size_needed);
+    block.data = std::unique_ptr<uint8_t[]>(new uint8_t[block.size]);
+    blocks_.emplace_back(std::move(block));
+  }
+
+  const Block& block = blocks_[iblock_];
+  uintptr_t base = (uintptr_t)block.data.get();
+  uintptr_t beg = (base + align - 1) & ~(uintptr_t)(align - 1);
+  offset_ = (size_t)(beg - base) + size;
+  nbyte_used_ += offset_;
+  nbyte_peak_ = std::max(nbyte_peak_, nbyte_used_);
+  return (void*)beg;
+}
+
+void Arena::release() {
+  reset();
+  blocks_.clear();
+}
+
+void Arena::leave_scope(uint32_t depth) {
+  L_ASSERT(
+    nscope_ == depth + 1,
+    "arena scopes must end in the reverse order they were entered"
+  );
+  nscope_ = depth;
+}
+
+size_t Arena::nbyte_reserved() const {
+  size_t out = 0;
+  for (const auto& block : blocks_) {
+    out += block.size;
+  }
+  return out;
+}
+
+Arena& get_scratch_arena() {
+  thread_local Arena arena;
+  return arena;
+}
+
+FrameArenas::FrameArenas(uint32_t nframe, size_t block_size) :
+  arenas_(),
+  iframe_(0) {
+  L_ASSERT(nframe > 0);
+  arenas_.reserve(nframe);
+  for (uint32_t i = 0; i < nframe; ++i) {
+    arenas_.emplace_back(std::make_unique<Arena>(block_size));
+  }
+}
+
+Arena& FrameArenas::begin_frame() {
+  ++iframe_;
+  Arena& out = get();
+  L_ASSERT(out.nscope() == 0, "cannot reset a frame arena with open scopes");
+  out.reset();
+  return out;
+}
+
+FrameArenas& get_frame_arenas() {
+  thread_local FrameArenas frame_arenas;
+  return frame_arenas;
+}
+
+} // namespace arena
+
+} // namespace liong
@@ -0,0 +1,314 @@
+#include "gft/bench.hpp"
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include "gft/log.hpp"
+#include "gft/stats.hpp"
+#include "gft/util.hpp"
+
+namespace liong {
+
+namespace bench {
+
+namespace detail {
+
+void use_char_pointer(const volatile char*) {}
+
+} // namespace detail
+
+BenchRegistry& BenchRegistry::get_inst() {
+  static std::unique_ptr<BenchRegistry> inner;
+  if (inner == nullptr) {
+    inner = std::make_unique<BenchRegistry>();
+  }
+  return *inner;
+}
+
+int BenchRegistry::reg(
+  const std::string& name,
+  std::function<void(BenchState&)>&& func
+) {
+  benches.emplace(name, Entry { func });
+  return 0;
+}
+
+namespace {
+
+// Calibration stops growing the number of iterations here, so that a body
+// the compiler optimized away can't make it overflow.
+constexpr uint64_t MAX_BENCH_NITER = 1ull << 32;
+
+void run_bench_state(const BenchRegistry::Entry& entry, BenchState& state) {
+  entry.f(state);
+  // A benchmark returning early would otherwise report zero time and never
+  // finish calibrating.
+  if (!state.is_iterated()) {
+    throw std::runtime_error("benchmark state was never iterated");
+  }
+}
+uint64_t run_bench_once(const BenchRegistry::Entry& entry, uint64_t niter) {
+  BenchState state(niter);
+  run_bench_state(entry, state);
+  return state.elapsed_ns();
+}
+
+// Find the number of iterations a sample needs to last at least
+// `min_sample_time_ns`. The benchmark is warmed up in the meantime.
+uint64_t calibrate_niter(
+  const BenchRegistry::Entry& entry,
+  uint64_t min_sample_time_ns,
+  uint64_t warmup_time_ns
+) {
+  uint64_t niter = 1;
+  uint64_t warmup_elapsed_ns = 0;
+  for (;;) {
+    uint64_t elapsed_ns = std::max<uint64_t>(run_bench_once(entry, niter), 1);
+    warmup_elapsed_ns += elapsed_ns;
+    if (elapsed_ns >= min_sample_time_ns || niter >= MAX_BENCH_NITER) {
+      if (warmup_elapsed_ns >= warmup_time_ns) {
+        break;
+      }
+      continue;
+    }
+    // Overshoot a little so the next round is likely to be long enough, but
+    // never grow by more than 10x at a time in case the first iterations
+    // were dominated by cold caches.
+    double scale = 1.2 * min_sample_time_ns / elapsed_ns;
+    scale = std::min(std::max(scale, 2.0), 10.0);
+    niter = std::min(
+      (uint64_t)std::ceil(niter * scale),
+      MAX_BENCH_NITER
+    );
+  }
+  return niter;
+}
+
+// Two-sided 95% critical values of Student's t-distribution, indexed by the
+// degrees of freedom minus one.
+const double T95[] = {
+  12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+  2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+  2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045,
+};
+double get_t95(size_t df) {
+  const size_t n = sizeof(T95) / sizeof(T95[0]);
+  if (df == 0) {
+    return 0.0;
+  }
+  return df <= n ? T95[df - 1] : 1.96;
+}
+
+double get_quantile(const std::vector<double>& sorted, double q) {
+  double pos = q * (sorted.size() - 1);
+  size_t i = (size_t)pos;
+  if (i + 1 >= sorted.size()) {
+    return sorted.back();
+  }
+  double frac = pos - i;
+  return sorted[i] * (1.0 - frac) + sorted[i + 1] * frac;
+}
+
+std::string fmt_time_ns(double ns) {
+  char buf[32];
+  if (ns < 1e3) {
+    std::snprintf(buf, sizeof(buf), "%.2fns", ns);
+  } else if (ns < 1e6) {
+    std::snprintf(buf, sizeof(buf), "%.2fus", ns * 1e-3);
+  } else if (ns < 1e9) {
+    std::snprintf(buf, sizeof(buf), "%.2fms", ns * 1e-6);
+  } else {
+    std::snprintf(buf, sizeof(buf), "%.2fs", ns * 1e-9);
+  }
+  return buf;
+}
+std::string fmt_throughput(double nbyte_per_sec) {
+  char buf[32];
+  if (nbyte_per_sec < 1024.0 * 1024.0) {
+    std::snprintf(buf, sizeof(buf), "%.2fKB/s", nbyte_per_sec / 1024.0);
+  } else if (nbyte_per_sec < 1024.0 * 1024.0 * 1024.0) {
+    std::snprintf(
+      buf, sizeof(buf), "%.2fMB/s", nbyte_per_sec / (1024.0 * 1024.0)
+    );
+  } else {
+    std::snprintf(
+      buf, sizeof(buf), "%.2fGB/s", nbyte_per_sec / (1024.0 * 1024.0 * 1024.0)
+    );
+  }
+  return buf;
+}
+
+BenchResult run_bench(
+  const std::string& name,
+  const BenchRegistry::Entry& entry,
+  const BenchConfig& cfg
+) {
+  uint64_t niter = calibrate_niter(
+    entry, cfg.min_sample_time_us * 1000ull, cfg.warmup_time_us * 1000ull
+  );
+
+  uint32_t nsample = std::max<uint32_t>(cfg.nsample, 1);
+  std::vector<double> samples;
+  samples.reserve(nsample);
+  stats::WelfordStats<double> ns_stats;
+  uint64_t nbyte_per_iter = 0;
+  for (uint32_t i = 0; i < nsample; ++i) {
+    BenchState state(niter);
+    run_bench_state(entry, state);
+    double ns_per_iter = (double)state.elapsed_ns() / niter;
+    samples.emplace_back(ns_per_iter);
+    ns_stats.push(ns_per_iter);
+    nbyte_per_iter = state.nbyte_per_iter();
+  }
+  std::sort(samples.begin(), samples.end());
+
+  BenchResult out {};
+  out.name = name;
+  out.niter = niter;
+  out.nsample = nsample;
+  out.min_ns = samples.front();
+  out.median_ns = get_quantile(samples, 0.5);
+  out.p99_ns = get_quantile(samples, 0.99);
+  out.mean_ns = ns_stats.avg();
+  if (nsample > 1) {
+    // `WelfordStats` reports the population variance; the confidence interval
+    // needs the sample variance.
+    double stddev = std::sqrt(ns_stats.var() * nsample / (nsample - 1));
+    out.ci95_ns = get_t95(nsample - 1) * stddev / std::sqrt((double)nsample);
+  }
+  if (nbyte_per_iter != 0 && out.median_ns > 0.0) {
+    out.nbyte_per_sec = nbyte_per_iter * 1e9 / out.median_ns;
+  }
+  return out;
+}
+
+} // namespace
+
+std::vector<BenchResult> BenchRegistry::run_all(const BenchConfig& cfg) {
+  const auto& benches = get_inst().benches;
+
+  std::vector<const std::pair<const std::string, Entry>*> scheduled;
+  for (const auto& pair : benches) {
+    if (util::match_wildcard(cfg.filter, pair.first)) {
+      scheduled.emplace_back(&pair);
+    }
+  }
+
+  std::vector<BenchResult> out;
+  if (scheduled.empty()) {
+    L_INFO("no benchmark to run");
+    return out;
+  } else {
+    L_INFO("scheduling ", scheduled.size(), " benchmarks");
+  }
+
+  for (const auto* pair : scheduled) {
+    try {
+      BenchResult result = run_bench(pair->first, pair->second, cfg);
+      std::string msg = util::format(
+        "[", result.name, "] median ", fmt_time_ns(result.median_ns),
+        ", min ", fmt_time_ns(result.min_ns),
+        ", p99 ", fmt_time_ns(result.p99_ns),
+        ", mean ", fmt_time_ns(result.mean_ns),
+        " +/- ", fmt_time_ns(result.ci95_ns),
+        " (", result.nsample, " x ", result.niter, " iters)"
+      );
+      if (result.nbyte_per_sec > 0.0) {
+        util::format_to(msg, ", ", fmt_throughput(result.nbyte_per_sec));
+      }
+      L_INFO(msg);
+      out.emplace_back(std::move(result));
+    } catch (const std::exception& e) {
+      L_ERROR("[", pair->first, "] failed: ", e.what());
+    } catch (...) {
+      L_ERROR("[", pair->first, "] failed by an illiterate exception");
+    }
+  }
+  return out;
+}
+
+json::JsonValue results2json(const std::vector<BenchResult>& results) {
+  json::JsonArray benchmarks {};
+  for (const auto& result : results) {
+    json::JsonObject benchmark {};
+    benchmark["name"] = result.name;
+    benchmark["niter"] = result.niter;
+    benchmark["nsample"] = result.nsample;
+    benchmark["min_ns"] = result.min_ns;
+    benchmark["median_ns"] = result.median_ns;
+    benchmark["p99_ns"] = result.p99_ns;
+    benchmark["mean_ns"] = result.mean_ns;
+    benchmark["ci95_ns"] = result.ci95_ns;
+    benchmark["nbyte_per_sec"] = result.nbyte_per_sec;
+    benchmarks.inner.emplace_back(std::move(benchmark));
+  }
+  json::JsonObject out {};
+  out["benchmarks"] = std::move(benchmarks);
+  return out;
+}
+std::vector<BenchResult> json2results(const json::JsonValue& json) {
+  std::vector<BenchResult> out;
+  for (const auto& benchmark : json["benchmarks"].arr) {
+    BenchResult result {};
+    result.name = (const std::string&)benchmark["name"];
+    result.niter = (uint64_t)(double)benchmark["niter"];
+    result.nsample = (uint32_t)(double)benchmark["nsample"];
+    result.min_ns = benchmark["min_ns"];
+    result.median_ns = benchmark["median_ns"];
+    result.p99_ns = benchmark["p99_ns"];
+    result.mean_ns = benchmark["mean_ns"];
+    result.ci95_ns = benchmark["ci95_ns"];
+    result.nbyte_per_sec = benchmark["nbyte_per_sec"];
+    out.emplace_back(std::move(result));
+  }
+  return out;
+}
+
+uint32_t compare_results(
+  const std::vector<BenchResult>& baseline,
+  const std::vector<BenchResult>& results,
+  double tolerance
+) {
+  std::map<std::string, const BenchResult*> name2baseline;
+  for (const auto& result : baseline) {
+    name2baseline[result.name] = &result;
+  }
+
+  uint32_t nregression = 0;
+  for (const auto& result : results) {
+    auto it = name2baseline.find(result.name);
+    if (it == name2baseline.end()) {
+      L_INFO("[", result.name, "] has no baseline");
+      continue;
+    }
+    const BenchResult& base = *it->second;
+    if (base.median_ns <= 0.0) {
+      continue;
+    }
+
+    double change = result.median_ns / base.median_ns - 1.0;
+    char change_lit[32];
+    std::snprintf(change_lit, sizeof(change_lit), "%+.2f%%", change * 100.0);
+    std::string msg = util::format(
+      "[", result.name, "] ", fmt_time_ns(base.median_ns), " -> ",
+      fmt_time_ns(result.median_ns), " (", change_lit, ")"
+    );
+
+    // Noise can easily move the median by a few percents, so only call it a
+    // regression when the confidence intervals don't overlap either.
+    bool is_regression = change > tolerance &&
+      result.mean_ns - result.ci95_ns > base.mean_ns + base.ci95_ns;
+    if (is_regression) {
+      L_WARN(msg, " regressed");
+      ++nregression;
+    } else {
+      L_INFO(msg);
+    }
+  }
+  return nregression;
+}
+
+} // namespace bench
+
+} // namespace liong
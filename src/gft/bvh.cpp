@@ -0,0 +1,745 @@
+#include "gft/bvh.hpp"
+#include <array>
+#include <cmath>
+#include "gft/assert.hpp"
+#include "gft/parallel.hpp"
+#include "gft/profile.hpp"
+
+namespace liong {
+namespace geom {
+
+using namespace glm;
+
+namespace {
+
+constexpr uint32_t MAX_BVH_NBIN = 64;
+// Deeper ranges are split at the median to bound the depth of degenerate
+// inputs; the median split takes at most 32 more levels to reach the leaves.
+constexpr uint32_t MAX_BVH_SAH_DEPTH = MAX_BVH_DEPTH - 33;
+
+inline Aabb make_empty_aabb() {
+  return Aabb {
+    vec3(std::numeric_limits<float>::infinity()),
+    vec3(-std::numeric_limits<float>::infinity()),
+  };
+}
+inline void extend_aabb(Aabb& aabb, const Aabb& other) {
+  aabb.min = glm::min(aabb.min, other.min);
+  aabb.max = glm::max(aabb.max, other.max);
+}
+inline void extend_aabb(Aabb& aabb, const vec3& point) {
+  aabb.min = glm::min(aabb.min, point);
+  aabb.max = glm::max(aabb.max, point);
+}
+// Half of the surface area, which is all the heuristic needs.
+inline float get_half_area(const Aabb& aabb) {
+  vec3 d = aabb.size();
+  return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+struct BvhBin {
+  Aabb aabb;
+  uint32_t nprim;
+};
+
+// Primitives are partitioned by value rather than through indices, so that
+// ranges are scanned sequentially instead of missing the cache on every
+// primitive.
+struct BvhRef {
+  Aabb aabb;
+  uint32_t iprim;
+
+  inline vec3 center() const {
+    return aabb.center();
+  }
+};
+// A range of references with the bounds of the references and of their
+// centers. The bounds of child ranges are gathered while partitioning, so
+// each level of the tree takes only two passes over the references.
+struct BvhRange {
+  uint32_t beg;
+  uint32_t end;
+  Aabb aabb;
+  Aabb center_aabb;
+
+  inline uint32_t nprim() const {
+    return end - beg;
+  }
+};
+
+struct BvhBuilder {
+  const BvhConfig& cfg;
+  std::vector<BvhRef> refs;
+  // Leaves refer to `Bvh::iprims` from this offset on.
+  uint32_t iprim_base;
+
+  // Build over the primitives `iprims` of `aabbs`, or over all `nprim`
+  // primitives if `iprims` is null.
+  BvhBuilder(
+    const BvhConfig& cfg,
+    const Aabb* aabbs,
+    const uint32_t* iprims,
+    size_t nprim,
+    uint32_t iprim_base
+  ) :
+    cfg(cfg),
+    refs(nprim),
+    iprim_base(iprim_base) {
+    parallel::parallel_for(0, nprim, [&](size_t i) {
+      uint32_t iprim = iprims != nullptr ? iprims[i] : (uint32_t)i;
+      refs[i] = BvhRef { aabbs[iprim], iprim };
+    });
+  }
+
+  static inline BvhRange make_empty_range(uint32_t beg) {
+    return BvhRange { beg, beg, make_empty_aabb(), make_empty_aabb() };
+  }
+  BvhRange make_range(uint32_t beg, uint32_t end) const {
+    BvhRange out { beg, end, make_empty_aabb(), make_empty_aabb() };
+    for (uint32_t i = beg; i < end; ++i) {
+      extend_aabb(out.aabb, refs[i].aabb);
+      extend_aabb(out.center_aabb, refs[i].center());
+    }
+    return out;
+  }
+
+  static inline uint32_t get_ibin(
+    float x,
+    float min,
+    float scale,
+    uint32_t nbin
+  ) {
+    return std::min((uint32_t)((x - min) * scale), nbin - 1);
+  }
+
+  // Find the cheapest binned split of `range` and partition it. Returns false
+  // if the range had better be a leaf.
+  bool split_sah(const BvhRange& range, BvhRange& left, BvhRange& right) {
+    uint32_t nprim = range.nprim();
+    if (nprim == 1) {
+      return false;
+    }
+    // Small ranges don't need as many bins, and their cost is dominated by
+    // evaluating the bins.
+    const uint32_t nbin = std::min(cfg.nbin, std::max(nprim, 4u));
+    vec3 extent = range.center_aabb.size();
+
+    std::array<std::array<BvhBin, MAX_BVH_NBIN>, 3> bins;
+    vec3 scale;
+    for (length_t axis = 0; axis < 3; ++axis) {
+      scale[axis] = extent[axis] > 0.0f ? nbin / extent[axis] : 0.0f;
+      for (uint32_t i = 0; i < nbin; ++i) {
+        bins[axis][i] = BvhBin { make_empty_aabb(), 0 };
+      }
+    }
+    for (uint32_t i = range.beg; i < range.end; ++i) {
+      const BvhRef& ref = refs[i];
+      vec3 center = ref.center();
+      for (length_t axis = 0; axis < 3; ++axis) {
+        float min = range.center_aabb.min[axis];
+        uint32_t ibin = get_ibin(center[axis], min, scale[axis], nbin);
+        BvhBin& bin = bins[axis][ibin];
+        extend_aabb(bin.aabb, ref.aabb);
+        bin.nprim += 1;
+      }
+    }
+
+    // Splitting after bin `i` costs the node itself plus the expected cost of
+    // the two halves, weighted by the chance of a ray through the node
+    // hitting each. Flat nodes weigh the halves equally.
+    float area = get_half_area(range.aabb);
+    float inv_area = area > 0.0f ? 1.0f / area : 0.0f;
+    float best_cost = std::numeric_limits<float>::infinity();
+    length_t best_axis = 0;
+    uint32_t best_ibin = 0;
+    for (length_t axis = 0; axis < 3; ++axis) {
+      if (extent[axis] <= 0.0f) {
+        continue;
+      }
+      std::array<float, MAX_BVH_NBIN> right_costs;
+      Aabb right_aabb = make_empty_aabb();
+      uint32_t right_nprim = 0;
+      for (uint32_t i = nbin - 1; i > 0; --i) {
+        const BvhBin& bin = bins[axis][i];
+        extend_aabb(right_aabb, bin.aabb);
+        right_nprim += bin.nprim;
+        right_costs[i - 1] =
+          right_nprim == 0 ? 0.0f : get_half_area(right_aabb) * right_nprim;
+      }
+      Aabb left_aabb = make_empty_aabb();
+      uint32_t left_nprim = 0;
+      for (uint32_t i = 0; i + 1 < nbin; ++i) {
+        const BvhBin& bin = bins[axis][i];
+        extend_aabb(left_aabb, bin.aabb);
+        left_nprim += bin.nprim;
+        if (left_nprim == 0 || left_nprim == nprim) {
+          continue;
+        }
+        float cost = cfg.node_cost +
+          (get_half_area(left_aabb) * left_nprim + right_costs[i]) * inv_area;
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = axis;
+          best_ibin = i;
+        }
+      }
+    }
+
+    if (best_cost == std::numeric_limits<float>::infinity()) {
+      // All centers coincide.
+      if (nprim <= cfg.max_leaf_nprim) {
+        return false;
+      }
+      uint32_t mid = range.beg + nprim / 2;
+      left = make_range(range.beg, mid);
+      right = make_range(mid, range.end);
+      return true;
+    }
+    if (nprim <= cfg.max_leaf_nprim && best_cost >= (float)nprim) {
+      return false;
+    }
+
+    float min = range.center_aabb.min[best_axis];
+    float s = scale[best_axis];
+    left = make_empty_range(range.beg);
+    right = make_empty_range(range.end);
+    while (left.end < right.beg) {
+      BvhRef& ref = refs[left.end];
+      vec3 center = ref.center();
+      if (get_ibin(center[best_axis], min, s, nbin) <= best_ibin) {
+        extend_aabb(left.aabb, ref.aabb);
+        extend_aabb(left.center_aabb, center);
+        ++left.end;
+      } else {
+        --right.beg;
+        std::swap(ref, refs[right.beg]);
+        extend_aabb(right.aabb, refs[right.beg].aabb);
+        extend_aabb(right.center_aabb, center);
+      }
+    }
+    return true;
+  }
+  bool split_median(const BvhRange& range, BvhRange& left, BvhRange& right) {
+    if (range.nprim() <= cfg.max_leaf_nprim) {
+      return false;
+    }
+    vec3 extent = range.center_aabb.size();
+    length_t axis = 0;
+    if (extent.y > extent[axis]) {
+      axis = 1;
+    }
+    if (extent.z > extent[axis]) {
+      axis = 2;
+    }
+    uint32_t mid = range.beg + range.nprim() / 2;
+    std::nth_element(
+      refs.begin() + range.beg,
+      refs.begin() + mid,
+      refs.begin() + range.end,
+      [&](const BvhRef& a, const BvhRef& b) {
+        return a.center()[axis] < b.center()[axis];
+      }
+    );
+    left = make_range(range.beg, mid);
+    right = make_range(mid, range.end);
+    return true;
+  }
+
+  // Build the subtree of `range` at the end of `nodes`. Offsets of inner nodes
+  // are relative to the beginning of `nodes`, so subtrees built in parallel
+  // into separate lists can be spliced afterwards.
+  void build(
+    const BvhRange& range,
+    uint32_t depth,
+    std::vector<BvhNode>& nodes
+  ) {
+    uint32_t inode = (uint32_t)nodes.size();
+    nodes.emplace_back(BvhNode {
+      range.aabb,
+      iprim_base + range.beg,
+      range.nprim(),
+    });
+
+    BvhRange left;
+    BvhRange right;
+    bool is_split = depth < MAX_BVH_SAH_DEPTH ?
+      split_sah(range, left, right) : split_median(range, left, right);
+    if (!is_split) {
+      return;
+    }
+    L_ASSERT(depth + 1 < MAX_BVH_DEPTH);
+    nodes[inode].nprim = 0;
+
+    if (range.nprim() < cfg.min_parallel_nprim) {
+      build(left, depth + 1, nodes);
+      nodes[inode].offset = (uint32_t)nodes.size();
+      build(right, depth + 1, nodes);
+      return;
+    }
+
+    std::vector<BvhNode> left_nodes;
+    std::vector<BvhNode> right_nodes;
+    {
+      parallel::TaskGroup group;
+      group.run([&]() { build(left, depth + 1, left_nodes); });
+      build(right, depth + 1, right_nodes);
+      group.wait();
+    }
+    auto splice = [&](const std::vector<BvhNode>& subtree) {
+      uint32_t base = (uint32_t)nodes.size();
+      for (BvhNode node : subtree) {
+        if (!node.is_leaf()) {
+          node.offset += base;
+        }
+        nodes.emplace_back(node);
+      }
+    };
+    nodes.reserve(nodes.size() + left_nodes.size() + right_nodes.size());
+    splice(left_nodes);
+    nodes[inode].offset = (uint32_t)nodes.size();
+    splice(right_nodes);
+  }
+};
+
+} // namespace
+
+Bvh Bvh::build(const Aabb* aabbs, size_t naabb, const BvhConfig& cfg) {
+  L_PROFILE_SCOPE("geom::Bvh::build");
+  L_ASSERT(naabb <= UINT32_MAX);
+  L_ASSERT(cfg.nbin >= 2 && cfg.nbin <= MAX_BVH_NBIN);
+  Bvh out {};
+  if (naabb == 0) {
+    return out;
+  }
+  BvhBuilder builder(cfg, aabbs, nullptr, naabb, 0);
+  out.nodes.reserve(naabb * 2 / std::max(cfg.max_leaf_nprim, 1u));
+  builder.build(builder.make_range(0, (uint32_t)naabb), 0, out.nodes);
+  out.iprims.resize(naabb);
+  for (size_t i = 0; i < naabb; ++i) {
+    out.iprims[i] = builder.refs[i].iprim;
+  }
+  return out;
+}
+
+Aabb Bvh::aabb() const {
+  return nodes.empty() ? make_empty_aabb() : nodes[0].aabb;
+}
+
+uint32_t Bvh::get_subtree_end(uint32_t inode) const {
+  // The last node of a subtree is its rightmost leaf.
+  while (!nodes[inode].is_leaf()) {
+    inode = nodes[inode].offset;
+  }
+  return inode + 1;
+}
+float Bvh::get_sah_cost(float node_cost, uint32_t inode) const {
+  if (nodes.empty()) {
+    return 0.0f;
+  }
+  uint32_t end = get_subtree_end(inode);
+  float area = get_half_area(nodes[inode].aabb);
+  float inv_area = area > 0.0f ? 1.0f / area : 0.0f;
+  return parallel::parallel_reduce(
+    inode,
+    end,
+    0.0f,
+    [&](size_t beg, size_t end) {
+      float cost = 0.0f;
+      for (size_t i = beg; i < end; ++i) {
+        const BvhNode& node = nodes[i];
+        float n = node.is_leaf() ? (float)node.nprim : node_cost;
+        cost += n * get_half_area(node.aabb);
+      }
+      return cost * inv_area;
+    },
+    [](float a, float b) { return a + b; }
+  );
+}
+
+
+namespace {
+
+// Subtrees of fewer nodes are refit on the calling thread.
+constexpr uint32_t MIN_PARALLEL_REFIT_NNODE = 4096;
+
+inline void refit_node(Bvh& bvh, uint32_t inode, const Aabb* aabbs) {
+  BvhNode& node = bvh.nodes[inode];
+  Aabb aabb = make_empty_aabb();
+  if (node.is_leaf()) {
+    for (uint32_t i = 0; i < node.nprim; ++i) {
+      extend_aabb(aabb, aabbs[bvh.iprims[node.offset + i]]);
+    }
+  } else {
+    extend_aabb(aabb, bvh.nodes[inode + 1].aabb);
+    extend_aabb(aabb, bvh.nodes[node.offset].aabb);
+  }
+  node.aabb = aabb;
+}
+// Refit the subtree occupying nodes `[inode, end)`. Children always follow
+// their parents, so a backward sweep sees the children first.
+void refit_subtree(Bvh& bvh, uint32_t inode, uint32_t end, const Aabb* aabbs) {
+  if (end - inode < MIN_PARALLEL_REFIT_NNODE) {
+    for (uint32_t i = end; i > inode; --i) {
+      refit_node(bvh, i - 1, aabbs);
+    }
+    return;
+  }
+  uint32_t iright = bvh.nodes[inode].offset;
+  {
+    parallel::TaskGroup group;
+    group.run([&]() { refit_subtree(bvh, inode + 1, iright, aabbs); });
+    refit_subtree(bvh, iright, end, aabbs);
+    group.wait();
+  }
+  refit_node(bvh, inode, aabbs);
+}
+
+} // namespace
+
+void Bvh::refit(const Aabb* aabbs) {
+  L_PROFILE_SCOPE("geom::Bvh::refit");
+  if (nodes.empty()) {
+    return;
+  }
+  refit_subtree(*this, 0, (uint32_t)nodes.size(), aabbs);
+}
+void Bvh::rebuild_subtree(
+  uint32_t inode,
+  const Aabb* aabbs,
+  const BvhConfig& cfg
+) {
+  L_PROFILE_SCOPE("geom::Bvh::rebuild_subtree");
+  L_ASSERT(inode < nodes.size());
+  L_ASSERT(cfg.nbin >= 2 && cfg.nbin <= MAX_BVH_NBIN);
+  uint32_t end = get_subtree_end(inode);
+
+  // Walk down from the root for the depth of the subtree.
+  uint32_t depth = 0;
+  for (uint32_t i = 0; i != inode; ++depth) {
+    i = inode < nodes[i].offset ? i + 1 : nodes[i].offset;
+  }
+  // The primitives of a subtree are contiguous too, from its leftmost leaf to
+  // its rightmost one.
+  uint32_t ileftmost = inode;
+  while (!nodes[ileftmost].is_leaf()) {
+    ileftmost += 1;
+  }
+  uint32_t iprim_beg = nodes[ileftmost].offset;
+  uint32_t iprim_end = nodes[end - 1].offset + nodes[end - 1].nprim;
+  uint32_t nprim = iprim_end - iprim_beg;
+
+  BvhBuilder builder(cfg, aabbs, iprims.data() + iprim_beg, nprim, iprim_beg);
+  std::vector<BvhNode> subtree;
+  builder.build(builder.make_range(0, nprim), depth, subtree);
+  for (uint32_t i = 0; i < nprim; ++i) {
+    iprims[iprim_beg + i] = builder.refs[i].iprim;
+  }
+
+  // Splice the new subtree in. Only offsets past the old subtree move; an
+  // offset pointing at `inode` itself stays.
+  uint32_t nnode_old = end - inode;
+  uint32_t nnode_new = (uint32_t)subtree.size();
+  auto shift = [&](BvhNode& node) {
+    if (!node.is_leaf() && node.offset >= end) {
+      node.offset = node.offset - nnode_old + nnode_new;
+    }
+  };
+  for (uint32_t i = 0; i < inode; ++i) {
+    shift(nodes[i]);
+  }
+  for (uint32_t i = end; i < nodes.size(); ++i) {
+    shift(nodes[i]);
+  }
+  for (BvhNode& node : subtree) {
+    if (!node.is_leaf()) {
+      node.offset += inode;
+    }
+  }
+  if (nnode_new > nnode_old) {
+    nodes.insert(
+      nodes.begin() + end,
+      nnode_new - nnode_old,
+      BvhNode {}
+    );
+  } else {
+    nodes.erase(nodes.begin() + inode + nnode_new, nodes.begin() + end);
+  }
+  std::copy(subtree.begin(), subtree.end(), nodes.begin() + inode);
+}
+
+
+namespace {
+
+template<int N>
+struct WideBvhCollapser {
+  const Bvh& bvh;
+  std::vector<WideBvhNode<N>>& nodes;
+
+  // Collapse the binary subtree at `inode` into a wide node and return its
+  // index.
+  uint32_t collapse(uint32_t inode) {
+    // Open the inner child of the largest surface area until the wide node is
+    // full, so that the children of a wide node are similar in size.
+    uint32_t ichildren[N];
+    uint32_t nchild = 0;
+    if (bvh.nodes[inode].is_leaf()) {
+      ichildren[nchild++] = inode;
+    } else {
+      ichildren[nchild++] = inode + 1;
+      ichildren[nchild++] = bvh.nodes[inode].offset;
+    }
+    while (nchild < N) {
+      int iopen = -1;
+      float max_area = -1.0f;
+      for (uint32_t i = 0; i < nchild; ++i) {
+        const BvhNode& child = bvh.nodes[ichildren[i]];
+        float area = get_half_area(child.aabb);
+        if (!child.is_leaf() && area > max_area) {
+          iopen = (int)i;
+          max_area = area;
+        }
+      }
+      if (iopen < 0) {
+        break;
+      }
+      uint32_t iopened = ichildren[iopen];
+      ichildren[iopen] = iopened + 1;
+      ichildren[nchild++] = bvh.nodes[iopened].offset;
+    }
+
+    uint32_t iwide = (uint32_t)nodes.size();
+    nodes.emplace_back();
+    for (uint32_t i = 0; i < N; ++i) {
+      if (i >= nchild) {
+        nodes[iwide].aabbs.clear(i);
+        nodes[iwide].offsets[i] = 0;
+        nodes[iwide].nprims[i] = 0;
+        continue;
+      }
+      const BvhNode& child = bvh.nodes[ichildren[i]];
+      uint32_t offset = child.is_leaf() ? child.offset :
+        collapse(ichildren[i]);
+      // `nodes` might have been reallocated.
+      WideBvhNode<N>& node = nodes[iwide];
+      node.aabbs.set(i, child.aabb);
+      node.offsets[i] = offset;
+      node.nprims[i] = child.nprim;
+    }
+    return iwide;
+  }
+};
+
+} // namespace
+
+template<int N>
+WideBvh<N> WideBvh<N>::from_bvh(const Bvh& bvh) {
+  WideBvh<N> out {};
+  if (bvh.empty()) {
+    return out;
+  }
+  out.nodes.reserve(bvh.nodes.size() / (N - 1) + 1);
+  WideBvhCollapser<N> collapser { bvh, out.nodes };
+  collapser.collapse(0);
+  out.iprims = bvh.iprims;
+  return out;
+}
+template<int N>
+void WideBvh<N>::refit(const Aabb* aabbs) {
+  // Children follow their parents here too. Unused slots are cleared, so
+  // that extending bounds with them changes nothing.
+  for (size_t i = nodes.size(); i > 0; --i) {
+    WideBvhNode<N>& node = nodes[i - 1];
+    for (int j = 0; j < N; ++j) {
+      if (node.nprims[j] == 0 && node.offsets[j] == 0) {
+        continue;
+      }
+      Aabb aabb = make_empty_aabb();
+      if (node.nprims[j] != 0) {
+        for (uint32_t k = 0; k < node.nprims[j]; ++k) {
+          extend_aabb(aabb, aabbs[iprims[node.offsets[j] + k]]);
+        }
+      } else {
+        const WideBvhNode<N>& child = nodes[node.offsets[j]];
+        for (int k = 0; k < N; ++k) {
+          extend_aabb(aabb, child.aabbs.get(k));
+        }
+      }
+      node.aabbs.set(j, aabb);
+    }
+  }
+}
+template struct WideBvh<4>;
+template struct WideBvh<8>;
+
+
+namespace {
+
+// Depth of the subtrees watched for degradation, giving up to 64 of them.
+constexpr uint32_t BVH_TREELET_DEPTH = 6;
+
+// Roots of the inner subtrees at `BVH_TREELET_DEPTH`, in depth-first order.
+// Rebuilding them never changes the nodes above, so the same treelets are
+// found again afterwards.
+void collect_treelet_roots(
+  const Bvh& bvh,
+  uint32_t inode,
+  uint32_t depth,
+  std::vector<uint32_t>& out
+) {
+  const BvhNode& node = bvh.nodes[inode];
+  if (node.is_leaf()) {
+    return;
+  }
+  if (depth == BVH_TREELET_DEPTH) {
+    out.emplace_back(inode);
+    return;
+  }
+  collect_treelet_roots(bvh, inode + 1, depth + 1, out);
+  collect_treelet_roots(bvh, node.offset, depth + 1, out);
+}
+void update_tri_aabbs(
+  const std::vector<Triangle>& tris,
+  std::vector<Aabb>& aabbs
+) {
+  aabbs.resize(tris.size());
+  parallel::parallel_for(0, tris.size(), [&](size_t i) {
+    aabbs[i] = Aabb::from_points(&tris[i].a, 3);
+  });
+}
+
+} // namespace
+
+TriangleBvh TriangleBvh::build(
+  std::vector<Triangle>&& tris,
+  const BvhConfig& cfg
+) {
+  TriangleBvh out {};
+  out.tris = std::move(tris);
+  out.cfg = cfg;
+  update_tri_aabbs(out.tris, out.aabbs);
+  out.bvh = Bvh::build(out.aabbs, cfg);
+  out.wide_bvh = WideBvh<4>::from_bvh(out.bvh);
+  out.build_cost = out.bvh.get_sah_cost(cfg.node_cost);
+  if (!out.bvh.empty()) {
+    std::vector<uint32_t> inodes;
+    collect_treelet_roots(out.bvh, 0, 0, inodes);
+    for (uint32_t inode : inodes) {
+      float cost = out.bvh.get_sah_cost(cfg.node_cost, inode);
+      out.treelets.emplace_back(BvhTreelet { inode, cost });
+    }
+  }
+  return out;
+}
+BvhUpdate TriangleBvh::refit(const std::vector<Triangle>& tris) {
+  L_PROFILE_SCOPE("geom::TriangleBvh::refit");
+  L_ASSERT(tris.size() == this->tris.size(),
+    "refit triangles must be the ones the bvh was built with");
+  this->tris = tris;
+  update_tri_aabbs(this->tris, aabbs);
+  bvh.refit(aabbs);
+
+  if (bvh.get_sah_cost(cfg.node_cost) > build_cost * cfg.max_refit_cost_ratio) {
+    *this = build(std::move(this->tris), cfg);
+    return L_BVH_UPDATE_FULL_REBUILD;
+  }
+
+  // Rebuild backwards, so that the treelets yet to rebuild don't move.
+  bool is_rebuilt = false;
+  for (size_t i = treelets.size(); i > 0; --i) {
+    BvhTreelet& treelet = treelets[i - 1];
+    float cost = bvh.get_sah_cost(cfg.node_cost, treelet.inode);
+    if (cost > treelet.build_cost * cfg.max_refit_subtree_cost_ratio) {
+      bvh.rebuild_subtree(treelet.inode, aabbs.data(), cfg);
+      is_rebuilt = true;
+      // A treelet of few primitives can be rebuilt into a single leaf, which
+      // is no longer a treelet root.
+      if (bvh.nodes[treelet.inode].is_leaf()) {
+        treelets.erase(treelets.begin() + (i - 1));
+        continue;
+      }
+      treelet.build_cost = bvh.get_sah_cost(cfg.node_cost, treelet.inode);
+    }
+  }
+  if (!is_rebuilt) {
+    wide_bvh.refit(aabbs.data());
+    return L_BVH_UPDATE_REFIT;
+  }
+
+  // The bounds above the rebuilt treelets are still fine, but their indices
+  // might have changed. Rebuilding never turns a leaf into an inner node, so
+  // the remaining treelet roots are found in the same order.
+  std::vector<uint32_t> inodes;
+  collect_treelet_roots(bvh, 0, 0, inodes);
+  L_ASSERT(inodes.size() == treelets.size());
+  for (size_t i = 0; i < inodes.size(); ++i) {
+    treelets[i].inode = inodes[i];
+  }
+  wide_bvh = WideBvh<4>::from_bvh(bvh);
+  return L_BVH_UPDATE_PARTIAL_REBUILD;
+}
+
+bool TriangleBvh::raycast(
+  const Ray& ray,
+  BvhRayHit& hit,
+  float t_max
+) const {
+  bool is_hit = false;
+  wide_bvh.traverse_ray(ray, t_max, [&](uint32_t itri, float& t_far) {
+    float t;
+    vec2 bary;
+    if (raycast_tri(ray, tris[itri], t, bary) && t <= t_far) {
+      t_far = t;
+      hit = BvhRayHit { itri, t, bary };
+      is_hit = true;
+    }
+    return false;
+  });
+  return is_hit;
+}
+bool TriangleBvh::raycast_any(const Ray& ray, float t_max) const {
+  bool is_hit = false;
+  wide_bvh.traverse_ray(ray, t_max, [&](uint32_t itri, float& t_far) {
+    float t;
+    vec2 bary;
+    is_hit = raycast_tri(ray, tris[itri], t, bary) && t <= t_far;
+    return is_hit;
+  });
+  return is_hit;
+}
+void TriangleBvh::query_aabb(
+  const Aabb& aabb,
+  std::vector<uint32_t>& itris
+) const {
+  bvh.traverse_aabb(aabb, [&](uint32_t itri) {
+    if (intersect_aabb_tri(tris[itri], aabb)) {
+      itris.emplace_back(itri);
+    }
+    return false;
+  });
+}
+bool TriangleBvh::nearest_point(
+  const vec3& point,
+  BvhPointHit& hit,
+  float max_dist
+) const {
+  bool is_hit = false;
+  float max_dist2 = max_dist * max_dist;
+  bvh.traverse_point(point, max_dist2, [&](uint32_t itri, float& dist2_far) {
+    vec3 nearest = nearest_point_tri(tris[itri], point);
+    vec3 d = nearest - point;
+    float dist2 = glm::dot(d, d);
+    if (dist2 <= dist2_far) {
+      dist2_far = dist2;
+      hit = BvhPointHit { itri, nearest, dist2 };
+      is_hit = true;
+    }
+    return false;
+  });
+  if (is_hit) {
+    hit.dist = std::sqrt(hit.dist);
+  }
+  return is_hit;
+}
+
+} // namespace geom
+} // namespace liong
@@ -0,0 +1,413 @@
+#include "gft/geom-soa.hpp"
+#include <cmath>
+#include "simd.hpp"
+
+namespace liong {
+namespace geom {
+
+namespace {
+
+using namespace simd;
+
+constexpr int W = NATIVE_WIDTH;
+
+inline Float3<W> load_points(const PointSoa& points, size_t i) {
+  return {
+    load<W>(points.xs.data() + i),
+    load<W>(points.ys.data() + i),
+    load<W>(points.zs.data() + i),
+  };
+}
+inline void store_points(PointSoa& points, size_t i, const Float3<W>& x) {
+  store<W>(points.xs.data() + i, x.x);
+  store<W>(points.ys.data() + i, x.y);
+  store<W>(points.zs.data() + i, x.z);
+}
+
+// Extend `[min, max]` with `n` floats.
+void reduce_min_max(const float* x, size_t n, float& min, float& max) {
+  size_t i = 0;
+  if (n >= W) {
+    Float<W> lo = load<W>(x);
+    Float<W> hi = lo;
+    for (i = W; i + W <= n; i += W) {
+      Float<W> v = load<W>(x + i);
+      lo = simd::min(lo, v);
+      hi = simd::max(hi, v);
+    }
+    float los[W];
+    float his[W];
+    store<W>(los, lo);
+    store<W>(his, hi);
+    for (int j = 0; j < W; ++j) {
+      min = std::min(min, los[j]);
+      max = std::max(max, his[j]);
+    }
+  }
+  for (; i < n; ++i) {
+    min = std::min(min, x[i]);
+    max = std::max(max, x[i]);
+  }
+}
+
+// Set the bits of `n` items in `masks`, `W` items at a time with
+// `test_lanes(i)` and the rest with `test(i)`.
+template<typename TLanes, typename T>
+void fill_masks(
+  size_t n,
+  std::vector<uint32_t>& masks,
+  TLanes&& test_lanes,
+  T&& test
+) {
+  static_assert(32 % W == 0, "lanes must not straddle mask words");
+  masks.assign(util::div_up(n, 32), 0);
+  size_t i = 0;
+  for (; i + W <= n; i += W) {
+    masks[i / 32] |= movemask(test_lanes(i)) << (i % 32);
+  }
+  for (; i < n; ++i) {
+    masks[i / 32] |= (test(i) ? 1u : 0u) << (i % 32);
+  }
+}
+
+// Apply the affine part of `trans` to the points in place.
+void trans_points(const glm::mat4& trans, PointSoa& points) {
+  Float3<W> cols[4];
+  for (glm::length_t i = 0; i < 4; ++i) {
+    cols[i] = Float3<W> {
+      set1<W>(trans[i].x),
+      set1<W>(trans[i].y),
+      set1<W>(trans[i].z),
+    };
+  }
+  size_t n = points.size();
+  size_t i = 0;
+  for (; i + W <= n; i += W) {
+    Float3<W> p = load_points(points, i);
+    store_points(points, i, Float3<W> {
+      cols[0].x * p.x + cols[1].x * p.y + cols[2].x * p.z + cols[3].x,
+      cols[0].y * p.x + cols[1].y * p.y + cols[2].y * p.z + cols[3].y,
+      cols[0].z * p.x + cols[1].z * p.y + cols[2].z * p.z + cols[3].z,
+    });
+  }
+  for (; i < n; ++i) {
+    points.set(i, glm::vec3(trans * glm::vec4(points.get(i), 1.0f)));
+  }
+}
+
+inline Aabb make_empty_aabb() {
+  return Aabb {
+    glm::vec3(std::numeric_limits<float>::infinity()),
+    glm::vec3(-std::numeric_limits<float>::infinity()),
+  };
+}
+inline void extend_aabb(Aabb& aabb, const Aabb& other) {
+  aabb.min = glm::min(aabb.min, other.min);
+  aabb.max = glm::max(aabb.max, other.max);
+}
+
+} // namespace
+
+PointSoa PointSoa::from_points(const glm::vec3* points, size_t npoint) {
+  PointSoa out {};
+  out.resize(npoint);
+  for (size_t i = 0; i < npoint; ++i) {
+    out.set(i, points[i]);
+  }
+  return out;
+}
+std::vector<glm::vec3> PointSoa::to_points() const {
+  std::vector<glm::vec3> out(size());
+  for (size_t i = 0; i < out.size(); ++i) {
+    out[i] = get(i);
+  }
+  return out;
+}
+Aabb PointSoa::aabb() const {
+  Aabb out = make_empty_aabb();
+  reduce_min_max(xs.data(), xs.size(), out.min.x, out.max.x);
+  reduce_min_max(ys.data(), ys.size(), out.min.y, out.max.y);
+  reduce_min_max(zs.data(), zs.size(), out.min.z, out.max.z);
+  return out;
+}
+void PointSoa::apply_trans(const glm::mat4& trans) {
+  trans_points(trans, *this);
+}
+
+TriangleSoa TriangleSoa::from_tris(const Triangle* tris, size_t ntri) {
+  TriangleSoa out {};
+  out.as.resize(ntri);
+  out.bs.resize(ntri);
+  out.cs.resize(ntri);
+  for (size_t i = 0; i < ntri; ++i) {
+    out.set(i, tris[i]);
+  }
+  return out;
+}
+Aabb TriangleSoa::aabb() const {
+  Aabb out = as.aabb();
+  extend_aabb(out, bs.aabb());
+  extend_aabb(out, cs.aabb());
+  return out;
+}
+void TriangleSoa::apply_trans(const glm::mat4& trans) {
+  trans_points(trans, as);
+  trans_points(trans, bs);
+  trans_points(trans, cs);
+}
+
+AabbSoa AabbSoa::from_aabbs(const Aabb* aabbs, size_t naabb) {
+  AabbSoa out {};
+  out.mins.resize(naabb);
+  out.maxs.resize(naabb);
+  for (size_t i = 0; i < naabb; ++i) {
+    out.set(i, aabbs[i]);
+  }
+  return out;
+}
+Aabb AabbSoa::aabb() const {
+  Aabb out = make_empty_aabb();
+  extend_aabb(out, mins.aabb());
+  extend_aabb(out, maxs.aabb());
+  return out;
+}
+void AabbSoa::apply_trans(const glm::mat4& trans) {
+  // Arvo's method: the center is transformed as a point and the extents by
+  // the absolute values of the linear part.
+  const Float<W> half_one = set1<W>(0.5f);
+  Float3<W> cols[4];
+  Float3<W> abs_cols[3];
+  for (glm::length_t i = 0; i < 4; ++i) {
+    cols[i] = Float3<W> {
+      set1<W>(trans[i].x),
+      set1<W>(trans[i].y),
+      set1<W>(trans[i].z),
+    };
+    if (i < 3) {
+      abs_cols[i] = Float3<W> {
+        set1<W>(std::abs(trans[i].x)),
+        set1<W>(std::abs(trans[i].y)),
+        set1<W>(std::abs(trans[i].z)),
+      };
+    }
+  }
+  size_t n = size();
+  size_t i = 0;
+  for (; i + W <= n; i += W) {
+    Float3<W> min = load_points(mins, i);
+    Float3<W> max = load_points(maxs, i);
+    Float3<W> c {
+      (min.x + max.x) * half_one,
+      (min.y + max.y) * half_one,
+      (min.z + max.z) * half_one,
+    };
+    Float3<W> h {
+      (max.x - min.x) * half_one,
+      (max.y - min.y) * half_one,
+      (max.z - min.z) * half_one,
+    };
+    Float3<W> c2 {
+      cols[0].x * c.x + cols[1].x * c.y + cols[2].x * c.z + cols[3].x,
+      cols[0].y * c.x + cols[1].y * c.y + cols[2].y * c.z + cols[3].y,
+      cols[0].z * c.x + cols[1].z * c.y + cols[2].z * c.z + cols[3].z,
+    };
+    Float3<W> h2 {
+      abs_cols[0].x * h.x + abs_cols[1].x * h.y + abs_cols[2].x * h.z,
+      abs_cols[0].y * h.x + abs_cols[1].y * h.y + abs_cols[2].y * h.z,
+      abs_cols[0].z * h.x + abs_cols[1].z * h.y + abs_cols[2].z * h.z,
+    };
+    store_points(mins, i, c2 - h2);
+    store_points(maxs, i, Float3<W> {
+      c2.x + h2.x,
+      c2.y + h2.y,
+      c2.z + h2.z,
+    });
+  }
+  for (; i < n; ++i) {
+    Aabb aabb = get(i);
+    glm::vec3 c = glm::vec3(trans * glm::vec4(aabb.center(), 1.0f));
+    glm::vec3 h = aabb.size() * 0.5f;
+    glm::vec3 h2 = glm::abs(glm::vec3(trans[0])) * h.x +
+      glm::abs(glm::vec3(trans[1])) * h.y +
+      glm::abs(glm::vec3(trans[2])) * h.z;
+    set(i, Aabb { c - h2, c + h2 });
+  }
+}
+
+TetrahedronSoa TetrahedronSoa::from_tetras(
+  const Tetrahedron* tets,
+  size_t ntet
+) {
+  TetrahedronSoa out {};
+  out.as.resize(ntet);
+  for (PointSoa& inv_row : out.inv_rows) {
+    inv_row.resize(ntet);
+  }
+  for (size_t i = 0; i < ntet; ++i) {
+    const Tetrahedron& tet = tets[i];
+    glm::vec3 e1 = tet.b - tet.a;
+    glm::vec3 e2 = tet.c - tet.a;
+    glm::vec3 e3 = tet.d - tet.a;
+    // Rows of the inverse are the cross products of the other two columns
+    // over the determinant.
+    glm::vec3 c23 = glm::cross(e2, e3);
+    float det = glm::dot(e1, c23);
+    float inv_det = det != 0.0f ? 1.0f / det :
+      std::numeric_limits<float>::quiet_NaN();
+    out.as.set(i, tet.a);
+    out.inv_rows[0].set(i, c23 * inv_det);
+    out.inv_rows[1].set(i, glm::cross(e3, e1) * inv_det);
+    out.inv_rows[2].set(i, glm::cross(e1, e2) * inv_det);
+  }
+  return out;
+}
+glm::vec4 TetrahedronSoa::get_bary(size_t i, const glm::vec3& point) const {
+  glm::vec3 d = point - as.get(i);
+  float u = glm::dot(inv_rows[0].get(i), d);
+  float v = glm::dot(inv_rows[1].get(i), d);
+  float w = glm::dot(inv_rows[2].get(i), d);
+  return glm::vec4(1.0f - u - v - w, u, v, w);
+}
+
+Aabb get_points_aabb(const glm::vec3* points, size_t npoint) {
+  static_assert(sizeof(glm::vec3) == 3 * sizeof(float),
+    "points must be tightly packed");
+  glm::vec3 min(std::numeric_limits<float>::infinity());
+  glm::vec3 max(-std::numeric_limits<float>::infinity());
+  size_t i = 0;
+  if (npoint >= W) {
+    // `W` points fill three registers, in which lane `j` of register `k`
+    // holds component `(k * W + j) % 3`. So the registers can be reduced as
+    // they are and sorted out by component at the end.
+    const float* x = &points[0].x;
+    Float<W> los[3];
+    Float<W> his[3];
+    for (int k = 0; k < 3; ++k) {
+      los[k] = his[k] = load<W>(x + k * W);
+    }
+    for (i = W; i + W <= npoint; i += W) {
+      const float* p = x + i * 3;
+      for (int k = 0; k < 3; ++k) {
+        Float<W> v = load<W>(p + k * W);
+        los[k] = simd::min(los[k], v);
+        his[k] = simd::max(his[k], v);
+      }
+    }
+    float lo[3 * W];
+    float hi[3 * W];
+    for (int k = 0; k < 3; ++k) {
+      store<W>(lo + k * W, los[k]);
+      store<W>(hi + k * W, his[k]);
+    }
+    for (int j = 0; j < 3 * W; ++j) {
+      min[j % 3] = std::min(min[j % 3], lo[j]);
+      max[j % 3] = std::max(max[j % 3], hi[j]);
+    }
+  }
+  for (; i < npoint; ++i) {
+    min = glm::min(points[i], min);
+    max = glm::max(points[i], max);
+  }
+  return Aabb::from_min_max(min, max);
+}
+
+void contains_point_aabb(
+  const Aabb& aabb,
+  const PointSoa& points,
+  std::vector<uint32_t>& masks
+) {
+  Float3<W> min { set1<W>(aabb.min.x), set1<W>(aabb.min.y),
+    set1<W>(aabb.min.z) };
+  Float3<W> max { set1<W>(aabb.max.x), set1<W>(aabb.max.y),
+    set1<W>(aabb.max.z) };
+  fill_masks(
+    points.size(),
+    masks,
+    [&](size_t i) {
+      Float3<W> p = load_points(points, i);
+      return (min.x <= p.x) & (min.y <= p.y) & (min.z <= p.z) &
+        (p.x <= max.x) & (p.y <= max.y) & (p.z <= max.z);
+    },
+    [&](size_t i) {
+      return contains_point_aabb(aabb, points.get(i));
+    }
+  );
+}
+
+namespace {
+
+// Barycentric containment from an origin vertex and the rows of an inverse
+// edge matrix.
+inline Mask<W> contains_point_tetra_lanes(
+  const Float3<W>& a,
+  const Float3<W>& r0,
+  const Float3<W>& r1,
+  const Float3<W>& r2,
+  const Float3<W>& p
+) {
+  const Float<W> zero = set1<W>(0.0f);
+  const Float<W> one = set1<W>(1.0f);
+  Float3<W> d = p - a;
+  Float<W> u = dot(r0, d);
+  Float<W> v = dot(r1, d);
+  Float<W> w = dot(r2, d);
+  return (u >= zero) & (v >= zero) & (w >= zero) & (one - u - v - w >= zero);
+}
+inline bool contains_point_tetra_bary(const glm::vec4& bary) {
+  return bary.x >= 0.0f && bary.y >= 0.0f && bary.z >= 0.0f &&
+    bary.w >= 0.0f;
+}
+
+} // namespace
+
+void contains_point_tetra(
+  const Tetrahedron& tet,
+  const PointSoa& points,
+  std::vector<uint32_t>& masks
+) {
+  TetrahedronSoa tets = TetrahedronSoa::from_tetras(&tet, 1);
+  auto broadcast = [](const PointSoa& x) {
+    return Float3<W> { set1<W>(x.xs[0]), set1<W>(x.ys[0]), set1<W>(x.zs[0]) };
+  };
+  Float3<W> a = broadcast(tets.as);
+  Float3<W> r0 = broadcast(tets.inv_rows[0]);
+  Float3<W> r1 = broadcast(tets.inv_rows[1]);
+  Float3<W> r2 = broadcast(tets.inv_rows[2]);
+  fill_masks(
+    points.size(),
+    masks,
+    [&](size_t i) {
+      Float3<W> p = load_points(points, i);
+      return contains_point_tetra_lanes(a, r0, r1, r2, p);
+    },
+    [&](size_t i) {
+      return contains_point_tetra_bary(tets.get_bary(0, points.get(i)));
+    }
+  );
+}
+void contains_point_tetra(
+  const TetrahedronSoa& tets,
+  const glm::vec3& point,
+  std::vector<uint32_t>& masks
+) {
+  Float3<W> p { set1<W>(point.x), set1<W>(point.y), set1<W>(point.z) };
+  fill_masks(
+    tets.size(),
+    masks,
+    [&](size_t i) {
+      return contains_point_tetra_lanes(
+        load_points(tets.as, i),
+        load_points(tets.inv_rows[0], i),
+        load_points(tets.inv_rows[1], i),
+        load_points(tets.inv_rows[2], i),
+        p
+      );
+    },
+    [&](size_t i) {
+      return contains_point_tetra_bary(tets.get_bary(i, point));
+    }
+  );
+}
+
+} // namespace geom
+} // namespace liong
@@ -1,17 +1,408 @@
 #include "gft/geom.hpp"
+#include <cmath>
+#include "simd.hpp"
 
 namespace liong {
 namespace geom {
 
 using namespace glm;
 
+bool raycast_tri(
+  const Ray& ray,
+  const Triangle& tri,
+  float& t,
+  vec2& bary
+) {
+  // Moller-Trumbore.
+  vec3 e1 = tri.b - tri.a;
+  vec3 e2 = tri.c - tri.a;
+  vec3 pvec = glm::cross(ray.v, e2);
+  float det = glm::dot(e1, pvec);
+  if (det == 0.0f) {
+    // The ray is parallel to the triangle or the triangle is degenerate.
+    return false;
+  }
+  float inv_det = 1.0f / det;
+  vec3 s = ray.p - tri.a;
+  float u = glm::dot(s, pvec) * inv_det;
+  if (u < 0.0f || u > 1.0f) {
+    return false;
+  }
+  vec3 q = glm::cross(s, e1);
+  float v = glm::dot(ray.v, q) * inv_det;
+  if (v < 0.0f || u + v > 1.0f) {
+    return false;
+  }
+  float t2 = glm::dot(e2, q) * inv_det;
+  if (!(t2 >= 0.0f)) {
+    return false;
+  }
+  t = t2;
+  bary = vec2(u, v);
+  return true;
+}
+bool raycast_aabb(const Ray& ray, const Aabb& aabb, float& t) {
+  // Slab test.
+  float t_near = 0.0f;
+  float t_far = std::numeric_limits<float>::infinity();
+  for (length_t i = 0; i < 3; ++i) {
+    if (aabb.min[i] > aabb.max[i]) {
+      return false;
+    }
+    if (ray.v[i] == 0.0f) {
+      if (ray.p[i] < aabb.min[i] || ray.p[i] > aabb.max[i]) {
+        return false;
+      }
+      continue;
+    }
+    float inv_v = 1.0f / ray.v[i];
+    float t1 = (aabb.min[i] - ray.p[i]) * inv_v;
+    float t2 = (aabb.max[i] - ray.p[i]) * inv_v;
+    t_near = std::max(t_near, std::min(t1, t2));
+    t_far = std::min(t_far, std::max(t1, t2));
+  }
+  if (t_near > t_far) {
+    return false;
+  }
+  t = t_near;
+  return true;
+}
+bool raycast_sphere(const Ray& ray, const Sphere& sphere, float& t) {
+  vec3 oc = ray.p - sphere.p;
+  float c = glm::dot(oc, oc) - sphere.r * sphere.r;
+  if (c <= 0.0f) {
+    t = 0.0f;
+    return true;
+  }
+  float a = glm::dot(ray.v, ray.v);
+  float b = glm::dot(oc, ray.v);
+  // Starting outside, so the sphere is behind if the ray is moving away.
+  if (a == 0.0f || b >= 0.0f) {
+    return false;
+  }
+  float disc = b * b - a * c;
+  if (disc < 0.0f) {
+    return false;
+  }
+  t = (-b - std::sqrt(disc)) / a;
+  return true;
+}
+bool raycast_tet(const Ray& ray, const Tetrahedron& tet, float& t) {
+  // Clip the ray by the four face planes, as the slab test does for boxes.
+  const vec3* verts[4] { &tet.a, &tet.b, &tet.c, &tet.d };
+  float t_near = 0.0f;
+  float t_far = std::numeric_limits<float>::infinity();
+  for (int i = 0; i < 4; ++i) {
+    const vec3& o = *verts[i];
+    const vec3& p0 = *verts[(i + 1) % 4];
+    const vec3& p1 = *verts[(i + 2) % 4];
+    const vec3& p2 = *verts[(i + 3) % 4];
+    vec3 n = glm::cross(p1 - p0, p2 - p0);
+    if (glm::dot(n, o - p0) > 0.0f) {
+      // Point outwards, away from the opposite vertex.
+      n = -n;
+    }
+    float dist = glm::dot(n, ray.p - p0);
+    float denom = glm::dot(n, ray.v);
+    if (denom == 0.0f) {
+      if (dist > 0.0f) {
+        return false;
+      }
+      continue;
+    }
+    float t2 = -dist / denom;
+    if (denom < 0.0f) {
+      t_near = std::max(t_near, t2);
+    } else {
+      t_far = std::min(t_far, t2);
+    }
+  }
+  if (t_near > t_far) {
+    return false;
+  }
+  t = t_near;
+  return true;
+}
+
+namespace {
+
+using namespace simd;
+
+// Lanes broadcast from scalars or loaded from SoA arrays.
+template<int N>
+inline Float3<N> set1_vec3(const vec3& x) {
+  return { set1<N>(x.x), set1<N>(x.y), set1<N>(x.z) };
+}
+template<int N>
+inline Float3<N> load_vec3(const float* x, const float* y, const float* z) {
+  return { load<N>(x), load<N>(y), load<N>(z) };
+}
+
+template<int N>
+uint32_t raycast_tri_packet(
+  const Float3<N>& p,
+  const Float3<N>& v,
+  const Float3<N>& a,
+  const Float3<N>& b,
+  const Float3<N>& c,
+  const Float<N>& t_max,
+  RayHitPacket<N>& hits
+) {
+  const Float<N> zero = set1<N>(0.0f);
+  const Float<N> one = set1<N>(1.0f);
+
+  Float3<N> e1 = b - a;
+  Float3<N> e2 = c - a;
+  Float3<N> pvec = cross(v, e2);
+  Float<N> det = dot(e1, pvec);
+  Float<N> inv_det = one / det;
+  Float3<N> s = p - a;
+  Float<N> u = dot(s, pvec) * inv_det;
+  Float3<N> q = cross(s, e1);
+  Float<N> w = dot(v, q) * inv_det;
+  Float<N> t = dot(e2, q) * inv_det;
+
+  // Lanes of zero determinant have NaNs or infinities here, which fail the
+  // comparisons below.
+  Mask<N> mask = ((det < zero) | (det > zero)) & (u >= zero) & (w >= zero) &
+    (u + w <= one) & (t >= zero) & (t <= t_max);
+  store<N>(hits.t, t);
+  store<N>(hits.u, u);
+  store<N>(hits.v, w);
+  return movemask(mask);
+}
+
+// Narrow `[t_near, t_far]` down to the slab between `t1` and `t2`. A ray
+// parallel to the slab and starting on its boundary gives `0 * inf`, i.e.,
+// NaN; such a ray never leaves the slab so the axis doesn't clip it.
+template<int N>
+inline void clip_slab(
+  const Float<N>& t1,
+  const Float<N>& t2,
+  Float<N>& t_near,
+  Float<N>& t_far
+) {
+  Mask<N> is_ordered = (t1 == t1) & (t2 == t2);
+  t_near = select(is_ordered, simd::max(t_near, simd::min(t1, t2)), t_near);
+  t_far = select(is_ordered, simd::min(t_far, simd::max(t1, t2)), t_far);
+}
+
+template<int N>
+uint32_t raycast_aabb_packet(
+  const Float3<N>& p,
+  const Float3<N>& inv_v,
+  const Float3<N>& min,
+  const Float3<N>& max,
+  const Float<N>& t_max,
+  RayHitPacket<N>& hits
+) {
+  Float<N> t_near = set1<N>(0.0f);
+  Float<N> t_far = t_max;
+  clip_slab((min.x - p.x) * inv_v.x, (max.x - p.x) * inv_v.x, t_near, t_far);
+  clip_slab((min.y - p.y) * inv_v.y, (max.y - p.y) * inv_v.y, t_near, t_far);
+  clip_slab((min.z - p.z) * inv_v.z, (max.z - p.z) * inv_v.z, t_near, t_far);
+
+  // Empty boxes, e.g., cleared lanes, would pass the slab test with their
+  // bounds swapped.
+  Mask<N> mask = (t_near <= t_far) & (min.x <= max.x) & (min.y <= max.y) &
+    (min.z <= max.z);
+  store<N>(hits.t, t_near);
+  return movemask(mask);
+}
+
+template<int N>
+inline Float3<N> load_ray_p(const RayPacket<N>& rays) {
+  return load_vec3<N>(rays.px, rays.py, rays.pz);
+}
+template<int N>
+inline Float3<N> load_ray_v(const RayPacket<N>& rays) {
+  return load_vec3<N>(rays.vx, rays.vy, rays.vz);
+}
+
+template<int N>
+uint32_t raycast_tri_rays(
+  const RayPacket<N>& rays,
+  const Triangle& tri,
+  RayHitPacket<N>& hits,
+  float t_max
+) {
+  return raycast_tri_packet<N>(
+    load_ray_p(rays),
+    load_ray_v(rays),
+    set1_vec3<N>(tri.a),
+    set1_vec3<N>(tri.b),
+    set1_vec3<N>(tri.c),
+    set1<N>(t_max),
+    hits
+  );
+}
+template<int N>
+uint32_t raycast_tri_prims(
+  const Ray& ray,
+  const TrianglePacket<N>& tris,
+  RayHitPacket<N>& hits,
+  float t_max
+) {
+  return raycast_tri_packet<N>(
+    set1_vec3<N>(ray.p),
+    set1_vec3<N>(ray.v),
+    load_vec3<N>(tris.ax, tris.ay, tris.az),
+    load_vec3<N>(tris.bx, tris.by, tris.bz),
+    load_vec3<N>(tris.cx, tris.cy, tris.cz),
+    set1<N>(t_max),
+    hits
+  );
+}
+template<int N>
+uint32_t raycast_aabb_rays(
+  const RayPacket<N>& rays,
+  const Aabb& aabb,
+  RayHitPacket<N>& hits,
+  float t_max
+) {
+  const Float<N> one = set1<N>(1.0f);
+  Float3<N> v = load_ray_v(rays);
+  Float3<N> inv_v = { one / v.x, one / v.y, one / v.z };
+  return raycast_aabb_packet<N>(
+    load_ray_p(rays),
+    inv_v,
+    set1_vec3<N>(aabb.min),
+    set1_vec3<N>(aabb.max),
+    set1<N>(t_max),
+    hits
+  );
+}
+template<int N>
+uint32_t raycast_aabb_prims(
+  const Ray& ray,
+  const AabbPacket<N>& aabbs,
+  RayHitPacket<N>& hits,
+  float t_max
+) {
+  return raycast_aabb_packet<N>(
+    set1_vec3<N>(ray.p),
+    set1_vec3<N>(1.0f / ray.v),
+    load_vec3<N>(aabbs.min_x, aabbs.min_y, aabbs.min_z),
+    load_vec3<N>(aabbs.max_x, aabbs.max_y, aabbs.max_z),
+    set1<N>(t_max),
+    hits
+  );
+}
+
+} // namespace
+
+uint32_t raycast_tri(
+  const RayPacket<4>& rays,
+  const Triangle& tri,
+  RayHitPacket<4>& hits,
+  float t_max
+) {
+  return raycast_tri_rays<4>(rays, tri, hits, t_max);
+}
+uint32_t raycast_tri(
+  const RayPacket<8>& rays,
+  const Triangle& tri,
+  RayHitPacket<8>& hits,
+  float t_max
+) {
+  return raycast_tri_rays<8>(rays, tri, hits, t_max);
+}
+uint32_t raycast_tri(
+  const Ray& ray,
+  const TrianglePacket<4>& tris,
+  RayHitPacket<4>& hits,
+  float t_max
+) {
+  return raycast_tri_prims<4>(ray, tris, hits, t_max);
+}
+uint32_t raycast_tri(
+  const Ray& ray,
+  const TrianglePacket<8>& tris,
+  RayHitPacket<8>& hits,
+  float t_max
+) {
+  return raycast_tri_prims<8>(ray, tris, hits, t_max);
+}
+uint32_t raycast_aabb(
+  const RayPacket<4>& rays,
+  const Aabb& aabb,
+  RayHitPacket<4>& hits,
+  float t_max
+) {
+  return raycast_aabb_rays<4>(rays, aabb, hits, t_max);
+}
+uint32_t raycast_aabb(
+  const RayPacket<8>& rays,
+  const Aabb& aabb,
+  RayHitPacket<8>& hits,
+  float t_max
+) {
+  return raycast_aabb_rays<8>(rays, aabb, hits, t_max);
+}
+uint32_t raycast_aabb(
+  const Ray& ray,
+  const AabbPacket<4>& aabbs,
+  RayHitPacket<4>& hits,
+  float t_max
+) {
+  return raycast_aabb_prims<4>(ray, aabbs, hits, t_max);
+}
+uint32_t raycast_aabb(
+  const Ray& ray,
+  const AabbPacket<8>& aabbs,
+  RayHitPacket<8>& hits,
+  float t_max
+) {
+  return raycast_aabb_prims<8>(ray, aabbs, hits, t_max);
+}
+
+vec3 nearest_point_tri(const Triangle& tri, const vec3& point) {
+  // Find the Voronoi region of the triangle features `point` is in.
+  vec3 ab = tri.b - tri.a;
+  vec3 ac = tri.c - tri.a;
+  vec3 ap = point - tri.a;
+  float d1 = glm::dot(ab, ap);
+  float d2 = glm::dot(ac, ap);
+  if (d1 <= 0.0f && d2 <= 0.0f) {
+    return tri.a;
+  }
+  vec3 bp = point - tri.b;
+  float d3 = glm::dot(ab, bp);
+  float d4 = glm::dot(ac, bp);
+  if (d3 >= 0.0f && d4 <= d3) {
+    return tri.b;
+  }
+  float vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+    return tri.a + ab * (d1 / (d1 - d3));
+  }
+  vec3 cp = point - tri.c;
+  float d5 = glm::dot(ab, cp);
+  float d6 = glm::dot(ac, cp);
+  if (d6 >= 0.0f && d5 <= d6) {
+    return tri.c;
+  }
+  float vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+    return tri.a + ac * (d2 / (d2 - d6));
+  }
+  float va = d3 * d6 - d5 * d4;
+  if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+    return tri.b + (tri.c - tri.b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+  }
+  // Inside the face.
+  float denom = 1.0f / (va + vb + vc);
+  return tri.a + ab * (vb * denom) + ac * (vc * denom);
+}
+
 bool contains_point_aabb(const Aabb& aabb, const vec3& point) {
   return aabb.min.x <= point.x && aabb.min.y <= point.y &&
          aabb.min.z <= point.z && aabb.max.x >= point.x &&
          aabb.max.y >= point.y && aabb.max.z >= point.z;
 }
 bool contains_point_sphere(const Sphere& sphere, const vec3& point) {
-  return (point - sphere.p).length() <= sphere.r;
+  vec3 d = point - sphere.p;
+  return glm::dot(d, d) <= sphere.r * sphere.r;
 }
 bool contains_point_tetra(
   const Tetrahedron& tetra,
@@ -41,9 +432,356 @@ bool contains_point_tetra(
 }
 
 bool intersect_aabb(const Aabb& aabb1, const Aabb& aabb2) {
-  return aabb1.min.x <= aabb2.max.x || aabb1.min.y <= aabb2.max.y ||
-         aabb1.min.z <= aabb2.max.z || aabb1.max.x >= aabb2.min.x ||
-         aabb1.max.y >= aabb2.min.y || aabb1.max.z >= aabb2.min.z;
+  return aabb1.min.x <= aabb2.max.x && aabb1.min.y <= aabb2.max.y &&
+         aabb1.min.z <= aabb2.max.z && aabb1.max.x >= aabb2.min.x &&
+         aabb1.max.y >= aabb2.min.y && aabb1.max.z >= aabb2.min.z;
+}
+bool intersect_aabb_tri(const Triangle& tri, const Aabb& aabb) {
+  // Separating axis test (Akenine-Moller): the box face normals, the
+  // triangle normal and the cross products of their edges. The box faces
+  // amount to a test against the bounds of the triangle, which rejects the
+  // most and goes first.
+  if (!intersect_aabb(Aabb::from_points(&tri.a, 3), aabb)) {
+    return false;
+  }
+  vec3 center = aabb.center();
+  vec3 half = aabb.size() * 0.5f;
+  vec3 v0 = tri.a - center;
+  vec3 v1 = tri.b - center;
+  vec3 v2 = tri.c - center;
+  auto is_separated = [&](const vec3& axis) {
+    float p0 = glm::dot(v0, axis);
+    float p1 = glm::dot(v1, axis);
+    float p2 = glm::dot(v2, axis);
+    float r = glm::dot(half, glm::abs(axis));
+    return std::min(std::min(p0, p1), p2) > r ||
+      std::max(std::max(p0, p1), p2) < -r;
+  };
+
+  vec3 f0 = v1 - v0;
+  vec3 f1 = v2 - v1;
+  vec3 f2 = v0 - v2;
+  if (is_separated(glm::cross(f0, f1))) {
+    return false;
+  }
+  for (const vec3& f : { f0, f1, f2 }) {
+    // Cross products with the X, Y and Z axes.
+    if (is_separated(vec3(0.0f, -f.z, f.y)) ||
+      is_separated(vec3(f.z, 0.0f, -f.x)) ||
+      is_separated(vec3(-f.y, f.x, 0.0f))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+namespace {
+
+// Signed distances to a triangle plane are snapped to zero within this
+// fraction of the magnitude of the inputs, so that the rounding errors of
+// (nearly) coplanar triangles don't decide the outcome.
+constexpr float TRI_PLANE_EPS = 1e-6f;
+
+inline float get_max_abs(const Triangle& tri) {
+  vec3 m = glm::max(glm::max(glm::abs(tri.a), glm::abs(tri.b)),
+    glm::abs(tri.c));
+  return std::max(std::max(m.x, m.y), m.z);
+}
+// Signed distances of `tri` to the plane through `o` of normal `n`, scaled
+// by the length of `n`. Returns false if `tri` is strictly on one side.
+inline bool get_tri_plane_dists(
+  const Triangle& tri,
+  const vec3& o,
+  const vec3& n,
+  float eps,
+  float (&d)[3]
+) {
+  d[0] = glm::dot(n, tri.a - o);
+  d[1] = glm::dot(n, tri.b - o);
+  d[2] = glm::dot(n, tri.c - o);
+  for (float& x : d) {
+    x = std::abs(x) <= eps ? 0.0f : x;
+  }
+  return !(d[0] > 0.0f && d[1] > 0.0f && d[2] > 0.0f) &&
+    !(d[0] < 0.0f && d[1] < 0.0f && d[2] < 0.0f);
+}
+// Interval of the intersection line a triangle straddling the plane of the
+// other covers. `p` are the projections of the vertices onto the line and
+// `d` their distances to the plane.
+inline void get_tri_line_interval(
+  const float (&p)[3],
+  const float (&d)[3],
+  float& t0,
+  float& t1
+) {
+  // Find the vertex alone on its side of the plane.
+  int i;
+  if (d[0] * d[1] > 0.0f) {
+    i = 2;
+  } else if (d[0] * d[2] > 0.0f) {
+    i = 1;
+  } else if (d[1] * d[2] > 0.0f || d[0] != 0.0f) {
+    i = 0;
+  } else if (d[1] != 0.0f) {
+    i = 1;
+  } else {
+    i = 2;
+  }
+  int j = (i + 1) % 3;
+  int k = (i + 2) % 3;
+  t0 = p[i] + (p[j] - p[i]) * d[i] / (d[i] - d[j]);
+  t1 = p[i] + (p[k] - p[i]) * d[i] / (d[i] - d[k]);
+  if (t0 > t1) {
+    std::swap(t0, t1);
+  }
+}
+// Coplanar triangles projected onto the axis-aligned plane most parallel to
+// theirs. Convex polygons are disjoint iff an edge normal separates them.
+bool intersect_tri_coplanar(
+  const Triangle& tri1,
+  const Triangle& tri2,
+  const vec3& n
+) {
+  vec3 an = glm::abs(n);
+  length_t axis = an.x >= an.y && an.x >= an.z ? 0 : an.y >= an.z ? 1 : 2;
+  length_t i0 = (axis + 1) % 3;
+  length_t i1 = (axis + 2) % 3;
+  vec2 p[3] {
+    { tri1.a[i0], tri1.a[i1] },
+    { tri1.b[i0], tri1.b[i1] },
+    { tri1.c[i0], tri1.c[i1] },
+  };
+  vec2 q[3] {
+    { tri2.a[i0], tri2.a[i1] },
+    { tri2.b[i0], tri2.b[i1] },
+    { tri2.c[i0], tri2.c[i1] },
+  };
+  auto is_separated = [](const vec2 (&p)[3], const vec2 (&q)[3]) {
+    for (int i = 0; i < 3; ++i) {
+      vec2 e = p[(i + 1) % 3] - p[i];
+      vec2 axis(-e.y, e.x);
+      float p0 = glm::dot(p[0], axis);
+      float p1 = glm::dot(p[1], axis);
+      float p2 = glm::dot(p[2], axis);
+      float q0 = glm::dot(q[0], axis);
+      float q1 = glm::dot(q[1], axis);
+      float q2 = glm::dot(q[2], axis);
+      if (std::max(std::max(p0, p1), p2) < std::min(std::min(q0, q1), q2) ||
+        std::max(std::max(q0, q1), q2) < std::min(std::min(p0, p1), p2)) {
+        return true;
+      }
+    }
+    return false;
+  };
+  return !is_separated(p, q) && !is_separated(q, p);
+}
+
+} // namespace
+
+bool intersect_tri(const Triangle& tri1, const Triangle& tri2) {
+  // Moller's interval overlap test: triangles straddling each other's
+  // planes intersect iff their intervals on the intersection line of the
+  // planes overlap.
+  float scale = std::max(get_max_abs(tri1), get_max_abs(tri2));
+  vec3 n2 = glm::cross(tri2.b - tri2.a, tri2.c - tri2.a);
+  float n2_len = std::sqrt(glm::dot(n2, n2));
+  float d1[3];
+  if (n2_len == 0.0f ||
+    !get_tri_plane_dists(tri1, tri2.a, n2, TRI_PLANE_EPS * n2_len * scale,
+      d1)) {
+    return false;
+  }
+  vec3 n1 = glm::cross(tri1.b - tri1.a, tri1.c - tri1.a);
+  float n1_len = std::sqrt(glm::dot(n1, n1));
+  float d2[3];
+  if (n1_len == 0.0f ||
+    !get_tri_plane_dists(tri2, tri1.a, n1, TRI_PLANE_EPS * n1_len * scale,
+      d2)) {
+    return false;
+  }
+  if ((d1[0] == 0.0f && d1[1] == 0.0f && d1[2] == 0.0f) ||
+    (d2[0] == 0.0f && d2[1] == 0.0f && d2[2] == 0.0f)) {
+    return intersect_tri_coplanar(tri1, tri2, n1);
+  }
+
+  // Project onto the axis the line is most parallel to, which orders the
+  // points on the line the same way.
+  vec3 dir = glm::abs(glm::cross(n1, n2));
+  length_t axis = dir.x >= dir.y && dir.x >= dir.z ? 0 :
+    dir.y >= dir.z ? 1 : 2;
+  float p1[3] { tri1.a[axis], tri1.b[axis], tri1.c[axis] };
+  float p2[3] { tri2.a[axis], tri2.b[axis], tri2.c[axis] };
+  float t10, t11;
+  float t20, t21;
+  get_tri_line_interval(p1, d1, t10, t11);
+  get_tri_line_interval(p2, d2, t20, t21);
+  return t10 <= t21 && t20 <= t11;
+}
+
+namespace {
+
+template<int N>
+inline Float<N> min3(const Float<N>& a, const Float<N>& b, const Float<N>& c) {
+  return simd::min(simd::min(a, b), c);
+}
+template<int N>
+inline Float<N> max3(const Float<N>& a, const Float<N>& b, const Float<N>& c) {
+  return simd::max(simd::max(a, b), c);
+}
+
+// Same as the scalar `intersect_aabb_tri`, in `N` lanes. Lanes with NaNs,
+// like cleared ones, fail.
+template<int N>
+uint32_t intersect_aabb_tri_packet(
+  const Float3<N>& a,
+  const Float3<N>& b,
+  const Float3<N>& c,
+  const Float3<N>& min,
+  const Float3<N>& max
+) {
+  const Float<N> zero = set1<N>(0.0f);
+  const Float<N> half_one = set1<N>(0.5f);
+  Float3<N> center {
+    (min.x + max.x) * half_one,
+    (min.y + max.y) * half_one,
+    (min.z + max.z) * half_one,
+  };
+  Float3<N> half {
+    (max.x - min.x) * half_one,
+    (max.y - min.y) * half_one,
+    (max.z - min.z) * half_one,
+  };
+  Float3<N> v0 = a - center;
+  Float3<N> v1 = b - center;
+  Float3<N> v2 = c - center;
+  auto overlaps = [&](const Float3<N>& axis) {
+    Float<N> p0 = dot(v0, axis);
+    Float<N> p1 = dot(v1, axis);
+    Float<N> p2 = dot(v2, axis);
+    Float<N> r = half.x * simd::abs(axis.x) + half.y * simd::abs(axis.y) +
+      half.z * simd::abs(axis.z);
+    return (min3(p0, p1, p2) <= r) & (max3(p0, p1, p2) >= zero - r);
+  };
+
+  // Box faces. Cleared lanes have infinite bounds, hence NaN centers, and
+  // fail here.
+  Mask<N> mask = overlaps(Float3<N> { set1<N>(1.0f), zero, zero }) &
+    overlaps(Float3<N> { zero, set1<N>(1.0f), zero }) &
+    overlaps(Float3<N> { zero, zero, set1<N>(1.0f) });
+  Float3<N> f0 = v1 - v0;
+  Float3<N> f1 = v2 - v1;
+  Float3<N> f2 = v0 - v2;
+  mask = mask & overlaps(cross(f0, f1));
+  for (const Float3<N>& f : { f0, f1, f2 }) {
+    mask = mask & overlaps(Float3<N> { zero, zero - f.z, f.y }) &
+      overlaps(Float3<N> { f.z, zero, zero - f.x }) &
+      overlaps(Float3<N> { zero - f.y, f.x, zero });
+  }
+  return movemask(mask);
+}
+
+template<int N>
+uint32_t intersect_aabb_tri_tris(
+  const TrianglePacket<N>& tris,
+  const Aabb& aabb
+) {
+  return intersect_aabb_tri_packet<N>(
+    load_vec3<N>(tris.ax, tris.ay, tris.az),
+    load_vec3<N>(tris.bx, tris.by, tris.bz),
+    load_vec3<N>(tris.cx, tris.cy, tris.cz),
+    set1_vec3<N>(aabb.min),
+    set1_vec3<N>(aabb.max)
+  );
+}
+template<int N>
+uint32_t intersect_aabb_tri_aabbs(
+  const Triangle& tri,
+  const AabbPacket<N>& aabbs
+) {
+  return intersect_aabb_tri_packet<N>(
+    set1_vec3<N>(tri.a),
+    set1_vec3<N>(tri.b),
+    set1_vec3<N>(tri.c),
+    load_vec3<N>(aabbs.min_x, aabbs.min_y, aabbs.min_z),
+    load_vec3<N>(aabbs.max_x, aabbs.max_y, aabbs.max_z)
+  );
+}
+
+// Reject the lanes strictly on one side of the plane of the other triangle
+// in SIMD, and run the scalar test on the rest, which are usually few. The
+// rejection uses twice the snapping distance of the scalar test so that the
+// two never disagree.
+template<int N>
+uint32_t intersect_tri_tris(
+  const Triangle& tri,
+  const TrianglePacket<N>& tris
+) {
+  Float3<N> a = load_vec3<N>(tris.ax, tris.ay, tris.az);
+  Float3<N> b = load_vec3<N>(tris.bx, tris.by, tris.bz);
+  Float3<N> c = load_vec3<N>(tris.cx, tris.cy, tris.cz);
+  Float3<N> ta = set1_vec3<N>(tri.a);
+  Float3<N> tb = set1_vec3<N>(tri.b);
+  Float3<N> tc = set1_vec3<N>(tri.c);
+
+  auto max_abs3 = [](const Float3<N>& v) {
+    return max3(simd::abs(v.x), simd::abs(v.y), simd::abs(v.z));
+  };
+  Float<N> scale = simd::max(
+    max3(max_abs3(a), max_abs3(b), max_abs3(c)),
+    set1<N>(get_max_abs(tri))
+  );
+  const Float<N> zero = set1<N>(0.0f);
+  const float eps = 2.0f * TRI_PLANE_EPS;
+  Float<N> eps2_scale = set1<N>(eps * eps) * scale * scale;
+  auto is_one_sided = [&](
+    const Float3<N>& n,
+    const Float3<N>& o,
+    const Float3<N>& p0,
+    const Float3<N>& p1,
+    const Float3<N>& p2
+  ) {
+    Float<N> d0 = dot(n, p0 - o);
+    Float<N> d1 = dot(n, p1 - o);
+    Float<N> d2 = dot(n, p2 - o);
+    Float<N> eps2 = dot(n, n) * eps2_scale;
+    Mask<N> is_far = (d0 * d0 > eps2) & (d1 * d1 > eps2) & (d2 * d2 > eps2);
+    Mask<N> is_above = (d0 > zero) & (d1 > zero) & (d2 > zero);
+    Mask<N> is_below = (d0 < zero) & (d1 < zero) & (d2 < zero);
+    return is_far & (is_above | is_below);
+  };
+  Float3<N> n = cross(b - a, c - a);
+  Float3<N> tn = set1_vec3<N>(glm::cross(tri.b - tri.a, tri.c - tri.a));
+  uint32_t rejected = movemask(is_one_sided(tn, ta, a, b, c) |
+    is_one_sided(n, a, ta, tb, tc));
+
+  uint32_t out = 0;
+  for (int i = 0; i < N; ++i) {
+    if (((rejected >> i) & 1) == 0 && intersect_tri(tri, tris.get(i))) {
+      out |= 1u << i;
+    }
+  }
+  return out;
+}
+
+} // namespace
+
+uint32_t intersect_tri(const Triangle& tri, const TrianglePacket<4>& tris) {
+  return intersect_tri_tris<4>(tri, tris);
+}
+uint32_t intersect_tri(const Triangle& tri, const TrianglePacket<8>& tris) {
+  return intersect_tri_tris<8>(tri, tris);
+}
+uint32_t intersect_aabb_tri(const TrianglePacket<4>& tris, const Aabb& aabb) {
+  return intersect_aabb_tri_tris<4>(tris, aabb);
+}
+uint32_t intersect_aabb_tri(const TrianglePacket<8>& tris, const Aabb& aabb) {
+  return intersect_aabb_tri_tris<8>(tris, aabb);
+}
+uint32_t intersect_aabb_tri(const Triangle& tri, const AabbPacket<4>& aabbs) {
+  return intersect_aabb_tri_aabbs<4>(tri, aabbs);
+}
+uint32_t intersect_aabb_tri(const Triangle& tri, const AabbPacket<8>& aabbs) {
+  return intersect_aabb_tri_aabbs<8>(tri, aabbs);
 }
 
 void split_tetra2tris(const Tetrahedron& tet, std::vector<Triangle>& out) {
@@ -107,27 +845,11 @@ void subdivide_aabb(
   const glm::uvec3& nslice,
   std::vector<Aabb>& out
 ) {
-  glm::vec3 size = aabb.size() / glm::vec3(nslice);
-
-  for (uint32_t z = 0; z < nslice.z; ++z) {
-    float z_min = aabb.min.z + z * size.z;
-    float z_max =
-      z + 1 == nslice.y ? aabb.max.z : aabb.min.z + (z + 1) * size.z;
-    for (uint32_t y = 0; y < nslice.y; ++y) {
-      float y_min = aabb.min.y + y * size.y;
-      float y_max =
-        y + 1 == nslice.y ? aabb.max.y : aabb.min.y + (y + 1) * size.y;
-      for (uint32_t x = 0; x < nslice.x; ++x) {
-        float x_min = aabb.min.x + x * size.x;
-        float x_max =
-          x + 1 == nslice.x ? aabb.max.x : aabb.min.x + (x + 1) * size.x;
-
-        Aabb aabb2 {};
-        aabb2.min = glm::vec3(x_min, y_min, z_min);
-        aabb2.max = glm::vec3(x_max, y_max, z_max);
-      }
-    }
-  }
+  AabbGrid grid { aabb, nslice };
+  out.reserve(out.size() + grid.size());
+  grid.for_each([&](size_t, const Aabb& sub_aabb) {
+    out.emplace_back(sub_aabb);
+  });
 }
 
 void split_aabb2points(const Aabb& aabb, std::vector<glm::vec3>& out) {
@@ -155,10 +877,8 @@ void tile_aabb_ceil(
   const glm::vec3& tile_size,
   std::vector<Aabb>& out
 ) {
-  glm::uvec3 nslice(glm::ceil(aabb.size() / tile_size));
-  glm::vec3 size2 = glm::vec3(nslice) * tile_size;
-  Aabb aabb2 = Aabb::from_center_size(aabb.center(), size2);
-  subdivide_aabb(aabb, nslice, out);
+  AabbGrid grid = AabbGrid::from_tile_size(aabb, tile_size);
+  subdivide_aabb(grid.aabb, grid.nslice, out);
 }
 
 } // namespace geom
@@ -1,8 +1,10 @@
 #include "gft/glslang.hpp"
 
+#include <initializer_list>
 #include <memory>
 
 #include "gft/assert.hpp"
+#include "gft/cache.hpp"
 #include "gft/log.hpp"
 #include "glslang/SPIRV/GlslangToSpv.h"
 #include "glslang/glslang/Include/BaseTypes.h"
@@ -443,7 +445,7 @@ class Hlsl2Spv {
   }
 };
 
-ComputeSpirvArtifact compile_comp(
+ComputeSpirvArtifact _compile_comp(
   const std::string& comp_src,
   const std::string& comp_entry_point
 ) {
@@ -453,7 +455,7 @@ ComputeSpirvArtifact compile_comp(
   conv.reflect(ubo_size);
   return { conv.to_spv(EShLangCompute), ubo_size };
 }
-ComputeSpirvArtifact compile_comp_hlsl(
+ComputeSpirvArtifact _compile_comp_hlsl(
   const std::string& comp_src,
   const std::string& comp_entry_point
 ) {
@@ -464,7 +466,7 @@ ComputeSpirvArtifact compile_comp_hlsl(
   return { conv.to_spv(EShLangCompute), ubo_size };
 }
 
-GraphicsSpirvArtifact compile_graph(
+GraphicsSpirvArtifact _compile_graph(
   const std::string& vert_src,
   const std::string& vert_entry_point,
   const std::string& frag_src,
@@ -478,7 +480,7 @@ GraphicsSpirvArtifact compile_graph(
   conv.reflect(ubo_size);
   return { conv.to_spv(EShLangVertex), conv.to_spv(EShLangFragment), ubo_size };
 }
-GraphicsSpirvArtifact compile_graph_hlsl(
+GraphicsSpirvArtifact _compile_graph_hlsl(
   const std::string& vert_src,
   const std::string& vert_entry_point,
   const std::string& frag_src,
@@ -493,6 +495,110 @@ GraphicsSpirvArtifact compile_graph_hlsl(
   return { conv.to_spv(EShLangVertex), conv.to_spv(EShLangFragment), ubo_size };
 }
 
+// Compilation is deterministic, so artifacts are memoized by the sources and
+// the target version. Shader variants are commonly created over and over
+// again, e.g., once per pipeline state.
+const size_t SPIRV_CACHE_NBYTE_BUDGET = 64 * 1024 * 1024;
+
+std::string _make_cache_key(
+  const char* kind,
+  std::initializer_list<const std::string*> parts
+) {
+  // Length-prefixed so that different splits of the same text don't collide.
+  std::string out = kind;
+  out += ':';
+  out += std::to_string((uint32_t)TARGET_CLIENT_VER);
+  for (const std::string* part : parts) {
+    out += ':';
+    out += std::to_string(part->size());
+    out += ':';
+    out += *part;
+  }
+  return out;
+}
+
+cache::LruCache<std::string, ComputeSpirvArtifact>& _get_comp_cache() {
+  static cache::LruCache<std::string, ComputeSpirvArtifact> inst([]() {
+    cache::LruCache<std::string, ComputeSpirvArtifact>::Config cfg {};
+    cfg.nbyte_budget = SPIRV_CACHE_NBYTE_BUDGET;
+    cfg.get_nbyte = [](
+      const std::string& key,
+      const ComputeSpirvArtifact& art
+    ) {
+      return key.size() + art.comp_spv.size() * sizeof(uint32_t);
+    };
+    return cfg;
+  }());
+  return inst;
+}
+cache::LruCache<std::string, GraphicsSpirvArtifact>& _get_graph_cache() {
+  static cache::LruCache<std::string, GraphicsSpirvArtifact> inst([]() {
+    cache::LruCache<std::string, GraphicsSpirvArtifact>::Config cfg {};
+    cfg.nbyte_budget = SPIRV_CACHE_NBYTE_BUDGET;
+    cfg.get_nbyte = [](
+      const std::string& key,
+      const GraphicsSpirvArtifact& art
+    ) {
+      return key.size() +
+        (art.vert_spv.size() + art.frag_spv.size()) * sizeof(uint32_t);
+    };
+    return cfg;
+  }());
+  return inst;
+}
+
+ComputeSpirvArtifact compile_comp(
+  const std::string& comp_src,
+  const std::string& comp_entry_point
+) {
+  std::string key =
+    _make_cache_key("glsl-comp", { &comp_src, &comp_entry_point });
+  return *_get_comp_cache().get_or_compute(key, [&]() {
+    return _compile_comp(comp_src, comp_entry_point);
+  });
+}
+ComputeSpirvArtifact compile_comp_hlsl(
+  const std::string& comp_src,
+  const std::string& comp_entry_point
+) {
+  std::string key =
+    _make_cache_key("hlsl-comp", { &comp_src, &comp_entry_point });
+  return *_get_comp_cache().get_or_compute(key, [&]() {
+    return _compile_comp_hlsl(comp_src, comp_entry_point);
+  });
+}
+
+GraphicsSpirvArtifact compile_graph(
+  const std::string& vert_src,
+  const std::string& vert_entry_point,
+  const std::string& frag_src,
+  const std::string& frag_entry_point
+) {
+  std::string key = _make_cache_key(
+    "glsl-graph", { &vert_src, &vert_entry_point, &frag_src, &frag_entry_point }
+  );
+  return *_get_graph_cache().get_or_compute(key, [&]() {
+    return _compile_graph(
+      vert_src, vert_entry_point, frag_src, frag_entry_point
+    );
+  });
+}
+GraphicsSpirvArtifact compile_graph_hlsl(
+  const std::string& vert_src,
+  const std::string& vert_entry_point,
+  const std::string& frag_src,
+  const std::string& frag_entry_point
+) {
+  std::string key = _make_cache_key(
+    "hlsl-graph", { &vert_src, &vert_entry_point, &frag_src, &frag_entry_point }
+  );
+  return *_get_graph_cache().get_or_compute(key, [&]() {
+    return _compile_graph_hlsl(
+      vert_src, vert_entry_point, frag_src, frag_entry_point
+    );
+  });
+}
+
 } // namespace glslang
 
 } // namespace liong
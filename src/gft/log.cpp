@@ -1,4 +1,12 @@
 #include "gft/log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace liong {
 namespace log {
@@ -24,11 +32,444 @@ void l_default_log_callback__(LogLevel lv, const std::string& msg) {
 
 LogCallback l_log_callback__ = &l_default_log_callback__;
 LogLevel l_filter_lv__ = LogLevel::L_LOG_LEVEL_DEBUG;
-std::string l_indent__ = "";
+thread_local std::string l_indent__ = "";
+std::atomic<bool> l_is_async__ { false };
+
+thread_local std::string l_log_buf__;
+thread_local bool l_log_buf_in_use__ = false;
+
+LogBuffer::LogBuffer() {
+  if (l_log_buf_in_use__) {
+    buf = &fallback;
+  } else {
+    l_log_buf_in_use__ = true;
+    l_log_buf__.clear();
+    buf = &l_log_buf__;
+  }
+}
+LogBuffer::~LogBuffer() {
+  if (buf == &l_log_buf__) {
+    l_log_buf_in_use__ = false;
+  }
+}
+
+namespace {
+
+struct LogRecord {
+  LogLevel lv;
+  std::string msg;
+};
+
+// Single-producer single-consumer ring buffer. The owning thread is the only
+// producer; consumers are serialized by `AsyncLogger::drain_mutex`. Message
+// strings are swapped in and out of the slots so that their capacity is
+// recycled.
+struct LogRing {
+  std::vector<LogRecord> records;
+  size_t mask;
+  alignas(64) std::atomic<size_t> head;
+  alignas(64) std::atomic<size_t> tail;
+  std::atomic<size_t> ndropped;
+
+  LogRing(size_t nrecord) :
+    records(nrecord), mask(nrecord - 1), head(0), tail(0), ndropped(0) {}
+
+  bool try_push(LogLevel lv, std::string& msg) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) > mask) {
+      return false;
+    }
+    LogRecord& rec = records[t & mask];
+    rec.lv = lv;
+    rec.msg.swap(msg);
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+  void drain(LogCallback cb) {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t t = tail.load(std::memory_order_acquire);
+    for (; h != t; ++h) {
+      LogRecord& rec = records[h & mask];
+      if (cb != nullptr) {
+        cb(rec.lv, rec.msg);
+      }
+      rec.msg.clear();
+      head.store(h + 1, std::memory_order_release);
+    }
+  }
+  bool empty() const {
+    return head.load(std::memory_order_acquire) ==
+      tail.load(std::memory_order_acquire);
+  }
+};
+
+struct AsyncLogger {
+  std::mutex ctrl_mutex;
+  size_t nrecord_per_thread = 1024;
+  std::atomic<LogOverflowPolicy> overflow_policy { L_LOG_OVERFLOW_POLICY_DROP };
+  std::terminate_handler prev_terminate_handler = nullptr;
+
+  std::mutex registry_mutex;
+  std::vector<std::shared_ptr<LogRing>> rings;
+
+  std::mutex drain_mutex;
+  std::vector<std::shared_ptr<LogRing>> draining_rings;
+
+  // Number of producers between checking `l_is_async__` and finishing their
+  // push. `stop` waits for them so that no record is left behind in a ring.
+  std::atomic<size_t> npushing { 0 };
+
+  std::mutex wake_mutex;
+  std::condition_variable wake_cv;
+  bool should_wake = false;
+  bool should_stop = false;
+  // Set while the worker sleeps, so that producers only notify it then.
+  std::atomic<bool> is_idle { false };
+  std::thread worker;
+
+  ~AsyncLogger() {
+    std::lock_guard<std::mutex> guard(ctrl_mutex);
+    stop();
+  }
+
+  // `ctrl_mutex` must be held.
+  void stop() {
+    if (!l_is_async__.load()) {
+      return;
+    }
+    l_is_async__.store(false);
+    // Producers that have seen `l_is_async__` set are still pushing; the
+    // worker drains their records once more after it's been stopped.
+    while (npushing.load() != 0) {
+      std::this_thread::yield();
+    }
+    {
+      std::lock_guard<std::mutex> guard(wake_mutex);
+      should_stop = true;
+    }
+    wake_cv.notify_one();
+    worker.join();
+    std::set_terminate(prev_terminate_handler);
+    prev_terminate_handler = nullptr;
+  }
+};
+
+AsyncLogger& get_async_logger() {
+  static AsyncLogger logger;
+  return logger;
+}
+
+thread_local std::shared_ptr<LogRing> l_ring__;
+// Set while the thread is delivering records to the callback. Records logged
+// by the callback itself are delivered synchronously to avoid deadlocks.
+thread_local bool l_is_draining__ = false;
+
+LogRing& get_thread_log_ring() {
+  if (l_ring__ == nullptr) {
+    AsyncLogger& logger = get_async_logger();
+    std::lock_guard<std::mutex> guard(logger.registry_mutex);
+    l_ring__ = std::make_shared<LogRing>(logger.nrecord_per_thread);
+    logger.rings.emplace_back(l_ring__);
+  }
+  return *l_ring__;
+}
+
+// Marks the thread as draining for a scope, even if the callback throws.
+struct DrainingScope {
+  DrainingScope() {
+    l_is_draining__ = true;
+  }
+  ~DrainingScope() {
+    l_is_draining__ = false;
+  }
+};
+
+void drain_all() {
+  if (l_is_draining__) {
+    // Called back from the log callback, e.g., by a failed assertion or the
+    // terminate handler. `drain_mutex` is already held by this thread.
+    return;
+  }
+  AsyncLogger& logger = get_async_logger();
+  std::lock_guard<std::mutex> drain_guard(logger.drain_mutex);
+  DrainingScope draining {};
+
+  {
+    std::lock_guard<std::mutex> guard(logger.registry_mutex);
+    logger.draining_rings = logger.rings;
+  }
+  LogCallback cb = l_log_callback__;
+  for (const auto& ring : logger.draining_rings) {
+    ring->drain(cb);
+    size_t ndropped = ring->ndropped.exchange(0, std::memory_order_relaxed);
+    if (ndropped != 0 && cb != nullptr) {
+      cb(
+        L_LOG_LEVEL_WARNING,
+        util::format("dropped ", ndropped, " log records on overflow")
+      );
+    }
+  }
+  logger.draining_rings.clear();
+
+  // Forget the rings of exited threads.
+  {
+    std::lock_guard<std::mutex> guard(logger.registry_mutex);
+    auto it = logger.rings.begin();
+    while (it != logger.rings.end()) {
+      if (it->use_count() == 1 && (*it)->empty()) {
+        it = logger.rings.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+bool has_pending_log() {
+  AsyncLogger& logger = get_async_logger();
+  std::lock_guard<std::mutex> guard(logger.registry_mutex);
+  for (const auto& ring : logger.rings) {
+    if (!ring->empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void wake_async_logger() {
+  AsyncLogger& logger = get_async_logger();
+  {
+    std::lock_guard<std::mutex> guard(logger.wake_mutex);
+    logger.should_wake = true;
+  }
+  logger.wake_cv.notify_one();
+}
+
+void async_log_worker() {
+  AsyncLogger& logger = get_async_logger();
+  std::unique_lock<std::mutex> lock(logger.wake_mutex);
+  while (!logger.should_stop) {
+    logger.should_wake = false;
+    lock.unlock();
+    drain_all();
+    lock.lock();
+
+    // Records pushed before producers can see `is_idle` are found by
+    // `has_pending_log`; the ones after that wake the worker up.
+    logger.is_idle.store(true);
+    if (!has_pending_log()) {
+      logger.wake_cv.wait(lock, [&] {
+        return logger.should_wake || logger.should_stop;
+      });
+    }
+    logger.is_idle.store(false, std::memory_order_relaxed);
+  }
+  lock.unlock();
+  drain_all();
+}
+
+[[noreturn]] void async_log_terminate_handler() {
+  flush_log();
+  std::terminate_handler prev = get_async_logger().prev_terminate_handler;
+  if (prev != nullptr) {
+    prev();
+  }
+  std::abort();
+}
+
+} // namespace
+
+namespace {
+
+bool try_push_async_log(LogLevel lv, std::string& msg) {
+  AsyncLogger& logger = get_async_logger();
+  LogRing& ring = get_thread_log_ring();
+  if (ring.try_push(lv, msg)) {
+    // Pairs with the worker setting `is_idle` before it checks the rings.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (logger.is_idle.load(std::memory_order_relaxed) &&
+        logger.is_idle.exchange(false)) {
+      wake_async_logger();
+    }
+    return true;
+  }
+
+  if (logger.overflow_policy.load(std::memory_order_relaxed) ==
+      L_LOG_OVERFLOW_POLICY_DROP) {
+    ring.ndropped.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  do {
+    if (!l_is_async__.load(std::memory_order_relaxed)) {
+      // Async logging is being disabled while we are waiting.
+      return false;
+    }
+    wake_async_logger();
+    std::this_thread::yield();
+  } while (!ring.try_push(lv, msg));
+  return true;
+}
+
+} // namespace
+
+void push_async_log(LogLevel lv, std::string& msg) {
+  if (l_is_draining__) {
+    l_log_callback__(lv, msg);
+    return;
+  }
+
+  // Register as a producer before checking again whether logging is still
+  // asynchronous; `AsyncLogger::stop` clears the flag before waiting for the
+  // registered producers.
+  AsyncLogger& logger = get_async_logger();
+  logger.npushing.fetch_add(1);
+  bool is_pushed = l_is_async__.load() && try_push_async_log(lv, msg);
+  logger.npushing.fetch_sub(1, std::memory_order_release);
+  if (!is_pushed) {
+    l_log_callback__(lv, msg);
+  }
+}
+
+std::mutex l_log_sites_mutex__;
+LogSite* l_log_sites__ = nullptr;
+
+LogSite::LogSite(const char* file, uint32_t line) :
+  file(file),
+  line(line),
+  ncall(0),
+  nsuppressed(0),
+  ntoken(0.0),
+  last_refill_ns(0) {
+  std::lock_guard<std::mutex> guard(l_log_sites_mutex__);
+  next = l_log_sites__;
+  l_log_sites__ = this;
+}
+LogSite::~LogSite() {
+  // Static locals are destroyed at exit in an unspecified order relative to
+  // the last calls to `report_suppressed_logs`.
+  std::lock_guard<std::mutex> guard(l_log_sites_mutex__);
+  for (LogSite** site = &l_log_sites__; *site != nullptr;
+       site = &(*site)->next) {
+    if (*site == this) {
+      *site = next;
+      break;
+    }
+  }
+}
+
+bool LogSite::sample_every_n(uint64_t n, uint64_t& nsuppressed_out) {
+  if (ncall.fetch_add(1, std::memory_order_relaxed) % n != 0) {
+    nsuppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  nsuppressed_out = nsuppressed.exchange(0, std::memory_order_relaxed);
+  return true;
+}
+bool LogSite::sample_once(uint64_t& nsuppressed_out) {
+  if (ncall.fetch_add(1, std::memory_order_relaxed) != 0) {
+    nsuppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  nsuppressed_out = 0;
+  return true;
+}
+bool LogSite::sample_rate_limited(
+  double nmsg_per_sec,
+  uint64_t& nsuppressed_out
+) {
+  // Allow a burst of up to one second worth of messages.
+  double burst = std::max(nmsg_per_sec, 1.0);
+  uint64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()
+  ).count();
+
+  bool has_token;
+  {
+    std::lock_guard<std::mutex> guard(bucket_mutex);
+    double dt = (now_ns - last_refill_ns) * 1e-9;
+    ntoken = std::min(ntoken + dt * nmsg_per_sec, burst);
+    last_refill_ns = now_ns;
+    has_token = ntoken >= 1.0;
+    if (has_token) {
+      ntoken -= 1.0;
+    }
+  }
+
+  if (!has_token) {
+    nsuppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  nsuppressed_out = nsuppressed.exchange(0, std::memory_order_relaxed);
+  return true;
+}
 
 } // namespace detail
 
 
+void report_suppressed_logs() {
+  struct SuppressedLogs {
+    const char* file;
+    uint32_t line;
+    uint64_t nsuppressed;
+  };
+  // Logged out of the lock; the callback can reach a sampled log macro for the
+  // first time, which registers its call site under the same lock.
+  std::vector<SuppressedLogs> suppressed_logs;
+  {
+    std::lock_guard<std::mutex> guard(detail::l_log_sites_mutex__);
+    for (detail::LogSite* site = detail::l_log_sites__; site != nullptr;
+         site = site->next) {
+      uint64_t nsuppressed =
+        site->nsuppressed.exchange(0, std::memory_order_relaxed);
+      if (nsuppressed != 0) {
+        suppressed_logs.emplace_back(
+          SuppressedLogs { site->file, site->line, nsuppressed }
+        );
+      }
+    }
+  }
+  for (const SuppressedLogs& suppressed_log : suppressed_logs) {
+    L_INFO(
+      "suppressed ", suppressed_log.nsuppressed, " messages logged at ",
+      suppressed_log.file, ":", suppressed_log.line
+    );
+  }
+}
+
+void enable_async_log(
+  size_t nrecord_per_thread,
+  LogOverflowPolicy overflow_policy
+) {
+  detail::AsyncLogger& logger = detail::get_async_logger();
+  std::lock_guard<std::mutex> guard(logger.ctrl_mutex);
+
+  size_t nrecord = 1;
+  while (nrecord < nrecord_per_thread) {
+    nrecord <<= 1;
+  }
+  // Only applies to threads that haven't logged asynchronously yet.
+  logger.nrecord_per_thread = nrecord;
+  logger.overflow_policy.store(overflow_policy, std::memory_order_relaxed);
+
+  if (detail::l_is_async__.load()) {
+    return;
+  }
+  logger.should_stop = false;
+  logger.worker = std::thread(&detail::async_log_worker);
+  logger.prev_terminate_handler =
+    std::set_terminate(&detail::async_log_terminate_handler);
+  detail::l_is_async__.store(true);
+}
+void disable_async_log() {
+  detail::AsyncLogger& logger = detail::get_async_logger();
+  std::lock_guard<std::mutex> guard(logger.ctrl_mutex);
+  logger.stop();
+}
+void flush_log() {
+  if (detail::l_is_async__.load()) {
+    detail::drain_all();
+  }
+}
+
 void set_log_callback(LogCallback cb) {
   detail::l_log_callback__ = cb;
 }
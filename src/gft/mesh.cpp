@@ -5,8 +5,12 @@
 #include <initializer_list>
 #include "glm/glm.hpp"
 #include "gft/mesh.hpp"
+#include "gft/arena.hpp"
+#include "gft/geom-soa.hpp"
 #include "gft/assert.hpp"
 #include "gft/log.hpp"
+#include "gft/parallel.hpp"
+#include "gft/profile.hpp"
 
 namespace liong {
 namespace mesh {
@@ -353,9 +357,13 @@ bool try_parse_obj(const std::string& obj, Mesh& mesh) {
   return parser.try_parse(mesh);
 }
 Mesh load_obj(const char* path) {
-  auto txt = util::load_text(path);
+  L_PROFILE_SCOPE("mesh::load_obj");
+  // The tokenizer only reads forward so the file doesn't have to be loaded
+  // into memory at once.
+  util::MappedFile file(path, util::L_MAPPED_FILE_ACCESS_HINT_SEQUENTIAL);
+  ObjParser parser(file.begin(), file.end());
   Mesh mesh {};
-  L_ASSERT(try_parse_obj(txt, mesh));
+  L_ASSERT(parser.try_parse(mesh));
   return mesh;
 }
 
@@ -390,7 +398,7 @@ std::vector<Triangle> Mesh::to_tris() const {
 }
 
 Aabb Mesh::aabb() const {
-  return Aabb::from_points(poses.data(), poses.size());
+  return get_points_aabb(poses.data(), poses.size());
 }
 
 struct UniqueVertex {
@@ -442,8 +450,22 @@ IndexedMesh IndexedMesh::from_mesh(const Mesh& mesh) {
   return out;
 }
 
+std::vector<Triangle> IndexedMesh::to_tris() const {
+  std::vector<Triangle> out {};
+  out.reserve(idxs.size());
+  for (const auto& idx : idxs) {
+    Triangle tri {
+      mesh.poses.at(idx.x),
+      mesh.poses.at(idx.y),
+      mesh.poses.at(idx.z),
+    };
+    out.emplace_back(std::move(tri));
+  }
+  return out;
+}
+
 Aabb PointCloud::aabb() const {
-  return geom::Aabb::from_points(poses);
+  return geom::get_points_aabb(poses.data(), poses.size());
 }
 
 std::vector<float> make_grid_lines(float min, float max, uint32_t n) {
@@ -544,18 +566,33 @@ std::vector<Bin> BinGrid::get_solid() const {
 }
 
 struct Binner {
+  // A primitive overlapping a bin.
+  struct BinRef {
+    uint32_t ibin;
+    uint32_t iprim;
+  };
+
   Aabb aabb;
   glm::uvec3 grid_res;
   Grid grid;
   std::vector<Bin> bins;
   uint32_t counter;
+  // Primitives are first collected in scratch memory and then distributed to
+  // the bins in `into_bingrid`, so that each bin allocates exactly once
+  // instead of growing one primitive at a time. The scope is on the calling
+  // thread's scratch arena, so a binner must stay on the thread creating it
+  // and be destroyed before any binner created earlier on that thread.
+  arena::ArenaScope scope;
+  arena::Vector<BinRef> bin_refs;
 
   Binner(const Aabb& aabb, const glm::uvec3& grid_res) :
     aabb(aabb),
     grid_res(grid_res),
     grid(build_grid(aabb, grid_res)),
     bins(),
-    counter() {
+    counter(),
+    scope(arena::get_scratch_arena()),
+    bin_refs(scope.arena) {
     bins.reserve(grid_res.x * grid_res.y * grid_res.z);
     for (uint32_t z = 0; z < grid_res.z; ++z) {
       float z_min = z == 0 ? aabb.min.z : grid.grid_lines_z.at(z - 1);
@@ -582,19 +619,23 @@ struct Binner {
     size_t i = 0;
     // The loop breaks when `x` is less than `grid_lines` so `i` ended at any
     // index of the left-close and right-open interval that contains the point.
-    // But also note that if the loop runs out of range, i.e., `x >= aabb.max`
-    // the index of the farthest bin is naturally assigned to `i`. Given that
-    // non-intersecting triangles are filetered in `bin` any point enclosed
-    // by `aabb` can be uniquely assigned to a bin at boundaries.
+    // But also note that if the loop runs out of range, i.e., `x >= aabb.max`,
+    // the index would be one past the farthest bin, so it's clamped. Given
+    // that non-intersecting triangles are filetered in `bin` any point
+    // enclosed by `aabb` can be uniquely assigned to a bin at boundaries.
     for (; i < grid_lines.size(); ++i) {
       if (x < grid_lines.at(i)) {
         break;
       }
     }
-    return i;
+    return std::min(i, grid_lines.size() - 1);
   }
 
-  bool bin(const Aabb& aabb, size_t& iprim) {
+  // Primitives are numbered in the order they are binned, including those
+  // outside the binner space.
+  bool bin(const Triangle& tri, size_t& iprim) {
+    iprim = counter++;
+    Aabb aabb = Aabb::from_points(&tri.a, 3);
     if (!intersect_aabb(this->aabb, aabb)) {
       // The triangle's AABB is not intersecting with the current binner space.
       // So simply ignore this triangle.
@@ -607,22 +648,52 @@ struct Binner {
     size_t imax_y = get_ibin(grid.grid_lines_y, aabb.max.y);
     size_t imin_z = get_ibin(grid.grid_lines_z, aabb.min.z);
     size_t imax_z = get_ibin(grid.grid_lines_z, aabb.max.z);
-    // TODO: (penguinliong) Consider the case of a very narrow triangle placed
-    // on the diagonal of the bins looped here. There is a significant room of
-    // optimization for large triangles.
+    if (imin_x == imax_x && imin_y == imax_y && imin_z == imax_z) {
+      size_t i = ((imin_z * grid_res.y + imin_y) * grid_res.x) + imin_x;
+      bin_refs.emplace_back(BinRef { (uint32_t)i, (uint32_t)iprim });
+      return true;
+    }
+
+    // Large triangles, especially narrow ones along the diagonal of the bins
+    // their bounds cover, overlap only a few of them. Candidate bins are
+    // tested exactly, a packet at a time.
+    bool is_binned = false;
+    AabbPacket<8> aabbs;
+    uint32_t ibins[8];
+    int ncandidate = 0;
+    auto flush = [&]() {
+      for (int i = ncandidate; i < 8; ++i) {
+        aabbs.clear(i);
+      }
+      uint32_t mask = intersect_aabb_tri(tri, aabbs);
+      for (int i = 0; i < ncandidate; ++i) {
+        if ((mask >> i) & 1) {
+          bin_refs.emplace_back(BinRef { ibins[i], (uint32_t)iprim });
+          is_binned = true;
+        }
+      }
+      ncandidate = 0;
+    };
     for (size_t z = imin_z; z <= imax_z; ++z) {
       for (size_t y = imin_y; y <= imax_y; ++y) {
         for (size_t x = imin_x; x <= imax_x; ++x) {
           size_t i = ((z * grid_res.y + y) * grid_res.x) + x;
-          bins.at(i).iprims.emplace_back(counter);
+          aabbs.set(ncandidate, bins[i].aabb);
+          ibins[ncandidate++] = (uint32_t)i;
+          if (ncandidate == 8) {
+            flush();
+          }
         }
       }
     }
-    ++counter;
-    return true;
+    if (ncandidate != 0) {
+      flush();
+    }
+    return is_binned;
   }
 
   bool bin(const glm::vec3& point, size_t& iprim) {
+    iprim = counter++;
     if (!contains_point_aabb(aabb, point)) {
       // The point is not intersecting with the current binner space. So simply
       // ignore this point.
@@ -633,12 +704,23 @@ struct Binner {
     size_t y = get_ibin(grid.grid_lines_y, point.y);
     size_t z = get_ibin(grid.grid_lines_z, point.z);
     size_t i = ((z * grid_res.y + y) * grid_res.x) + x;
-    bins.at(i).iprims.emplace_back(counter);
-    ++counter;
+    bin_refs.emplace_back(BinRef { (uint32_t)i, (uint32_t)iprim });
     return true;
   }
 
   BinGrid into_bingrid() {
+    {
+      arena::Vector<uint32_t> nprims(bins.size(), 0, scope.arena);
+      for (const auto& bin_ref : bin_refs) {
+        ++nprims.at(bin_ref.ibin);
+      }
+      for (size_t i = 0; i < bins.size(); ++i) {
+        bins[i].iprims.reserve(nprims[i]);
+      }
+    }
+    for (const auto& bin_ref : bin_refs) {
+      bins.at(bin_ref.ibin).iprims.emplace_back(bin_ref.iprim);
+    }
     BinGrid out {
       std::move(grid),
       std::move(bins),
@@ -652,6 +734,7 @@ BinGrid bin_point_cloud(
   const glm::uvec3& grid_res,
   const PointCloud& point_cloud
 ) {
+  L_PROFILE_SCOPE("mesh::bin_point_cloud");
   Binner binner(aabb, grid_res);
   for (const auto& point : point_cloud.poses) {
     size_t _;
@@ -675,16 +758,16 @@ BinGrid bin_mesh(
   const glm::uvec3& grid_res,
   const Mesh& mesh
 ) {
+  L_PROFILE_SCOPE("mesh::bin_mesh");
   Binner binner(aabb, grid_res);
   for (size_t i = 0; i < mesh.poses.size(); i += 3) {
-    glm::vec3 points[3] {
+    Triangle tri {
       mesh.poses.at(i),
-      mesh.poses.at(i + 2),
       mesh.poses.at(i + 1),
+      mesh.poses.at(i + 2),
     };
-    Aabb aabb2 = Aabb::from_points(points, 3);
     size_t _;
-    binner.bin(aabb2, _);
+    binner.bin(tri, _);
   }
   return binner.into_bingrid();
 }
@@ -701,16 +784,16 @@ BinGrid bin_idxmesh(
   const glm::uvec3& grid_res,
   const IndexedMesh& idxmesh
 ) {
+  L_PROFILE_SCOPE("mesh::bin_idxmesh");
   Binner binner(aabb, grid_res);
   for (const auto& idx : idxmesh.idxs) {
-    glm::vec3 points[3] {
+    Triangle tri {
       idxmesh.mesh.poses.at(idx.x),
       idxmesh.mesh.poses.at(idx.y),
       idxmesh.mesh.poses.at(idx.z),
     };
-    Aabb aabb2 = Aabb::from_points(points, 3);
     size_t _;
-    binner.bin(aabb2, _);
+    binner.bin(tri, _);
   }
   return binner.into_bingrid();
 }
@@ -766,6 +849,7 @@ TetrahedralMesh TetrahedralMesh::from_points(
   const glm::vec3& grid_interval,
   const std::vector<glm::vec3>& points
 ) {
+  L_PROFILE_SCOPE("mesh::TetrahedralMesh::from_points");
   // Bin vertices into a voxel grid.
   mesh::BinGrid grid = mesh::bin_point_cloud(grid_interval, { points });
 
@@ -1024,7 +1108,7 @@ std::vector<glm::vec3> SkinnedMesh::animate(
   );
 
   std::vector<glm::vec3> out(idxmesh.mesh.poses.size());
-  for (size_t i = 0; i < idxmesh.mesh.poses.size(); ++i) {
+  parallel::parallel_for(0, idxmesh.mesh.poses.size(), [&](size_t i) {
     glm::vec4 rest_pos = glm::vec4(idxmesh.mesh.poses.at(i), 1.0f);
     glm::uvec4 ibone = skinning.ibones.at(i);
     glm::vec4 bone_weight = skinning.bone_weights.at(i);
@@ -1034,7 +1118,7 @@ std::vector<glm::vec3> SkinnedMesh::animate(
                     bone_mats.at(ibone.z) * rest_pos * bone_weight.z +
                     bone_mats.at(ibone.w) * rest_pos * bone_weight.w;
     out.at(i) = pos;
-  }
+  });
   return out;
 }
 std::vector<glm::vec3> SkinnedMesh::animate(float tick) {
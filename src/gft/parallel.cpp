@@ -0,0 +1,209 @@
+#include "gft/parallel.hpp"
+#include "gft/assert.hpp"
+
+namespace liong {
+
+namespace parallel {
+
+namespace {
+
+// The pool and the index of the worker running on the current thread, if the
+// current thread is a worker.
+thread_local ThreadPool* l_worker_pool__ = nullptr;
+thread_local size_t l_worker_idx__ = 0;
+
+std::atomic<bool> l_is_deterministic__ { false };
+
+} // namespace
+
+ThreadPool::ThreadPool(uint32_t nthread) :
+  workers_(),
+  threads_(),
+  inject_mutex_(),
+  inject_tasks_(),
+  sleep_mutex_(),
+  sleep_cv_(),
+  npending_(0),
+  is_stopping_(false) {
+  if (nthread == 0) {
+    nthread = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  workers_.reserve(nthread);
+  for (uint32_t i = 0; i < nthread; ++i) {
+    workers_.emplace_back(std::make_unique<Worker>());
+  }
+  threads_.reserve(nthread);
+  for (uint32_t i = 0; i < nthread; ++i) {
+    threads_.emplace_back([this, i]() { work(i); });
+  }
+}
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> guard(sleep_mutex_);
+    is_stopping_.store(true);
+  }
+  sleep_cv_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  // Workers only exit once the queues are empty, but tasks can still be
+  // spawned from outside while they are exiting.
+  while (try_run_one()) {}
+}
+
+void ThreadPool::spawn(Task&& task) {
+  npending_.fetch_add(1);
+  if (l_worker_pool__ == this) {
+    Worker& worker = *workers_[l_worker_idx__];
+    std::lock_guard<std::mutex> guard(worker.mutex);
+    worker.tasks.emplace_back(std::move(task));
+  } else {
+    std::lock_guard<std::mutex> guard(inject_mutex_);
+    inject_tasks_.emplace_back(std::move(task));
+  }
+  // Lock to make sure the notification isn't lost between a sleeping worker
+  // checking `npending_` and starting to wait.
+  { std::lock_guard<std::mutex> guard(sleep_mutex_); }
+  sleep_cv_.notify_one();
+}
+
+bool ThreadPool::try_pop(size_t iworker, Task& task) {
+  // Newest tasks first on the local deque; they are the most likely to still
+  // be in cache.
+  if (iworker < workers_.size()) {
+    Worker& worker = *workers_[iworker];
+    std::lock_guard<std::mutex> guard(worker.mutex);
+    if (!worker.tasks.empty()) {
+      task = std::move(worker.tasks.back());
+      worker.tasks.pop_back();
+      return true;
+    }
+  }
+  std::lock_guard<std::mutex> guard(inject_mutex_);
+  if (!inject_tasks_.empty()) {
+    task = std::move(inject_tasks_.front());
+    inject_tasks_.pop_front();
+    return true;
+  }
+  return false;
+}
+bool ThreadPool::try_steal(size_t iworker, Task& task) {
+  // Oldest tasks first from the others; they tend to be the biggest ones.
+  // Contended deques are skipped at first and revisited with a blocking lock
+  // only if nothing could be stolen elsewhere.
+  bool is_contended = false;
+  for (uint32_t ipass = 0; ipass < 2; ++ipass) {
+    for (size_t i = 1; i <= workers_.size(); ++i) {
+      Worker& victim = *workers_[(iworker + i) % workers_.size()];
+      std::unique_lock<std::mutex> guard(victim.mutex, std::defer_lock);
+      if (ipass == 0) {
+        if (!guard.try_lock()) {
+          is_contended = true;
+          continue;
+        }
+      } else {
+        guard.lock();
+      }
+      if (!victim.tasks.empty()) {
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+      }
+    }
+    if (!is_contended) {
+      break;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::try_run_one() {
+  if (npending_.load() == 0) {
+    return false;
+  }
+  size_t iworker = l_worker_pool__ == this ? l_worker_idx__ : workers_.size();
+  Task task;
+  if (!try_pop(iworker, task) && !try_steal(iworker, task)) {
+    return false;
+  }
+  npending_.fetch_sub(1);
+  task();
+  return true;
+}
+
+void ThreadPool::work(size_t iworker) {
+  l_worker_pool__ = this;
+  l_worker_idx__ = iworker;
+  for (;;) {
+    if (try_run_one()) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    // Tasks queued before stopping are still run.
+    if (is_stopping_.load() && npending_.load() == 0) {
+      break;
+    }
+    // `spawn` notifies under `sleep_mutex_`, so no wake-up is lost. Pending
+    // tasks that couldn't be found yet, e.g., because they are being pushed,
+    // are retried right away.
+    sleep_cv_.wait(lock, [this]() {
+      return is_stopping_.load() || npending_.load() != 0;
+    });
+  }
+  l_worker_pool__ = nullptr;
+}
+
+ThreadPool& get_default_pool() {
+  static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+  return pool;
+}
+
+void enable_deterministic_mode() {
+  l_is_deterministic__.store(true);
+}
+void disable_deterministic_mode() {
+  l_is_deterministic__.store(false);
+}
+bool is_deterministic_mode() {
+  return l_is_deterministic__.load(std::memory_order_relaxed);
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool) :
+  pool_(pool),
+  nrunning_(0),
+  exception_mutex_(),
+  exception_() {}
+TaskGroup::~TaskGroup() {
+  while (nrunning_.load(std::memory_order_acquire) != 0) {
+    if (!pool_.try_run_one()) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void TaskGroup::set_exception(std::exception_ptr exception) {
+  std::lock_guard<std::mutex> guard(exception_mutex_);
+  if (exception_ == nullptr) {
+    exception_ = exception;
+  }
+}
+
+void TaskGroup::wait() {
+  while (nrunning_.load(std::memory_order_acquire) != 0) {
+    if (!pool_.try_run_one()) {
+      std::this_thread::yield();
+    }
+  }
+  std::exception_ptr exception;
+  {
+    std::lock_guard<std::mutex> guard(exception_mutex_);
+    std::swap(exception, exception_);
+  }
+  if (exception != nullptr) {
+    std::rethrow_exception(exception);
+  }
+}
+
+} // namespace parallel
+
+} // namespace liong
@@ -0,0 +1,325 @@
+#include "gft/profile.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "gft/util.hpp"
+
+namespace liong {
+namespace profile {
+
+namespace detail {
+
+namespace {
+
+// Events recorded by a single thread. The mutex is only contended while
+// events are being collected or cleared.
+struct ProfileThreadBuffer {
+  uint32_t tid;
+  std::mutex mutex;
+  std::vector<ProfileEvent> events;
+};
+
+struct Profiler {
+  std::mutex registry_mutex;
+  std::vector<std::shared_ptr<ProfileThreadBuffer>> bufs;
+};
+
+Profiler& get_profiler() {
+  static Profiler profiler;
+  return profiler;
+}
+
+thread_local std::shared_ptr<ProfileThreadBuffer> l_profile_buf__;
+thread_local uint32_t l_profile_depth__ = 0;
+
+ProfileThreadBuffer& get_thread_profile_buf() {
+  if (l_profile_buf__ == nullptr) {
+    Profiler& profiler = get_profiler();
+    std::lock_guard<std::mutex> guard(profiler.registry_mutex);
+    l_profile_buf__ = std::make_shared<ProfileThreadBuffer>();
+    l_profile_buf__->tid = (uint32_t)profiler.bufs.size();
+    l_profile_buf__->events.reserve(4096);
+    profiler.bufs.emplace_back(l_profile_buf__);
+  }
+  return *l_profile_buf__;
+}
+
+} // namespace
+
+uint64_t get_profile_timestamp_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()
+  ).count();
+}
+uint32_t enter_profile_scope() {
+  return l_profile_depth__++;
+}
+void exit_profile_scope(const char* name, uint32_t depth, uint64_t begin_ns) {
+  uint64_t end_ns = get_profile_timestamp_ns();
+  --l_profile_depth__;
+
+  ProfileThreadBuffer& buf = get_thread_profile_buf();
+  std::lock_guard<std::mutex> guard(buf.mutex);
+  buf.events.emplace_back(
+    ProfileEvent { name, buf.tid, depth, begin_ns, end_ns }
+  );
+}
+
+} // namespace detail
+
+std::vector<ProfileEvent> collect_profile_events() {
+  detail::Profiler& profiler = detail::get_profiler();
+  std::lock_guard<std::mutex> guard(profiler.registry_mutex);
+
+  std::vector<ProfileEvent> out;
+  for (const auto& buf : profiler.bufs) {
+    std::lock_guard<std::mutex> buf_guard(buf->mutex);
+    out.insert(out.end(), buf->events.begin(), buf->events.end());
+  }
+
+  // Events are recorded when scopes close, so children come before their
+  // parents. Reorder them so that parents come first.
+  std::sort(
+    out.begin(), out.end(), [](const ProfileEvent& a, const ProfileEvent& b) {
+      if (a.tid != b.tid) {
+        return a.tid < b.tid;
+      }
+      if (a.begin_ns != b.begin_ns) {
+        return a.begin_ns < b.begin_ns;
+      }
+      return a.depth < b.depth;
+    }
+  );
+  return out;
+}
+void clear_profile_events() {
+  detail::Profiler& profiler = detail::get_profiler();
+  std::lock_guard<std::mutex> guard(profiler.registry_mutex);
+  for (const auto& buf : profiler.bufs) {
+    std::lock_guard<std::mutex> buf_guard(buf->mutex);
+    buf->events.clear();
+  }
+}
+
+json::JsonValue to_chrome_trace(const std::vector<ProfileEvent>& events) {
+  uint64_t epoch_ns = std::numeric_limits<uint64_t>::max();
+  for (const auto& event : events) {
+    epoch_ns = std::min(epoch_ns, event.begin_ns);
+  }
+
+  json::JsonArray trace_events {};
+  trace_events.inner.reserve(events.size());
+  for (const auto& event : events) {
+    // Timestamps are in microseconds.
+    json::JsonObject trace_event {};
+    trace_event["name"] = event.name;
+    trace_event["cat"] = "gft";
+    trace_event["ph"] = "X";
+    trace_event["ts"] = (event.begin_ns - epoch_ns) * 1e-3;
+    trace_event["dur"] = (event.end_ns - event.begin_ns) * 1e-3;
+    trace_event["pid"] = 0;
+    trace_event["tid"] = event.tid;
+    trace_events.inner.emplace_back(std::move(trace_event));
+  }
+
+  json::JsonObject out {};
+  out["traceEvents"] = std::move(trace_events);
+  out["displayTimeUnit"] = "ns";
+  return out;
+}
+void save_chrome_trace(
+  const char* path,
+  const std::vector<ProfileEvent>& events
+) {
+  util::save_text(path, json::print(to_chrome_trace(events)));
+}
+
+namespace {
+
+struct ProfileStats {
+  uint64_t ncall = 0;
+  uint64_t total_ns = 0;
+  uint64_t self_ns = 0;
+  uint64_t min_ns = std::numeric_limits<uint64_t>::max();
+  uint64_t max_ns = 0;
+
+  void push(uint64_t dur_ns) {
+    ++ncall;
+    total_ns += dur_ns;
+    self_ns += dur_ns;
+    min_ns = std::min(min_ns, dur_ns);
+    max_ns = std::max(max_ns, dur_ns);
+  }
+};
+
+ProfileSummaryEntry make_summary_entry(
+  const std::string& name,
+  uint32_t depth,
+  const ProfileStats& stats
+) {
+  ProfileSummaryEntry out {};
+  out.name = name;
+  out.depth = depth;
+  out.ncall = stats.ncall;
+  out.total_ns = stats.total_ns;
+  out.self_ns = stats.self_ns;
+  out.min_ns = stats.min_ns;
+  out.max_ns = stats.max_ns;
+  return out;
+}
+
+// Walk through the events and find the parent of each event, i.e., the
+// innermost enclosing scope on the same thread. `f` is called with the event
+// index and the parent index, which is `SIZE_MAX` for top-level events and
+// for events whose parent scope hasn't closed yet. `events` must be ordered as
+// returned by `collect_profile_events`.
+template<typename F>
+void walk_profile_tree(const std::vector<ProfileEvent>& events, F&& f) {
+  std::vector<size_t> stack;
+  for (size_t i = 0; i < events.size(); ++i) {
+    const ProfileEvent& event = events[i];
+    if (i != 0 && events[i - 1].tid != event.tid) {
+      stack.clear();
+    }
+    stack.resize(event.depth, SIZE_MAX);
+    f(i, stack.empty() ? SIZE_MAX : stack.back());
+    stack.emplace_back(i);
+  }
+}
+
+} // namespace
+
+std::vector<ProfileSummaryEntry> summarize_flat(
+  const std::vector<ProfileEvent>& events
+) {
+  std::map<std::string, ProfileStats> name2stats;
+  walk_profile_tree(events, [&](size_t i, size_t iparent) {
+    const ProfileEvent& event = events[i];
+    uint64_t dur_ns = event.end_ns - event.begin_ns;
+    name2stats[event.name].push(dur_ns);
+    if (iparent != SIZE_MAX) {
+      name2stats[events[iparent].name].self_ns -= dur_ns;
+    }
+  });
+
+  std::vector<ProfileSummaryEntry> out;
+  out.reserve(name2stats.size());
+  for (const auto& pair : name2stats) {
+    out.emplace_back(make_summary_entry(pair.first, 0, pair.second));
+  }
+  std::stable_sort(
+    out.begin(),
+    out.end(),
+    [](const ProfileSummaryEntry& a, const ProfileSummaryEntry& b) {
+      return a.total_ns > b.total_ns;
+    }
+  );
+  return out;
+}
+
+std::vector<ProfileSummaryEntry> summarize_hierarchical(
+  const std::vector<ProfileEvent>& events
+) {
+  struct Node {
+    std::string name;
+    uint32_t depth;
+    ProfileStats stats;
+    std::map<std::string, size_t> children;
+  };
+  // The root node is a placeholder.
+  std::vector<Node> nodes(1);
+  std::vector<size_t> event2node(events.size());
+
+  walk_profile_tree(events, [&](size_t i, size_t iparent) {
+    const ProfileEvent& event = events[i];
+    uint64_t dur_ns = event.end_ns - event.begin_ns;
+
+    size_t iparent_node = iparent == SIZE_MAX ? 0 : event2node[iparent];
+    auto it = nodes[iparent_node].children.find(event.name);
+    size_t inode;
+    if (it == nodes[iparent_node].children.end()) {
+      inode = nodes.size();
+      nodes[iparent_node].children.emplace(event.name, inode);
+      Node node {};
+      node.name = event.name;
+      node.depth = iparent_node == 0 ? 0 : nodes[iparent_node].depth + 1;
+      nodes.emplace_back(std::move(node));
+    } else {
+      inode = it->second;
+    }
+    event2node[i] = inode;
+
+    nodes[inode].stats.push(dur_ns);
+    if (iparent_node != 0) {
+      nodes[iparent_node].stats.self_ns -= dur_ns;
+    }
+  });
+
+  std::vector<ProfileSummaryEntry> out;
+  out.reserve(nodes.size() - 1);
+  std::vector<size_t> stack { 0 };
+  while (!stack.empty()) {
+    size_t inode = stack.back();
+    stack.pop_back();
+    if (inode != 0) {
+      const Node& node = nodes[inode];
+      out.emplace_back(make_summary_entry(node.name, node.depth, node.stats));
+    }
+
+    // Push in ascending order so that the child taking the most time is
+    // visited first.
+    std::vector<size_t> children;
+    for (const auto& pair : nodes[inode].children) {
+      children.emplace_back(pair.second);
+    }
+    std::stable_sort(children.begin(), children.end(), [&](size_t a, size_t b) {
+      return nodes[a].stats.total_ns < nodes[b].stats.total_ns;
+    });
+    stack.insert(stack.end(), children.begin(), children.end());
+  }
+  return out;
+}
+
+std::string print_profile_summary(
+  const std::vector<ProfileSummaryEntry>& entries
+) {
+  std::string out;
+  char buf[256];
+  std::snprintf(
+    buf,
+    sizeof(buf),
+    "%-40s %10s %12s %12s %12s %12s %12s\n",
+    "name",
+    "ncall",
+    "total (ms)",
+    "self (ms)",
+    "avg (us)",
+    "min (us)",
+    "max (us)"
+  );
+  out += buf;
+  for (const auto& entry : entries) {
+    std::string name = std::string(entry.depth * 2, ' ') + entry.name;
+    std::snprintf(
+      buf,
+      sizeof(buf),
+      "%-40s %10llu %12.3f %12.3f %12.3f %12.3f %12.3f\n",
+      name.c_str(),
+      (unsigned long long)entry.ncall,
+      entry.total_ns * 1e-6,
+      entry.self_ns * 1e-6,
+      entry.total_ns * 1e-3 / entry.ncall,
+      entry.min_ns * 1e-3,
+      entry.max_ns * 1e-3
+    );
+    out += buf;
+  }
+  return out;
+}
+
+} // namespace profile
+} // namespace liong
@@ -0,0 +1,295 @@
+// # Thin SIMD wrappers for geometry kernels.
+// @PENGUINLIONG
+#pragma once
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define L_SIMD_SSE 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#define L_SIMD_AVX 1
+#include <immintrin.h>
+#endif
+
+namespace liong {
+namespace simd {
+
+// Widest vector the build targets, for kernels streaming over arrays.
+#if defined(L_SIMD_AVX)
+constexpr int NATIVE_WIDTH = 8;
+#else
+constexpr int NATIVE_WIDTH = 4;
+#endif
+
+// `N` float lanes. Widths without an instruction set backing them fall back
+// to plain loops, which compilers usually vectorize anyway.
+template<int N>
+struct Float {
+  float x[N];
+};
+// Lane mask with all bits of a lane set for true.
+template<int N>
+struct Mask {
+  uint32_t x[N];
+};
+
+#define L_SIMD_FALLBACK_BINOP(ty, op, expr)         \
+  template<int N>                                   \
+  inline ty<N> op(const ty<N>& a, const ty<N>& b) { \
+    ty<N> out;                                      \
+    for (int i = 0; i < N; ++i) {                   \
+      out.x[i] = (expr);                            \
+    }                                               \
+    return out;                                     \
+  }
+#define L_SIMD_FALLBACK_CMP(op, cmp)                        \
+  template<int N>                                           \
+  inline Mask<N> op(const Float<N>& a, const Float<N>& b) { \
+    Mask<N> out;                                            \
+    for (int i = 0; i < N; ++i) {                           \
+      out.x[i] = a.x[i] cmp b.x[i] ? ~0u : 0u;              \
+    }                                                       \
+    return out;                                             \
+  }
+
+template<int N>
+inline Float<N> load(const float* x) {
+  Float<N> out;
+  for (int i = 0; i < N; ++i) {
+    out.x[i] = x[i];
+  }
+  return out;
+}
+template<int N>
+inline void store(float* out, const Float<N>& a) {
+  for (int i = 0; i < N; ++i) {
+    out[i] = a.x[i];
+  }
+}
+template<int N>
+inline Float<N> set1(float x) {
+  Float<N> out;
+  for (int i = 0; i < N; ++i) {
+    out.x[i] = x;
+  }
+  return out;
+}
+L_SIMD_FALLBACK_BINOP(Float, operator+, a.x[i] + b.x[i])
+L_SIMD_FALLBACK_BINOP(Float, operator-, a.x[i] - b.x[i])
+L_SIMD_FALLBACK_BINOP(Float, operator*, a.x[i] * b.x[i])
+L_SIMD_FALLBACK_BINOP(Float, operator/, a.x[i] / b.x[i])
+// `min` and `max` return `b` if either operand is NaN, like `minps`/`maxps`.
+L_SIMD_FALLBACK_BINOP(Float, min, a.x[i] < b.x[i] ? a.x[i] : b.x[i])
+L_SIMD_FALLBACK_BINOP(Float, max, a.x[i] > b.x[i] ? a.x[i] : b.x[i])
+L_SIMD_FALLBACK_CMP(operator==, ==)
+L_SIMD_FALLBACK_CMP(operator<, <)
+L_SIMD_FALLBACK_CMP(operator<=, <=)
+L_SIMD_FALLBACK_CMP(operator>, >)
+L_SIMD_FALLBACK_CMP(operator>=, >=)
+L_SIMD_FALLBACK_BINOP(Mask, operator&, a.x[i] & b.x[i])
+L_SIMD_FALLBACK_BINOP(Mask, operator|, a.x[i] | b.x[i])
+// Lanes of `a` where `mask` is set, `b` elsewhere.
+template<int N>
+inline Float<N> select(
+  const Mask<N>& mask,
+  const Float<N>& a,
+  const Float<N>& b
+) {
+  Float<N> out;
+  for (int i = 0; i < N; ++i) {
+    out.x[i] = mask.x[i] != 0 ? a.x[i] : b.x[i];
+  }
+  return out;
+}
+// Bit `i` is set if lane `i` is set.
+template<int N>
+inline uint32_t movemask(const Mask<N>& mask) {
+  uint32_t out = 0;
+  for (int i = 0; i < N; ++i) {
+    out |= (mask.x[i] != 0 ? 1u : 0u) << i;
+  }
+  return out;
+}
+
+#undef L_SIMD_FALLBACK_BINOP
+#undef L_SIMD_FALLBACK_CMP
+
+#ifdef L_SIMD_SSE
+template<>
+struct Float<4> {
+  __m128 v;
+};
+template<>
+struct Mask<4> {
+  __m128 v;
+};
+
+template<>
+inline Float<4> load<4>(const float* x) {
+  return { _mm_loadu_ps(x) };
+}
+template<>
+inline void store<4>(float* out, const Float<4>& a) {
+  _mm_storeu_ps(out, a.v);
+}
+template<>
+inline Float<4> set1<4>(float x) {
+  return { _mm_set1_ps(x) };
+}
+inline Float<4> operator+(const Float<4>& a, const Float<4>& b) {
+  return { _mm_add_ps(a.v, b.v) };
+}
+inline Float<4> operator-(const Float<4>& a, const Float<4>& b) {
+  return { _mm_sub_ps(a.v, b.v) };
+}
+inline Float<4> operator*(const Float<4>& a, const Float<4>& b) {
+  return { _mm_mul_ps(a.v, b.v) };
+}
+inline Float<4> operator/(const Float<4>& a, const Float<4>& b) {
+  return { _mm_div_ps(a.v, b.v) };
+}
+inline Float<4> min(const Float<4>& a, const Float<4>& b) {
+  return { _mm_min_ps(a.v, b.v) };
+}
+inline Float<4> max(const Float<4>& a, const Float<4>& b) {
+  return { _mm_max_ps(a.v, b.v) };
+}
+inline Mask<4> operator==(const Float<4>& a, const Float<4>& b) {
+  return { _mm_cmpeq_ps(a.v, b.v) };
+}
+inline Mask<4> operator<(const Float<4>& a, const Float<4>& b) {
+  return { _mm_cmplt_ps(a.v, b.v) };
+}
+inline Mask<4> operator<=(const Float<4>& a, const Float<4>& b) {
+  return { _mm_cmple_ps(a.v, b.v) };
+}
+inline Mask<4> operator>(const Float<4>& a, const Float<4>& b) {
+  return { _mm_cmpgt_ps(a.v, b.v) };
+}
+inline Mask<4> operator>=(const Float<4>& a, const Float<4>& b) {
+  return { _mm_cmpge_ps(a.v, b.v) };
+}
+inline Mask<4> operator&(const Mask<4>& a, const Mask<4>& b) {
+  return { _mm_and_ps(a.v, b.v) };
+}
+inline Mask<4> operator|(const Mask<4>& a, const Mask<4>& b) {
+  return { _mm_or_ps(a.v, b.v) };
+}
+inline Float<4> select(
+  const Mask<4>& mask,
+  const Float<4>& a,
+  const Float<4>& b
+) {
+  return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) };
+}
+inline uint32_t movemask(const Mask<4>& mask) {
+  return (uint32_t)_mm_movemask_ps(mask.v);
+}
+#endif // L_SIMD_SSE
+
+#ifdef L_SIMD_AVX
+template<>
+struct Float<8> {
+  __m256 v;
+};
+template<>
+struct Mask<8> {
+  __m256 v;
+};
+
+template<>
+inline Float<8> load<8>(const float* x) {
+  return { _mm256_loadu_ps(x) };
+}
+template<>
+inline void store<8>(float* out, const Float<8>& a) {
+  _mm256_storeu_ps(out, a.v);
+}
+template<>
+inline Float<8> set1<8>(float x) {
+  return { _mm256_set1_ps(x) };
+}
+inline Float<8> operator+(const Float<8>& a, const Float<8>& b) {
+  return { _mm256_add_ps(a.v, b.v) };
+}
+inline Float<8> operator-(const Float<8>& a, const Float<8>& b) {
+  return { _mm256_sub_ps(a.v, b.v) };
+}
+inline Float<8> operator*(const Float<8>& a, const Float<8>& b) {
+  return { _mm256_mul_ps(a.v, b.v) };
+}
+inline Float<8> operator/(const Float<8>& a, const Float<8>& b) {
+  return { _mm256_div_ps(a.v, b.v) };
+}
+inline Float<8> min(const Float<8>& a, const Float<8>& b) {
+  return { _mm256_min_ps(a.v, b.v) };
+}
+inline Float<8> max(const Float<8>& a, const Float<8>& b) {
+  return { _mm256_max_ps(a.v, b.v) };
+}
+inline Mask<8> operator==(const Float<8>& a, const Float<8>& b) {
+  return { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) };
+}
+inline Mask<8> operator<(const Float<8>& a, const Float<8>& b) {
+  return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) };
+}
+inline Mask<8> operator<=(const Float<8>& a, const Float<8>& b) {
+  return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) };
+}
+inline Mask<8> operator>(const Float<8>& a, const Float<8>& b) {
+  return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) };
+}
+inline Mask<8> operator>=(const Float<8>& a, const Float<8>& b) {
+  return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) };
+}
+inline Mask<8> operator&(const Mask<8>& a, const Mask<8>& b) {
+  return { _mm256_and_ps(a.v, b.v) };
+}
+inline Mask<8> operator|(const Mask<8>& a, const Mask<8>& b) {
+  return { _mm256_or_ps(a.v, b.v) };
+}
+inline Float<8> select(
+  const Mask<8>& mask,
+  const Float<8>& a,
+  const Float<8>& b
+) {
+  return { _mm256_blendv_ps(b.v, a.v, mask.v) };
+}
+inline uint32_t movemask(const Mask<8>& mask) {
+  return (uint32_t)_mm256_movemask_ps(mask.v);
+}
+#endif // L_SIMD_AVX
+
+template<int N>
+inline Float<N> abs(const Float<N>& a) {
+  return max(a, set1<N>(0.0f) - a);
+}
+
+// Helpers for 3D vectors of lanes.
+template<int N>
+struct Float3 {
+  Float<N> x;
+  Float<N> y;
+  Float<N> z;
+};
+template<int N>
+inline Float3<N> operator-(const Float3<N>& a, const Float3<N>& b) {
+  return { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+template<int N>
+inline Float<N> dot(const Float3<N>& a, const Float3<N>& b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+template<int N>
+inline Float3<N> cross(const Float3<N>& a, const Float3<N>& b) {
+  return {
+    a.y * b.z - a.z * b.y,
+    a.z * b.x - a.x * b.z,
+    a.x * b.y - a.y * b.x,
+  };
+}
+
+} // namespace simd
+} // namespace liong
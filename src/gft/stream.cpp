@@ -1,6 +1,14 @@
 #include <cstdlib>
+#include <algorithm>
 #include "gft/stream.hpp"
 #include "gft/assert.hpp"
+#ifndef _WIN32
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif // _WIN32
 
 namespace liong {
 namespace stream {
@@ -20,10 +28,243 @@ void ReadStream::extract_data(void* out, size_t size) {
   offset_ += size;
 }
 
+bool ReadStream::try_extract_uleb128(uint64_t& out) {
+  const uint8_t* beg = (const uint8_t*)pos();
+  size_t n = std::min(size_remain(), detail::MAX_LEB128_SIZE);
+  uint64_t x = 0;
+  for (size_t i = 0; i < n; ++i) {
+    uint8_t byte = beg[i];
+    // The 10th byte can only contribute the highest bit.
+    if (i == detail::MAX_LEB128_SIZE - 1 && byte > 1) {
+      return false;
+    }
+    x |= (uint64_t)(byte & 0x7F) << (i * 7);
+    if ((byte & 0x80) == 0) {
+      offset_ += i + 1;
+      out = x;
+      return true;
+    }
+  }
+  return false;
+}
+bool ReadStream::try_extract_sleb128(int64_t& out) {
+  const uint8_t* beg = (const uint8_t*)pos();
+  size_t n = std::min(size_remain(), detail::MAX_LEB128_SIZE);
+  uint64_t x = 0;
+  for (size_t i = 0; i < n; ++i) {
+    uint8_t byte = beg[i];
+    // The 10th byte holds the highest bit and its sign extension, so it can
+    // only be all zeros or all ones.
+    if (i == detail::MAX_LEB128_SIZE - 1 && byte != 0x00 && byte != 0x7F) {
+      return false;
+    }
+    x |= (uint64_t)(byte & 0x7F) << (i * 7);
+    if ((byte & 0x80) == 0) {
+      uint32_t nbit = (uint32_t)(i + 1) * 7;
+      if (nbit < 64 && (byte & 0x40) != 0) {
+        // Sign extension.
+        x |= ~uint64_t(0) << nbit;
+      }
+      offset_ += i + 1;
+      out = (int64_t)x;
+      return true;
+    }
+  }
+  return false;
+}
+
 void WriteStream::append_data(const void* data, size_t size) {
-  size_t offset = data_.size();
-  data_.resize(offset + size);
-  std::memcpy(data_.data() + offset, data, size);
+  // Don't `resize` here; it zero-fills the new space before we overwrite it.
+  const uint8_t* beg = (const uint8_t*)data;
+  data_.insert(data_.end(), beg, beg + size);
+}
+
+
+ChunkedWriteStream::Chunk& ChunkedWriteStream::next_writable_chunk(
+  size_t size_hint
+) {
+  if (!chunks_.empty()) {
+    Chunk& chunk = chunks_.at(ichunk_);
+    if (chunk.size < chunk.capacity) {
+      return chunk;
+    }
+    if (ichunk_ + 1 < chunks_.size()) {
+      // Move on to a reserved chunk.
+      Chunk& next_chunk = chunks_.at(++ichunk_);
+      next_chunk.offset = size_;
+      return next_chunk;
+    }
+  }
+
+  size_t capacity = std::max(chunk_size_, size_hint);
+  Chunk chunk {};
+  // Intentionally default-initialized.
+  chunk.owned.reset(new uint8_t[capacity]);
+  chunk.data = chunk.owned.get();
+  chunk.offset = size_;
+  chunk.size = 0;
+  chunk.capacity = capacity;
+  chunks_.emplace_back(std::move(chunk));
+  ichunk_ = chunks_.size() - 1;
+  return chunks_.back();
+}
+ChunkedWriteStream::Chunk& ChunkedWriteStream::locate_chunk(size_t offset) {
+  auto it = std::upper_bound(
+    chunks_.begin(),
+    chunks_.begin() + ichunk_ + 1,
+    offset,
+    [](size_t offset, const Chunk& chunk) { return offset < chunk.offset; }
+  );
+  L_ASSERT(it != chunks_.begin());
+  return *(--it);
+}
+
+void ChunkedWriteStream::reserve(size_t size) {
+  size_t size_avail = 0;
+  for (size_t i = ichunk_; i < chunks_.size(); ++i) {
+    const Chunk& chunk = chunks_.at(i);
+    size_avail += chunk.capacity - chunk.size;
+  }
+  if (size_avail >= size) {
+    return;
+  }
+
+  size_t capacity = std::max(chunk_size_, size - size_avail);
+  Chunk chunk {};
+  chunk.owned.reset(new uint8_t[capacity]);
+  chunk.data = chunk.owned.get();
+  chunk.offset = size_;
+  chunk.size = 0;
+  chunk.capacity = capacity;
+  chunks_.emplace_back(std::move(chunk));
+}
+
+void ChunkedWriteStream::append_data(const void* data, size_t size) {
+  const uint8_t* src = (const uint8_t*)data;
+  while (size > 0) {
+    Chunk& chunk = next_writable_chunk(size);
+    size_t n = std::min(size, chunk.capacity - chunk.size);
+    std::memcpy(chunk.owned.get() + chunk.size, src, n);
+    chunk.size += n;
+    size_ += n;
+    src += n;
+    size -= n;
+  }
+}
+void ChunkedWriteStream::append_data_ref(const void* data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+
+  Chunk chunk {};
+  chunk.owned = nullptr;
+  chunk.data = (const uint8_t*)data;
+  chunk.offset = size_;
+  chunk.size = size;
+  chunk.capacity = size;
+
+  // Insert after the current chunk, or replace the current chunk if nothing
+  // has been written to it yet. Reserved chunks are kept for later appends.
+  size_t ichunk = 0;
+  if (!chunks_.empty()) {
+    ichunk = chunks_.at(ichunk_).size == 0 ? ichunk_ : ichunk_ + 1;
+  }
+  chunks_.insert(chunks_.begin() + ichunk, std::move(chunk));
+  ichunk_ = ichunk;
+  size_ += size;
+}
+
+void ChunkedWriteStream::patch_data(
+  size_t offset,
+  const void* data,
+  size_t size
+) {
+  L_ASSERT(offset + size <= size_, "patch is out of range");
+  const uint8_t* src = (const uint8_t*)data;
+  while (size > 0) {
+    Chunk& chunk = locate_chunk(offset);
+    L_ASSERT(
+      chunk.owned != nullptr, "cannot patch data appended by reference"
+    );
+    size_t local_offset = offset - chunk.offset;
+    size_t n = std::min(size, chunk.size - local_offset);
+    std::memcpy(chunk.owned.get() + local_offset, src, n);
+    offset += n;
+    src += n;
+    size -= n;
+  }
+}
+
+void ChunkedWriteStream::save(const char* path) const {
+  size_t nchunk_written = chunks_.empty() ? 0 : ichunk_ + 1;
+#ifdef _WIN32
+  std::ofstream f(path, std::ios::trunc | std::ios::out | std::ios::binary);
+  L_ASSERT(f.is_open(), "unable to open file: ", path);
+  for (size_t i = 0; i < nchunk_written; ++i) {
+    const Chunk& chunk = chunks_.at(i);
+    f.write((const char*)chunk.data, chunk.size);
+  }
+  f.close();
+#else
+#ifdef IOV_MAX
+  const size_t MAX_NIOV = IOV_MAX;
+#else
+  const size_t MAX_NIOV = 16;
+#endif // IOV_MAX
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  L_ASSERT(fd >= 0, "unable to open file: ", path);
+
+  std::vector<iovec> iovs;
+  iovs.reserve(nchunk_written);
+  for (size_t i = 0; i < nchunk_written; ++i) {
+    const Chunk& chunk = chunks_.at(i);
+    if (chunk.size > 0) {
+      iovs.emplace_back(iovec { (void*)chunk.data, chunk.size });
+    }
+  }
+
+  size_t iiov = 0;
+  while (iiov < iovs.size()) {
+    int niov = (int)std::min(iovs.size() - iiov, MAX_NIOV);
+    ssize_t nwritten = writev(fd, iovs.data() + iiov, niov);
+    if (nwritten < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    // Skip the fully written buffers and adjust a partially written one.
+    size_t n = (size_t)nwritten;
+    while (n > 0) {
+      iovec& iov = iovs.at(iiov);
+      if (n >= iov.iov_len) {
+        n -= iov.iov_len;
+        ++iiov;
+      } else {
+        iov.iov_base = (uint8_t*)iov.iov_base + n;
+        iov.iov_len -= n;
+        n = 0;
+      }
+    }
+  }
+  close(fd);
+  L_ASSERT(iiov == iovs.size(), "unable to write file: ", path);
+#endif // _WIN32
+}
+
+std::vector<uint8_t> ChunkedWriteStream::take() {
+  size_t nchunk_written = chunks_.empty() ? 0 : ichunk_ + 1;
+  std::vector<uint8_t> out;
+  out.reserve(size_);
+  for (size_t i = 0; i < nchunk_written; ++i) {
+    const Chunk& chunk = chunks_.at(i);
+    out.insert(out.end(), chunk.data, chunk.data + chunk.size);
+  }
+  chunks_.clear();
+  size_ = 0;
+  ichunk_ = 0;
+  return out;
 }
 
 } // namespace stream
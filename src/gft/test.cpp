@@ -1,6 +1,12 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <exception>
+#include <mutex>
+#include <thread>
 #include "gft/test.hpp"
 #include "gft/log.hpp"
+#include "gft/util.hpp"
 
 namespace liong {
 
@@ -20,38 +26,241 @@ TestRegistry& TestRegistry::get_inst() {
 }
 
 int TestRegistry::reg(const std::string& name, std::function<void()>&& func) {
-  tests.emplace(name, Entry { func });
+  tests.emplace(name, Entry { func, false });
   return 0;
 }
+int TestRegistry::reg_serial(
+  const std::string& name,
+  std::function<void()>&& func
+) {
+  tests.emplace(name, Entry { func, true });
+  return 0;
+}
+
+namespace {
+
+typedef std::pair<const std::string, TestRegistry::Entry> TestEntryPair;
+
+struct TestLogRecord {
+  log::LogLevel lv;
+  std::string msg;
+};
+// Records logged by the test running on this thread, when tests run in
+// parallel. They are forwarded to `l_forward_log_callback__` as a whole
+// after the test, so that outputs of concurrent tests don't interleave.
+thread_local std::vector<TestLogRecord>* l_test_logs__ = nullptr;
+log::LogCallback l_forward_log_callback__ = nullptr;
+
+void buffer_test_log(log::LogLevel lv, const std::string& msg) {
+  if (l_test_logs__ != nullptr) {
+    l_test_logs__->emplace_back(TestLogRecord { lv, msg });
+  } else {
+    // Logged by a thread that isn't running a test, e.g., a pool worker.
+    l_forward_log_callback__(lv, msg);
+  }
+}
+
+TestResult run_test(const TestEntryPair& pair) {
+  TestResult out {};
+  out.name = pair.first;
+
+  L_INFO("[", pair.first, "]");
+  log::push_indent();
+  auto beg = std::chrono::steady_clock::now();
+  try {
+    pair.second.f();
+    out.is_succ = true;
+  } catch (const std::exception& e) {
+    L_ERROR("unit test '", pair.first, "' threw an exception");
+    L_ERROR(e.what());
+    out.error = e.what();
+  } catch (...) {
+    L_ERROR("unit test '", pair.first, "' threw an illiterate exception");
+    out.error = "illiterate exception";
+  }
+  auto end = std::chrono::steady_clock::now();
+  log::pop_indent();
+
+  out.duration_ns =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(end - beg).count();
+  return out;
+}
+
+// Slowest tests first; tests that have never been timed are assumed to be the
+// slowest.
+void sort_by_duration(
+  std::vector<const TestEntryPair*>& pairs,
+  const std::map<std::string, uint64_t>& name2duration_ns
+) {
+  auto get_duration_ns = [&](const TestEntryPair* pair) {
+    auto it = name2duration_ns.find(pair->first);
+    return it == name2duration_ns.end() ? UINT64_MAX : it->second;
+  };
+  std::stable_sort(
+    pairs.begin(),
+    pairs.end(),
+    [&](const TestEntryPair* a, const TestEntryPair* b) {
+      return get_duration_ns(a) > get_duration_ns(b);
+    }
+  );
+}
+
+} // namespace
 
 TestReport TestRegistry::run_all() {
+  return run_all(TestConfig {});
+}
+TestReport TestRegistry::run_all(const TestConfig& cfg) {
   const auto& tests = get_inst().tests;
 
+  std::vector<const TestEntryPair*> parallel_tests;
+  std::vector<const TestEntryPair*> serial_tests;
+  for (const auto& pair : tests) {
+    if (!util::match_wildcard(cfg.filter, pair.first)) {
+      continue;
+    }
+    if (pair.second.is_serial) {
+      serial_tests.emplace_back(&pair);
+    } else {
+      parallel_tests.emplace_back(&pair);
+    }
+  }
+  sort_by_duration(parallel_tests, cfg.name2duration_ns);
+  sort_by_duration(serial_tests, cfg.name2duration_ns);
+
   TestReport out {};
-  if (tests.empty()) {
+  size_t ntest = parallel_tests.size() + serial_tests.size();
+  if (ntest == 0) {
     L_INFO("no test to run");
     return out;
-  } else {
-    L_INFO("scheduling ", tests.size(), " tests");
   }
 
-  for (const auto& pair : tests) {
-    L_INFO("[", pair.first, "]");
-    log::push_indent();
-    try {
-      pair.second.f();
-    } catch (const std::exception& e) {
-      L_ERROR("unit test '", pair.first, "' threw an exception");
-      L_ERROR(e.what());
-      ++out.nfail;
-      continue;
-    } catch (...) {
-      L_ERROR("unit test '", pair.first, "' threw an illiterate exception");
+  uint32_t nthread = cfg.nthread;
+  if (nthread == 0) {
+    nthread = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  nthread = (uint32_t)std::min<size_t>(nthread, parallel_tests.size());
+  L_INFO(
+    "scheduling ", ntest, " tests on ", std::max(nthread, 1u), " threads"
+  );
+
+  std::mutex report_mutex;
+  auto push_result = [&](TestResult&& result) {
+    std::lock_guard<std::mutex> guard(report_mutex);
+    if (result.is_succ) {
+      ++out.nsucc;
+    } else {
       ++out.nfail;
-      continue;
     }
-    log::pop_indent();
-    ++out.nsucc;
+    out.results.emplace_back(std::move(result));
+  };
+
+  auto beg = std::chrono::steady_clock::now();
+  if (nthread <= 1) {
+    for (const auto* pair : parallel_tests) {
+      push_result(run_test(*pair));
+    }
+  } else {
+    // Parallel tests don't change the log callback; those that do are serial.
+    l_forward_log_callback__ = log::detail::l_log_callback__;
+    if (l_forward_log_callback__ != nullptr) {
+      log::set_log_callback(&buffer_test_log);
+    }
+    std::mutex output_mutex;
+
+    std::atomic<size_t> inext { 0 };
+    std::vector<std::thread> threads;
+    threads.reserve(nthread);
+    for (uint32_t i = 0; i < nthread; ++i) {
+      threads.emplace_back([&]() {
+        std::vector<TestLogRecord> logs;
+        for (;;) {
+          size_t itest = inext.fetch_add(1);
+          if (itest >= parallel_tests.size()) {
+            break;
+          }
+          l_test_logs__ = &logs;
+          TestResult result = run_test(*parallel_tests[itest]);
+          l_test_logs__ = nullptr;
+          if (l_forward_log_callback__ != nullptr) {
+            std::lock_guard<std::mutex> guard(output_mutex);
+            for (const auto& record : logs) {
+              l_forward_log_callback__(record.lv, record.msg);
+            }
+          }
+          logs.clear();
+          push_result(std::move(result));
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    if (l_forward_log_callback__ != nullptr) {
+      log::set_log_callback(l_forward_log_callback__);
+    }
+  }
+  for (const auto* pair : serial_tests) {
+    push_result(run_test(*pair));
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  uint64_t elapsed_ms =
+    std::chrono::duration_cast<std::chrono::milliseconds>(end - beg).count();
+  L_INFO(
+    "ran ", ntest, " tests in ", elapsed_ms, "ms, ", out.nsucc,
+    " succeeded, ", out.nfail, " failed"
+  );
+  for (const auto& result : out.results) {
+    if (!result.is_succ) {
+      L_ERROR("failed: ", result.name);
+    }
+  }
+  return out;
+}
+
+json::JsonValue report2json(const TestReport& report) {
+  json::JsonArray tests {};
+  for (const auto& result : report.results) {
+    json::JsonObject test {};
+    test["name"] = result.name;
+    test["is_succ"] = result.is_succ;
+    test["duration_ns"] = result.duration_ns;
+    if (!result.is_succ) {
+      test["error"] = result.error;
+    }
+    tests.inner.emplace_back(std::move(test));
+  }
+  json::JsonObject out {};
+  out["nsucc"] = report.nsucc;
+  out["nfail"] = report.nfail;
+  out["tests"] = std::move(tests);
+  return out;
+}
+std::map<std::string, uint64_t> json2durations(const json::JsonValue& json) {
+  auto is_valid_test = [](const json::JsonValue& test) {
+    if (!test.is_obj()) {
+      return false;
+    }
+    auto name = test.obj.find("name");
+    auto duration_ns = test.obj.find("duration_ns");
+    return name != test.obj.inner.end() && name->second.is_str() &&
+      duration_ns != test.obj.inner.end() && duration_ns->second.is_num() &&
+      (double)duration_ns->second >= 0.0;
+  };
+
+  std::map<std::string, uint64_t> out;
+  auto tests = json.is_obj() ? json.obj.find("tests") : json.obj.inner.end();
+  if (tests == json.obj.inner.end() || !tests->second.is_arr()) {
+    L_WARN("ignored malformed test report without a list of tests");
+    return out;
+  }
+  for (const auto& test : tests->second.arr) {
+    if (!is_valid_test(test)) {
+      L_WARN("ignored malformed test report with an invalid test record");
+      return {};
+    }
+    out[test["name"].str] = (uint64_t)(double)test["duration_ns"];
   }
   return out;
 }
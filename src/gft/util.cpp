@@ -1,12 +1,44 @@
 #include "gft/util.hpp"
 #include "gft/assert.hpp"
+#include "gft/parallel.hpp"
+#include <algorithm>
 #include <chrono>
+#include <stdexcept>
 #include <thread>
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
 
 namespace liong {
 
 namespace util {
 
+namespace detail {
+
+thread_local std::ostringstream format_fallback_stream_;
+thread_local bool format_fallback_stream_in_use_ = false;
+
+std::ostringstream* acquire_format_fallback_stream() {
+  if (format_fallback_stream_in_use_) {
+    return nullptr;
+  }
+  format_fallback_stream_in_use_ = true;
+  return &format_fallback_stream_;
+}
+void release_format_fallback_stream() {
+  format_fallback_stream_in_use_ = false;
+}
+
+} // namespace detail
+
 std::vector<uint8_t> load_file(const char* path) {
   std::ifstream f(path, std::ios::ate | std::ios::binary | std::ios::in);
   L_ASSERT(f.is_open(), "unable to open file: ", path);
@@ -43,6 +75,192 @@ void save_text(const char* path, const std::string& txt) {
   f.close();
 }
 
+MappedFile::MappedFile() : data_(nullptr), size_(0) {
+#ifdef _WIN32
+  file_handle_ = INVALID_HANDLE_VALUE;
+  mapping_handle_ = nullptr;
+#endif // _WIN32
+}
+MappedFile::MappedFile(const char* path, MappedFileAccessHint hint) :
+  MappedFile() {
+  bool succ = try_map(path, hint, *this);
+  L_ASSERT(succ, "unable to map file: ", path);
+}
+MappedFile::MappedFile(MappedFile&& x) : MappedFile() {
+  *this = std::move(x);
+}
+MappedFile::~MappedFile() {
+  unmap();
+}
+MappedFile& MappedFile::operator=(MappedFile&& x) {
+  if (this != &x) {
+    unmap();
+    data_ = std::exchange(x.data_, nullptr);
+    size_ = std::exchange(x.size_, 0);
+#ifdef _WIN32
+    file_handle_ = std::exchange(x.file_handle_, INVALID_HANDLE_VALUE);
+    mapping_handle_ = std::exchange(x.mapping_handle_, nullptr);
+#endif // _WIN32
+  }
+  return *this;
+}
+
+#ifdef _WIN32
+void MappedFile::unmap() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_handle_ != nullptr) {
+    CloseHandle(mapping_handle_);
+  }
+  if (file_handle_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_handle_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  mapping_handle_ = nullptr;
+  file_handle_ = INVALID_HANDLE_VALUE;
+}
+bool MappedFile::try_map(
+  const char* path,
+  MappedFileAccessHint hint,
+  MappedFile& out
+) {
+  out.unmap();
+
+  DWORD flags = FILE_ATTRIBUTE_NORMAL;
+  switch (hint) {
+  case L_MAPPED_FILE_ACCESS_HINT_SEQUENTIAL:
+    flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+    break;
+  case L_MAPPED_FILE_ACCESS_HINT_RANDOM:
+    flags |= FILE_FLAG_RANDOM_ACCESS;
+    break;
+  default:
+    break;
+  }
+  HANDLE file = CreateFileA(
+    path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr
+  );
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  out.file_handle_ = file;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    out.unmap();
+    return false;
+  }
+  if (size.QuadPart == 0) {
+    // Empty files cannot be mapped.
+    return true;
+  }
+
+  HANDLE mapping =
+    CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    out.unmap();
+    return false;
+  }
+  out.mapping_handle_ = mapping;
+
+  const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (data == nullptr) {
+    out.unmap();
+    return false;
+  }
+  out.data_ = data;
+  out.size_ = (size_t)size.QuadPart;
+
+  if (hint == L_MAPPED_FILE_ACCESS_HINT_WILL_NEED) {
+    WIN32_MEMORY_RANGE_ENTRY range { (PVOID)data, out.size_ };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+  }
+  return true;
+}
+#else
+void MappedFile::unmap() {
+  if (data_ != nullptr) {
+    munmap((void*)data_, size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+bool MappedFile::try_map(
+  const char* path,
+  MappedFileAccessHint hint,
+  MappedFile& out
+) {
+  out.unmap();
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st {};
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+  if (st.st_size == 0) {
+    // Empty files cannot be mapped.
+    close(fd);
+    return true;
+  }
+
+  size_t size = (size_t)st.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file referenced.
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  int advice = MADV_NORMAL;
+  switch (hint) {
+  case L_MAPPED_FILE_ACCESS_HINT_SEQUENTIAL:
+    advice = MADV_SEQUENTIAL;
+    break;
+  case L_MAPPED_FILE_ACCESS_HINT_RANDOM:
+    advice = MADV_RANDOM;
+    break;
+  case L_MAPPED_FILE_ACCESS_HINT_WILL_NEED:
+    advice = MADV_WILLNEED;
+    break;
+  default:
+    break;
+  }
+  if (advice != MADV_NORMAL) {
+    // It's only a hint so failures are ignored.
+    madvise(data, size, advice);
+  }
+
+  out.data_ = data;
+  out.size_ = size;
+  return true;
+}
+#endif // _WIN32
+
+std::vector<std::future<MappedFile>> load_files_async(
+  const std::vector<std::string>& paths,
+  MappedFileAccessHint hint
+) {
+  parallel::ThreadPool& pool = parallel::get_default_pool();
+  std::vector<std::future<MappedFile>> out;
+  out.reserve(paths.size());
+  for (const auto& path : paths) {
+    out.emplace_back(pool.submit([path, hint]() {
+      MappedFile file {};
+      if (!MappedFile::try_map(path.c_str(), hint, file)) {
+        throw std::runtime_error("unable to open file: " + path);
+      }
+      return file;
+    }));
+  }
+  return out;
+}
+
 // Save an array of 8-bit unsigned int colors with RGBA channels packed from LSB
 // to MSB in a 32-bit unsigned int into a bitmap file.
 void save_bmp(const uint32_t* pxs, uint32_t w, uint32_t h, const char* path) {
@@ -114,6 +332,33 @@ bool ends_with(const std::string& end, const std::string& str) {
   }
   return true;
 }
+bool match_wildcard(const std::string& pattern, const std::string& str) {
+  // Position to resume from when a `*` has to consume more characters.
+  size_t star_pattern = std::string::npos;
+  size_t star_str = 0;
+  size_t i = 0;
+  size_t j = 0;
+  while (j < str.size()) {
+    if (i < pattern.size() && pattern[i] == '*') {
+      star_pattern = ++i;
+      star_str = j;
+    } else if (
+      i < pattern.size() && (pattern[i] == str[j] || pattern[i] == '?')
+    ) {
+      ++i;
+      ++j;
+    } else if (star_pattern != std::string::npos) {
+      i = star_pattern;
+      j = ++star_str;
+    } else {
+      return false;
+    }
+  }
+  while (i < pattern.size() && pattern[i] == '*') {
+    ++i;
+  }
+  return i == pattern.size();
+}
 std::vector<std::string> split(char sep, const std::string& str) {
   std::vector<std::string> out;
 
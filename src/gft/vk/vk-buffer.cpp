@@ -83,7 +83,7 @@ BufferRef VulkanBuffer::create(
   out->ctxt = ctxt_;
   out->buf = std::move(buf);
   out->dyn_detail = std::move(dyn_detail);
-  L_DEBUG("created buffer '", cfg.label, "'");
+  L_DEBUG_RATE_LIMITED(10, "created buffer '", cfg.label, "'");
 
   return out;
 }
@@ -91,7 +91,7 @@ VulkanBuffer::VulkanBuffer(VulkanContextRef ctxt, BufferInfo&& info) :
   Buffer(std::move(info)), ctxt(ctxt) {}
 VulkanBuffer::~VulkanBuffer() {
   if (buf) {
-    L_DEBUG("destroyed buffer '", info.label, "'");
+    L_DEBUG_RATE_LIMITED(10, "destroyed buffer '", info.label, "'");
   }
 }
 
@@ -106,12 +106,12 @@ void* VulkanBuffer::map(MemoryAccess map_access) {
                         : VK_ACCESS_HOST_WRITE_BIT;
   dyn_detail.stage = VK_PIPELINE_STAGE_HOST_BIT;
 
-  L_DEBUG("mapped buffer '", info.label, "'");
+  L_DEBUG_RATE_LIMITED(10, "mapped buffer '", info.label, "'");
   return (uint8_t*)mapped;
 }
 void VulkanBuffer::unmap() {
   vmaUnmapMemory(*ctxt->allocator, buf->alloc);
-  L_DEBUG("unmapped buffer '", info.label, "'");
+  L_DEBUG_RATE_LIMITED(10, "unmapped buffer '", info.label, "'");
 }
 
 }  // namespace vk
@@ -375,9 +375,6 @@ ContextRef _create_ctxt(
   out->submit_details = std::move(submit_details);
   out->img_samplers = std::move(img_samplers);
   out->depth_img_samplers = std::move(depth_img_samplers);
-  out->desc_set_detail = {};
-  out->cmd_pool_pool = {};
-  out->query_pool_pool = {};
   out->allocator = std::move(allocator);
 
   L_DEBUG(
@@ -428,10 +425,76 @@ ContextRef VulkanContext::create(
   return out;
 }
 
+// Pooled objects idle for longer than this are destroyed on the next
+// acquisition or release of the same kind of object, so that a burst of
+// concurrent work doesn't hold on to device memory while the context keeps
+// running. Idle objects are not referenced by any command buffer in flight
+// nor by any other thread, so they are safe to destroy on whichever thread
+// triggers the eviction; the descriptor pool map is guarded for this reason.
+const std::chrono::seconds MAX_POOLED_OBJ_IDLE_TIME(10);
+
+DescriptorSetPool::Config _get_desc_set_pool_cfg(VulkanContext& ctxt) {
+  DescriptorSetPool::Config out {};
+  out.max_idle = 1024;
+  out.max_idle_per_key = 64;
+  out.max_idle_time = MAX_POOLED_OBJ_IDLE_TIME;
+  out.on_destroy = [&ctxt](
+    const DescriptorSetKey& key,
+    sys::DescriptorSetRef& desc_set
+  ) {
+    // The descriptor set is freed with its descriptor pool.
+    ContextDescriptorSetDetail& detail = ctxt.desc_set_detail;
+    sys::DescriptorPoolRef desc_pool;
+    {
+      std::lock_guard<std::mutex> guard(detail.desc_pools_mutex);
+      auto it = detail.desc_pools.find(desc_set->desc_set);
+      if (it != detail.desc_pools.end()) {
+        desc_pool = std::move(it->second);
+        detail.desc_pools.erase(it);
+      }
+    }
+    desc_set.reset();
+  };
+  return out;
+}
+CommandPoolPool::Config _get_cmd_pool_pool_cfg() {
+  CommandPoolPool::Config out {};
+  out.max_idle_per_key = 16;
+  out.max_idle_time = MAX_POOLED_OBJ_IDLE_TIME;
+  return out;
+}
+QueryPoolPool::Config _get_query_pool_pool_cfg() {
+  QueryPoolPool::Config out {};
+  out.max_idle = 64;
+  out.max_idle_time = MAX_POOLED_OBJ_IDLE_TIME;
+  return out;
+}
+
+void _log_pool_counters(const char* name, const pool::SyncPoolCounters& c) {
+  L_DEBUG(
+    name, ": ", c.nhit, " hits, ", c.nmiss, " misses, ", c.nlive, " live, ",
+    c.nidle, " idle, ", c.nevicted, " evicted"
+  );
+}
+
 VulkanContext::VulkanContext(VulkanInstanceRef inst, ContextInfo&& info) :
-  Context(std::move(info)), inst(inst) {}
+  Context(std::move(info)),
+  inst(inst),
+  desc_set_detail {
+    {},
+    {},
+    {},
+    DescriptorSetPool(_get_desc_set_pool_cfg(*this)),
+  },
+  cmd_pool_pool(_get_cmd_pool_pool_cfg()),
+  query_pool_pool(_get_query_pool_pool_cfg()) {}
 VulkanContext::~VulkanContext() {
   if (dev) {
+    _log_pool_counters(
+      "descriptor set pool", desc_set_detail.desc_set_pool.counters()
+    );
+    _log_pool_counters("command pool pool", cmd_pool_pool.counters());
+    _log_pool_counters("query pool pool", query_pool_pool.counters());
     L_DEBUG("destroyed vulkan context '", info.label, "'");
   }
 }
@@ -476,15 +539,9 @@ sys::DescriptorSetLayoutRef VulkanContext::get_desc_set_layout(
   const std::vector<ResourceType>& rsc_tys
 ) {
   DescriptorSetKey desc_set_key = DescriptorSetKey::create(rsc_tys);
-  auto it = desc_set_detail.desc_set_layouts.find(desc_set_key);
-  if (it != desc_set_detail.desc_set_layouts.end()) {
-    return it->second;
-  } else {
-    sys::DescriptorSetLayoutRef desc_set_layout =
-      _create_desc_set_layout(*this, rsc_tys);
-    desc_set_detail.desc_set_layouts[desc_set_key] = desc_set_layout;
-    return desc_set_layout;
-  }
+  return *desc_set_detail.desc_set_layouts.get_or_compute(
+    desc_set_key, [&]() { return _create_desc_set_layout(*this, rsc_tys); }
+  );
 }
 
 sys::DescriptorPoolRef _create_desc_pool(
@@ -563,15 +620,21 @@ DescriptorSetPoolItem VulkanContext::acquire_desc_set(
 ) {
   L_ASSERT(!rsc_tys.empty());
   DescriptorSetKey key = DescriptorSetKey::create(rsc_tys);
-  if (desc_set_detail.desc_set_pool.has_free_item(key)) {
-    return desc_set_detail.desc_set_pool.acquire(std::move(key));
+  DescriptorSetPoolItem item{};
+  if (desc_set_detail.desc_set_pool.try_acquire(key, item)) {
+    return item;
   } else {
     sys::DescriptorPoolRef desc_pool = _create_desc_pool(*this, rsc_tys);
     sys::DescriptorSetLayoutRef desc_set_layout = get_desc_set_layout(rsc_tys);
     sys::DescriptorSetRef desc_set = _alloc_desc_set(
       *this, desc_pool->desc_pool, desc_set_layout->desc_set_layout
     );
-    desc_set_detail.desc_pools.emplace_back(std::move(desc_pool));
+    {
+      std::lock_guard<std::mutex> guard(desc_set_detail.desc_pools_mutex);
+      desc_set_detail.desc_pools.emplace(
+        desc_set->desc_set, std::move(desc_pool)
+      );
+    }
     return desc_set_detail.desc_set_pool.create(
       std::move(key), std::move(desc_set)
     );
@@ -591,9 +654,8 @@ sys::CommandPoolRef _create_cmd_pool(
 }
 
 CommandPoolPoolItem VulkanContext::acquire_cmd_pool(SubmitType submit_ty) {
-  if (cmd_pool_pool.has_free_item(submit_ty)) {
-    CommandPoolPoolItem item{};
-    item = cmd_pool_pool.acquire(std::move(submit_ty));
+  CommandPoolPoolItem item{};
+  if (cmd_pool_pool.try_acquire(submit_ty, item)) {
     VK_ASSERT << vkResetCommandPool(*dev, *item.value(), 0);
     return item;
   } else {
@@ -615,8 +677,9 @@ sys::QueryPoolRef _create_query_pool(
 }
 
 QueryPoolPoolItem VulkanContext::acquire_query_pool() {
-  if (query_pool_pool.has_free_item(0)) {
-    return query_pool_pool.acquire(0);
+  QueryPoolPoolItem item{};
+  if (query_pool_pool.try_acquire(0, item)) {
+    return item;
   } else {
     sys::QueryPoolRef query_pool =
       _create_query_pool(*this, VK_QUERY_TYPE_TIMESTAMP, 2);
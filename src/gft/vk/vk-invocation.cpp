@@ -5,6 +5,7 @@
 #include "gft/vk/vk-task.hpp"
 #include "gft/vk/vk-transaction.hpp"
 #include "gft/log.hpp"
+#include "gft/arena.hpp"
 
 namespace liong {
 namespace vk {
@@ -15,9 +16,11 @@ void _update_desc_set(
   const std::vector<ResourceType>& rsc_tys,
   const std::vector<ResourceView>& rsc_views
 ) {
-  std::vector<VkDescriptorBufferInfo> dbis;
-  std::vector<VkDescriptorImageInfo> diis;
-  std::vector<VkWriteDescriptorSet> wdss;
+  arena::ArenaScope scope(arena::get_scratch_arena());
+  arena::Vector<VkDescriptorBufferInfo> dbis(scope.arena);
+  arena::Vector<VkDescriptorImageInfo> diis(scope.arena);
+  arena::Vector<VkWriteDescriptorSet> wdss(scope.arena);
+  // Reserved so that the pointers to the infos stay valid.
   dbis.reserve(rsc_views.size());
   diis.reserve(rsc_views.size());
   wdss.reserve(rsc_views.size());
@@ -33,7 +36,8 @@ void _update_desc_set(
     dbi.range = buf_view.size;
     dbis.emplace_back(std::move(dbi));
 
-    L_DEBUG(
+    L_DEBUG_RATE_LIMITED(
+      10,
       "bound pool resource #", wdss.size(), " to buffer '", buf.info.label, "'"
     );
 
@@ -50,7 +54,8 @@ void _update_desc_set(
       dii.imageLayout = layout;
       diis.emplace_back(std::move(dii));
 
-      L_DEBUG(
+      L_DEBUG_RATE_LIMITED(
+        10,
         "bound pool resource #", wdss.size(), " to image '", img.info.label, "'"
       );
     } else if (rsc_view.rsc_view_ty == L_RESOURCE_VIEW_TYPE_DEPTH_IMAGE) {
@@ -63,7 +68,8 @@ void _update_desc_set(
       dii.imageLayout = layout;
       diis.emplace_back(std::move(dii));
 
-      L_DEBUG(
+      L_DEBUG_RATE_LIMITED(
+        10,
         "bound pool resource #",
         wdss.size(),
         " to depth image '",
@@ -115,8 +121,8 @@ void _update_desc_set(
   );
 }
 void _collect_task_invoke_transit(
-  const std::vector<ResourceView> rsc_views,
-  const std::vector<ResourceType> rsc_tys,
+  const std::vector<ResourceView>& rsc_views,
+  const std::vector<ResourceType>& rsc_tys,
   InvocationTransitionDetail& transit_detail
 ) {
   L_ASSERT(rsc_views.size() == rsc_tys.size());
@@ -168,31 +174,55 @@ void _collect_task_invoke_transit(
     }
   }
 }
+void _merge_transits(
+  const InvocationTransitionDetail& src,
+  InvocationTransitionDetail& dst
+) {
+  dst.buf_transit.insert(
+    dst.buf_transit.end(), src.buf_transit.begin(), src.buf_transit.end()
+  );
+  dst.img_transit.insert(
+    dst.img_transit.end(), src.img_transit.begin(), src.img_transit.end()
+  );
+  dst.depth_img_transit.insert(
+    dst.depth_img_transit.end(),
+    src.depth_img_transit.begin(),
+    src.depth_img_transit.end()
+  );
+}
 void _merge_subinvoke_transits(
   const std::vector<InvocationRef>& subinvokes,
   InvocationTransitionDetail& transit_detail
 ) {
+  // Size the lists once; the detail is kept by the invocation for its whole
+  // lifetime.
+  size_t nbuf_transit = transit_detail.buf_transit.size();
+  size_t nimg_transit = transit_detail.img_transit.size();
+  size_t ndepth_img_transit = transit_detail.depth_img_transit.size();
   for (const auto& subinvoke : subinvokes) {
-    const VulkanInvocationRef& subinvoke_ =
-      VulkanInvocation::from_hal(subinvoke);
     L_ASSERT(subinvoke != nullptr);
-    for (const auto& pair : subinvoke_->transit_detail.buf_transit) {
-      transit_detail.buf_transit.emplace_back(pair);
-    }
-    for (const auto& pair : subinvoke_->transit_detail.img_transit) {
-      transit_detail.img_transit.emplace_back(pair);
-    }
-    for (const auto& pair : subinvoke_->transit_detail.depth_img_transit) {
-      transit_detail.depth_img_transit.emplace_back(pair);
-    }
+    const InvocationTransitionDetail& src =
+      VulkanInvocation::from_hal(subinvoke)->transit_detail;
+    nbuf_transit += src.buf_transit.size();
+    nimg_transit += src.img_transit.size();
+    ndepth_img_transit += src.depth_img_transit.size();
+  }
+  transit_detail.buf_transit.reserve(nbuf_transit);
+  transit_detail.img_transit.reserve(nimg_transit);
+  transit_detail.depth_img_transit.reserve(ndepth_img_transit);
+
+  for (const auto& subinvoke : subinvokes) {
+    _merge_transits(
+      VulkanInvocation::from_hal(subinvoke)->transit_detail, transit_detail
+    );
   }
 }
 void _merge_subinvoke_transits(
   const VulkanInvocationRef& subinvoke,
   InvocationTransitionDetail& transit_detail
 ) {
-  std::vector<InvocationRef> subinvokes{subinvoke};
-  _merge_subinvoke_transits(subinvokes, transit_detail);
+  L_ASSERT(subinvoke != nullptr);
+  _merge_transits(subinvoke->transit_detail, transit_detail);
 }
 SubmitType _infer_submit_ty(const std::vector<InvocationRef>& subinvokes) {
   for (size_t i = 0; i < subinvokes.size(); ++i) {
@@ -914,7 +944,7 @@ const BufferView& _transit_rsc(
   );
 
   if (transact.level == VK_COMMAND_BUFFER_LEVEL_PRIMARY) {
-    L_DEBUG("inserted buffer barrier");
+    L_DEBUG_RATE_LIMITED(10, "inserted buffer barrier");
   }
 
   dyn_detail.access = dst_access;
@@ -965,7 +995,7 @@ const ImageView& _transit_rsc(
   );
 
   if (transact.level == VK_COMMAND_BUFFER_LEVEL_PRIMARY) {
-    L_DEBUG("inserted image barrier");
+    L_DEBUG_RATE_LIMITED(10, "inserted image barrier");
   }
 
   dyn_detail.access = dst_access;
@@ -1016,7 +1046,7 @@ const DepthImageView& _transit_rsc(
   );
 
   if (transact.level == VK_COMMAND_BUFFER_LEVEL_PRIMARY) {
-    L_DEBUG("inserted depth image barrier");
+    L_DEBUG_RATE_LIMITED(10, "inserted depth image barrier");
   }
 
   dyn_detail.access = dst_access;
@@ -1112,14 +1142,16 @@ std::vector<sys::FenceRef> _record_invoke_impl(
         &img_idx
       );
       if (res == VK_NOT_READY) {
-        L_DEBUG("failed to acquire image immediately");
+        L_DEBUG_RATE_LIMITED(10, "failed to acquire image immediately");
       }
     } while (res == VK_TIMEOUT);
     VK_ASSERT << res;
 
     transact.is_frozen = true;
 
-    L_DEBUG("applied presentation invocation (image #", img_idx, ")");
+    L_DEBUG_RATE_LIMITED(
+      10, "applied presentation invocation (image #", img_idx, ")"
+    );
     return {present_fence, acquire_fence};
   }
 
@@ -1138,7 +1170,9 @@ std::vector<sys::FenceRef> _record_invoke_impl(
       cmdbuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, *invoke.query_pool.value(), 0
     );
 
-    L_DEBUG("invocation '", invoke.info.label, "' will be timed");
+    L_DEBUG_RATE_LIMITED(
+      10, "invocation '", invoke.info.label, "' will be timed"
+    );
   }
 
   _transit_rscs(transact, invoke.transit_detail);
@@ -1148,7 +1182,9 @@ std::vector<sys::FenceRef> _record_invoke_impl(
     vkCmdCopyBuffer(
       cmdbuf, b2b_detail.src->buf, b2b_detail.dst->buf, 1, &b2b_detail.bc
     );
-    L_DEBUG("applied transfer invocation '", invoke.info.label, "'");
+    L_DEBUG_RATE_LIMITED(
+      10, "applied transfer invocation '", invoke.info.label, "'"
+    );
   } else if (invoke.b2i_detail) {
     const InvocationCopyBufferToImageDetail& b2i_detail = *invoke.b2i_detail;
     vkCmdCopyBufferToImage(
@@ -1159,7 +1195,9 @@ std::vector<sys::FenceRef> _record_invoke_impl(
       1,
       &b2i_detail.bic
     );
-    L_DEBUG("applied transfer invocation '", invoke.info.label, "'");
+    L_DEBUG_RATE_LIMITED(
+      10, "applied transfer invocation '", invoke.info.label, "'"
+    );
   } else if (invoke.i2b_detail) {
     const InvocationCopyImageToBufferDetail& i2b_detail = *invoke.i2b_detail;
     vkCmdCopyImageToBuffer(
@@ -1170,7 +1208,9 @@ std::vector<sys::FenceRef> _record_invoke_impl(
       1,
       &i2b_detail.bic
     );
-    L_DEBUG("applied transfer invocation '", invoke.info.label, "'");
+    L_DEBUG_RATE_LIMITED(
+      10, "applied transfer invocation '", invoke.info.label, "'"
+    );
   } else if (invoke.i2i_detail) {
     const InvocationCopyImageToImageDetail& i2i_detail = *invoke.i2i_detail;
     vkCmdCopyImage(
@@ -1182,7 +1222,9 @@ std::vector<sys::FenceRef> _record_invoke_impl(
       1,
       &i2i_detail.ic
     );
-    L_DEBUG("applied transfer invocation '", invoke.info.label, "'");
+    L_DEBUG_RATE_LIMITED(
+      10, "applied transfer invocation '", invoke.info.label, "'"
+    );
   } else if (invoke.comp_detail) {
     const InvocationComputeDetail& comp_detail = *invoke.comp_detail;
     const VulkanTaskRef& task = comp_detail.task;
@@ -1202,12 +1244,16 @@ std::vector<sys::FenceRef> _record_invoke_impl(
       );
     }
     vkCmdDispatch(cmdbuf, workgrp_count.x, workgrp_count.y, workgrp_count.z);
-    L_DEBUG("applied compute invocation '", invoke.info.label, "'");
+    L_DEBUG_RATE_LIMITED(
+      10, "applied compute invocation '", invoke.info.label, "'"
+    );
   } else if (invoke.graph_detail) {
     const InvocationGraphicsDetail& graph_detail = *invoke.graph_detail;
     const VulkanTaskRef& task = graph_detail.task;
 
-    std::vector<VkBuffer> vert_bufs{};
+    arena::ArenaScope scope(arena::get_scratch_arena());
+    arena::Vector<VkBuffer> vert_bufs(scope.arena);
+    vert_bufs.reserve(graph_detail.vert_bufs.size());
     for (const auto& vert_buf : graph_detail.vert_bufs) {
       vert_bufs.emplace_back(vert_buf->buf);
     }
@@ -1252,7 +1298,9 @@ std::vector<sys::FenceRef> _record_invoke_impl(
     } else {
       vkCmdDraw(cmdbuf, graph_detail.nvert, graph_detail.ninst, 0, 0);
     }
-    L_DEBUG("applied graphics invocation '", invoke.info.label, "'");
+    L_DEBUG_RATE_LIMITED(
+      10, "applied graphics invocation '", invoke.info.label, "'"
+    );
   } else if (invoke.pass_detail) {
     const InvocationRenderPassDetail& pass_detail = *invoke.pass_detail;
     const VulkanRenderPassRef& pass =
@@ -1272,13 +1320,18 @@ std::vector<sys::FenceRef> _record_invoke_impl(
     rpbi.clearValueCount = (uint32_t)pass->clear_values.size();
     rpbi.pClearValues = pass->clear_values.data();
 
-    std::vector<VkImageView> img_views(pass_detail.attms.size());
+    arena::ArenaScope scope(arena::get_scratch_arena());
+    arena::Vector<VkImageView> img_views(
+      pass_detail.attms.size(), VK_NULL_HANDLE, scope.arena
+    );
     for (size_t i = 0; i < pass_detail.attms.size(); ++i) {
       img_views.at(i) = pass_detail.attms.at(i)->img_view;
     }
 
     vkCmdBeginRenderPass(cmdbuf, &rpbi, sc);
-    L_DEBUG("render pass invocation '", invoke.info.label, "' began");
+    L_DEBUG_RATE_LIMITED(
+      10, "render pass invocation '", invoke.info.label, "' began"
+    );
 
     for (size_t i = 0; i < pass_detail.subinvokes.size(); ++i) {
       // if (i > 0) {
@@ -1299,12 +1352,16 @@ std::vector<sys::FenceRef> _record_invoke_impl(
       }
     }
     vkCmdEndRenderPass(cmdbuf);
-    L_DEBUG("render pass invocation '", invoke.info.label, "' ended");
+    L_DEBUG_RATE_LIMITED(
+      10, "render pass invocation '", invoke.info.label, "' ended"
+    );
   } else if (invoke.composite_detail) {
     const InvocationCompositeDetail& composite_detail =
       *invoke.composite_detail;
 
-    L_DEBUG("composite invocation '", invoke.info.label, "' began");
+    L_DEBUG_RATE_LIMITED(
+      10, "composite invocation '", invoke.info.label, "' began"
+    );
 
     for (size_t i = 0; i < composite_detail.subinvokes.size(); ++i) {
       const VulkanInvocationRef& subinvoke = composite_detail.subinvokes[i];
@@ -1316,7 +1373,9 @@ std::vector<sys::FenceRef> _record_invoke_impl(
       }
     }
 
-    L_DEBUG("composite invocation '", invoke.info.label, "' ended");
+    L_DEBUG_RATE_LIMITED(
+      10, "composite invocation '", invoke.info.label, "' ended"
+    );
   } else {
     unreachable();
   }
@@ -1324,7 +1383,7 @@ std::vector<sys::FenceRef> _record_invoke_impl(
   if (invoke.query_pool.is_valid()) {
     VkCommandBuffer cmdbuf2 = _get_cmdbuf(transact, L_SUBMIT_TYPE_ANY);
     if (cmdbuf != cmdbuf2) {
-      L_WARN(
+      L_WARN_ONCE(
         "begin and end timestamps are recorded in different command "
         "buffers, timing accuracy might be compromised"
       );
@@ -1334,7 +1393,9 @@ std::vector<sys::FenceRef> _record_invoke_impl(
     );
   }
 
-  L_DEBUG("scheduled invocation '", invoke.info.label, "' for execution");
+  L_DEBUG_RATE_LIMITED(
+    10, "scheduled invocation '", invoke.info.label, "' for execution"
+  );
 
   return {};
 }
@@ -8,11 +8,23 @@
 namespace liong {
 namespace vk {
 
+// Framebuffers are keyed by attachment views, so the ones of transient or
+// resized images are never hit again. Let them go after a while.
+FramebufferPool::Config _get_framebuf_pool_cfg() {
+  FramebufferPool::Config out {};
+  out.max_idle = 64;
+  out.max_idle_per_key = 4;
+  out.max_idle_time = std::chrono::seconds(10);
+  return out;
+}
+
 VulkanRenderPass::VulkanRenderPass(
   const VulkanContextRef& ctxt,
   RenderPassInfo&& info
 ) :
-  RenderPass(std::move(info)), ctxt(ctxt) {}
+  RenderPass(std::move(info)),
+  ctxt(ctxt),
+  framebuf_pool(_get_framebuf_pool_cfg()) {}
 
 VkAttachmentLoadOp _get_load_op(AttachmentAccess attm_access) {
   if (attm_access & L_ATTACHMENT_ACCESS_CLEAR_BIT) {
@@ -231,8 +243,9 @@ FramebufferPoolItem VulkanRenderPass::acquire_framebuf(
   const std::vector<ResourceView>& attms
 ) {
   FramebufferKey key = FramebufferKey::create(*this, attms);
-  if (framebuf_pool.has_free_item(key)) {
-    return framebuf_pool.acquire(std::move(key));
+  FramebufferPoolItem item{};
+  if (framebuf_pool.try_acquire(key, item)) {
+    return item;
   } else {
     return framebuf_pool.create(std::move(key), _create_framebuf(*this, attms));
   }
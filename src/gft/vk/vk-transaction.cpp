@@ -1,5 +1,7 @@
 #include "gft/vk/vk-transaction.hpp"
+#include "gft/arena.hpp"
 #include "gft/log.hpp"
+#include "gft/profile.hpp"
 
 namespace liong {
 namespace vk {
@@ -10,17 +12,33 @@ VulkanTransaction::VulkanTransaction(
 ) :
   Transaction(std::move(info)), ctxt(ctxt) {}
 
+// Each submission is a frame of the submitting thread's frame arenas; scratch
+// data of the submission is drawn from that frame's arena. Submissions still
+// allocate from the heap for:
+//
+// - the `VulkanTransaction` object and its `submit_details` and `fences`
+//   lists, which live until the transaction is destroyed;
+// - a command buffer handle and a signal semaphore per queue switch, and a
+//   fence per submission (two more for presentation);
+// - the swapchain image index on every acquisition;
+// - the `InvocationTransitionDetail` lists of invocations created per frame;
+//   they are kept by the invocation, so build invocations once and reuse
+//   them to avoid this.
 TransactionRef VulkanTransaction::create(
   const InvocationRef& invoke,
   const TransactionConfig& cfg
 ) {
   const VulkanInvocationRef& invoke_ = VulkanInvocation::from_hal(invoke);
   const VulkanContextRef& ctxt = VulkanContext::from_hal(invoke_->ctxt);
+  arena::get_frame_arenas().begin_frame();
 
   TransactionLike transact(ctxt, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
   util::Timer timer{};
   timer.tic();
-  invoke_->record(transact);
+  {
+    L_PROFILE_SCOPE("vk::VulkanTransaction::record");
+    invoke_->record(transact);
+  }
   timer.toc();
 
   TransactionInfo info{};
@@ -30,7 +48,8 @@ TransactionRef VulkanTransaction::create(
     std::make_shared<VulkanTransaction>(ctxt, std::move(info));
   out->submit_details = std::move(transact.submit_details);
   out->fences = std::move(transact.fences);
-  L_DEBUG(
+  L_DEBUG_RATE_LIMITED(
+    10,
     "created and submitted transaction for execution, command recording took ",
     timer.us(), "us"
   );
@@ -38,14 +57,15 @@ TransactionRef VulkanTransaction::create(
 }
 VulkanTransaction::~VulkanTransaction() {
   if (!is_waited) {
-    L_WARN(
+    L_WARN_RATE_LIMITED(
+      1,
       "destroying transaction '", info.label, "' before it is done, waiting "
       "for it to finish (it's better you wait it explicit on your own)"
     );
     wait();
   }
   if (fences.size() > 0) {
-    L_DEBUG("destroyed transaction");
+    L_DEBUG_RATE_LIMITED(10, "destroyed transaction");
   }
 }
 bool VulkanTransaction::is_done() {
@@ -53,8 +73,10 @@ bool VulkanTransaction::is_done() {
 }
 void VulkanTransaction::wait() {
   if (is_waited) { return; }
+  L_PROFILE_SCOPE("vk::VulkanTransaction::wait");
 
-  std::vector<VkFence> fences2(fences.size());
+  arena::ArenaScope scope(arena::get_frame_arenas().get());
+  arena::Vector<VkFence> fences2(fences.size(), VK_NULL_HANDLE, scope.arena);
   for (size_t i = 0; i < fences.size(); ++i) {
     fences2.at(i) = fences.at(i)->fence;
   }
@@ -79,14 +101,17 @@ void VulkanTransaction::wait() {
     submit_detail.cmdbuf.reset();
 
     VK_ASSERT << vkResetCommandPool(
-      *ctxt->dev, submit_detail.cmd_pool.inner->value->cmd_pool, 0
+      *ctxt->dev, submit_detail.cmd_pool.value()->cmd_pool, 0
     );
 
     submit_detail.cmd_pool.release();
   }
 
-  L_DEBUG("command drain returned after ", wait_timer.us(), "us since the wait "
-    "started (spin interval = ", SPIN_INTERVAL / 1000.0, "us)");
+  L_DEBUG_RATE_LIMITED(
+    10,
+    "command drain returned after ", wait_timer.us(), "us since the wait "
+    "started (spin interval = ", SPIN_INTERVAL / 1000.0, "us)"
+  );
   is_waited = true;
 }
 
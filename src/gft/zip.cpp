@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <stdexcept>
 #include "gft/assert.hpp"
 #include "gft/log.hpp"
 #include "gft/zip.hpp"
@@ -18,7 +20,6 @@ struct ZipParser {
   stream::ReadStream stream;
   std::vector<ZipFileRecord> records;
   std::map<uint32_t, size_t> rel_offset2irecord;
-  std::map<std::string, size_t> file_name2irecord;
   uint32_t cdr_offset;
 
   ZipParser(const void* data, size_t size) : stream(data, size), cdr_offset() {}
@@ -45,27 +46,25 @@ struct ZipParser {
     if (compressed_size == 0xFFFFFFFF || uncompressed_size == 0xFFFFFFFF) {
       L_ERROR("zip64 is not supported");
     }
-    std::string file_name(stream.extract<uint16_t>(), '\0');
-    std::vector<uint8_t> extra_field(stream.extract<uint16_t>());
-    if (stream.size_remain() < file_name.size() + extra_field.size()) {
+    uint16_t file_name_size = stream.extract<uint16_t>();
+    uint16_t extra_field_size = stream.extract<uint16_t>();
+    if (stream.size_remain() < file_name_size + extra_field_size) {
       L_ERROR("corrupted local file header");
       return false;
     }
-    stream.extract_data(file_name.data(), file_name.size());
-    stream.extract_data(extra_field.data(), extra_field.size());
+    stream::ReadView<char> file_name = stream.view<char>(file_name_size);
+    stream.skip(extra_field_size);
 
     size_t irecord = records.size();
 
     rel_offset2irecord[rel_offset] = irecord;
 
     ZipFileRecord& record = records.emplace_back();
-    record.file_name = file_name;
+    record.file_name = std::string(file_name.begin(), file_name.end());
     record.data = stream.pos();
     record.size = uncompressed_size;
     record.crc32 = crc32;
 
-    file_name2irecord[file_name] = irecord;
-
     stream.skip(compressed_size);
 
     if ((flags & 0x8) != 0) {
@@ -111,9 +110,9 @@ struct ZipParser {
     uint32_t crc32 = stream.extract<uint32_t>();
     uint32_t compressed_size = stream.extract<uint32_t>();
     uint32_t uncompressed_size = stream.extract<uint32_t>();
-    std::string file_name(stream.extract<uint16_t>(), '\0');
-    std::vector<uint8_t> extra_field(stream.extract<uint16_t>());
-    std::string comment(stream.extract<uint16_t>(), '\0');
+    uint16_t file_name_size = stream.extract<uint16_t>();
+    uint16_t extra_field_size = stream.extract<uint16_t>();
+    uint16_t comment_size = stream.extract<uint16_t>();
     uint16_t disk_number = stream.extract<uint16_t>();
     if (disk_number != 0) {
       L_ERROR("multi-disk zip file is not supported");
@@ -122,9 +121,14 @@ struct ZipParser {
     uint16_t internal_attrs = stream.extract<uint16_t>();
     uint32_t external_attrs = stream.extract<uint32_t>();
     uint32_t rel_offset = stream.extract<uint32_t>();
-    stream.extract_data(file_name.data(), file_name.size());
-    stream.extract_data(extra_field.data(), extra_field.size());
-    stream.extract_data(comment.data(), comment.size());
+    size_t var_size = file_name_size + extra_field_size + comment_size;
+    if (stream.size_remain() < var_size) {
+      L_ERROR("corrupted central directory file header");
+      return false;
+    }
+    stream::ReadView<char> file_name = stream.view<char>(file_name_size);
+    stream.skip(extra_field_size);
+    stream.skip(comment_size);
 
     auto it = rel_offset2irecord.find(rel_offset);
     if (it == rel_offset2irecord.end()) {
@@ -133,7 +137,10 @@ struct ZipParser {
     }
 
     const ZipFileRecord& record = records.at(it->second);
-    if (record.file_name != file_name) {
+    if (record.file_name.size() != file_name.size() ||
+        !std::equal(
+          file_name.begin(), file_name.end(), record.file_name.begin()
+        )) {
       L_ERROR("zip file name in file entry mismatched the cdr");
       return false;
     }
@@ -164,8 +171,8 @@ struct ZipParser {
     }
     uint32_t cdr_size_total = stream.extract<uint32_t>();
     uint32_t cdr_offset = stream.extract<uint32_t>();
-    std::string comment(stream.extract<uint16_t>(), '\0');
-    stream.extract_data(comment.data(), comment.size());
+    uint16_t comment_size = stream.extract<uint16_t>();
+    stream.skip(comment_size);
     return true;
   }
 
@@ -234,13 +241,14 @@ struct ZipParser {
 };
 
 struct ZipArchiver {
-  stream::WriteStream stream;
+  stream::ChunkedWriteStream stream;
   const std::vector<ZipFileRecord>& records;
   std::vector<uint32_t> rel_offsets;
   uint32_t cdr_offset;
   uint32_t ecdr_offset;
 
-  ZipArchiver(const std::vector<ZipFileRecord>& records) : records(records) {}
+  ZipArchiver(const std::vector<ZipFileRecord>& records) :
+    records(records), cdr_offset(), ecdr_offset() {}
 
   void append_file_records() {
     for (size_t i = 0; i < records.size(); ++i) {
@@ -260,11 +268,12 @@ struct ZipArchiver {
       stream.append<uint16_t>(0); // extra field size
       stream.append_data(record.file_name.data(), record.file_name.size());
 
-      stream.append_data(record.data, record.size);
+      // File data are kept alive by the archive so don't copy them.
+      stream.append_data_ref(record.data, record.size);
     }
   }
   void append_central_directory_records() {
-    uint32_t cdr_offset = (uint32_t)stream.size();
+    cdr_offset = (uint32_t)stream.size();
 
     for (size_t i = 0; i < records.size(); ++i) {
       const ZipFileRecord& record = records.at(i);
@@ -289,7 +298,7 @@ struct ZipArchiver {
     }
   }
   void append_end_of_central_directory_record() {
-    uint32_t ecdr_offset = (uint32_t)stream.size();
+    ecdr_offset = (uint32_t)stream.size();
 
     stream.append<uint32_t>(L_ZIP_SIGNATURE_END_OF_CENTRAL_DIRECTORY_RECORD);
     stream.append<uint16_t>(0);                        // current disk number
@@ -317,7 +326,6 @@ ZipArchive ZipArchive::from_bytes(const uint8_t* data, size_t size) {
 
   ZipArchive ar {};
   ar.records = std::move(parser.records);
-  ar.file_name2irecord = std::move(parser.file_name2irecord);
   return ar;
 }
 ZipArchive ZipArchive::from_bytes(const std::vector<uint8_t>& data) {
@@ -325,6 +333,108 @@ ZipArchive ZipArchive::from_bytes(const std::vector<uint8_t>& data) {
 }
 
 
+namespace {
+
+// Split a path into segments. Directory segments keep their trailing slashes.
+std::vector<std::string> split_path(const std::string& path) {
+  std::vector<std::string> out;
+  size_t beg = 0;
+  while (beg < path.size()) {
+    size_t end = path.find('/', beg);
+    if (end == std::string::npos) {
+      out.emplace_back(path, beg, path.size() - beg);
+      break;
+    }
+    // Empty segments (`a//b`, `/a`) are not meaningful in archives.
+    if (end != beg) {
+      out.emplace_back(path, beg, end + 1 - beg);
+    }
+    beg = end + 1;
+  }
+  return out;
+}
+
+void index_record(ZipArchiveIndex& index, const std::string& file_name) {
+  size_t irecord = index.nrecord++;
+  index.file_name2irecord[file_name] = irecord;
+
+  std::vector<ZipPathTrieNode>& nodes = index.trie_nodes;
+  if (nodes.empty()) {
+    nodes.emplace_back(ZipPathTrieNode { (size_t)-1, {} });
+  }
+  size_t inode = 0;
+  for (auto& seg : split_path(file_name)) {
+    auto it = nodes.at(inode).children.find(seg);
+    if (it == nodes.at(inode).children.end()) {
+      size_t inode_child = nodes.size();
+      nodes.at(inode).children.emplace(std::move(seg), inode_child);
+      nodes.emplace_back(ZipPathTrieNode { (size_t)-1, {} });
+      inode = inode_child;
+    } else {
+      inode = it->second;
+    }
+  }
+  nodes.at(inode).irecord = irecord;
+}
+ZipArchiveIndex build_index(const std::vector<ZipFileRecord>& records) {
+  ZipArchiveIndex out {};
+  for (const auto& record : records) {
+    index_record(out, record.file_name);
+  }
+  return out;
+}
+
+} // namespace
+
+ZipArchiveIndexCache::ZipArchiveIndexCache(const ZipArchiveIndexCache& b) :
+  mutex_(),
+  index_() {
+  std::lock_guard<std::mutex> guard(b.mutex_);
+  index_ = b.index_;
+}
+ZipArchiveIndexCache& ZipArchiveIndexCache::operator=(
+  const ZipArchiveIndexCache& b
+) {
+  if (this != &b) {
+    std::shared_ptr<ZipArchiveIndex> index;
+    {
+      std::lock_guard<std::mutex> guard(b.mutex_);
+      index = b.index_;
+    }
+    std::lock_guard<std::mutex> guard(mutex_);
+    index_ = std::move(index);
+  }
+  return *this;
+}
+std::shared_ptr<const ZipArchiveIndex> ZipArchiveIndexCache::get(
+  const std::vector<ZipFileRecord>& records
+) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (index_ == nullptr || index_->nrecord != records.size()) {
+    index_ = std::make_shared<ZipArchiveIndex>(build_index(records));
+  }
+  return index_;
+}
+void ZipArchiveIndexCache::add_last(
+  const std::vector<ZipFileRecord>& records
+) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  // Indices shared with copies of the archive are never modified.
+  if (
+    index_ != nullptr &&
+    index_.use_count() == 1 &&
+    index_->nrecord + 1 == records.size()
+  ) {
+    index_record(*index_, records.back().file_name);
+  } else {
+    index_.reset();
+  }
+}
+void ZipArchiveIndexCache::invalidate() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  index_.reset();
+}
+
 void ZipArchive::add_file(
   const std::string& file_name,
   const void* data,
@@ -336,14 +446,144 @@ void ZipArchive::add_file(
   record.size = size;
   record.crc32 = util::crc32(data, size);
 
-  file_name2irecord.emplace(std::make_pair(file_name, records.size()));
   records.emplace_back(std::move(record));
+  index_cache_.add_last(records);
+}
+void ZipArchive::reindex() {
+  index_cache_.invalidate();
 }
 void ZipArchive::to_bytes(std::vector<uint8_t>& out) const {
   ZipArchiver archiver(records);
   archiver.archive();
   out = archiver.stream.take();
 }
+void ZipArchive::to_file(const char* path) const {
+  ZipArchiver archiver(records);
+  archiver.archive();
+  archiver.stream.save(path);
+}
+
+
+struct ZipGlobber {
+  const std::vector<ZipFileRecord>& records;
+  const std::vector<ZipPathTrieNode>& trie_nodes;
+  std::vector<std::string> segs;
+  std::vector<std::string> out;
+
+  ZipGlobber(
+    const std::vector<ZipFileRecord>& records,
+    const std::vector<ZipPathTrieNode>& trie_nodes,
+    const std::string& pattern
+  ) :
+    records(records), trie_nodes(trie_nodes), segs(split_path(pattern)) {
+    // A trailing `**` matches everything underneath.
+    if (!segs.empty() && segs.back() == "**") {
+      segs.back() = "**/";
+      segs.emplace_back("*");
+    }
+  }
+
+  void match(size_t inode, size_t iseg) {
+    const ZipPathTrieNode& node = trie_nodes.at(inode);
+    if (iseg == segs.size()) {
+      if (node.irecord != (size_t)-1) {
+        out.emplace_back(records.at(node.irecord).file_name);
+      }
+      return;
+    }
+
+    const std::string& seg = segs.at(iseg);
+    if (seg == "**/") {
+      // Match zero directory, or one more directory and try again.
+      match(inode, iseg + 1);
+      for (const auto& pair : node.children) {
+        if (pair.first.back() == '/') {
+          match(pair.second, iseg);
+        }
+      }
+    } else if (seg.find_first_of("*?") == std::string::npos) {
+      // Literal segments are looked up directly.
+      auto it = node.children.find(seg);
+      if (it != node.children.end()) {
+        match(it->second, iseg + 1);
+      }
+    } else {
+      bool is_dir = seg.back() == '/';
+      for (const auto& pair : node.children) {
+        if ((pair.first.back() == '/') != is_dir) {
+          continue;
+        }
+        if (util::match_wildcard(seg, pair.first)) {
+          match(pair.second, iseg + 1);
+        }
+      }
+    }
+  }
+
+  std::vector<std::string> glob() {
+    if (segs.empty() || trie_nodes.empty()) {
+      return {};
+    }
+    match(0, 0);
+    // `**` may reach the same record through different paths.
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return std::move(out);
+  }
+};
+
+const ZipFileRecord& ZipArchive::get_file(const std::string& file_name) const {
+  const ZipFileRecord* record = try_get_file(file_name);
+  if (record == nullptr) {
+    throw std::out_of_range("zip archive has no file named " + file_name);
+  }
+  return *record;
+}
+const ZipFileRecord* ZipArchive::try_get_file(const std::string& file_name
+) const {
+  std::shared_ptr<const ZipArchiveIndex> index = index_cache_.get(records);
+  auto it = index->file_name2irecord.find(file_name);
+  if (it == index->file_name2irecord.end()) {
+    return nullptr;
+  }
+  // The record might have been renamed since it was indexed.
+  const ZipFileRecord& record = records.at(it->second);
+  return record.file_name == file_name ? &record : nullptr;
+}
+
+std::vector<std::string> ZipArchive::list_dir(const std::string& dir) const {
+  std::shared_ptr<const ZipArchiveIndex> index = index_cache_.get(records);
+  const std::vector<ZipPathTrieNode>& nodes = index->trie_nodes;
+  if (nodes.empty()) {
+    return {};
+  }
+
+  std::string prefix {};
+  size_t inode = 0;
+  for (auto& seg : split_path(dir)) {
+    if (seg.back() != '/') {
+      seg.push_back('/');
+    }
+    auto it = nodes.at(inode).children.find(seg);
+    if (it == nodes.at(inode).children.end()) {
+      return {};
+    }
+    prefix += seg;
+    inode = it->second;
+  }
+
+  std::vector<std::string> out;
+  out.reserve(nodes.at(inode).children.size());
+  for (const auto& pair : nodes.at(inode).children) {
+    out.emplace_back(prefix + pair.first);
+  }
+  return out;
+}
+std::vector<std::string> ZipArchive::glob(const std::string& pattern) const {
+  std::shared_ptr<const ZipArchiveIndex> index = index_cache_.get(records);
+  ZipGlobber globber(records, index->trie_nodes, pattern);
+  return globber.glob();
+}
 
 
 } // namespace zip